@@ -129,7 +129,8 @@ enum proxy_type_t
 enum storage_mode_t
 {
 	storage_mode_allocate = 0,
-	storage_mode_sparse
+	storage_mode_sparse,
+	storage_mode_fast_allocate
 };
 
 enum state_t
@@ -799,6 +799,7 @@ void bind_session()
     enum_<storage_mode_t>("storage_mode_t")
         .value("storage_mode_allocate", storage_mode_allocate)
         .value("storage_mode_sparse", storage_mode_sparse)
+        .value("storage_mode_fast_allocate", storage_mode_fast_allocate)
     ;
 
     enum_<lt::session::options_t>("options_t")
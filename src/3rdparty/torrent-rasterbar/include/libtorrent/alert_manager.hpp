@@ -183,6 +183,10 @@ namespace libtorrent {
 		// the number of resume data alerts  in the alert queue
 		int m_num_queued_resume;
 
+		// the number of threads blocked in wait_for_alert(). m_condition is
+		// only signalled when this is non-zero
+		int m_num_waiters;
+
 		// this is either 0 or 1, it indicates which m_alerts and m_allocations
 		// the alert_manager is allowed to use right now. This is swapped when
 		// the client calls get_all(), at which point all of the alert objects
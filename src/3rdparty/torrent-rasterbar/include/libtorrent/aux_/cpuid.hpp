@@ -40,6 +40,13 @@ namespace libtorrent { namespace aux
 	// initialized by static initializers (in cpuid.cpp)
 	TORRENT_EXTRA_EXPORT extern bool sse42_support;
 	TORRENT_EXTRA_EXPORT extern bool mmx_support;
+
+	// SHA extensions (SHA-NI). Used by the built-in SHA-1 implementation
+	TORRENT_EXTRA_EXPORT extern bool sha_support;
+
+	// AVX2, including OS support for saving the ymm registers. Used by the
+	// multi-buffer SHA-1 implementation
+	TORRENT_EXTRA_EXPORT extern bool avx2_support;
 } }
 
 #endif // TORRENT_CPUID_HPP_INCLUDED
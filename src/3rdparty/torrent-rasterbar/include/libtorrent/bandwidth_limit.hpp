@@ -82,8 +82,8 @@ struct TORRENT_EXTRA_EXPORT bandwidth_channel
 		return false;
 	}
 
-	// used as temporary storage while distributing
-	// bandwidth
+	// the sum of the priorities of the requests queued on
+	// this channel, as of the bandwidth manager's last tick
 	int tmp;
 
 	// this is the number of bytes to distribute this round
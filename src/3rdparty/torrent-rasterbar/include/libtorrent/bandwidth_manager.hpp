@@ -36,6 +36,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 
 #include <boost/shared_ptr.hpp>
+#include <list>
+#include <deque>
+#include <map>
 
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
@@ -80,12 +83,93 @@ struct TORRENT_EXTRA_EXPORT bandwidth_manager
 
 private:
 
-	// these are the consumers that want bandwidth
-	typedef std::vector<bw_request> queue_t;
-	queue_t m_queue;
+	// quota is handed out in two levels. Requests are queued in class
+	// buckets, one per set of limited bandwidth channels they draw from
+	// (the peer classes of a torrent, the global ones and the peer's own).
+	// Every tick, each bucket takes its share of its channels' quota,
+	// weighted by the sum of the priorities of its requests. Within a
+	// bucket, every request has its own deficit: the bucket's credit per
+	// priority level since the request was queued, times its priority. So
+	// all requests of a bucket accrue quota in step without being visited.
+	// A request is handed its deficit once that's a packet worth for the
+	// highest queued priority, all it asked for, or it has waited a few
+	// ticks. Since requests are queued with the credit of the moment, the
+	// front one is always the first to be due. A tick costs
+	// O(buckets x channels) plus O(1) for every request it hands quota to
+	struct channel_set
+	{
+		bandwidth_channel* channel[bw_request::max_bandwidth_channels];
+		bool operator<(channel_set const& rhs) const;
+	};
+
+	struct queued_request
+	{
+		queued_request(bw_request const& r, boost::uint64_t c, boost::uint32_t t)
+			: request(r), start(c), tick(t) {}
+
+		bw_request request;
+
+		// the bucket's credit when the request was queued
+		boost::uint64_t start;
+
+		// the bucket's tick count when the request was queued
+		boost::uint32_t tick;
+	};
+
+	struct bucket
+	{
+		explicit bucket(channel_set const& c);
+
+		channel_set channels;
+
+		// these are the consumers that want bandwidth
+		std::deque<queued_request> queue;
+
+		// the sum of the priorities of the requests in queue
+		int weight;
+
+		// the quota handed to this bucket per priority level since it was
+		// created, in 1/65536 bytes. It may wrap around, only differences
+		// are used
+		boost::uint64_t credit;
+
+		// the number of ticks since the bucket was created
+		boost::uint32_t ticks;
+
+		// the bytes taken from the channels that haven't been handed to
+		// any request yet. -1 if none of the channels has a limit, then
+		// every request is due right away
+		boost::int64_t reserved;
+	};
+
+	typedef std::list<bucket> buckets_t;
+
+	// the deficit of r, in bytes
+	static boost::int64_t deficit(bucket const& b, queued_request const& r);
+
+	// hands the requests in b that are due their deficit, and moves them
+	// to done
+	void serve_bucket(bucket& b, std::vector<bw_request>& done);
+	void pop_request(bucket& b, std::vector<bw_request>& done);
+
+	buckets_t m_buckets;
+
+	// all buckets, keyed by their channels
+	typedef std::map<channel_set, buckets_t::iterator> bucket_index_t;
+	bucket_index_t m_bucket_index;
+
+	// the number of requests in all buckets
+	int m_queue_size;
+
 	// the number of bytes all the requests in queue are for
 	boost::int64_t m_queued_bytes;
 
+	// the highest priority of any request queued since the queue was
+	// last empty. A request of this priority is handed about one packet
+	// worth of quota at a time, also when the rate limit is split across
+	// too many requests for that
+	int m_max_priority;
+
 	// this is the channel within the consumers
 	// that bandwidth is assigned to (upload or download)
 	int m_channel;
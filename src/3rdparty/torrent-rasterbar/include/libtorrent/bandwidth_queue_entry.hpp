@@ -57,16 +57,6 @@ struct TORRENT_EXTRA_EXPORT bw_request
 	// once assigned reaches this, we dispatch the request function
 	int request_size;
 
-	// the max number of rounds for this request to survive
-	// this ensures that requests gets responses at very low
-	// rate limits, when the requested size would take a long
-	// time to satisfy
-	int ttl;
-
-	// loops over the bandwidth channels and assigns bandwidth
-	// from the most limiting one
-	int assign_bandwidth();
-
 	enum { max_bandwidth_channels = 10 };
 	// we don't actually support more than 10 channels per peer
 	bandwidth_channel* channel[max_bandwidth_channels];
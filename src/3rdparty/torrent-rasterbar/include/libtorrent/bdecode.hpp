@@ -343,7 +343,11 @@ struct TORRENT_EXPORT bdecode_node
 	// useful if you know approximately how many tokens are in the file
 	// you are about to parse. Doing so will save realloc operations
 	// while parsing. You should only call this on the root node, before
-	// passing it in to bdecode().
+	// passing it in to bdecode(). A node that is reused for parsing keeps
+	// its token storage, so parsing a stream of messages into the same node
+	// stops allocating once it has grown to fit the largest one. Without
+	// either, bdecode() estimates the number of tokens from the size of the
+	// input.
 	void reserve(int tokens);
 
 	// this buffer *MUST* be identical to the one originally parsed. This
@@ -221,8 +221,12 @@ namespace libtorrent
 		void write_have(int index) TORRENT_OVERRIDE;
 		void write_dont_have(int index) TORRENT_OVERRIDE;
 		void write_piece(peer_request const& r, disk_buffer_holder& buffer) TORRENT_OVERRIDE;
+		void write_piece_from_files(peer_request const& r
+			, std::vector<file_range> const& ranges) TORRENT_OVERRIDE;
+		bool can_send_zero_copy() const TORRENT_OVERRIDE;
 		void write_keepalive() TORRENT_OVERRIDE;
 		void write_handshake();
+		void write_piece_header(peer_request const& r);
 #ifndef TORRENT_DISABLE_EXTENSIONS
 		void write_extensions();
 		void write_upload_only();
@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/config.hpp"
 #include "libtorrent/disk_io_job.hpp" // for block_cache_reference
 #include "libtorrent/debug.hpp"
+#include "libtorrent/file.hpp" // for file_range
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 
@@ -72,6 +73,12 @@ namespace libtorrent
 			int size; // the total size of the buffer
 			int used_size; // this is the number of bytes to send/receive
 			block_cache_reference ref;
+
+			// for buffers backed by a file rather than memory (see
+			// append_file()), ``buf`` and ``start`` are NULL and this is the
+			// file and the offset of the first byte to send
+			file_handle file;
+			boost::int64_t file_offset;
 		};
 
 		bool empty() const { return m_bytes == 0; }
@@ -88,6 +95,19 @@ namespace libtorrent
 			, free_buffer_fun destructor, void* userdata
 			, block_cache_reference ref = block_cache_reference());
 
+		// appends a range of a file, to be sent from the file directly rather
+		// than from memory. build_iovec() stops at file ranges, the caller is
+		// expected to check front_file() and send them separately
+		void append_file(file_range const& r);
+
+		// if the first buffer in the chain is a file range, sets ``r`` to what
+		// is left to send of it and returns true
+		bool front_file(file_range& r) const;
+
+		// returns true if sending ``bytes`` bytes from the front reaches a
+		// file range, i.e. all buffers in memory in front of it fit in them
+		bool reaches_file(int bytes) const;
+
 		// returns the number of bytes available at the
 		// end of the last chained buffer.
 		int space_in_last_buffer();
@@ -413,8 +413,19 @@ namespace libtorrent
 	// 
 	// The overloads that don't take an ``error_code&`` may throw an exception in case of a
 	// file error, the other overloads sets the error code to reflect the error, if any.
+	//
+	// The files are read front to back by the calling thread, in chunks of at least 4 MiB,
+	// and hashed by one thread per CPU core. The chunk buffers are capped at 64 MiB in total,
+	// so with very large pieces fewer threads are used. ``f`` is always called on the
+	// calling thread.
 	TORRENT_EXPORT void set_piece_hashes(create_torrent& t, std::string const& p
 		, boost::function<void(int)> const& f, error_code& ec);
+
+	// Like set_piece_hashes() above, with ``num_threads`` hashing threads (0 means one per
+	// CPU core). Returning false from ``f`` stops hashing and sets ``ec`` to
+	// ``boost::asio::error::operation_aborted``.
+	TORRENT_EXPORT void set_piece_hashes(create_torrent& t, std::string const& p
+		, boost::function<bool(int)> const& f, int num_threads, error_code& ec);
 	inline void set_piece_hashes(create_torrent& t, std::string const& p, error_code& ec)
 	{
 		set_piece_hashes(t, p, detail::nop, ec);
@@ -54,6 +54,7 @@ namespace libtorrent
 	struct cached_piece_entry;
 	struct bdecode_node;
 	class torrent_info;
+	struct file_range;
 
 	struct block_cache_reference
 	{
@@ -104,6 +105,8 @@ namespace libtorrent
 			, load_torrent
 			, clear_piece
 			, tick_storage
+			, check_pieces
+			, map_read
 			, resolve_links
 
 			, num_job_ids
@@ -152,13 +155,19 @@ namespace libtorrent
 		// for aiocb_complete this points to the aiocb that completed
 		// for get_cache_info this points to a cache_status object which
 		// is filled in
+		// for check_pieces this is the array of resulting piece hashes,
+		// 20 bytes per piece, allocated with malloc()
+		// for map_read this is the list of file ranges the block is
+		// stored in, allocated with new
 		union
 		{
 			char* disk_block;
 			char* string;
+			char* piece_hashes;
 			entry* resume_data;
 			bdecode_node const* check_resume_data;
 			std::vector<boost::uint8_t>* priorities;
+			std::vector<file_range>* file_ranges;
 			torrent_info* torrent_file;
 			int delete_options;
 		} buffer;
@@ -185,6 +194,15 @@ namespace libtorrent
 			// the hard link to.
 			std::vector<std::string>* links;
 
+			// for check_pieces jobs. The number of consecutive pieces to hash,
+			// starting at ``piece``, and the number of them that were hashed
+			// before an error was encountered
+			struct check_args
+			{
+				boost::uint16_t num_pieces;
+				boost::uint16_t num_hashed;
+			} check;
+
 			struct io_args
 			{
 			// if this is set, the read operation is required to
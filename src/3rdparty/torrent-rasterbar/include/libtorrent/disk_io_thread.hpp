@@ -308,6 +308,17 @@ namespace libtorrent
 			, int flags = 0) TORRENT_OVERRIDE;
 		void async_hash(piece_manager* storage, int piece, int flags
 			, boost::function<void(disk_io_job const*)> const& handler, void* requester) TORRENT_OVERRIDE;
+		void async_check_pieces(piece_manager* storage, int piece
+			, int num_pieces, int flags
+			, boost::function<void(disk_io_job const*)> const& handler) TORRENT_OVERRIDE;
+
+		// looks up which files, and where in them, the block ``r`` is stored,
+		// so it can be sent without reading it into a buffer. Returns false
+		// (and doesn't call the handler) if the block has to be read with
+		// async_read() instead, because it's in the cache
+		bool async_map_read(piece_manager* storage, peer_request const& r
+			, boost::function<void(disk_io_job const*)> const& handler
+			, int flags = 0) TORRENT_OVERRIDE;
 		void async_move_storage(piece_manager* storage, std::string const& p, int flags
 			, boost::function<void(disk_io_job const*)> const& handler) TORRENT_OVERRIDE;
 		void async_release_files(piece_manager* storage
@@ -432,6 +443,9 @@ namespace libtorrent
 		int do_load_torrent(disk_io_job* j, jobqueue_t& completed_jobs);
 		int do_clear_piece(disk_io_job* j, jobqueue_t& completed_jobs);
 		int do_tick(disk_io_job* j, jobqueue_t& completed_jobs);
+		int do_check_pieces(disk_io_job* j, jobqueue_t& completed_jobs);
+		int do_map_read(disk_io_job* j, jobqueue_t& completed_jobs);
+		bool block_in_cache(disk_io_job const* j);
 		int do_resolve_links(disk_io_job* j, jobqueue_t& completed_jobs);
 
 		void call_job_handlers(void* userdata);
@@ -282,6 +282,11 @@ namespace libtorrent
 			// when creating a file, set the executable attribute
 			attribute_executable = 0x400,
 
+			// when allocating the file (i.e. not in sparse mode), only do so if
+			// the filesystem supports it natively. Never fall back to writing
+			// zeros to the file
+			fast_allocate = 0x800,
+
 			// the mask of all attribute bits
 			attribute_mask = attribute_hidden | attribute_executable
 		};
@@ -355,6 +360,16 @@ namespace libtorrent
 
 	TORRENT_EXTRA_EXPORT int bufs_size(file::iovec_t const* bufs, int num_bufs);
 
+	// a range of bytes in an open file. Used to hand data to the network
+	// without reading it into memory first (see
+	// storage_interface::map_file_ranges())
+	struct file_range
+	{
+		file_handle handle;
+		boost::int64_t offset;
+		int size;
+	};
+
 }
 
 #endif // TORRENT_FILE_HPP_INCLUDED
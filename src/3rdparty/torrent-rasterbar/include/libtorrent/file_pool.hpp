@@ -33,11 +33,19 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef TORRENT_FILE_POOL_HPP
 #define TORRENT_FILE_POOL_HPP
 
-#include <map>
+#include <vector>
+#include <utility>
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <boost/unordered_map.hpp>
+#include <boost/atomic.hpp>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
 #include "libtorrent/file.hpp"
 #include "libtorrent/time.hpp"
 #include "libtorrent/thread.hpp"
 #include "libtorrent/file_storage.hpp"
+#include "libtorrent/linked_list.hpp"
 #include "libtorrent/aux_/time.hpp"
 
 namespace libtorrent
@@ -80,6 +88,11 @@ namespace libtorrent
 	// not opening more file handles than specified. Given multiple threads,
 	// each with the ability to lock a file handle (via smart pointer), there
 	// may be windows where more file handles are open.
+	//
+	// The handles are split into shards by storage, each with its own mutex,
+	// hash table and LRU list, so disk threads working on different torrents
+	// don't contend, and evicting the least recently used file doesn't
+	// depend on the number of open files.
 	struct TORRENT_EXPORT file_pool : boost::noncopyable
 	{
 		// ``size`` specifies the number of allowed files handles
@@ -105,6 +118,11 @@ namespace libtorrent
 		// by the file_pool.
 		int size_limit() const { return m_size; }
 
+		// the limit used when the file_pool_size setting is 0. It's a fifth of
+		// the file descriptors this process may open (see RLIMIT_NOFILE), the
+		// rest is meant for peer connections.
+		static int default_size_limit();
+
 		// internal
 		void set_low_prio_io(bool b) { m_low_prio_io = b; }
 		void get_status(std::vector<pool_file_status>* files, void* st) const;
@@ -126,32 +144,70 @@ namespace libtorrent
 
 	private:
 
-		file_handle remove_oldest(mutex::scoped_lock&);
-
-		int m_size;
-		bool m_low_prio_io;
+		typedef std::pair<void*, int> file_key;
 
-		struct lru_file_entry
+		struct lru_file_entry : list_node<lru_file_entry>
 		{
 			lru_file_entry()
-				: opened(aux::time_now())
+				: key(static_cast<void*>(NULL), 0)
+				, opened(aux::time_now())
 				, last_use(opened)
+				, use_seq(0)
 				, mode(0) {}
+			file_key key;
 			file_handle file_ptr;
 			time_point const opened;
 			time_point last_use;
+			// orders uses across shards. last_use is too coarse for that,
+			// aux::time_now() is only updated once per session tick
+			boost::uint64_t use_seq;
 			int mode;
 		};
 
 		// maps storage pointer, file index pairs to the
 		// LRU entry for the file
-		typedef std::map<std::pair<void*, int>, lru_file_entry> file_set;
+		typedef boost::unordered_map<file_key, lru_file_entry> file_set;
+
+		enum { num_shards = 16 };
+
+		struct shard
+		{
+			file_set files;
+
+			// the entries in ``files``, most recently used first
+			linked_list<lru_file_entry> lru;
+
+			mutable mutex mtx;
+		};
+
+		shard& shard_for(void* st);
+		shard const& shard_for(void* st) const;
+
+		// unlinks and removes the entry from its shard. The shard's mutex
+		// must be held. The file handle is returned so it can be closed
+		// after the mutex is released
+		file_handle erase_entry(shard& s, file_set::iterator i);
+
+		// closes least recently used files until no more than m_size are open.
+		// The file handles are added to ``defer_destruction``, to be closed by
+		// the caller. No shard mutex may be held when calling this
+		void trim(std::vector<file_handle>& defer_destruction);
+
+		boost::atomic<int> m_size;
+		bool m_low_prio_io;
+
+		// the number of open files, across all shards
+		boost::atomic<int> m_num_files;
+
+		// incremented on every file use, see lru_file_entry::use_seq
+		boost::atomic<boost::uint64_t> m_use_counter;
+
+		shard m_shards[num_shards];
 
-		file_set m_files;
 #if TORRENT_USE_ASSERTS
 		std::vector<std::pair<std::string, void const*> > m_deleted_storages;
+		mutable mutex m_deleted_mutex;
 #endif
-		mutable mutex m_mutex;
 	};
 }
 
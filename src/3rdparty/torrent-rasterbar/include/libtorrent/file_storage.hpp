@@ -430,6 +430,7 @@ namespace libtorrent
 			swap(ti.m_file_base, m_file_base);
 #endif
 			swap(ti.m_paths, m_paths);
+			swap(ti.m_path_lookup, m_path_lookup);
 			swap(ti.m_name, m_name);
 			swap(ti.m_total_size, m_total_size);
 			swap(ti.m_num_pieces, m_num_pieces);
@@ -584,6 +585,7 @@ namespace libtorrent
 	private:
 
 		int get_or_add_path(char const* branch_path, int branch_len);
+		void rebuild_path_lookup(std::size_t size);
 
 		void add_pad_file(int size
 			, std::vector<internal_file_entry>::iterator& i
@@ -640,6 +642,13 @@ namespace libtorrent
 		// entry appended, to form full file paths
 		std::vector<std::string> m_paths;
 
+		// hash table (open addressing) of indices into m_paths, -1 marks an
+		// empty slot. It lets get_or_add_path() find the index of a directory
+		// without comparing against every path, which made adding files
+		// quadratic for torrents with many directories. The size is a power
+		// of two, at least twice the number of paths
+		std::vector<int> m_path_lookup;
+
 		// name of torrent. For multi-file torrents
 		// this is always the root directory
 		std::string m_name;
@@ -37,9 +37,12 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 
-#include <set>
 #include <vector>
+#include <string>
 #include <iterator>
+#include <algorithm>
+#include <utility>
+#include <cstring>
 
 #include <boost/limits.hpp>
 #include <boost/utility.hpp>
@@ -50,6 +53,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/address.hpp"
 #include "libtorrent/assert.hpp"
+#include "libtorrent/error_code.hpp"
 
 namespace libtorrent
 {
@@ -138,9 +142,43 @@ namespace detail
 	inline boost::uint16_t max_addr<boost::uint16_t>()
 	{ return (std::numeric_limits<boost::uint16_t>::max)(); }
 
+	// address comparison used by the filter lookup. The IPv4 and IPv6
+	// overloads compare whole words instead of byte by byte, which lets the
+	// compiler turn the binary search into conditional moves
+	template<class Addr>
+	bool addr_less(Addr const& lhs, Addr const& rhs) { return lhs < rhs; }
+
+	inline boost::uint32_t load_be32(unsigned char const* p)
+	{
+		return (boost::uint32_t(p[0]) << 24) | (boost::uint32_t(p[1]) << 16)
+			| (boost::uint32_t(p[2]) << 8) | boost::uint32_t(p[3]);
+	}
+
+	inline bool addr_less(address_v4::bytes_type const& lhs
+		, address_v4::bytes_type const& rhs)
+	{ return load_be32(&lhs[0]) < load_be32(&rhs[0]); }
+
+#if TORRENT_USE_IPV6
+	inline bool addr_less(address_v6::bytes_type const& lhs
+		, address_v6::bytes_type const& rhs)
+	{
+		boost::uint64_t const lh = (boost::uint64_t(load_be32(&lhs[0])) << 32) | load_be32(&lhs[4]);
+		boost::uint64_t const rh = (boost::uint64_t(load_be32(&rhs[0])) << 32) | load_be32(&rhs[4]);
+		boost::uint64_t const ll = (boost::uint64_t(load_be32(&lhs[8])) << 32) | load_be32(&lhs[12]);
+		boost::uint64_t const rl = (boost::uint64_t(load_be32(&rhs[8])) << 32) | load_be32(&rhs[12]);
+		return (lh < rh) | ((lh == rh) & (ll < rl));
+	}
+#endif
+
 	// this is the generic implementation of
 	// a filter for a specific address type.
 	// it works with IPv4 and IPv6
+	//
+	// the rules are kept as a flat array of ranges sorted by start address,
+	// each range extending to the start of the next one, so lookups are a
+	// binary search over contiguous memory. New rules are queued and merged
+	// into the array in one pass the next time the filter is queried, which
+	// keeps adding millions of rules (i.e. loading a blocklist) cheap.
 	template<class Addr>
 	class filter_impl
 	{
@@ -149,78 +187,37 @@ namespace detail
 		filter_impl()
 		{
 			// make the entire ip-range non-blocked
-			m_access_list.insert(range(zero<Addr>(), 0));
+			m_access_list.push_back(range(zero<Addr>(), 0));
 		}
 
 		void add_rule(Addr first, Addr last, int flags)
 		{
-			TORRENT_ASSERT(!m_access_list.empty());
 			TORRENT_ASSERT(first < last || first == last);
-
-			typename range_t::iterator i = m_access_list.upper_bound(first);
-			typename range_t::iterator j = m_access_list.upper_bound(last);
-
-			if (i != m_access_list.begin()) --i;
-
-			TORRENT_ASSERT(j != m_access_list.begin());
-			TORRENT_ASSERT(j != i);
-
-			boost::uint32_t first_access = i->access;
-			boost::uint32_t last_access = std::prev(j)->access;
-
-			if (i->start != first && first_access != flags)
-			{
-				i = m_access_list.insert(i, range(first, flags));
-			}
-			else if (i != m_access_list.begin() && std::prev(i)->access == flags)
-			{
-				--i;
-				first_access = i->access;
-			}
-			TORRENT_ASSERT(!m_access_list.empty());
-			TORRENT_ASSERT(i != m_access_list.end());
-
-			if (i != j) m_access_list.erase(std::next(i), j);
-			if (i->start == first)
-			{
-				// we can do this const-cast because we know that the new
-				// start address will keep the set correctly ordered
-				const_cast<Addr&>(i->start) = first;
-				const_cast<boost::uint32_t&>(i->access) = flags;
-			}
-			else if (first_access != flags)
-			{
-				m_access_list.insert(i, range(first, flags));
-			}
-
-			if ((j != m_access_list.end()
-					&& minus_one(j->start) != last)
-				|| (j == m_access_list.end()
-					&& last != max_addr<Addr>()))
-			{
-				TORRENT_ASSERT(j == m_access_list.end() || last < minus_one(j->start));
-				if (last_access != flags)
-					j = m_access_list.insert(j, range(plus_one(last), last_access));
-			}
-
-			if (j != m_access_list.end() && j->access == flags) m_access_list.erase(j);
-			TORRENT_ASSERT(!m_access_list.empty());
+			m_pending.push_back(rule(first, last, flags));
 		}
 
 		boost::uint32_t access(Addr const& addr) const
 		{
+			apply_pending();
 			TORRENT_ASSERT(!m_access_list.empty());
-			typename range_t::const_iterator i = m_access_list.upper_bound(addr);
-			if (i != m_access_list.begin()) --i;
-			TORRENT_ASSERT(i != m_access_list.end());
-			TORRENT_ASSERT(i->start <= addr && (std::next(i) == m_access_list.end()
-				|| addr < std::next(i)->start));
-			return i->access;
+			// branch-free binary search for the last range starting at or
+			// before addr. The first range always starts at the zero address
+			range const* base = &m_access_list[0];
+			std::size_t n = m_access_list.size();
+			while (n > 1)
+			{
+				std::size_t const half = n / 2;
+				base = addr_less(addr, base[half].start) ? base : base + half;
+				n -= half;
+			}
+			TORRENT_ASSERT(base->start <= addr);
+			return base->access;
 		}
 
 		template <class ExternalAddressType>
 		std::vector<ip_range<ExternalAddressType> > export_filter() const
 		{
+			apply_pending();
 			std::vector<ip_range<ExternalAddressType> > ret;
 			ret.reserve(m_access_list.size());
 
@@ -242,10 +239,41 @@ namespace detail
 			return ret;
 		}
 
+		// the number of entries and their size in bytes, as stored by
+		// serialize()
+		int num_ranges() const { apply_pending(); return int(m_access_list.size()); }
+		static int range_size() { return int(sizeof(range)); }
+
+		// appends the raw rule array to ``buf``. It can only be read back by
+		// a build with the same layout and byte order
+		void serialize(std::vector<char>& buf) const
+		{
+			apply_pending();
+			char const* p = reinterpret_cast<char const*>(&m_access_list[0]);
+			buf.insert(buf.end(), p, p + m_access_list.size() * sizeof(range));
+		}
+
+		// replaces the rules with ``num`` raw ranges produced by serialize().
+		// Returns false (and leaves the filter untouched) if they don't form a
+		// valid filter
+		bool deserialize(char const* buf, int num)
+		{
+			if (num < 1) return false;
+			range_t list(num);
+			std::memcpy(&list[0], buf, num * sizeof(range));
+			if (list[0].start != zero<Addr>()) return false;
+			for (int k = 1; k < num; ++k)
+				if (!(list[k - 1].start < list[k].start)) return false;
+			m_access_list.swap(list);
+			m_pending.clear();
+			return true;
+		}
+
 	private:
 
 		struct range
 		{
+			range(): access(0) {}
 			range(Addr addr, int a = 0): start(addr), access(a) {}
 			bool operator<(range const& r) const
 			{ return start < r.start; }
@@ -253,13 +281,114 @@ namespace detail
 			{ return start < a; }
 			Addr start;
 			// the end of the range is implicit
-			// and given by the next entry in the set
+			// and given by the next entry in the list
 			boost::uint32_t access;
 		};
 
-		typedef std::set<range> range_t;
-		range_t m_access_list;
-	
+		// a rule that hasn't been merged into m_access_list yet
+		struct rule
+		{
+			rule(Addr const& f, Addr const& l, int a): first(f), last(l), access(a) {}
+			Addr first;
+			Addr last;
+			boost::uint32_t access;
+		};
+
+		typedef std::vector<range> range_t;
+
+		static bool rule_first_less(rule const& lhs, rule const& rhs)
+		{ return lhs.first < rhs.first; }
+
+		// appends r, unless it would just extend the last range
+		static void append(range_t& list, range const& r)
+		{
+			if (!list.empty() && list.back().access == r.access) return;
+			TORRENT_ASSERT(list.empty() || list.back().start < r.start);
+			list.push_back(r);
+		}
+
+		// merges the queued rules into m_access_list. Later rules take
+		// precedence over earlier ones, so each run of rules with the same
+		// access is applied in turn. Within a run the order doesn't matter,
+		// which is what lets a run be sorted and merged in one sweep. A
+		// blocklist is a single run, costing O(m log m + n) for m rules added
+		// to a filter of n ranges.
+		void apply_pending() const
+		{
+			if (m_pending.empty()) return;
+
+			typename std::vector<rule>::iterator run = m_pending.begin();
+			while (run != m_pending.end())
+			{
+				typename std::vector<rule>::iterator run_end = run + 1;
+				while (run_end != m_pending.end() && run_end->access == run->access)
+					++run_end;
+				merge_run(run, run_end);
+				run = run_end;
+			}
+			m_pending.clear();
+		}
+
+		// sets the access of all rules in [begin, end), which all have the
+		// same access, on m_access_list
+		void merge_run(typename std::vector<rule>::iterator begin
+			, typename std::vector<rule>::iterator end) const
+		{
+			boost::uint32_t const flags = begin->access;
+			std::sort(begin, end, &rule_first_less);
+
+			// coalesce overlapping and adjacent rules, in place
+			typename std::vector<rule>::iterator out = begin;
+			for (typename std::vector<rule>::iterator r = begin + 1; r != end; ++r)
+			{
+				if (out->last == max_addr<Addr>()
+					|| !(plus_one(out->last) < r->first))
+				{
+					if (out->last < r->last) out->last = r->last;
+				}
+				else
+				{
+					*++out = *r;
+				}
+			}
+			end = out + 1;
+
+			// then merge the disjoint rules with the current ranges in a
+			// single sweep
+			range_t merged;
+			merged.reserve(m_access_list.size() + (end - begin) * 2);
+			typename range_t::const_iterator i = m_access_list.begin();
+			typename range_t::const_iterator const list_end = m_access_list.end();
+			boost::uint32_t prev_access = i->access;
+			for (typename std::vector<rule>::const_iterator r = begin; r != end; ++r)
+			{
+				for (; i != list_end && i->start < r->first; ++i)
+				{
+					append(merged, *i);
+					prev_access = i->access;
+				}
+				append(merged, range(r->first, flags));
+				// skip the ranges covered by the rule, remembering the access
+				// in effect at its last address
+				for (; i != list_end && !(r->last < i->start); ++i)
+					prev_access = i->access;
+
+				if (r->last == max_addr<Addr>()) break;
+				Addr const next = plus_one(r->last);
+				if (i == list_end || next < i->start)
+					append(merged, range(next, prev_access));
+			}
+			for (; i != list_end; ++i) append(merged, *i);
+
+			m_access_list.swap(merged);
+			TORRENT_ASSERT(!m_access_list.empty());
+		}
+
+		// these are updated lazily from const member functions, the same
+		// way piece_picker defers rebuilding its priority list
+		mutable range_t m_access_list;
+		mutable std::vector<rule> m_pending;
+
 	};
 
 }
@@ -294,6 +423,12 @@ struct TORRENT_EXPORT ip_filter
 	// 
 	// This means that in a case of overlapping ranges, the last one applied takes
 	// precedence.
+	//
+	// Rules are queued, and merged into the filter in a single pass the next
+	// time it's queried. Adding a large number of rules is therefore cheap,
+	// but the first query after that does the work of merging them, so a
+	// filter that has just been modified must not be queried from several
+	// threads at once.
 	void add_rule(address first, address last, boost::uint32_t flags);
 
 	// Returns the access permissions for the given address (``addr``). The permission
@@ -318,6 +453,18 @@ struct TORRENT_EXPORT ip_filter
 	// and one for IPv6 addresses.
 	filter_tuple_t export_filter() const;
 
+	// Writes the rules to ``filename`` in a compact binary form, replacing the
+	// file atomically. load_cache() reads it back without any parsing, which
+	// is meant for keeping a preprocessed copy of a large blocklist. The file
+	// is only valid for builds with the same byte order.
+	void save_cache(std::string const& filename, error_code& ec) const;
+
+	// Replaces the rules with the ones stored by save_cache(). The file is
+	// memory mapped where supported. Returns false and sets ``ec`` if the
+	// file can't be read or isn't a valid cache, in which case the filter is
+	// left unchanged.
+	bool load_cache(std::string const& filename, error_code& ec);
+
 //	void print() const;
 
 private:
@@ -328,6 +475,19 @@ private:
 #endif
 };
 
+// Parses a blocklist and sets ``ip_filter::blocked`` on all of its ranges in
+// ``f``. Both the PeerGuardian plaintext format (``description:first-last``)
+// and the eMule ipfilter.dat format (``first - last , level , description``)
+// are supported, line by line, and the buffer may be gzip compressed. IPv6
+// ranges are only recognized in the eMule format. As in eMule, entries with
+// an access level above 127 are not blocked. Comments and lines that can't
+// be parsed are skipped.
+//
+// Returns the number of ranges added, or -1 if the buffer couldn't be
+// inflated, in which case ``ec`` is set.
+TORRENT_EXPORT int parse_blocklist(char const* buf, int size, ip_filter& f
+	, error_code& ec);
+
 // the port filter maps non-overlapping port ranges to flags. This
 // is primarily used to indicate whether a range of ports should
 // be connected to or not. The default is to have the full port
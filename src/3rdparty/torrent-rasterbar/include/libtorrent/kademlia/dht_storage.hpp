@@ -68,9 +68,13 @@ namespace dht
 	// the peers, mutable and immutable items and it's designed to
 	// provide a fast and fully compliant behavior of the BEPs.
 	//
-	// libtorrent comes with one built-in storage implementation:
+	// libtorrent comes with two built-in storage implementations:
 	// ``dht_default_storage`` (private non-accessible class). Its
 	// constructor function is called dht_default_storage_constructor().
+	// ``dht_flat_storage``, for nodes storing a lot of data, keeps torrents
+	// and items in open addressing hash tables and the peers of a torrent in
+	// one flat array, and honors dht_settings::max_storage_memory. Its
+	// constructor function is dht_flat_storage_constructor().
 	//
 	struct TORRENT_EXPORT dht_storage_interface
 	{
@@ -213,6 +217,12 @@ namespace dht
 	TORRENT_EXPORT dht_storage_interface* dht_default_storage_constructor(sha1_hash const& id
 		, dht_settings const& settings);
 
+	// the least recently used torrents and items are evicted when the
+	// storage would exceed dht_settings::max_storage_memory. Pass it to
+	// session_handle::set_dht_storage() before the DHT is started.
+	TORRENT_EXPORT dht_storage_interface* dht_flat_storage_constructor(sha1_hash const& id
+		, dht_settings const& settings);
+
 } } // namespace libtorrent::dht
 
 #endif //TORRENT_DHT_STORAGE_HPP
@@ -70,6 +70,8 @@ struct TORRENT_EXTRA_EXPORT observer : boost::noncopyable
 		, m_refs(0)
 		, m_port(0)
 		, m_transaction_id()
+		, m_short_timeout(1000)
+		, m_timeout(15000)
 		, flags(0)
 	{
 		TORRENT_ASSERT(a);
@@ -123,6 +125,19 @@ struct TORRENT_EXTRA_EXPORT observer : boost::noncopyable
 	boost::uint16_t transaction_id() const
 	{ return m_transaction_id; }
 
+	// milliseconds after sending until short_timeout() and timeout() are
+	// called. Set by the rpc_manager from its round trip time estimates
+	void set_timeouts(int short_timeout_ms, int timeout_ms)
+	{
+		TORRENT_ASSERT(short_timeout_ms > 0 && short_timeout_ms <= 0xffff);
+		TORRENT_ASSERT(timeout_ms >= short_timeout_ms && timeout_ms <= 0xffff);
+		m_short_timeout = boost::uint16_t(short_timeout_ms);
+		m_timeout = boost::uint16_t(timeout_ms);
+	}
+
+	int short_timeout_ms() const { return m_short_timeout; }
+	int timeout_ms() const { return m_timeout; }
+
 	enum {
 		flag_queried = 1,
 		flag_initial = 2,
@@ -161,6 +176,10 @@ private:
 
 	// the transaction ID for this call
 	boost::uint16_t m_transaction_id;
+
+	// in milliseconds, see set_timeouts()
+	boost::uint16_t m_short_timeout;
+	boost::uint16_t m_timeout;
 public:
 	unsigned char flags;
 
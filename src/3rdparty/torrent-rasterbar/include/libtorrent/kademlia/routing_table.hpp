@@ -161,6 +161,10 @@ public:
 	void remove_node(node_entry* n
 		, table_t::iterator bucket) ;
 
+	// the round trip time of the live node with this id and endpoint, in
+	// milliseconds, or 0xffff if we don't have the node or it has no RTT yet
+	int node_rtt(node_id const& id, udp::endpoint const& ep);
+
 	int bucket_size(int bucket) const
 	{
 		int num_buckets = m_buckets.size();
@@ -113,8 +113,16 @@ public:
 
 	void update_node_id(node_id const& id) { m_our_id = id; }
 
+	// the smoothed round trip time and its mean deviation over all replies,
+	// in milliseconds. Both are 0 until the first reply
+	int rtt_estimate() const { return m_srtt; }
+	int rtt_deviation() const { return m_rttvar; }
+
 private:
 
+	void update_rtt(int rtt);
+	void set_timeouts(observer& o, udp::endpoint const& target);
+
 	boost::uint32_t calc_connection_id(udp::endpoint addr);
 
 	mutable boost::pool<> m_pool_allocator;
@@ -132,6 +140,8 @@ private:
 	routing_table& m_table;
 	time_point m_timer;
 	node_id m_our_id;
+	int m_srtt;
+	int m_rttvar;
 	boost::uint32_t m_allocated_observers:31;
 	boost::uint32_t m_destructing:1;
 };
@@ -60,7 +60,8 @@ namespace libtorrent
 
 		job_type_t type;
 
-		// used for write jobs
+		// used for write jobs. A write job without buffers waits for the
+		// socket to become writable, for sendfile()
 		std::vector<boost::asio::const_buffer> const* vec;
 		// used for read jobs
 		char* recv_buf;
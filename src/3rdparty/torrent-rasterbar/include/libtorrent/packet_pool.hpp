@@ -0,0 +1,238 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_PACKET_POOL_HPP
+#define TORRENT_PACKET_POOL_HPP
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/debug.hpp" // for single_threaded
+#include "libtorrent/assert.hpp"
+
+#include <boost/cstdint.hpp>
+#include <vector>
+#include <cstdlib>
+
+namespace libtorrent
+{
+	// used for out-of-order incoming packets
+	// as well as sent packets that are waiting to be ACKed
+	struct packet
+	{
+		// the last time this packet was sent
+		time_point send_time;
+
+		// the number of bytes actually allocated in 'buf'
+		boost::uint16_t allocated;
+
+		// the size of the buffer 'buf' points to
+		boost::uint16_t size;
+
+		// this is the offset to the payload inside the buffer
+		// this is also used as a cursor to describe where the
+		// next payload that hasn't been consumed yet starts
+		boost::uint16_t header_size;
+
+		// the number of times this packet has been sent
+		boost::uint8_t num_transmissions:6;
+
+		// true if we need to send this packet again. All
+		// outstanding packets are marked as needing to be
+		// resent on timeouts
+		bool need_resend:1;
+
+		// this is set to true for packets that were
+		// sent with the DF bit set (Don't Fragment)
+		bool mtu_probe:1;
+
+#ifdef TORRENT_DEBUG
+		int num_fast_resend;
+#endif
+
+		// the actual packet buffer
+		boost::uint8_t buf[1];
+	};
+
+	// a free list of packet buffers that can hold up to ``allocate_size``
+	// bytes of payload each
+	struct packet_slab
+	{
+		packet_slab(int alloc_size, int limit)
+			: allocate_size(alloc_size)
+			, m_limit(limit)
+		{}
+
+		~packet_slab()
+		{
+			for (std::vector<packet*>::iterator i = m_storage.begin()
+				, end(m_storage.end()); i != end; ++i)
+				std::free(*i);
+		}
+
+		// returns NULL if there's no buffer to recycle
+		packet* try_alloc()
+		{
+			if (m_storage.empty()) return NULL;
+			packet* p = m_storage.back();
+			m_storage.pop_back();
+			return p;
+		}
+
+		// returns false if the free list is full, and the caller should free
+		// the buffer instead
+		bool try_release(packet* p)
+		{
+			if (int(m_storage.size()) >= m_limit) return false;
+			m_storage.push_back(p);
+			return true;
+		}
+
+		// frees one cached buffer, to give back memory once the pool has
+		// gone idle
+		void decay()
+		{
+			if (m_storage.empty()) return;
+			std::free(m_storage.back());
+			m_storage.pop_back();
+		}
+
+		int size() const { return int(m_storage.size()); }
+
+		int const allocate_size;
+
+	private:
+		// explicitly disallow assignment, to silence msvc warning
+		packet_slab& operator=(packet_slab const&);
+
+		int const m_limit;
+		std::vector<packet*> m_storage;
+	};
+
+	// a cache of packet buffers for uTP, owned by the utp_socket_manager.
+	// Packets are sized to the MTU, so a few fixed size classes cover almost
+	// all of them. Freed buffers are kept on a free list per size class and
+	// handed out again, instead of going through malloc() and free() for
+	// every packet sent, resent or received. Only larger packets, and packets
+	// released while their free list is full, hit the heap.
+	struct packet_pool : single_threaded
+	{
+		packet_pool()
+			: m_syn_slab(64, 50)
+			, m_mtu_floor_slab(TORRENT_INET_MIN_MTU_PAYLOAD, 512)
+			, m_mtu_ceiling_slab(TORRENT_ETHERNET_MTU_PAYLOAD, 512)
+			, m_allocations(0)
+			, m_acquired(0)
+		{}
+
+		// returns a packet with room for ``allocate`` bytes in its buffer.
+		// ``packet::allocated`` is set to ``allocate``, regardless of how
+		// much the size class can hold, since it limits how much payload may
+		// be put in the packet
+		packet* acquire(int allocate)
+		{
+			TORRENT_ASSERT(is_single_thread());
+			TORRENT_ASSERT(allocate >= 0);
+			TORRENT_ASSERT(allocate <= 0xffff);
+			++m_acquired;
+			packet_slab* slab = slab_for(allocate);
+			packet* p = slab ? slab->try_alloc() : NULL;
+			if (p == NULL)
+			{
+				++m_allocations;
+				p = static_cast<packet*>(std::malloc(sizeof(packet)
+					+ (slab ? slab->allocate_size : allocate)));
+				if (p == NULL) return NULL;
+			}
+			p->allocated = boost::uint16_t(allocate);
+			return p;
+		}
+
+		void release(packet* p)
+		{
+			TORRENT_ASSERT(is_single_thread());
+			if (p == NULL) return;
+			packet_slab* slab = slab_for(p->allocated);
+			if (slab == NULL || !slab->try_release(p))
+				std::free(p);
+		}
+
+		// called once per second by the utp_socket_manager. Returns cached
+		// buffers to the heap slowly, so a burst doesn't pin memory forever
+		void decay()
+		{
+			TORRENT_ASSERT(is_single_thread());
+			m_syn_slab.decay();
+			m_mtu_floor_slab.decay();
+			m_mtu_ceiling_slab.decay();
+		}
+
+		// the number of times a buffer was taken from the heap, and the
+		// number of packets handed out in total
+		boost::int64_t num_allocations() const { return m_allocations; }
+		boost::int64_t num_acquired() const { return m_acquired; }
+
+		// the number of buffers waiting to be reused
+		int num_cached() const
+		{
+			return m_syn_slab.size() + m_mtu_floor_slab.size()
+				+ m_mtu_ceiling_slab.size();
+		}
+
+	private:
+
+		enum
+		{
+			// the largest uTP payload of a minimum size IPv4 packet, and of
+			// an ethernet frame (see the MTU constants in utp_stream.hpp)
+			TORRENT_INET_MIN_MTU_PAYLOAD = 576 - 20 - 8,
+			TORRENT_ETHERNET_MTU_PAYLOAD = 1500 - 20 - 8
+		};
+
+		packet_slab* slab_for(int allocate)
+		{
+			if (allocate <= m_syn_slab.allocate_size) return &m_syn_slab;
+			if (allocate <= m_mtu_floor_slab.allocate_size) return &m_mtu_floor_slab;
+			if (allocate <= m_mtu_ceiling_slab.allocate_size) return &m_mtu_ceiling_slab;
+			return NULL;
+		}
+
+		packet_slab m_syn_slab;
+		packet_slab m_mtu_floor_slab;
+		packet_slab m_mtu_ceiling_slab;
+
+		boost::int64_t m_allocations;
+		boost::int64_t m_acquired;
+	};
+}
+
+#endif // TORRENT_PACKET_POOL_HPP
+
@@ -83,6 +83,16 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
+// piece payload can be sent from the file it's stored in straight into a TCP
+// socket, with sendfile() (see settings_pack::zero_copy_send)
+#ifndef TORRENT_USE_SENDFILE
+#if defined TORRENT_LINUX
+#define TORRENT_USE_SENDFILE 1
+#else
+#define TORRENT_USE_SENDFILE 0
+#endif
+#endif
+
 namespace libtorrent
 {
 	class torrent;
@@ -672,6 +682,10 @@ namespace libtorrent
 			, void* userdata = NULL, block_cache_reference ref
 			= block_cache_reference());
 
+		// appends a range of a file to the send buffer, to be sent without
+		// reading it into memory
+		void append_send_file(file_range const& r);
+
 #ifndef TORRENT_NO_DEPRECATE
 #ifndef TORRENT_DISABLE_RESOLVE_COUNTRIES
 		void set_country(char const* c)
@@ -750,6 +764,16 @@ namespace libtorrent
 		virtual void write_dont_have(int index) = 0;
 		virtual void write_keepalive() = 0;
 		virtual void write_piece(peer_request const& r, disk_buffer_holder& buffer) = 0;
+
+		// like write_piece(), but the payload is sent straight from the files
+		// in ``ranges``. Only called if can_send_zero_copy() returns true
+		virtual void write_piece_from_files(peer_request const&
+			, std::vector<file_range> const&) { TORRENT_ASSERT(false); }
+
+		// returns true if piece payload may be sent to this peer from the
+		// files directly, rather than read into the cache first. This requires
+		// an unencrypted protocol on a plain TCP socket
+		virtual bool can_send_zero_copy() const { return false; }
 		virtual void write_suggest(int piece) = 0;
 		virtual void write_bitfield() = 0;
 
@@ -811,6 +835,12 @@ namespace libtorrent
 		void fill_send_buffer();
 		void on_disk_read_complete(disk_io_job const* j, peer_request r
 			, time_point issue_time);
+		void on_disk_map_complete(disk_io_job const* j, peer_request r
+			, time_point issue_time);
+#if TORRENT_USE_SENDFILE
+		void on_send_file_ready(error_code const& error, std::size_t);
+		void release_header_cork();
+#endif
 		void on_disk_write_complete(disk_io_job const* j
 			, peer_request r, boost::shared_ptr<torrent> t);
 		void on_seed_mode_hashed(disk_io_job const* j);
@@ -1240,6 +1270,12 @@ namespace libtorrent
 		// outstanding requests need to increase at the same pace to keep up.
 		bool m_slow_start:1;
 
+#if TORRENT_USE_SENDFILE
+		// set while the socket is corked (TCP_CORK) to hold a piece header back
+		// until its payload is sent with sendfile() after it
+		bool m_header_corked:1;
+#endif
+
 		template <class Handler>
 		aux::allocating_handler<Handler, TORRENT_READ_HANDLER_MAX_SIZE>
 			make_read_handler(Handler const& handler)
@@ -34,7 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_POLICY_HPP_INCLUDED
 
 #include <algorithm>
-#include <deque>
+#include <vector>
 #include "libtorrent/string_util.hpp" // for allocate_string_copy
 #include "libtorrent/request_blocks.hpp" // for source_rank
 
@@ -156,6 +156,12 @@ namespace libtorrent
 		// our external IP changes
 		void clear_peer_prio();
 
+		// last_connected is part of the connect candidate keys. Call these
+		// after changing it from the outside on peers that aren't connected,
+		// for one peer or all of them
+		void update_candidate(torrent_peer const* p);
+		void update_candidate_keys();
+
 #if TORRENT_USE_ASSERTS
 		bool has_connection(const peer_connection_interface* p);
 #endif
@@ -165,11 +171,7 @@ namespace libtorrent
 
 		int num_peers() const { return int(m_peers.size()); }
 
-#ifdef TORRENT_OPTIMIZE_MEMORY_USAGE
 		typedef std::vector<torrent_peer*> peers_t;
-#else
-		typedef std::deque<torrent_peer*> peers_t;
-#endif
 
 		typedef peers_t::iterator iterator;
 		typedef peers_t::const_iterator const_iterator;
@@ -216,6 +218,20 @@ namespace libtorrent
 
 		void update_connect_candidates(int delta);
 
+		// the keys of peers that aren't connect candidates. The ones that
+		// may be erased to make room for new peers are told apart from the
+		// rest, see is_erase_candidate()
+		enum { erasable_key = 0xfffffffe, not_candidate = 0xffffffff };
+		static bool is_candidate_key(boost::uint32_t k) { return k < erasable_key; }
+
+		// packs the fields compare_peer() looks at first, except for the peer
+		// rank (which depends on our external address), into a number where
+		// lower is better
+		boost::uint32_t candidate_key(torrent_peer const& p) const;
+
+		// the index of p in m_peers, or -1
+		int peer_index(torrent_peer const* p) const;
+
 		void update_peer(torrent_peer* p, int src, int flags
 		, tcp::endpoint const& remote, char const* destination);
 		bool insert_peer(torrent_peer* p, iterator iter, int flags, torrent_state* state);
@@ -235,8 +251,16 @@ namespace libtorrent
 		enum flags_t { force_erase = 1 };
 		void erase_peers(torrent_state* state, int flags = 0);
 
+		// sorted by address. Only the pointers are kept here, the
+		// torrent_peer objects live in the allocator's pools and are
+		// referenced by peer connections and the piece picker
 		peers_t m_peers;
 
+		// the candidate_key() of every peer in m_peers, at the same index.
+		// find_connect_candidates() skips over peers and compares them by
+		// this array and only dereferences the ones that may be picked
+		std::vector<boost::uint32_t> m_candidate_keys;
+
 		// this should be NULL for the most part. It's set
 		// to point to a valid torrent_peer object if that
 		// object needs to be kept alive. If we ever feel
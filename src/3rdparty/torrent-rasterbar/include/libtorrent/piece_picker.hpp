@@ -347,6 +347,8 @@ namespace libtorrent
 		void mark_as_canceled(piece_block block, torrent_peer* peer);
 		void mark_as_finished(piece_block block, torrent_peer* peer);
 		void mark_as_pad(piece_block block);
+		bool is_pad(piece_block block) const;
+		int pad_blocks_in_piece(int index) const;
 	
 		// prevent blocks from being picked from this piece.
 		// to unlock the piece, call restore_piece() on it
@@ -707,6 +709,11 @@ namespace libtorrent
 
 		void break_one_seed();
 
+		// the row of pad block bits for the piece, or NULL if it doesn't
+		// have any pad blocks
+		boost::uint32_t const* pad_row(int piece) const;
+		int pad_row_words() const { return (m_blocks_per_piece + 31) / 32; }
+
 		void update_pieces() const;
 
 		// fills in the range [start, end) of pieces in
@@ -747,13 +754,15 @@ namespace libtorrent
 		// doesn't exist in the piece_info buckets
 		// pieces with the filtered flag set doesn't have entries in
 		// the m_piece_info buckets either
-		// TODO: should this be allocated lazily?
+		// a torrent only creates its picker when it's missing pieces, seeds
+		// don't have one (see torrent::need_picker())
 		mutable std::vector<piece_pos> m_piece_map;
 
-		// this maps pieces to a range of blocks that are pad files and should not
-		// be picked
-		// TOOD: this could be a much more efficient data structure
-		std::set<piece_block> m_pad_blocks;
+		// the pieces that have blocks that are pad files and should not be
+		// picked, sorted. Each one has a row of pad_row_words() words in
+		// m_pad_blocks, with one bit per block
+		std::vector<int> m_pad_pieces;
+		std::vector<boost::uint32_t> m_pad_blocks;
 
 		// the number of seeds. These are not added to
 		// the availability counters of the pieces
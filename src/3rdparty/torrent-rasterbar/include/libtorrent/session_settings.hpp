@@ -1397,6 +1397,7 @@ namespace libtorrent
 			, max_dht_items(700)
 			, max_peers(5000)
 			, max_torrent_search_reply(20)
+			, max_storage_memory(64 * 1024 * 1024)
 			, restrict_routing_ips(true)
 			, restrict_search_ips(true)
 			, extended_routing_table(true)
@@ -1446,6 +1447,12 @@ namespace libtorrent
 		// DHT
 		int max_torrent_search_reply;
 
+		// the number of bytes the torrents, peers and items stored by the DHT
+		// may use, 0 means no limit. Only the storage created by
+		// dht_flat_storage_constructor() honors it, the least recently used
+		// entries are evicted to stay below it.
+		int max_storage_memory;
+
 		// determines if the routing table entries should restrict entries to one
 		// per IP. This defaults to true, which helps mitigate some attacks on
 		// the DHT. It prevents adding multiple nodes with IPs with a very close
@@ -696,6 +696,14 @@ namespace libtorrent
 			// any.
 			proxy_tracker_connections,
 
+			// when enabled, piece payload sent to plaintext bittorrent peers
+			// over TCP is sent straight from the files it's stored in, using
+			// sendfile(), instead of being read into the disk cache and copied
+			// into the socket. Blocks that are already in the cache, and peers
+			// using encryption, SSL, uTP or a proxy are still served from
+			// memory. This is only supported on linux.
+			zero_copy_send,
+
 			max_bool_setting_internal
 		};
 
@@ -789,7 +797,9 @@ namespace libtorrent
 			// for viruses. deferring the closing of the files will be the
 			// difference between a usable system and a completely hogged down
 			// system. Most operating systems also has a limit on the total number
-			// of file descriptors a process may have open.
+			// of file descriptors a process may have open. The default, 0, sizes
+			// the pool to a fifth of the process' file descriptor limit
+			// (RLIMIT_NOFILE), but at least 40.
 			file_pool_size,
 
 			// ``max_failcount`` is the maximum times we try to connect to a peer
@@ -32,6 +32,15 @@ namespace libtorrent
 		, boost::uint8_t const* data
 		, boost::uint32_t len);
 	TORRENT_EXTRA_EXPORT void SHA1_final(boost::uint8_t* digest, sha_ctx* context);
+
+	// hashes ``num`` independent messages (``data[i]``, ``len[i]`` bytes) and
+	// writes the 20 byte digests back-to-back into ``digests``. On CPUs with
+	// AVX2 up to 8 messages are hashed in parallel, which is most efficient
+	// when they are of the same size, like pieces.
+	TORRENT_EXTRA_EXPORT void SHA1_multi(boost::uint8_t const* const* data
+		, boost::uint32_t const* len
+		, boost::uint8_t* digests
+		, int num);
 }
 
 #endif
@@ -265,6 +265,20 @@ namespace libtorrent
 		virtual int writev(file::iovec_t const* bufs, int num_bufs
 			, int piece, int offset, int flags, storage_error& ec) = 0;
 
+		// This function is used to send piece data to peers straight from
+		// the files it's stored in, without copying it through a buffer (see
+		// settings_pack::zero_copy_send). It should append the files and
+		// offsets the ``size`` bytes at ``offset`` into ``piece`` are stored
+		// at to ``ranges``, one file_range per file the range spans.
+		//
+		// Return false if any part of the range isn't stored verbatim in a
+		// regular file. The data is then read with readv() instead. This is
+		// what the default implementation does.
+		virtual bool map_file_ranges(int /* piece */, int /* offset */
+			, int /* size */, int /* flags */
+			, std::vector<file_range>& /* ranges */, storage_error& /* ec */)
+		{ return false; }
+
 		// This function is called when first checking (or re-checking) the
 		// storage for a torrent. It should return true if any of the files that
 		// is used in this storage exists on disk. If so, the storage will be
@@ -446,6 +460,8 @@ namespace libtorrent
 			, int piece, int offset, int flags, storage_error& ec) TORRENT_OVERRIDE;
 		int writev(file::iovec_t const* bufs, int num_bufs
 			, int piece, int offset, int flags, storage_error& ec) TORRENT_OVERRIDE;
+		bool map_file_ranges(int piece, int offset, int size, int flags
+			, std::vector<file_range>& ranges, storage_error& ec) TORRENT_OVERRIDE;
 
 		// if the files in this storage are mapped, returns the mapped
 		// file_storage, otherwise returns the original file_storage object.
@@ -503,6 +519,10 @@ namespace libtorrent
 		mutable bitfield m_file_created;
 
 		bool m_allocate_files;
+
+		// only allocate files if it can be done without writing to them. See
+		// storage_mode_fast_allocate
+		bool m_fast_allocate;
 	};
 
 	// this storage implementation does not write anything to disk
@@ -55,7 +55,13 @@ namespace libtorrent
 
 		// All pieces will be written to the place where they belong and sparse files
 		// will be used. This is the recommended, and default mode.
-		storage_mode_sparse
+		storage_mode_sparse,
+
+		// Like storage_mode_allocate, but files are only allocated if the
+		// filesystem can do so without writing to them (``fallocate()`` on
+		// linux). On filesystems that would fall back to filling the files
+		// with zeros, they are left sparse instead.
+		storage_mode_fast_allocate
 	};
 
 	// see default_storage::default_storage()
@@ -362,10 +362,16 @@ namespace libtorrent
 		peer_connection* find_peer(peer_id const& pid);
 
 		void on_resume_data_checked(disk_io_job const* j);
+		// true if the resume data says we have every piece, and there's
+		// nothing that needs a piece picker to be set up before it's
+		// checked (pad files, partial pieces, read cache suggestions)
+		bool resumes_as_seed() const;
 		void on_force_recheck(disk_io_job const* j);
-		void on_piece_hashed(disk_io_job const* j);
+		void on_pieces_checked(disk_io_job const* j);
 		void files_checked();
 		void start_checking();
+		void issue_check_jobs();
+		void issue_check_job(int piece, int num_pieces);
 
 		void start_announcing();
 		void stop_announcing();
@@ -1407,7 +1413,7 @@ namespace libtorrent
 		boost::uint16_t m_became_finished;
 
 		// when checking, this is the first piece we have not
-		// issued a hash job for
+		// issued a check job for
 		int m_checking_piece;
 
 		// the number of pieces we completed the check of
@@ -66,6 +66,12 @@ namespace libtorrent
 		, char const* element, int element_len);
 	TORRENT_EXTRA_EXPORT bool verify_encoding(std::string& target);
 
+	// internal
+	// the bdecode() token limit for .torrent files, metadata and resume data.
+	// Every entry in a file list takes 10 or more tokens, the default limit
+	// would not allow more than about 100k files
+	enum { torrent_file_token_limit = 20000000 };
+
 	// the web_seed_entry holds information about a web seed (also known
 	// as URL seed or HTTP seed). It is essentially a URL with some state
 	// associated with it. For more information, see `BEP 17`_ and `BEP 19`_.
@@ -40,6 +40,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <string>
 #include <list>
+#include <map>
 #include <utility>
 #include <ctime>
 
@@ -364,7 +365,8 @@ namespace libtorrent
 	{
 	public:
 
-		tracker_manager(udp_socket& sock
+		tracker_manager(io_service& ios
+			, udp_socket& sock
 			, counters& stats_counters
 			, resolver_interface& resolver
 			, aux::session_settings const& sett
@@ -404,8 +406,27 @@ namespace libtorrent
 		udp_socket& get_udp_socket() { return m_udp_socket; }
 		resolver_interface& host_resolver() { return m_host_resolver; }
 
+		// UDP tracker requests that need a connection ID for a tracker address
+		// another request is already connecting to wait for that one instead
+		// of sending a connect of their own. Returns true if c was queued
+		// behind the request in flight, and false if c is now the one to
+		// connect. c must call udp_connect_finished() once it's answered, or
+		// gave up.
+		bool join_udp_connect(boost::shared_ptr<udp_tracker_connection> const& c
+			, address const& tracker);
+		void udp_connect_finished(udp_tracker_connection const* c
+			, address const& tracker);
+
+		// scrapes to the same UDP tracker endpoint are collected for a short
+		// while and then sent together, up to
+		// udp_tracker_connection::max_scrape_hashes info-hashes per request
+		// (BEP 15)
+		void queue_udp_scrape(boost::shared_ptr<udp_tracker_connection> const& c);
+
 	private:
 
+		void send_udp_scrapes(error_code const& ec);
+
 		typedef mutex mutex_t;
 		mutable mutex_t m_mutex;
 
@@ -418,6 +439,23 @@ namespace libtorrent
 		typedef std::vector<boost::shared_ptr<http_tracker_connection> > http_conns_t;
 		http_conns_t m_http_conns;
 
+		// tracker address -> the request sending the connect, and the ones
+		// waiting for its connection ID
+		struct udp_connect_t
+		{
+			udp_tracker_connection const* connecting;
+			std::vector<boost::shared_ptr<udp_tracker_connection> > waiting;
+		};
+		typedef std::map<address, udp_connect_t> udp_connects_t;
+		udp_connects_t m_udp_connects;
+
+		// scrapes not sent yet, per tracker endpoint
+		typedef std::map<udp::endpoint
+			, std::vector<boost::shared_ptr<udp_tracker_connection> > > udp_scrapes_t;
+		udp_scrapes_t m_udp_scrapes;
+		deadline_timer m_udp_scrape_timer;
+		bool m_udp_scrape_timer_active;
+
 		class udp_socket& m_udp_socket;
 		resolver_interface& m_host_resolver;
 		aux::session_settings const& m_settings;
@@ -45,6 +45,20 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <deque>
 
+// recvmmsg() and sendmmsg(), to receive and send batches of UDP packets
+// with one system call
+#ifndef TORRENT_USE_MMSG
+#if defined TORRENT_LINUX && !defined TORRENT_ANDROID && defined __GLIBC__
+#if __GLIBC_PREREQ(2, 14) && LINUX_VERSION_CODE >= KERNEL_VERSION(3,0,0)
+#define TORRENT_USE_MMSG 1
+#endif
+#endif
+#endif
+
+#ifndef TORRENT_USE_MMSG
+#define TORRENT_USE_MMSG 0
+#endif
+
 namespace libtorrent
 {
 	struct TORRENT_EXTRA_EXPORT udp_socket_observer
@@ -108,6 +122,13 @@ namespace libtorrent
 
 		void set_buf_size(int s);
 
+		// when enabled (the default), and the platform supports it, incoming
+		// packets are read in batches with recvmmsg() and packets sent while
+		// handling them are flushed together with sendmmsg() once the batch
+		// has been handled. Consecutive packets to the same destination are
+		// coalesced with UDP_SEGMENT where the kernel supports it.
+		void set_batched_io(bool b);
+
 		typedef udp::socket::receive_buffer_size receive_buffer_size;
 		typedef udp::socket::send_buffer_size send_buffer_size;
 
@@ -222,7 +243,7 @@ namespace libtorrent
 		void setup_read(udp::socket* s);
 		void on_read(error_code const& ec, udp::socket* s);
 		void on_read_impl(udp::endpoint const& ep
-			, error_code const& e, std::size_t bytes_transferred);
+			, error_code const& e, char const* buf, std::size_t bytes_transferred);
 		void on_name_lookup(error_code const& e, tcp::resolver::iterator i);
 		void on_connect_timeout(error_code const& ec);
 		void on_connected(error_code const& ec);
@@ -238,6 +259,15 @@ namespace libtorrent
 
 		void drain_queue();
 
+		void subscribe_writable(udp::socket* s);
+
+#if TORRENT_USE_MMSG
+		void read_batched(udp::socket* s);
+		void queue_batched(udp::endpoint const& ep, char const* p, int len
+			, error_code& ec);
+		void flush_batched();
+#endif
+
 		void wrap(udp::endpoint const& ep, char const* p, int len, error_code& ec);
 		void wrap(char const* hostname, int port, char const* p, int len, error_code& ec);
 		void unwrap(error_code const& e, char const* buf, int size);
@@ -253,8 +283,34 @@ namespace libtorrent
 		// the desired size, and it's resized
 		// later
 		int m_new_buf_size;
+
+		// with batched I/O this holds recv_batch_size receive buffers of
+		// m_buf_size bytes each
 		char* m_buf;
 
+#if TORRENT_USE_MMSG
+		enum
+		{
+			// the number of packets received per recvmmsg() call
+			recv_batch_size = 32,
+
+			// the max number of outgoing packets held back while handling a
+			// receive batch, and the max number of segments per UDP_SEGMENT send
+			send_batch_size = 64
+		};
+
+		struct batched_packet
+		{
+			udp::endpoint ep;
+			int offset; // into m_send_buf
+			int len;
+		};
+
+		// packets sent while handling a receive batch, waiting to be flushed
+		std::vector<batched_packet> m_send_batch;
+		std::vector<char> m_send_buf;
+#endif
+
 #if TORRENT_USE_IPV6
 		udp::socket m_ipv6_sock;
 		aux::handler_storage<TORRENT_READ_HANDLER_MAX_SIZE> m_v6_read_handler_storage;
@@ -303,6 +359,21 @@ namespace libtorrent
 #endif
 		bool m_v4_write_subscribed:1;
 
+		bool m_batched_io:1;
+
+		// true while the packets of a receive batch are handed to the
+		// observers. Outgoing packets are queued and the receive buffers
+		// may not be reallocated during this time
+		bool m_in_batch:1;
+
+		// packets shorter than this are coalesced into UDP_SEGMENT sends on
+		// the socket. 0 if the kernel doesn't accept UDP_SEGMENT, lowered to
+		// the segment size of a send the route or device refused
+		int m_v4_gso_limit;
+#if TORRENT_USE_IPV6
+		int m_v6_gso_limit;
+#endif
+
 #if TORRENT_USE_ASSERTS
 		bool m_started;
 		int m_magic;
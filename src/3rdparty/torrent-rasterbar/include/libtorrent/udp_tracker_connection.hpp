@@ -71,6 +71,9 @@ namespace libtorrent
 
 		boost::uint32_t transaction_id() const { return m_transaction_id; }
 
+		// the most info-hashes a scrape request may carry (BEP 15)
+		enum { max_scrape_hashes = 74 };
+
 	private:
 
 		enum action_t
@@ -110,6 +113,11 @@ namespace libtorrent
 		void send_udp_announce();
 		void send_udp_scrape();
 
+		// sends the scrape through the tracker manager, which batches it with
+		// the scrapes of other torrents for the same tracker
+		void queue_udp_scrape();
+		void scrape_done(int complete, int downloaded, int incomplete);
+
 		virtual void on_timeout(error_code const& ec);
 
 		udp::endpoint pick_target_endpoint() const;
@@ -131,6 +139,10 @@ namespace libtorrent
 		boost::uint32_t m_transaction_id;
 		int m_attempts;
 
+		// the scrapes sent along with ours, in the order of the info-hashes
+		// following our own in the request. We hand the response out to them
+		std::vector<boost::shared_ptr<udp_tracker_connection> > m_batch;
+
 		// action_t
 		boost::uint8_t m_state;
 
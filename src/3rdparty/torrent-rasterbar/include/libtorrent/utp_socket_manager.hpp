@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/session_status.hpp"
 #include "libtorrent/enum_net.hpp"
 #include "libtorrent/aux_/session_settings.hpp"
+#include "libtorrent/packet_pool.hpp"
 
 namespace libtorrent
 {
@@ -110,6 +111,12 @@ namespace libtorrent
 		// the counter is the enum from ``counters``.
 		void inc_stats_counter(int counter, int delta = 1);
 
+		// packet buffers used by the uTP sockets are recycled through this
+		// pool rather than being returned to the heap
+		packet* acquire_packet(int allocate) { return m_packet_pool.acquire(allocate); }
+		void release_packet(packet* p) { m_packet_pool.release(p); }
+		packet_pool const& get_packet_pool() const { return m_packet_pool; }
+
 	private:
 		// explicitly disallow assignment, to silence msvc warning
 		utp_socket_manager& operator=(utp_socket_manager const&);
@@ -171,6 +178,11 @@ namespace libtorrent
 		// this is  passed on to the instantiate connection
 		// if this is non-null it will create SSL connections over uTP
 		void* m_ssl_context;
+
+		// cached packet buffers shared by all uTP sockets. This must outlive
+		// the sockets, since they release their buffers back to it when
+		// they're deleted
+		packet_pool m_packet_pool;
 	};
 }
 
@@ -45,6 +45,7 @@ namespace libtorrent
 		: m_alert_mask(alert_mask)
 		, m_queue_size_limit(queue_limit)
 		, m_num_queued_resume(0)
+		, m_num_waiters(0)
 		, m_generation(0)
 	{}
 
@@ -64,7 +65,9 @@ namespace libtorrent
 			return m_alerts[m_generation].front();
 
 		// this call can be interrupted prematurely by other signals
+		++m_num_waiters;
 		m_condition.wait_for(lock, max_wait);
+		--m_num_waiters;
 		if (!m_alerts[m_generation].empty())
 			return m_alerts[m_generation].front();
 
@@ -79,6 +82,7 @@ namespace libtorrent
 
 		if (m_alerts[m_generation].size() == 1)
 		{
+			bool const waiters = m_num_waiters > 0;
 			lock.unlock();
 
 			// we just posted to an empty queue. If anyone is waiting for
@@ -87,9 +91,10 @@ namespace libtorrent
 			// message loop to poll for alerts.
 			if (m_notify) m_notify();
 
-			// TODO: 2 keep a count of the number of threads waiting. Only if it's
-			// > 0 notify them
-			m_condition.notify_all();
+			// a client that only polls, or only uses the notify callback,
+			// never waits on the condition variable. Don't pay for the
+			// system call then
+			if (waiters) m_condition.notify_all();
 		}
 		else
 		{
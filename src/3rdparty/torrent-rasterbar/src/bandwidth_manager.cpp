@@ -33,11 +33,51 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/bandwidth_manager.hpp"
 #include "libtorrent/time.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace libtorrent
 {
+	namespace {
+
+	// the number of bytes a request of the highest queued priority is
+	// handed at a time, at least. Roughly one packet
+	const int min_quantum = 1500;
+
+	// bucket::credit is in units of 1 / (1 << credit_shift) bytes
+	const int credit_shift = 16;
+
+	// the number of ticks a request waits at most to be handed its
+	// deficit, when the rate is too low for a packet worth
+	const boost::uint32_t max_wait_ticks = 4;
+
+	void return_quota(bandwidth_channel* const* channel, int amount)
+	{
+		for (int j = 0; j < bw_request::max_bandwidth_channels && channel[j]; ++j)
+			channel[j]->return_quota(amount);
+	}
+
+	}
+
+	bool bandwidth_manager::channel_set::operator<(channel_set const& rhs) const
+	{
+		return std::lexicographical_compare(channel
+			, channel + bw_request::max_bandwidth_channels
+			, rhs.channel, rhs.channel + bw_request::max_bandwidth_channels);
+	}
+
+	bandwidth_manager::bucket::bucket(channel_set const& c)
+		: channels(c)
+		, weight(0)
+		, credit(0)
+		, ticks(0)
+		, reserved(0)
+	{}
 
 	bandwidth_manager::bandwidth_manager(int channel)
-		: m_queued_bytes(0)
+		: m_queue_size(0)
+		, m_queued_bytes(0)
+		, m_max_priority(1)
 		, m_channel(channel)
 		, m_abort(false)
 	{
@@ -47,8 +87,14 @@ namespace libtorrent
 	{
 		m_abort = true;
 
-		queue_t tm;
-		tm.swap(m_queue);
+		std::vector<bw_request> tm;
+		for (buckets_t::iterator i = m_buckets.begin()
+			, end(m_buckets.end()); i != end; ++i)
+		{
+			while (!i->queue.empty()) pop_request(*i, tm);
+		}
+		m_buckets.clear();
+		m_bucket_index.clear();
 		m_queued_bytes = 0;
 
 		while (!tm.empty())
@@ -62,10 +108,14 @@ namespace libtorrent
 #if TORRENT_USE_ASSERTS
 	bool bandwidth_manager::is_queued(bandwidth_socket const* peer) const
 	{
-		for (queue_t::const_iterator i = m_queue.begin()
-			, end(m_queue.end()); i != end; ++i)
+		for (buckets_t::const_iterator b = m_buckets.begin()
+			, end(m_buckets.end()); b != end; ++b)
 		{
-			if (i->peer.get() == peer) return true;
+			for (std::deque<queued_request>::const_iterator i = b->queue.begin()
+				, end2(b->queue.end()); i != end2; ++i)
+			{
+				if (i->request.peer.get() == peer) return true;
+			}
 		}
 		return false;
 	}
@@ -73,7 +123,7 @@ namespace libtorrent
 
 	int bandwidth_manager::queue_size() const
 	{
-		return m_queue.size();
+		return m_queue_size;
 	}
 
 	boost::int64_t bandwidth_manager::queued_bytes() const
@@ -106,18 +156,36 @@ namespace libtorrent
 			return blk;
 		}
 
+		// channels without a limit don't hold back the request. Leaving them
+		// out keeps requests that only differ by those in the same bucket
 		int k = 0;
 		bw_request bwr(peer, blk, priority);
 		for (int i = 0; i < num_channels; ++i)
 		{
-			if (chan[i]->need_queueing(blk))
+			if (chan[i]->throttle() > 0 && chan[i]->need_queueing(blk))
 				bwr.channel[k++] = chan[i];
 		}
 
 		if (k == 0) return blk;
 
+		channel_set c;
+		std::memcpy(c.channel, bwr.channel, sizeof(c.channel));
+		bucket_index_t::iterator b = m_bucket_index.find(c);
+		if (b == m_bucket_index.end())
+		{
+			b = m_bucket_index.insert(std::make_pair(c
+				, m_buckets.insert(m_buckets.end(), bucket(c)))).first;
+		}
+
+		// the request starts out with no deficit, and accrues it from the
+		// next tick on
+		bucket& bk = *b->second;
+		bk.weight += priority;
+		bk.queue.push_back(queued_request(bwr, bk.credit, bk.ticks));
+
+		m_max_priority = (std::max)(m_max_priority, priority);
 		m_queued_bytes += blk;
-		m_queue.push_back(bwr);
+		++m_queue_size;
 		return 0;
 	}
 
@@ -125,102 +193,210 @@ namespace libtorrent
 	void bandwidth_manager::check_invariant() const
 	{
 		boost::int64_t queued = 0;
-		for (queue_t::const_iterator i = m_queue.begin()
-			, end(m_queue.end()); i != end; ++i)
+		int num_requests = 0;
+		for (buckets_t::const_iterator b = m_buckets.begin()
+			, end(m_buckets.end()); b != end; ++b)
 		{
-			queued += i->request_size - i->assigned;
+			TORRENT_ASSERT(!b->queue.empty());
+			TORRENT_ASSERT(m_bucket_index.find(b->channels) != m_bucket_index.end());
+
+			int weight = 0;
+			boost::int64_t deficits = 0;
+			for (std::deque<queued_request>::const_iterator i = b->queue.begin()
+				, end2(b->queue.end()); i != end2; ++i)
+			{
+				queued += i->request.request_size - i->request.assigned;
+				weight += i->request.priority;
+				deficits += deficit(*b, *i);
+				TORRENT_ASSERT(std::memcmp(i->request.channel, b->channels.channel
+					, sizeof(i->request.channel)) == 0);
+				++num_requests;
+			}
+			TORRENT_ASSERT(weight == b->weight);
+			// the requests are never owed more than the bucket took
+			TORRENT_ASSERT(b->reserved < 0 || deficits <= b->reserved);
 		}
 		TORRENT_ASSERT(queued == m_queued_bytes);
+		TORRENT_ASSERT(num_requests == m_queue_size);
+		TORRENT_ASSERT(int(m_bucket_index.size()) == int(m_buckets.size()));
 	}
 #endif
 
-	void bandwidth_manager::update_quotas(time_duration const& dt)
+	boost::int64_t bandwidth_manager::deficit(bucket const& b, queued_request const& r)
 	{
-		if (m_abort) return;
-		if (m_queue.empty()) return;
-
-		INVARIANT_CHECK;
+		// none of the channels are limited
+		if (b.reserved < 0) return INT_MAX;
 
-		boost::int64_t dt_milliseconds = total_milliseconds(dt);
-		if (dt_milliseconds > 3000) dt_milliseconds = 3000;
+		boost::uint64_t const d = b.credit - r.start;
+		boost::uint64_t const prio = boost::uint64_t(r.request.priority);
+		return boost::int64_t((d >> credit_shift) * prio
+			+ (((d & ((boost::uint64_t(1) << credit_shift) - 1)) * prio) >> credit_shift));
+	}
 
-		// for each bandwidth channel, call update_quota(dt)
+	void bandwidth_manager::pop_request(bucket& b, std::vector<bw_request>& done)
+	{
+		bw_request& r = b.queue.front().request;
+		m_queued_bytes -= r.request_size - r.assigned;
+		--m_queue_size;
+		b.weight -= r.priority;
 
-		std::vector<bandwidth_channel*> channels;
+		done.push_back(r);
+		b.queue.pop_front();
+	}
 
-		queue_t tm;
+	void bandwidth_manager::serve_bucket(bucket& b, std::vector<bw_request>& done)
+	{
+		// the credit a request needs to be handed a packet worth of quota
+		// at the highest priority. Lower priorities are handed less, at
+		// the same pace
+		boost::uint64_t const due
+			= (boost::uint64_t(min_quantum) << credit_shift) / m_max_priority;
 
-		for (queue_t::iterator i = m_queue.begin();
-			i != m_queue.end();)
+		while (!b.queue.empty())
 		{
-			if (i->peer->is_disconnecting())
-			{
-				m_queued_bytes -= i->request_size - i->assigned;
+			queued_request& q = b.queue.front();
+			bw_request& r = q.request;
+			boost::int64_t const d = deficit(b, q);
 
-				// return all assigned quota to all the
-				// bandwidth channels this peer belongs to
-				for (int j = 0; j < bw_request::max_bandwidth_channels && i->channel[j]; ++j)
+			if (r.peer->is_disconnecting())
+			{
+				// its deficit goes back to the channels
+				if (b.reserved >= 0)
 				{
-					bandwidth_channel* bwc = i->channel[j];
-					bwc->return_quota(i->assigned);
+					b.reserved -= d;
+					return_quota(r.channel, int(d));
 				}
-
-				i->assigned = 0;
-				tm.push_back(*i);
-				i = m_queue.erase(i);
+				pop_request(b, done);
 				continue;
 			}
-			for (int j = 0; j < bw_request::max_bandwidth_channels && i->channel[j]; ++j)
+
+			int const left = r.request_size - r.assigned;
+			if (d < left && (d == 0 || (b.credit - q.start < due
+				&& b.ticks - q.tick < max_wait_ticks))) break;
+
+			// a request asking for less than its deficit leaves the rest
+			// to the channels
+			int const a = int((std::min)(d, boost::int64_t(left)));
+			if (b.reserved >= 0)
 			{
-				bandwidth_channel* bwc = i->channel[j];
-				bwc->tmp = 0;
+				b.reserved -= d;
+				if (d > a) return_quota(r.channel, int(d - a));
 			}
-			++i;
+			TORRENT_ASSERT(a > 0);
+			r.assigned += a;
+			m_queued_bytes -= a;
+			pop_request(b, done);
 		}
+	}
+
+	void bandwidth_manager::update_quotas(time_duration const& dt)
+	{
+		if (m_abort) return;
+		if (m_buckets.empty()) return;
+
+		INVARIANT_CHECK;
 
-		for (queue_t::iterator i = m_queue.begin()
-			, end(m_queue.end()); i != end; ++i)
+		boost::int64_t dt_milliseconds = total_milliseconds(dt);
+		if (dt_milliseconds > 3000) dt_milliseconds = 3000;
+
+		// for each bandwidth channel, call update_quota(dt)
+		std::vector<bandwidth_channel*> channels;
+		for (buckets_t::iterator i = m_buckets.begin()
+			, end(m_buckets.end()); i != end; ++i)
 		{
-			for (int j = 0; j < bw_request::max_bandwidth_channels && i->channel[j]; ++j)
+			for (int j = 0; j < bw_request::max_bandwidth_channels
+				&& i->channels.channel[j]; ++j)
 			{
-				bandwidth_channel* bwc = i->channel[j];
-				if (bwc->tmp == 0) channels.push_back(bwc);
-				TORRENT_ASSERT(INT_MAX - bwc->tmp > i->priority);
-				bwc->tmp += i->priority;
+				channels.push_back(i->channels.channel[j]);
 			}
 		}
+		std::sort(channels.begin(), channels.end());
+		channels.erase(std::unique(channels.begin(), channels.end()), channels.end());
 
 		for (std::vector<bandwidth_channel*>::iterator i = channels.begin()
 			, end(channels.end()); i != end; ++i)
 		{
 			(*i)->update_quota(int(dt_milliseconds));
+			(*i)->tmp = 0;
 		}
 
-		for (queue_t::iterator i = m_queue.begin();
-			i != m_queue.end();)
+		// the sum of the priorities of the requests queued on each channel
+		for (buckets_t::iterator i = m_buckets.begin()
+			, end(m_buckets.end()); i != end; ++i)
 		{
-			int a = i->assign_bandwidth();
-			if (i->assigned == i->request_size
-				|| (i->ttl <= 0 && i->assigned > 0))
+			for (int j = 0; j < bw_request::max_bandwidth_channels
+				&& i->channels.channel[j]; ++j)
 			{
-				a += i->request_size - i->assigned;
-				TORRENT_ASSERT(i->assigned <= i->request_size);
-				tm.push_back(*i);
-				i = m_queue.erase(i);
+				TORRENT_ASSERT(INT_MAX - i->channels.channel[j]->tmp > i->weight);
+				i->channels.channel[j]->tmp += i->weight;
 			}
-			else
+		}
+
+		// each bucket takes its share of the quota of its most limiting
+		// channel, from all of its channels
+		for (buckets_t::iterator i = m_buckets.begin()
+			, end(m_buckets.end()); i != end; ++i)
+		{
+			int share_quota = -1;
+			int share_weight = 1;
+			for (int j = 0; j < bw_request::max_bandwidth_channels
+				&& i->channels.channel[j]; ++j)
+			{
+				bandwidth_channel* bwc = i->channels.channel[j];
+				if (bwc->throttle() == 0) continue;
+				TORRENT_ASSERT(bwc->tmp > 0);
+				if (share_quota >= 0
+					&& boost::int64_t(bwc->distribute_quota) * share_weight
+					>= boost::int64_t(share_quota) * bwc->tmp)
+					continue;
+				share_quota = bwc->distribute_quota;
+				share_weight = bwc->tmp;
+			}
+
+			++i->ticks;
+			if (share_quota < 0)
+			{
+				i->reserved = -1;
+				continue;
+			}
+			if (i->reserved < 0) i->reserved = 0;
+
+			int const take = int(boost::int64_t(share_quota) * i->weight / share_weight);
+			if (take == 0) continue;
+			for (int j = 0; j < bw_request::max_bandwidth_channels
+				&& i->channels.channel[j]; ++j)
+			{
+				i->channels.channel[j]->use_quota(take);
+			}
+			i->reserved += take;
+			i->credit += (boost::uint64_t(take) << credit_shift) / boost::uint64_t(i->weight);
+		}
+
+		std::vector<bw_request> tm;
+		for (buckets_t::iterator i = m_buckets.begin(); i != m_buckets.end();)
+		{
+			serve_bucket(*i, tm);
+			if (!i->queue.empty())
 			{
 				++i;
+				continue;
 			}
-			m_queued_bytes -= a;
+
+			// what's left after rounding the credit goes back to the channels
+			if (i->reserved > 0) return_quota(i->channels.channel, int(i->reserved));
+			m_bucket_index.erase(i->channels);
+			i = m_buckets.erase(i);
 		}
 
-		while (!tm.empty())
+		if (m_queue_size == 0) m_max_priority = 1;
+
+		// hand out the quota in the order the requests were done, so that
+		// peers asking for more right away end up in the same order at
+		// the back of their queues
+		for (std::vector<bw_request>::iterator i = tm.begin()
+			, end(tm.end()); i != end; ++i)
 		{
-			bw_request& bwr = tm.back();
-			bwr.peer->assign_bandwidth(m_channel, bwr.assigned);
-			tm.pop_back();
+			i->peer->assign_bandwidth(m_channel, i->assigned);
 		}
 	}
 }
-
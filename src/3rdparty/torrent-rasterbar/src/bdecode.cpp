@@ -34,7 +34,23 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/alloca.hpp"
 #include <boost/system/error_code.hpp>
 #include <limits>
-#include <cstring> // for memset
+#include <algorithm> // for min
+#include <cstring> // for memset, memcpy
+
+// the tokenizer scans digit runs (string length prefixes and integers) 16
+// bytes at a time. SSE2 is part of the x86-64 baseline, so no runtime check
+// is needed. The conversion of the digits relies on little-endian loads,
+// which every SSE2 capable CPU has
+#if TORRENT_HAS_SSE && (defined __SSE2__ || defined _M_X64 || defined _M_AMD64 \
+	|| (defined _M_IX86_FP && _M_IX86_FP >= 2))
+#define TORRENT_BDECODE_SSE2 1
+#include <emmintrin.h>
+#if defined _MSC_VER
+#include <intrin.h> // for _BitScanForward
+#endif
+#else
+#define TORRENT_BDECODE_SSE2 0
+#endif
 
 #ifndef BOOST_SYSTEM_NOEXCEPT
 #define BOOST_SYSTEM_NOEXCEPT throw()
@@ -123,6 +139,57 @@ namespace libtorrent
 		return *str1 == 0;
 	}
 
+#if TORRENT_BDECODE_SSE2
+	// the fast paths below read this many bytes from the start of a digit
+	// run, without looking for the end of the buffer
+	const int scan_width = 16;
+
+	// returns the number of leading ASCII digits in the 16 bytes at p
+	int digit_run(char const* p)
+	{
+		__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+		// bytes in ['0', '9'] become [0, 9], everything else ends up above 9
+		__m128i const d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+		__m128i const nine = _mm_set1_epi8(9);
+		int const digits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(d, nine), nine));
+		// the bit above the 16 lanes terminates an all-digit run
+		unsigned int const stop = ~static_cast<unsigned int>(digits);
+#if defined _MSC_VER
+		unsigned long idx;
+		_BitScanForward(&idx, stop);
+		return int(idx);
+#else
+		return __builtin_ctz(stop);
+#endif
+	}
+
+	// converts the n (1-8) ASCII digits at p to their value. Reads 8 bytes.
+	// This is the usual SWAR reduction, pairs of digits are combined into
+	// 2-digit lanes, then 4, then 8
+	boost::uint64_t digits_value8(char const* p, int n)
+	{
+		TORRENT_ASSERT(n >= 1 && n <= 8);
+		boost::uint64_t v;
+		std::memcpy(&v, p, 8);
+		v -= 0x3030303030303030ULL;
+		// move the digits to the most significant end, the vacated low bytes
+		// act as leading zeros
+		v <<= 8 * (8 - n);
+		v = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ffULL;
+		v = (v * 100 + (v >> 16)) & 0x0000ffff0000ffffULL;
+		v = (v * 10000 + (v >> 32)) & 0x00000000ffffffffULL;
+		return v;
+	}
+
+	// the value of the n (1-15) ASCII digits at p
+	boost::int64_t digits_value(char const* p, int n)
+	{
+		if (n <= 8) return boost::int64_t(digits_value8(p, n));
+		return boost::int64_t(digits_value8(p, n - 8) * 100000000ULL
+			+ digits_value8(p + n - 8, 8));
+	}
+#endif // TORRENT_BDECODE_SSE2
+
 	} // anonymous namespace
 
 
@@ -714,6 +781,18 @@ namespace libtorrent
 			return -1;
 		}
 
+		// a node that hasn't been used or reserve()d yet gets room for a token
+		// every 4 bytes of input up front (bounded), rather than growing the
+		// vector one doubling at a time. Inputs dominated by long strings (like
+		// "pieces") get far fewer tokens than that, those are moved into a
+		// tight allocation once parsed
+		bool const presized = ret.m_tokens.capacity() == 0 && token_limit > 0;
+		if (presized)
+		{
+			ret.m_tokens.reserve((std::min)((std::min)(token_limit, 0x10000)
+				, int((end - start) / 4) + 2));
+		}
+
 		// this is the stack of bdecode_token indices, into m_tokens.
 		// sp is the stack pointer, as index into the array, stack
 		int sp = 0;
@@ -778,6 +857,26 @@ namespace libtorrent
 				{
 					char const* int_start = start;
 					bdecode_errors::error_code_enum e = bdecode_errors::no_error;
+#if TORRENT_BDECODE_SSE2
+					// a well-formed integer with room to spare at the end of the
+					// buffer is validated with a single scan. Anything else,
+					// including errors, goes through check_integer()
+					char const* digits = start + 1;
+					if (end - digits > scan_width)
+					{
+						digits += *digits == '-';
+						// single digits (flags, mostly) need no scan
+						int const n = digits[1] == 'e' && numeric(digits[0]) ? 1
+							: digit_run(digits);
+						if (n > 0 && n < scan_width && digits[n] == 'e')
+						{
+							ret.m_tokens.push_back(bdecode_token(int_start - orig_start
+								, 1, bdecode_token::integer, 1));
+							start = digits + n + 1;
+							break;
+						}
+					}
+#endif
 					// +1 here to point to the first digit, rather than 'i'
 					start = check_integer(start + 1, end, e);
 					if (e)
@@ -840,6 +939,18 @@ namespace libtorrent
 
 					boost::int64_t len = t - '0';
 					char const* str_start = start;
+#if TORRENT_BDECODE_SSE2
+					// single digit lengths (most dictionary keys) need no scan
+					int const n = end - start <= scan_width ? 0
+						: start[1] == ':' ? 1 : digit_run(start);
+					if (n > 0 && n < scan_width && start[n] == ':')
+					{
+						len = n == 1 ? len : digits_value(start, n);
+						start += n;
+					}
+					else
+#endif
+					{
 					++start;
 					if (start >= end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
 					bdecode_errors::error_code_enum e = bdecode_errors::no_error;
@@ -848,6 +959,7 @@ namespace libtorrent
 						TORRENT_FAIL_BDECODE(e);
 					if (start == end)
 						TORRENT_FAIL_BDECODE(bdecode_errors::expected_colon);
+					}
 
 					// remaining buffer size excluding ':'
 					const ptrdiff_t buff_size = end - start - 1;
@@ -913,6 +1025,12 @@ done:
 		ret.m_tokens.push_back(bdecode_token(start - orig_start, 0
 			, bdecode_token::end));
 
+		if (presized && ret.m_tokens.capacity() > 1024
+			&& ret.m_tokens.size() * 2 < ret.m_tokens.capacity())
+		{
+			std::vector<bdecode_token>(ret.m_tokens).swap(ret.m_tokens);
+		}
+
 		ret.m_token_idx = 0;
 		ret.m_buffer = orig_start;
 		ret.m_buffer_size = start - orig_start;
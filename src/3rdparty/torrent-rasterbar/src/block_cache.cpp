@@ -215,6 +215,8 @@ const char* const job_action_name[] =
 	"load_torrent",
 	"clear_piece",
 	"tick_storage",
+	"check_pieces",
+	"map_read",
 	"resolve_links"
 };
 
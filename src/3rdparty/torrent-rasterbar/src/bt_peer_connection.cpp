@@ -2487,6 +2487,67 @@ namespace libtorrent
 	{
 		INVARIANT_CHECK;
 
+		write_piece_header(r);
+
+		if (buffer.ref().storage == 0)
+		{
+			append_send_buffer(buffer.get(), r.length
+				, &buffer_free_disk_buf, &m_allocator);
+		}
+		else
+		{
+			append_const_send_buffer(buffer.get(), r.length
+				, &buffer_reclaim_block, &m_allocator, buffer.ref());
+		}
+		buffer.release();
+
+		m_payloads.push_back(range(send_buffer_size() - r.length, r.length));
+		setup_send();
+
+		stats_counters().inc_stats_counter(counters::num_outgoing_piece);
+	}
+
+	bool bt_peer_connection::can_send_zero_copy() const
+	{
+#if TORRENT_USE_SENDFILE
+		if (!m_settings.get_bool(settings_pack::zero_copy_send)) return false;
+#if !defined(TORRENT_DISABLE_ENCRYPTION) && !defined(TORRENT_DISABLE_EXTENSIONS)
+		// the payload has to go out as it's stored on disk
+		if (m_rc4_encrypted || !m_enc_handler.is_send_plaintext()) return false;
+#endif
+		// this excludes SSL, uTP, i2p and proxied connections
+		return get_socket()->get<tcp::socket>() != NULL;
+#else
+		return false;
+#endif
+	}
+
+	void bt_peer_connection::write_piece_from_files(peer_request const& r
+		, std::vector<file_range> const& ranges)
+	{
+		INVARIANT_CHECK;
+
+		TORRENT_ASSERT(can_send_zero_copy());
+
+		write_piece_header(r);
+
+		int size = 0;
+		for (std::vector<file_range>::const_iterator i = ranges.begin()
+			, end(ranges.end()); i != end; ++i)
+		{
+			append_send_file(*i);
+			size += i->size;
+		}
+		TORRENT_ASSERT(size == r.length);
+
+		m_payloads.push_back(range(send_buffer_size() - r.length, r.length));
+		setup_send();
+
+		stats_counters().inc_stats_counter(counters::num_outgoing_piece);
+	}
+
+	void bt_peer_connection::write_piece_header(peer_request const& r)
+	{
 		TORRENT_ASSERT(m_sent_handshake);
 		TORRENT_ASSERT(m_sent_bitfield);
 
@@ -2542,23 +2603,6 @@ namespace libtorrent
 		{
 			send_buffer(msg, 13);
 		}
-
-		if (buffer.ref().storage == 0)
-		{
-			append_send_buffer(buffer.get(), r.length
-				, &buffer_free_disk_buf, &m_allocator);
-		}
-		else
-		{
-			append_const_send_buffer(buffer.get(), r.length
-				, &buffer_reclaim_block, &m_allocator, buffer.ref());
-		}
-		buffer.release();
-
-		m_payloads.push_back(range(send_buffer_size() - r.length, r.length));
-		setup_send();
-
-		stats_counters().inc_stats_counter(counters::num_outgoing_piece);
 	}
 
 	// --------------------------
@@ -44,7 +44,8 @@ namespace libtorrent
 			buffer_t& b = m_vec.front();
 			if (b.used_size > bytes_to_pop)
 			{
-				b.start += bytes_to_pop;
+				if (b.file) b.file_offset += bytes_to_pop;
+				else b.start += bytes_to_pop;
 				b.used_size -= bytes_to_pop;
 				m_bytes -= bytes_to_pop;
 				TORRENT_ASSERT(m_bytes <= m_capacity);
@@ -53,7 +54,7 @@ namespace libtorrent
 				break;
 			}
 
-			b.free_fun(b.buf, b.userdata, b.ref);
+			if (b.free_fun) b.free_fun(b.buf, b.userdata, b.ref);
 			m_bytes -= b.used_size;
 			m_capacity -= b.size;
 			bytes_to_pop -= b.used_size;
@@ -78,6 +79,7 @@ namespace libtorrent
 		b.free_fun = destructor;
 		b.userdata = userdata;
 		b.ref = ref;
+		b.file_offset = 0;
 		m_vec.push_back(b);
 
 		m_bytes += used_size;
@@ -98,6 +100,7 @@ namespace libtorrent
 		b.free_fun = destructor;
 		b.userdata = userdata;
 		b.ref = ref;
+		b.file_offset = 0;
 		m_vec.push_front(b);
 
 		m_bytes += used_size;
@@ -105,6 +108,51 @@ namespace libtorrent
 		TORRENT_ASSERT(m_bytes <= m_capacity);
 	}
 
+	void chained_buffer::append_file(file_range const& r)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(r.handle);
+		TORRENT_ASSERT(r.size > 0);
+		buffer_t b;
+		b.buf = NULL;
+		b.size = r.size;
+		b.start = NULL;
+		b.used_size = r.size;
+		b.free_fun = NULL;
+		b.userdata = NULL;
+		b.file = r.handle;
+		b.file_offset = r.offset;
+		m_vec.push_back(b);
+
+		m_bytes += r.size;
+		m_capacity += r.size;
+		TORRENT_ASSERT(m_bytes <= m_capacity);
+	}
+
+	bool chained_buffer::front_file(file_range& r) const
+	{
+		TORRENT_ASSERT(is_single_thread());
+		if (m_vec.empty() || !m_vec.front().file) return false;
+		buffer_t const& b = m_vec.front();
+		r.handle = b.file;
+		r.offset = b.file_offset;
+		r.size = b.used_size;
+		return true;
+	}
+
+	bool chained_buffer::reaches_file(int bytes) const
+	{
+		TORRENT_ASSERT(is_single_thread());
+		for (std::deque<buffer_t>::const_iterator i = m_vec.begin()
+			, end(m_vec.end()); i != end; ++i)
+		{
+			if (i->file) return true;
+			bytes -= i->used_size;
+			if (bytes < 0) return false;
+		}
+		return false;
+	}
+
 	// returns the number of bytes available at the
 	// end of the last chained buffer.
 	int chained_buffer::space_in_last_buffer()
@@ -112,6 +160,7 @@ namespace libtorrent
 		TORRENT_ASSERT(is_single_thread());
 		if (m_vec.empty()) return 0;
 		buffer_t& b = m_vec.back();
+		if (b.file) return 0;
 		return b.size - b.used_size - (b.start - b.buf);
 	}
 
@@ -135,6 +184,7 @@ namespace libtorrent
 		TORRENT_ASSERT(is_single_thread());
 		if (m_vec.empty()) return 0;
 		buffer_t& b = m_vec.back();
+		if (b.file) return 0;
 		char* insert = b.start + b.used_size;
 		if (insert + s > b.buf + b.size) return 0;
 		b.used_size += s;
@@ -162,6 +212,8 @@ namespace libtorrent
 		for (std::deque<buffer_t>::iterator i = m_vec.begin()
 			, end(m_vec.end()); bytes > 0 && i != end; ++i)
 		{
+			// file ranges are not in memory, they're sent separately
+			if (i->file) break;
 			if (i->used_size > bytes)
 			{
 				TORRENT_ASSERT(bytes > 0);
@@ -179,7 +231,7 @@ namespace libtorrent
 		for (std::deque<buffer_t>::iterator i = m_vec.begin()
 			, end(m_vec.end()); i != end; ++i)
 		{
-			i->free_fun(i->buf, i->userdata, i->ref);
+			if (i->free_fun) i->free_fun(i->buf, i->userdata, i->ref);
 		}
 		m_bytes = 0;
 		m_capacity = 0;
@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/torrent.hpp"
 
 #include <boost/bind.hpp>
+#include <algorithm>
 
 namespace libtorrent
 {
@@ -255,6 +256,74 @@ namespace libtorrent
 		return lhs->time_of_last_unchoke() < rhs->time_of_last_unchoke();
 	}
 
+	// picks peers best-first according to a comparison function (one of the
+	// above, returning true if lhs should be unchoked before rhs) without
+	// sorting the whole vector. Building the heap is linear and each pop is
+	// O(log N), so selecting the top K peers costs O(N + K log N) instead of
+	// O(N log N). Popped peers are collected at the back of the vector, best
+	// one last, and finish() moves them to the front in order.
+	template <class Compare>
+	struct unchoke_heap
+	{
+		unchoke_heap(std::vector<peer_connection*>& peers, Compare cmp)
+			: m_peers(peers), m_cmp(cmp), m_end(peers.end())
+		{
+			std::make_heap(m_peers.begin(), m_end, *this);
+		}
+
+		bool empty() const { return m_end == m_peers.begin(); }
+
+		peer_connection* pop()
+		{
+			TORRENT_ASSERT(!empty());
+			std::pop_heap(m_peers.begin(), m_end, *this);
+			--m_end;
+			return *m_end;
+		}
+
+		// pops up to num peers
+		void pop(int num)
+		{
+			while (num > 0 && !empty())
+			{
+				pop();
+				--num;
+			}
+		}
+
+		void finish()
+		{
+			std::reverse(m_peers.begin(), m_peers.end());
+		}
+
+		// the standard heap keeps its largest element on top. We want the
+		// best unchoke candidate there, so the arguments are swapped
+		bool operator()(peer_connection const* lhs, peer_connection const* rhs) const
+		{ return m_cmp(rhs, lhs); }
+
+	private:
+		std::vector<peer_connection*>& m_peers;
+		Compare m_cmp;
+		std::vector<peer_connection*>::iterator m_end;
+	};
+
+	template <class Compare>
+	void select_unchoke_candidates(std::vector<peer_connection*>& peers
+		, int num, Compare cmp)
+	{
+		// with unlimited unchoke slots every peer is ranked, and a plain sort
+		// beats draining the heap
+		if (num >= int(peers.size()))
+		{
+			std::sort(peers.begin(), peers.end(), cmp);
+			return;
+		}
+
+		unchoke_heap<Compare> heap(peers, cmp);
+		heap.pop(num);
+		heap.finish();
+	}
+
 	} // anonymous namespace
 
 	int unchoke_sort(std::vector<peer_connection*>& peers
@@ -306,10 +375,10 @@ namespace libtorrent
 				}
 			}
 
-			// if we're using the bittyrant choker, sort peers by their return
+			// if we're using the bittyrant choker, pick peers by their return
 			// on investment. i.e. download rate / upload rate
-			std::sort(peers.begin(), peers.end()
-				, boost::bind(&bittyrant_unchoke_compare, _1, _2));
+			unchoke_heap<bool(*)(peer_connection const*, peer_connection const*)>
+				heap(peers, &bittyrant_unchoke_compare);
 
 			int upload_capacity_left = max_upload_rate;
 
@@ -318,10 +387,9 @@ namespace libtorrent
 			// until there none left
 			upload_slots = 0;
 
-			for (std::vector<peer_connection*>::iterator i = peers.begin()
-				, end(peers.end()); i != end; ++i)
+			while (!heap.empty())
 			{
-				peer_connection* p = *i;
+				peer_connection* p = heap.pop();
 				TORRENT_ASSERT(p);
 
 				if (p->est_reciprocation_rate() > upload_capacity_left) break;
@@ -329,6 +397,7 @@ namespace libtorrent
 				++upload_slots;
 				upload_capacity_left -= p->est_reciprocation_rate();
 			}
+			heap.finish();
 
 			return upload_slots;
 		}
@@ -350,21 +419,18 @@ namespace libtorrent
 			// it purely based on the current state of our peers.
 			upload_slots = 0;
 
-			// TODO: optimize this using partial_sort or something. We don't need
-			// to sort the entire list
-
-			// TODO: make the comparison function a free function and move it
-			// into this cpp file
-			std::sort(peers.begin(), peers.end()
-				, boost::bind(&upload_rate_compare, _1, _2));
+			// visit peers in order of decreasing upload rate, only as far as
+			// we need to. The order is thrown away, the peers are ranked by the
+			// seed choking algorithm below
+			unchoke_heap<bool(*)(peer_connection const*, peer_connection const*)>
+				heap(peers, &upload_rate_compare);
 
 			// TODO: make configurable
 			int rate_threshold = 1024;
 
-			for (std::vector<peer_connection*>::const_iterator i = peers.begin()
-				, end(peers.end()); i != end; ++i)
+			while (!heap.empty())
 			{
-				peer_connection const& p = **i;
+				peer_connection const& p = *heap.pop();
 				int const rate = int(p.uploaded_in_last_round()
 					* 1000 / total_milliseconds(unchoke_interval));
 
@@ -383,37 +449,35 @@ namespace libtorrent
 		// being seeded, the download rate will be 0, and the peers we have sent
 		// the least to should be unchoked
 
-		// we use partial sort here, because we only care about the top
-		// upload_slots peers.
+		// we only care about the top upload_slots peers, so only those are
+		// picked off a heap, in order.
+
+		int const num_slots = (std::min)(upload_slots, int(peers.size()));
 
 		if (sett.get_int(settings_pack::seed_choking_algorithm)
 			== settings_pack::round_robin)
 		{
 			int const pieces = sett.get_int(settings_pack::seeding_piece_quota);
 
-			std::partial_sort(peers.begin(), peers.begin()
-				+ (std::min)(upload_slots, int(peers.size())), peers.end()
+			select_unchoke_candidates(peers, num_slots
 				, boost::bind(&unchoke_compare_rr, _1, _2, pieces));
 		}
 		else if (sett.get_int(settings_pack::seed_choking_algorithm)
 			== settings_pack::fastest_upload)
 		{
-			std::partial_sort(peers.begin(), peers.begin()
-				+ (std::min)(upload_slots, int(peers.size())), peers.end()
-				, boost::bind(&unchoke_compare_fastest_upload, _1, _2));
+			select_unchoke_candidates(peers, num_slots
+				, &unchoke_compare_fastest_upload);
 		}
 		else if (sett.get_int(settings_pack::seed_choking_algorithm)
 			== settings_pack::anti_leech)
 		{
-			std::partial_sort(peers.begin(), peers.begin()
-				+ (std::min)(upload_slots, int(peers.size())), peers.end()
-				, boost::bind(&unchoke_compare_anti_leech, _1, _2));
+			select_unchoke_candidates(peers, num_slots
+				, &unchoke_compare_anti_leech);
 		}
 		else
 		{
 			int const pieces = sett.get_int(settings_pack::seeding_piece_quota);
-			std::partial_sort(peers.begin(), peers.begin()
-				+ (std::min)(upload_slots, int(peers.size())), peers.end()
+			select_unchoke_candidates(peers, num_slots
 				, boost::bind(&unchoke_compare_rr, _1, _2, pieces));
 
 			TORRENT_ASSERT(false);
@@ -32,6 +32,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/config.hpp"
 #include <cstring>
+#include <boost/cstdint.hpp>
 
 #include "libtorrent/aux_/cpuid.hpp"
 
@@ -62,6 +63,43 @@ namespace libtorrent { namespace aux
 #endif
 	}
 
+	// internal. Like cpuid() but for the leafs that take a sub-leaf in ecx
+	// (such as 7, the extended features)
+	void cpuid_count(unsigned int info[4], int type, int subtype)
+	{
+#if TORRENT_HAS_SSE && defined _MSC_VER
+		__cpuidex((int*)info, type, subtype);
+
+#elif TORRENT_HAS_SSE && defined __GNUC__
+		if (__get_cpuid_max(0, NULL) < static_cast<unsigned int>(type))
+		{
+			std::memset(&info[0], 0, sizeof(unsigned int) * 4);
+			return;
+		}
+		__cpuid_count(type, subtype, info[0], info[1], info[2], info[3]);
+#else
+		TORRENT_UNUSED(type);
+		TORRENT_UNUSED(subtype);
+		std::memset(&info[0], 0, sizeof(unsigned int) * 4);
+#endif
+	}
+
+#if TORRENT_HAS_SSE
+	// returns the low 32 bits of the XCR0 register, i.e. which register
+	// states the operating system saves on context switches
+	boost::uint32_t xgetbv0()
+	{
+#if defined _MSC_VER
+		return boost::uint32_t(_xgetbv(0));
+#else
+		boost::uint32_t eax, edx;
+		// xgetbv with ecx = 0
+		__asm__ (".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+		return eax;
+#endif
+	}
+#endif
+
 	bool supports_sse42()
 	{
 #if TORRENT_HAS_SSE
@@ -84,10 +122,43 @@ namespace libtorrent { namespace aux
 #endif
 	}
 
+	bool supports_sha()
+	{
+#if TORRENT_HAS_SSE
+		unsigned int cpui[4];
+		cpuid(cpui, 1);
+		// the SHA extensions operate on xmm registers and use pshufb (SSSE3)
+		// and pblendw (SSE4.1)
+		if ((cpui[2] & (1 << 9)) == 0 || (cpui[2] & (1 << 19)) == 0) return false;
+		cpuid_count(cpui, 7, 0);
+		return (cpui[1] & (1 << 29)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	bool supports_avx2()
+	{
+#if TORRENT_HAS_SSE
+		unsigned int cpui[4];
+		cpuid(cpui, 1);
+		// the CPU has to support AVX and the OS has to enable it (OSXSAVE),
+		// and has to save both the xmm and ymm state
+		if ((cpui[2] & (1 << 27)) == 0 || (cpui[2] & (1 << 28)) == 0) return false;
+		if ((xgetbv0() & 6) != 6) return false;
+		cpuid_count(cpui, 7, 0);
+		return (cpui[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+
 	} // anonymous namespace
 
 	bool sse42_support = supports_sse42();
 	bool mmx_support = supports_mmx();
+	bool sha_support = supports_sha();
+	bool avx2_support = supports_avx2();
 } }
 
 
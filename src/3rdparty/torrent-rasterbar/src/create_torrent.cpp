@@ -35,20 +35,26 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/file_pool.hpp"
 #include "libtorrent/storage.hpp"
 #include "libtorrent/aux_/escape_string.hpp" // for convert_to_wstring
-#include "libtorrent/disk_io_thread.hpp"
+#include "libtorrent/thread.hpp"
+#include "libtorrent/hasher.hpp"
 #include "libtorrent/aux_/merkle.hpp" // for merkle_*()
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/announce_entry.hpp"
-#include "libtorrent/performance_counters.hpp" // for counters
-#include "libtorrent/alert_manager.hpp"
 
 #include <boost/bind.hpp>
 #include <boost/next_prior.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/ref.hpp>
+
+#include <deque>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef TORRENT_WINDOWS
+#include <unistd.h> // for sysconf
+#endif
 
 #define MAX_SYMLINK_PATH 200
 
@@ -162,34 +168,85 @@ namespace libtorrent
 			}
 		}
 
-		void on_hash(disk_io_job const* j, create_torrent* t
-			, boost::shared_ptr<piece_manager> storage, disk_io_thread* iothread
-			, int* piece_counter, int* completed_piece
-			, boost::function<void(int)> const* f, error_code* ec)
+		// the pieces read into one buffer are hashed by one thread. Reading
+		// files in chunks this large keeps the disk streaming, even with
+		// small pieces
+		enum { hash_chunk_size = 4 * 1024 * 1024 };
+
+		// the total size of the chunk buffers. It doesn't grow with the number
+		// of threads, so large pieces on many cores don't pin gigabytes
+		enum { hash_buffer_budget = 64 * 1024 * 1024 };
+
+		struct hash_chunk
 		{
-			if (j->ret != 0)
-			{
-				// on error
-				*ec = j->error.ec;
-				iothread->set_num_threads(0);
-				return;
-			}
-			t->set_hash(j->piece, sha1_hash(j->d.piece_hash));
-			(*f)(*completed_piece);
-			++(*completed_piece);
-			if (*piece_counter < t->num_pieces())
-			{
-				iothread->async_hash(storage.get(), *piece_counter
-					, disk_io_job::sequential_access
-					, boost::bind(&on_hash, _1, t, storage, iothread
-					, piece_counter, completed_piece, f, ec), NULL);
-				++(*piece_counter);
-			}
-			else
+			std::vector<char> buffer;
+			int first_piece;
+			int num_pieces;
+		};
+
+		// chunks read by the calling thread, waiting to be hashed by the
+		// worker threads. Hashed chunks are returned to the free list, and new
+		// ones are only allocated while it's empty and the budget allows
+		struct hash_queue
+		{
+			hash_queue(create_torrent& t)
+				: torrent(t), hashed(0), done(false) {}
+
+			create_torrent& torrent;
+			mutex m;
+			condition_variable cond;
+			std::deque<hash_chunk*> pending;
+			std::vector<hash_chunk*> free_chunks;
+			int hashed;
+			bool done;
+		};
+
+		void hash_thread_fun(hash_queue* q)
+		{
+			mutex::scoped_lock l(q->m);
+			for (;;)
 			{
-				iothread->abort(true);
+				while (q->pending.empty() && !q->done) q->cond.wait(l);
+				if (q->pending.empty()) return;
+
+				hash_chunk* c = q->pending.front();
+				q->pending.pop_front();
+				l.unlock();
+
+				char const* buf = &c->buffer[0];
+				for (int i = c->first_piece; i < c->first_piece + c->num_pieces; ++i)
+				{
+					int const size = q->torrent.piece_size(i);
+					// set_hash() only touches the entry of this piece
+					q->torrent.set_hash(i, hasher(buf, size).final());
+					buf += size;
+				}
+
+				l.lock();
+				q->hashed += c->num_pieces;
+				q->free_chunks.push_back(c);
+				q->cond.notify_all();
 			}
-			iothread->submit_jobs();
+		}
+
+		int default_hash_threads()
+		{
+#if defined TORRENT_WINDOWS
+			SYSTEM_INFO si;
+			GetSystemInfo(&si);
+			int const cpus = si.dwNumberOfProcessors;
+#elif defined _SC_NPROCESSORS_ONLN
+			int const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+			int const cpus = 1;
+#endif
+			return (std::max)(cpus, 1);
+		}
+
+		bool void_progress(boost::function<void(int)> const& f, int piece)
+		{
+			f(piece);
+			return true;
 		}
 
 	} // anonymous namespace
@@ -248,9 +305,13 @@ namespace libtorrent
 	void set_piece_hashes(create_torrent& t, std::string const& p
 		, boost::function<void(int)> const& f, error_code& ec)
 	{
-		// optimized path
-		io_service ios;
+		set_piece_hashes(t, p, boost::bind(&void_progress, boost::cref(f), _1)
+			, 0, ec);
+	}
 
+	void set_piece_hashes(create_torrent& t, std::string const& p
+		, boost::function<bool(int)> const& f, int num_threads, error_code& ec)
+	{
 #if TORRENT_USE_UNC_PATHS
 		std::string path = canonicalize_path(p);
 #else
@@ -269,47 +330,110 @@ namespace libtorrent
 			return;
 		}
 
-		// dummy torrent object pointer
-		boost::shared_ptr<char> dummy;
-		counters cnt;
-		disk_io_thread disk_thread(ios, cnt, 0);
-		disk_thread.set_num_threads(1);
+		if (num_threads <= 0) num_threads = default_hash_threads();
 
+		file_pool pool;
 		storage_params params;
 		params.files = &t.files();
 		params.mapped_files = NULL;
 		params.path = path;
-		params.pool = &disk_thread.files();
+		params.pool = &pool;
 		params.mode = storage_mode_sparse;
+		boost::scoped_ptr<storage_interface> storage(default_storage_constructor(params));
+
+		int const pieces_per_chunk = (std::max)(1, int(hash_chunk_size / t.piece_length()));
+		int const chunk_bytes = pieces_per_chunk * t.piece_length();
+		// one chunk is being read while the others are hashed, two per
+		// thread are more than the threads can keep busy
+		int const max_chunks = (std::min)(num_threads * 2
+			, (std::max)(2, int(hash_buffer_budget / chunk_bytes)));
+		// any more threads than chunks would never have one to hash
+		num_threads = (std::min)(num_threads, max_chunks - 1);
+
+		hash_queue q(t);
+		// a deque, so growing it doesn't move the chunks being hashed
+		std::deque<hash_chunk> chunks;
+
+		std::vector<boost::shared_ptr<thread> > threads;
+		for (int i = 0; i < num_threads; ++i)
+			threads.push_back(boost::make_shared<thread>(boost::bind(&hash_thread_fun, &q)));
+
+		// the calling thread reads the files front to back (no
+		// file::random_access, so the OS reads ahead) and reports progress,
+		// the worker threads only hash
+		int reported = 0;
+		bool aborted = false;
+		mutex::scoped_lock l(q.m);
+		for (int piece = 0; piece < t.num_pieces() && !aborted;)
+		{
+			while (q.free_chunks.empty() && int(chunks.size()) == max_chunks)
+				q.cond.wait(l);
+			hash_chunk* c;
+			if (q.free_chunks.empty())
+			{
+				chunks.push_back(hash_chunk());
+				c = &chunks.back();
+			}
+			else
+			{
+				c = q.free_chunks.back();
+				q.free_chunks.pop_back();
+			}
+			int const hashed = q.hashed;
+			l.unlock();
+			if (c->buffer.empty()) c->buffer.resize(chunk_bytes);
 
-		storage_interface* storage_impl = default_storage_constructor(params);
-
-		boost::shared_ptr<piece_manager> storage = boost::make_shared<piece_manager>(
-			storage_impl, dummy, const_cast<file_storage*>(&t.files()));
+			for (; reported < hashed && !aborted; ++reported)
+				aborted = !f(reported);
+			if (aborted)
+			{
+				l.lock();
+				q.free_chunks.push_back(c);
+				break;
+			}
 
-		settings_pack sett;
-		sett.set_int(settings_pack::cache_size, 0);
-		sett.set_int(settings_pack::aio_threads, 2);
+			c->first_piece = piece;
+			c->num_pieces = (std::min)(pieces_per_chunk, t.num_pieces() - piece);
+			int size = 0;
+			for (int i = piece; i < piece + c->num_pieces; ++i)
+				size += t.piece_size(i);
 
-		// TODO: this should probably be optional
-		alert_manager dummy2(0, 0);
-		disk_thread.set_settings(&sett, dummy2);
+			file::iovec_t b = { &c->buffer[0], size_t(size) };
+			storage_error se;
+			int const ret = storage->readv(&b, 1, piece, 0, 0, se);
+			if (se) ec = se.ec;
+			else if (ret != size) ec = errors::file_too_short;
 
-		int piece_counter = 0;
-		int completed_piece = 0;
-		int piece_read_ahead = 15 * 1024 * 1024 / t.piece_length();
-		if (piece_read_ahead < 1) piece_read_ahead = 1;
+			l.lock();
+			if (ec)
+			{
+				q.free_chunks.push_back(c);
+				break;
+			}
+			q.pending.push_back(c);
+			q.cond.notify_all();
+			piece += c->num_pieces;
+		}
 
-		for (int i = 0; i < piece_read_ahead; ++i)
+		// let the threads drain the queue and exit
+		q.done = true;
+		q.cond.notify_all();
+		while (!aborted && !ec && reported < t.num_pieces())
 		{
-			disk_thread.async_hash(storage.get(), i, disk_io_job::sequential_access
-				, boost::bind(&on_hash, _1, &t, storage, &disk_thread
-				, &piece_counter, &completed_piece, &f, &ec), NULL);
-			++piece_counter;
-			if (piece_counter >= t.num_pieces()) break;
+			while (q.hashed == reported) q.cond.wait(l);
+			int const hashed = q.hashed;
+			l.unlock();
+			for (; reported < hashed && !aborted; ++reported)
+				aborted = !f(reported);
+			l.lock();
 		}
-		disk_thread.submit_jobs();
-		ios.run(ec);
+		if (aborted) q.pending.clear();
+		l.unlock();
+
+		for (int i = 0; i < int(threads.size()); ++i)
+			threads[i]->join();
+
+		if (aborted && !ec) ec = boost::asio::error::operation_aborted;
 	}
 
 	create_torrent::~create_torrent() {}
@@ -62,6 +62,10 @@ namespace libtorrent
 	{
 		if (action == rename_file || action == move_storage)
 			free(buffer.string);
+		else if (action == check_pieces)
+			free(buffer.piece_hashes);
+		else if (action == map_read)
+			delete buffer.file_ranges;
 		else if (action == save_resume_data)
 			delete static_cast<entry*>(buffer.resume_data);
 	}
@@ -41,6 +41,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/file_pool.hpp"
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/platform_util.hpp"
+#include "libtorrent/allocator.hpp" // for page_aligned_allocator
+#include "libtorrent/sha1.hpp" // for SHA1_multi
 #include <boost/scoped_array.hpp>
 #include <boost/bind.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -146,7 +148,7 @@ namespace libtorrent
 		, m_userdata(userdata)
 		, m_last_cache_expiry(min_time())
 		, m_last_file_check(clock_type::now())
-		, m_file_pool(40)
+		, m_file_pool(file_pool::default_size_limit())
 		, m_disk_cache(block_size, ios, boost::bind(&disk_io_thread::trigger_cache_trim, this))
 		, m_cache_check_state(cache_check_idle)
 		, m_stats_counters(cnt)
@@ -269,7 +271,9 @@ namespace libtorrent
 		apply_pack(pack, m_settings);
 		error_code ec;
 		m_disk_cache.set_settings(m_settings, ec);
-		m_file_pool.resize(m_settings.get_int(settings_pack::file_pool_size));
+		int const file_pool_size = m_settings.get_int(settings_pack::file_pool_size);
+		m_file_pool.resize(file_pool_size > 0 ? file_pool_size
+			: file_pool::default_size_limit());
 #ifndef TORRENT_NO_DEPRECATE
 		if (ec && alerts.should_post<mmap_cache_alert>())
 		{
@@ -1044,6 +1048,8 @@ namespace libtorrent
 		&disk_io_thread::do_load_torrent,
 		&disk_io_thread::do_clear_piece,
 		&disk_io_thread::do_tick,
+		&disk_io_thread::do_check_pieces,
+		&disk_io_thread::do_map_read,
 	};
 
 	} // anonymous namespace
@@ -1773,6 +1779,66 @@ namespace libtorrent
 		add_job(j);
 	}
 
+	void disk_io_thread::async_check_pieces(piece_manager* storage, int piece
+		, int num_pieces, int flags
+		, boost::function<void(disk_io_job const*)> const& handler)
+	{
+#ifdef TORRENT_DEBUG
+		// the caller must increment the torrent refcount before
+		// issuing an async disk request
+		storage->assert_torrent_refcount();
+#endif
+		TORRENT_ASSERT(num_pieces > 0);
+		TORRENT_ASSERT(num_pieces <= 0xffff);
+		TORRENT_ASSERT(piece + num_pieces <= storage->files()->num_pieces());
+
+		disk_io_job* j = allocate_job(disk_io_job::check_pieces);
+		j->storage = storage->shared_from_this();
+		j->piece = piece;
+		j->d.check.num_pieces = num_pieces;
+		j->d.check.num_hashed = 0;
+		j->buffer.piece_hashes = static_cast<char*>(malloc(num_pieces * 20));
+		j->callback = handler;
+		j->flags = flags;
+
+		add_job(j);
+	}
+
+	bool disk_io_thread::async_map_read(piece_manager* storage, peer_request const& r
+		, boost::function<void(disk_io_job const*)> const& handler, int flags)
+	{
+#ifdef TORRENT_DEBUG
+		// the caller must increment the torrent refcount before
+		// issuing an async disk request
+		storage->assert_torrent_refcount();
+#endif
+		TORRENT_ASSERT(r.length <= 16 * 1024);
+
+		disk_io_job* j = allocate_job(disk_io_job::map_read);
+		j->storage = storage->shared_from_this();
+		j->piece = r.piece;
+		j->d.io.offset = r.start;
+		j->d.io.buffer_size = r.length;
+
+		// if the block is in the cache, the file may not have the data yet
+		// (dirty blocks), or we may as well send it from memory (read cache)
+		mutex::scoped_lock l(m_cache_mutex);
+		if (block_in_cache(j))
+		{
+			l.unlock();
+			free_job(j);
+			return false;
+		}
+		l.unlock();
+
+		j->buffer.file_ranges = new std::vector<file_range>();
+		j->callback = handler;
+		j->flags = flags;
+
+		add_job(j);
+		return true;
+	}
+
 	void disk_io_thread::async_move_storage(piece_manager* storage, std::string const& p, int flags
 		, boost::function<void(disk_io_job const*)> const& handler)
 	{
@@ -2296,6 +2362,160 @@ namespace libtorrent
 		return ret >= 0 ? 0 : -1;
 	}
 
+	// returns true if any of the blocks the read job ``j`` touches is in the
+	// cache. The cache mutex must be held when calling this
+	bool disk_io_thread::block_in_cache(disk_io_job const* j)
+	{
+		// pieces may be left in the cache with no blocks (ghost entries, or
+		// just to keep their hash state), so look at the blocks themselves
+		cached_piece_entry const* pe = m_disk_cache.find_piece(j);
+		if (pe == NULL) return false;
+
+		int const block_size = m_disk_cache.block_size();
+		int const first = j->d.io.offset / block_size;
+		int const last = (j->d.io.offset + j->d.io.buffer_size - 1) / block_size;
+		for (int b = first; b <= last && b < int(pe->blocks_in_piece); ++b)
+		{
+			if (pe->blocks[b].buf != NULL) return true;
+		}
+		return false;
+	}
+
+	int disk_io_thread::do_map_read(disk_io_job* j, jobqueue_t& /* completed_jobs */ )
+	{
+		TORRENT_ASSERT(m_magic == 0x1337);
+
+		// the block may have been pulled into the cache while the job was
+		// queued. Returning 1 tells the caller to fall back to a regular read
+		mutex::scoped_lock l(m_cache_mutex);
+		bool const cached = block_in_cache(j);
+		l.unlock();
+		if (cached) return 1;
+
+		int const file_flags = file_flags_for_job(j
+			, m_settings.get_bool(settings_pack::coalesce_reads));
+
+		if (!j->storage->get_storage_impl()->map_file_ranges(j->piece
+			, j->d.io.offset, j->d.io.buffer_size, file_flags
+			, *j->buffer.file_ranges, j->error))
+		{
+			j->buffer.file_ranges->clear();
+			return j->error ? -1 : 1;
+		}
+
+#ifdef POSIX_FADV_WILLNEED
+		// the ranges are sent with sendfile() from the network thread, which
+		// would block on a page cache miss. Start reading them in from here
+		for (std::vector<file_range>::const_iterator i = j->buffer.file_ranges->begin()
+			, end(j->buffer.file_ranges->end()); i != end; ++i)
+		{
+			posix_fadvise(i->handle->native_handle(), i->offset, i->size
+				, POSIX_FADV_WILLNEED);
+		}
+#endif
+
+		m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+		return 0;
+	}
+
+	// reads a run of consecutive pieces with a single large read and hashes
+	// them together. This is used when checking files, where the pieces are
+	// not expected to be in the cache and we don't want them to be. The
+	// caller bounds the number of outstanding check jobs, and their size, by
+	// checking_mem_usage. Outstanding jobs further ahead in the torrent are
+	// picked up by the other disk threads, which acts as read-ahead for this
+	// one.
+	int disk_io_thread::do_check_pieces(disk_io_job* j, jobqueue_t& /* completed_jobs */ )
+	{
+		TORRENT_ASSERT(m_magic == 0x1337);
+
+		file_storage const& fs = *j->storage->files();
+		int const first = j->piece;
+		int const num_pieces = j->d.check.num_pieces;
+		int const piece_length = fs.piece_length();
+		int const extent_size = (num_pieces - 1) * piece_length
+			+ fs.piece_size(first + num_pieces - 1);
+		int const file_flags = file_flags_for_job(j
+			, m_settings.get_bool(settings_pack::coalesce_reads));
+
+		char* buf = page_aligned_allocator::malloc(extent_size);
+		if (buf == NULL)
+		{
+			j->error.ec = error::no_memory;
+			j->error.operation = storage_error::alloc_cache_piece;
+			return -1;
+		}
+
+		time_point const start_time = clock_type::now();
+
+		file::iovec_t iov = { buf, size_t(extent_size) };
+		storage_error extent_error;
+		int const ret = j->storage->get_storage_impl()->readv(&iov, 1, first
+			, 0, file_flags, extent_error);
+
+		if (ret > 0)
+		{
+			boost::uint32_t const read_time = total_microseconds(clock_type::now() - start_time);
+			m_read_time.add_sample(read_time);
+
+			m_stats_counters.inc_stats_counter(counters::num_blocks_read
+				, (ret + m_disk_cache.block_size() - 1) / m_disk_cache.block_size());
+			m_stats_counters.inc_stats_counter(counters::num_read_ops);
+			m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
+			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+		}
+
+		// the pieces that were read in full by the extent read. A short read
+		// or an error leaves the remaining pieces to be read one at a time
+		// below, to find out exactly which piece (and file) is affected
+		int num_read = 0;
+		if (ret == extent_size) num_read = num_pieces;
+		else if (ret > 0) num_read = ret / piece_length;
+
+		boost::uint8_t const* bufs[8];
+		boost::uint32_t lens[8];
+		boost::uint8_t* hashes = reinterpret_cast<boost::uint8_t*>(j->buffer.piece_hashes);
+		for (int i = 0; i < num_read; i += 8)
+		{
+			int const batch = (std::min)(8, num_read - i);
+			for (int k = 0; k < batch; ++k)
+			{
+				bufs[k] = reinterpret_cast<boost::uint8_t const*>(buf)
+					+ (i + k) * piece_length;
+				lens[k] = fs.piece_size(first + i + k);
+			}
+			SHA1_multi(bufs, lens, hashes + i * 20, batch);
+		}
+
+		for (int i = num_read; i < num_pieces; ++i)
+		{
+			int const piece_size = fs.piece_size(first + i);
+			char* piece_buf = buf + i * piece_length;
+			file::iovec_t piece_iov = { piece_buf, size_t(piece_size) };
+			int const r = j->storage->get_storage_impl()->readv(&piece_iov, 1
+				, first + i, 0, file_flags, j->error);
+			if (r < 0)
+			{
+				j->d.check.num_hashed = i;
+				page_aligned_allocator::free(buf);
+				return -1;
+			}
+
+			// a short read is not an error in itself, the piece will just fail
+			// the hash check. Don't hash stale buffer contents though
+			if (r < piece_size) memset(piece_buf + r, 0, piece_size - r);
+			j->error = storage_error();
+
+			boost::uint8_t const* p = reinterpret_cast<boost::uint8_t const*>(piece_buf);
+			boost::uint32_t const len = piece_size;
+			SHA1_multi(&p, &len, hashes + i * 20, 1);
+		}
+
+		page_aligned_allocator::free(buf);
+		j->d.check.num_hashed = num_pieces;
+		return 0;
+	}
+
 	int disk_io_thread::do_hash(disk_io_job* j, jobqueue_t& /* completed_jobs */ )
 	{
 		INVARIANT_CHECK;
@@ -1542,6 +1542,15 @@ namespace libtorrent
 		}
 #endif
 
+#ifdef POSIX_FADV_SEQUENTIAL
+		if ((mode & random_access) == 0)
+		{
+			// the file is read front to back (i.e. when checking files).
+			// This increases the kernel's read-ahead window
+			posix_fadvise(native_handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+		}
+#endif
+
 #endif
 		m_open_mode = mode;
 
@@ -2141,6 +2150,22 @@ typedef struct _FILE_ALLOCATED_RANGE_BUFFER {
 			int ret;
 #endif
 
+#if defined TORRENT_LINUX && !defined TORRENT_ANDROID
+			// fallocate() allocates the blocks without writing to them. Unlike
+			// posix_fallocate(), it fails on filesystems that don't support
+			// that, instead of filling the file with zeros
+			ret = fallocate(native_handle(), 0, 0, s);
+			if (ret == 0) return true;
+			if (errno != EOPNOTSUPP && errno != ENOSYS && errno != EINVAL)
+			{
+				ec.assign(errno, system_category());
+				return false;
+			}
+
+			// allocating the file would mean writing all of it. Leave it sparse
+			if (m_open_mode & fast_allocate) return true;
+#endif
+
 #if TORRENT_HAS_FALLOCATE
 			// if fallocate failed, we have to use posix_fallocate
 			// which can be painfully slow
@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <boost/version.hpp>
 #include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
 
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
@@ -43,13 +44,19 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/file_pool.hpp"
 #include "libtorrent/error_code.hpp"
 #include "libtorrent/file_storage.hpp" // for file_entry
+#include "libtorrent/platform_util.hpp" // for max_open_files
 #include "libtorrent/aux_/time.hpp"
 
+#include <algorithm>
+#include <limits>
+
 namespace libtorrent
 {
 	file_pool::file_pool(int size)
 		: m_size(size)
 		, m_low_prio_io(true)
+		, m_num_files(0)
+		, m_use_counter(0)
 	{
 	}
 
@@ -124,35 +131,73 @@ namespace libtorrent
 	}
 #endif // TORRENT_WINDOWS
 
+	int file_pool::default_size_limit()
+	{
+		int const max_files = max_open_files();
+		// leave some margin for sockets, epoll/kqueue, log files etc. This
+		// mirrors the connections_limit cap in session_impl, which takes 80%
+		int const share = (std::min)(max_files, 100000) / 5;
+		return (std::max)(40, share - 4);
+	}
+
+	file_pool::shard& file_pool::shard_for(void* st)
+	{
+		// the low bits of a heap pointer are mostly zero, mix them in
+		boost::uint32_t const h = boost::uint32_t(std::size_t(st) >> 4) * 2654435761u;
+		return m_shards[h >> 28];
+	}
+
+	file_pool::shard const& file_pool::shard_for(void* st) const
+	{
+		return const_cast<file_pool*>(this)->shard_for(st);
+	}
+
+	file_handle file_pool::erase_entry(shard& s, file_set::iterator i)
+	{
+		file_handle file_ptr = i->second.file_ptr;
+		s.lru.erase(&i->second);
+		s.files.erase(i);
+		--m_num_files;
+		return file_ptr;
+	}
+
 	file_handle file_pool::open_file(void* st, std::string const& p
 		, int file_index, file_storage const& fs, int m, error_code& ec)
 	{
-		// potentially used to hold a reference to a file object that's
-		// about to be destructed. If we have such object we assign it to
+		// potentially used to hold references to file objects that are
+		// about to be destructed. If we have such objects we assign them to
 		// this member to be destructed after we release the mutex. On some
 		// operating systems (such as OSX) closing a file may take a long
 		// time. We don't want to hold the mutex for that.
-		file_handle defer_destruction;
-
-		mutex::scoped_lock l(m_mutex);
+		std::vector<file_handle> defer_destruction;
 
 #if TORRENT_USE_ASSERTS
-		// we're not allowed to open a file
-		// from a deleted storage!
-		TORRENT_ASSERT(std::find(m_deleted_storages.begin(), m_deleted_storages.end()
-			, std::make_pair(fs.name(), static_cast<void const*>(&fs)))
-			== m_deleted_storages.end());
+		{
+			// we're not allowed to open a file
+			// from a deleted storage!
+			mutex::scoped_lock l(m_deleted_mutex);
+			TORRENT_ASSERT(std::find(m_deleted_storages.begin(), m_deleted_storages.end()
+				, std::make_pair(fs.name(), static_cast<void const*>(&fs)))
+				== m_deleted_storages.end());
+		}
 #endif
 
 		TORRENT_ASSERT(st != 0);
 		TORRENT_ASSERT(is_complete(p));
 		TORRENT_ASSERT((m & file::rw_mask) == file::read_only
 			|| (m & file::rw_mask) == file::read_write);
-		file_set::iterator i = m_files.find(std::make_pair(st, file_index));
-		if (i != m_files.end())
+
+		shard& s = shard_for(st);
+		mutex::scoped_lock l(s.mtx);
+
+		file_set::iterator i = s.files.find(std::make_pair(st, file_index));
+		if (i != s.files.end())
 		{
 			lru_file_entry& e = i->second;
 			e.last_use = aux::time_now();
+			e.use_seq = ++m_use_counter;
+			s.lru.erase(&e);
+			s.lru.push_front(&e);
 
 			// if we asked for a file in write mode,
 			// and the cached file is is not opened in
@@ -167,13 +212,13 @@ namespace libtorrent
 				// be outstanding operations on it, we can't close the
 				// file, we can only delete our reference to it.
 				// if this is the only reference to the file, it will be closed
-				defer_destruction = e.file_ptr;
+				defer_destruction.push_back(e.file_ptr);
 				e.file_ptr = boost::make_shared<file>();
 
 				std::string full_path = fs.file_path(file_index, p);
 				if (!e.file_ptr->open(full_path, m, ec))
 				{
-					m_files.erase(i);
+					defer_destruction.push_back(erase_entry(s, i));
 					return file_handle();
 				}
 #ifdef TORRENT_WINDOWS
@@ -187,75 +232,99 @@ namespace libtorrent
 			return e.file_ptr;
 		}
 
-		lru_file_entry e;
-		e.file_ptr = boost::make_shared<file>();
-		if (!e.file_ptr)
+		file_handle file_ptr = boost::make_shared<file>();
+		if (!file_ptr)
 		{
 			ec = error_code(boost::system::errc::not_enough_memory, generic_category());
-			return e.file_ptr;
+			return file_ptr;
 		}
 		std::string full_path = fs.file_path(file_index, p);
-		if (!e.file_ptr->open(full_path, m, ec))
+		if (!file_ptr->open(full_path, m, ec))
 			return file_handle();
 #ifdef TORRENT_WINDOWS
 		if (m_low_prio_io)
-			set_low_priority(e.file_ptr);
+			set_low_priority(file_ptr);
 #endif
+		file_key const key(st, file_index);
+		lru_file_entry& e = s.files[key];
+		e.key = key;
+		e.file_ptr = file_ptr;
+		e.use_seq = ++m_use_counter;
 		e.mode = m;
-		file_handle file_ptr = e.file_ptr;
-		m_files.insert(std::make_pair(std::make_pair(st, file_index), e));
+		s.lru.push_front(&e);
 		TORRENT_ASSERT(file_ptr->is_open());
+		l.unlock();
 
-		if (int(m_files.size()) >= m_size)
+		if (++m_num_files > m_size)
 		{
 			// the file cache is at its maximum size, close
 			// the least recently used (lru) file from it
-			defer_destruction = remove_oldest(l);
+			trim(defer_destruction);
 		}
 		return file_ptr;
 	}
 
 	void file_pool::get_status(std::vector<pool_file_status>* files, void* st) const
 	{
-		mutex::scoped_lock l(m_mutex);
-
-		file_set::const_iterator start = m_files.lower_bound(std::make_pair(st, 0));
-		file_set::const_iterator end = m_files.upper_bound(std::make_pair(st, INT_MAX));
+		shard const& s = shard_for(st);
+		mutex::scoped_lock l(s.mtx);
 
-		for (file_set::const_iterator i = start; i != end; ++i)
+		std::size_t const first = files->size();
+		for (file_set::const_iterator i = s.files.begin(); i != s.files.end(); ++i)
 		{
-			pool_file_status s;
-			s.file_index = i->first.second;
-			s.open_mode = i->second.mode;
-			s.last_use = i->second.last_use;
-			files->push_back(s);
+			if (i->first.first != st) continue;
+			pool_file_status fs;
+			fs.file_index = i->first.second;
+			fs.open_mode = i->second.mode;
+			fs.last_use = i->second.last_use;
+			files->push_back(fs);
 		}
+		l.unlock();
+
+		// the hash table isn't ordered, report the files by index like before
+		std::sort(files->begin() + first, files->end()
+			, boost::bind(&pool_file_status::file_index, _1)
+				< boost::bind(&pool_file_status::file_index, _2));
 	}
 
-	file_handle file_pool::remove_oldest(mutex::scoped_lock&)
+	void file_pool::trim(std::vector<file_handle>& defer_destruction)
 	{
-		file_set::iterator i = std::min_element(m_files.begin(), m_files.end()
-			, boost::bind(&lru_file_entry::last_use, boost::bind(&file_set::value_type::second, _1))
-				< boost::bind(&lru_file_entry::last_use, boost::bind(&file_set::value_type::second, _2)));
-		if (i == m_files.end()) return file_handle();
-
-		file_handle file_ptr = i->second.file_ptr;
-		m_files.erase(i);
-
-		// closing a file may be long running operation (mac os x)
-		// let the calling function destruct it after releasing the mutex
-		return file_ptr;
+		while (m_num_files > m_size)
+		{
+			// each shard's LRU list is ordered, so the least recently used
+			// file overall is at the back of one of them
+			shard* victim = NULL;
+			boost::uint64_t oldest = (std::numeric_limits<boost::uint64_t>::max)();
+			for (int k = 0; k < num_shards; ++k)
+			{
+				shard& s = m_shards[k];
+				mutex::scoped_lock l(s.mtx);
+				lru_file_entry const* e = s.lru.back();
+				if (e == NULL || e->use_seq >= oldest) continue;
+				oldest = e->use_seq;
+				victim = &s;
+			}
+			if (victim == NULL) return;
+
+			mutex::scoped_lock l(victim->mtx);
+			lru_file_entry* e = victim->lru.back();
+			// another thread may have emptied the shard in the meantime
+			if (e == NULL) continue;
+			file_set::iterator i = victim->files.find(e->key);
+			TORRENT_ASSERT(i != victim->files.end());
+			defer_destruction.push_back(erase_entry(*victim, i));
+		}
 	}
 
 	void file_pool::release(void* st, int file_index)
 	{
-		mutex::scoped_lock l(m_mutex);
+		shard& s = shard_for(st);
+		mutex::scoped_lock l(s.mtx);
 
-		file_set::iterator i = m_files.find(std::make_pair(st, file_index));
-		if (i == m_files.end()) return;
+		file_set::iterator i = s.files.find(std::make_pair(st, file_index));
+		if (i == s.files.end()) return;
 
-		file_handle file_ptr = i->second.file_ptr;
-		m_files.erase(i);
+		file_handle file_ptr = erase_entry(s, i);
 
 		// closing a file may take a long time (mac os x), so make sure
 		// we're not holding the mutex
@@ -267,23 +336,31 @@ namespace libtorrent
 	// storage. If 0 is passed, all files are closed
 	void file_pool::release(void* st)
 	{
-		mutex::scoped_lock l(m_mutex);
+		std::vector<file_handle> to_close;
 
 		if (st == 0)
 		{
-			m_files.clear();
-			l.unlock();
+			for (int k = 0; k < num_shards; ++k)
+			{
+				shard& s = m_shards[k];
+				mutex::scoped_lock l(s.mtx);
+				while (!s.files.empty())
+					to_close.push_back(erase_entry(s, s.files.begin()));
+			}
 			return;
 		}
 
-		file_set::iterator begin = m_files.lower_bound(std::make_pair(st, 0));
-		file_set::iterator end = m_files.upper_bound(std::make_pair(st, std::numeric_limits<int>::max()));
+		shard& s = shard_for(st);
+		mutex::scoped_lock l(s.mtx);
 
-		std::vector<file_handle> to_close;
-		while (begin != end)
+		for (file_set::iterator i = s.files.begin(); i != s.files.end();)
 		{
-			to_close.push_back(begin->second.file_ptr);
-			m_files.erase(begin++);
+			if (i->first.first != st)
+			{
+				++i;
+				continue;
+			}
+			to_close.push_back(erase_entry(s, i++));
 		}
 		l.unlock();
 		// the files are closed here while the lock is not held
@@ -292,7 +369,7 @@ namespace libtorrent
 #if TORRENT_USE_ASSERTS
 	void file_pool::mark_deleted(file_storage const& fs)
 	{
-		mutex::scoped_lock l(m_mutex);
+		mutex::scoped_lock l(m_deleted_mutex);
 		m_deleted_storages.push_back(std::make_pair(fs.name()
 			, static_cast<void const*>(&fs)));
 		if(m_deleted_storages.size() > 100)
@@ -301,10 +378,11 @@ namespace libtorrent
 
 	bool file_pool::assert_idle_files(void* st) const
 	{
-		mutex::scoped_lock l(m_mutex);
+		shard const& s = shard_for(st);
+		mutex::scoped_lock l(s.mtx);
 
-		for (file_set::const_iterator i = m_files.begin();
-			i != m_files.end(); ++i)
+		for (file_set::const_iterator i = s.files.begin();
+			i != s.files.end(); ++i)
 		{
 			if (i->first.first == st && !i->second.file_ptr.unique())
 				return false;
@@ -318,35 +396,44 @@ namespace libtorrent
 		// these are destructed _after_ the mutex is released
 		std::vector<file_handle> defer_destruction;
 
-		mutex::scoped_lock l(m_mutex);
-
 		TORRENT_ASSERT(size > 0);
 
 		if (size == m_size) return;
 		m_size = size;
-		if (int(m_files.size()) <= m_size) return;
 
 		// close the least recently used files
-		while (int(m_files.size()) > m_size)
-			defer_destruction.push_back(remove_oldest(l));
+		trim(defer_destruction);
 	}
 
 	void file_pool::close_oldest()
 	{
-		mutex::scoped_lock l(m_mutex);
+		// this is called rarely, it's fine to look at every file
+		shard* victim = NULL;
+		file_key key;
+		time_point oldest = max_time();
+		for (int k = 0; k < num_shards; ++k)
+		{
+			shard& s = m_shards[k];
+			mutex::scoped_lock l(s.mtx);
+			for (file_set::const_iterator i = s.files.begin(); i != s.files.end(); ++i)
+			{
+				if (i->second.opened >= oldest) continue;
+				oldest = i->second.opened;
+				key = i->first;
+				victim = &s;
+			}
+		}
+		if (victim == NULL) return;
 
-		file_set::iterator i = std::min_element(m_files.begin(), m_files.end()
-			, boost::bind(&lru_file_entry::opened, boost::bind(&file_set::value_type::second, _1))
-				< boost::bind(&lru_file_entry::opened, boost::bind(&file_set::value_type::second, _2)));
-		if (i == m_files.end()) return;
+		mutex::scoped_lock l(victim->mtx);
+		file_set::iterator i = victim->files.find(key);
+		if (i == victim->files.end()) return;
 
-		file_handle file_ptr = i->second.file_ptr;
-		m_files.erase(i);
+		file_handle file_ptr = erase_entry(*victim, i);
 
 		// closing a file may be long running operation (mac os x)
 		l.unlock();
 		file_ptr.reset();
-		l.lock();
 	}
 }
 
@@ -77,6 +77,7 @@ namespace libtorrent
 		, m_file_base(f.m_file_base)
 #endif
 		, m_paths(f.m_paths)
+		, m_path_lookup(f.m_path_lookup)
 		, m_name(f.m_name)
 		, m_total_size(f.m_total_size)
 		, m_num_files(f.m_num_files)
@@ -95,6 +96,7 @@ namespace libtorrent
 		m_file_base = f.m_file_base;
 #endif
 		m_paths = f.m_paths;
+		m_path_lookup = f.m_path_lookup;
 		m_name = f.m_name;
 		m_total_size = f.m_total_size;
 		m_num_files = f.m_num_files;
@@ -130,6 +132,18 @@ namespace libtorrent
 			return memcmp(str2.c_str(), str, len) == 0;
 		}
 
+		// FNV-1a, for the path lookup table
+		boost::uint32_t path_hash(char const* str, int len)
+		{
+			boost::uint32_t h = 2166136261u;
+			for (int i = 0; i < len; ++i)
+			{
+				h ^= boost::uint8_t(str[i]);
+				h *= 16777619u;
+			}
+			return h;
+		}
+
 		bool compare_file_entry_size(internal_file_entry const& fe1
 			, internal_file_entry const& fe2)
 		{
@@ -206,23 +220,38 @@ namespace libtorrent
 		while (branch_len > 0 && branch_path[branch_len-1] == TORRENT_SEPARATOR)
 			--branch_len;
 
-		// do we already have this path in the path list?
-		std::vector<std::string>::reverse_iterator p
-			= std::find_if(m_paths.rbegin(), m_paths.rend()
-				, boost::bind(&compare_string, branch_path, branch_len, _1));
+		// keep the lookup table at most half full
+		if (m_path_lookup.size() < m_paths.size() * 2 + 2)
+			rebuild_path_lookup((std::max)(m_path_lookup.size() * 2, size_t(64)));
 
-		if (p == m_paths.rend())
+		// do we already have this path in the path list?
+		std::size_t const mask = m_path_lookup.size() - 1;
+		std::size_t slot = path_hash(branch_path, branch_len) & mask;
+		for (; m_path_lookup[slot] != -1; slot = (slot + 1) & mask)
 		{
-			// no, we don't. add it
-			int const ret = int(m_paths.size());
-			TORRENT_ASSERT(branch_len == 0 || branch_path[0] != TORRENT_SEPARATOR);
-			m_paths.push_back(std::string(branch_path, branch_len));
-			return ret;
+			int const idx = m_path_lookup[slot];
+			// yes we do. use it
+			if (compare_string(branch_path, branch_len, m_paths[idx])) return idx;
 		}
-		else
+
+		// no, we don't. add it
+		int const ret = int(m_paths.size());
+		TORRENT_ASSERT(branch_len == 0 || branch_path[0] != TORRENT_SEPARATOR);
+		m_paths.push_back(std::string(branch_path, branch_len));
+		m_path_lookup[slot] = ret;
+		return ret;
+	}
+
+	void file_storage::rebuild_path_lookup(std::size_t const size)
+	{
+		TORRENT_ASSERT((size & (size - 1)) == 0);
+		m_path_lookup.assign(size, -1);
+		std::size_t const mask = size - 1;
+		for (int i = 0; i < int(m_paths.size()); ++i)
 		{
-			// yes we do. use it
-			return int(p.base() - m_paths.begin() - 1);
+			std::size_t slot = path_hash(m_paths[i].c_str(), int(m_paths[i].size())) & mask;
+			while (m_path_lookup[slot] != -1) slot = (slot + 1) & mask;
+			m_path_lookup[slot] = i;
 		}
 	}
 
@@ -1104,6 +1133,7 @@ namespace libtorrent
 		std::vector<boost::int64_t>().swap(m_file_base);
 #endif
 		std::vector<std::string>().swap(m_paths);
+		std::vector<int>().swap(m_path_lookup);
 	}
 }
 
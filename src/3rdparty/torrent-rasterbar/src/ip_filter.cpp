@@ -31,7 +31,24 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "libtorrent/ip_filter.hpp"
+#include "libtorrent/gzip.hpp"
+#include "libtorrent/file.hpp"
+#include "libtorrent/aux_/escape_string.hpp" // for convert_to_native
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+
 #include <boost/utility.hpp>
+#include <cstring>
+#include <cctype>
+
+#if TORRENT_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
 
 
 namespace libtorrent
@@ -76,6 +93,386 @@ namespace libtorrent
 #endif
 	}
 	
+	namespace {
+
+	// the header of an ip_filter cache file. The ranges of the IPv4 filter
+	// follow it, then the ones of the IPv6 filter, in their in-memory layout
+	struct cache_header
+	{
+		char magic[8];
+		// 0x01020304 as written by the saving machine, to detect a file
+		// from a build with a different byte order
+		boost::uint32_t byte_order;
+		boost::uint32_t range4_size;
+		boost::uint32_t num_ranges4;
+		boost::uint32_t range6_size;
+		boost::uint32_t num_ranges6;
+	};
+
+	char const cache_magic[8] = {'l', 't', 'i', 'p', 'f', 'l', 't', '1'};
+
+	// a read-only view of a whole file. It's memory mapped where supported,
+	// and read into a buffer otherwise
+	struct file_view
+	{
+		file_view(): data(NULL), size(0)
+#if TORRENT_HAVE_MMAP
+			, m_mapping(NULL)
+#endif
+		{}
+
+		bool open(std::string const& filename, error_code& ec)
+		{
+#if TORRENT_HAVE_MMAP
+			int const fd = ::open(convert_to_native(filename).c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				ec.assign(errno, system_category());
+				return false;
+			}
+			struct ::stat st;
+			if (::fstat(fd, &st) < 0)
+			{
+				ec.assign(errno, system_category());
+				::close(fd);
+				return false;
+			}
+			size = boost::int64_t(st.st_size);
+			if (size > 0)
+			{
+				void* m = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (m == MAP_FAILED)
+				{
+					ec.assign(errno, system_category());
+					::close(fd);
+					return false;
+				}
+				m_mapping = m;
+				data = static_cast<char const*>(m);
+			}
+			::close(fd);
+			return true;
+#else
+			file f;
+			if (!f.open(filename, file::read_only, ec)) return false;
+			size = f.get_size(ec);
+			if (ec) return false;
+			if (size <= 0) return true;
+			m_buffer.resize(size);
+			file::iovec_t b = { &m_buffer[0], size_t(size) };
+			if (f.readv(0, &b, 1, ec) != size)
+			{
+				if (!ec) ec = errors::file_too_short;
+				return false;
+			}
+			data = &m_buffer[0];
+			return true;
+#endif
+		}
+
+		~file_view()
+		{
+#if TORRENT_HAVE_MMAP
+			if (m_mapping) ::munmap(m_mapping, size);
+#endif
+		}
+
+		char const* data;
+		boost::int64_t size;
+
+	private:
+#if TORRENT_HAVE_MMAP
+		void* m_mapping;
+#else
+		std::vector<char> m_buffer;
+#endif
+	};
+
+	} // anonymous namespace
+
+	void ip_filter::save_cache(std::string const& filename, error_code& ec) const
+	{
+		ec.clear();
+
+		cache_header h;
+		std::memcpy(h.magic, cache_magic, sizeof(h.magic));
+		h.byte_order = 0x01020304;
+		h.range4_size = m_filter4.range_size();
+		h.num_ranges4 = m_filter4.num_ranges();
+#if TORRENT_USE_IPV6
+		h.range6_size = m_filter6.range_size();
+		h.num_ranges6 = m_filter6.num_ranges();
+#else
+		h.range6_size = 0;
+		h.num_ranges6 = 0;
+#endif
+
+		std::vector<char> buf(reinterpret_cast<char const*>(&h)
+			, reinterpret_cast<char const*>(&h) + sizeof(h));
+		m_filter4.serialize(buf);
+#if TORRENT_USE_IPV6
+		m_filter6.serialize(buf);
+#endif
+
+		// write to a temporary file and move it in place, so that a crash
+		// never leaves a truncated cache behind
+		std::string const tmp = filename + ".tmp";
+		{
+			file f;
+			if (!f.open(tmp, file::write_only, ec)) return;
+			file::iovec_t b = { &buf[0], buf.size() };
+			boost::int64_t const written = f.writev(0, &b, 1, ec);
+			if (ec) return;
+			if (written != boost::int64_t(buf.size()))
+			{
+				ec = errors::file_too_short;
+				return;
+			}
+		}
+
+		rename(tmp, filename, ec);
+		if (ec)
+		{
+			// some systems won't replace an existing file
+			error_code ignore;
+			remove(filename, ignore);
+			rename(tmp, filename, ec);
+		}
+	}
+
+	bool ip_filter::load_cache(std::string const& filename, error_code& ec)
+	{
+		ec.clear();
+
+		file_view view;
+		if (!view.open(filename, ec)) return false;
+
+		cache_header h;
+		if (view.size < boost::int64_t(sizeof(h)))
+		{
+			ec = errors::file_too_short;
+			return false;
+		}
+		std::memcpy(&h, view.data, sizeof(h));
+
+		if (std::memcmp(h.magic, cache_magic, sizeof(h.magic)) != 0
+			|| h.byte_order != 0x01020304
+			|| h.range4_size != boost::uint32_t(m_filter4.range_size())
+#if TORRENT_USE_IPV6
+			|| h.range6_size != boost::uint32_t(m_filter6.range_size())
+#endif
+			)
+		{
+			ec = errors::invalid_file_tag;
+			return false;
+		}
+
+		if (view.size != boost::int64_t(sizeof(h))
+			+ boost::int64_t(h.range4_size) * h.num_ranges4
+			+ boost::int64_t(h.range6_size) * h.num_ranges6)
+		{
+			ec = errors::file_too_short;
+			return false;
+		}
+
+		char const* ptr = view.data + sizeof(h);
+		detail::filter_impl<address_v4::bytes_type> filter4;
+		if (!filter4.deserialize(ptr, h.num_ranges4))
+		{
+			ec = errors::parse_failed;
+			return false;
+		}
+		ptr += boost::int64_t(h.range4_size) * h.num_ranges4;
+
+#if TORRENT_USE_IPV6
+		detail::filter_impl<address_v6::bytes_type> filter6;
+		if (!filter6.deserialize(ptr, h.num_ranges6))
+		{
+			ec = errors::parse_failed;
+			return false;
+		}
+		m_filter6 = filter6;
+#endif
+		m_filter4 = filter4;
+		return true;
+	}
+
+	namespace {
+
+	bool is_blank(char c) { return c == ' ' || c == '\t'; }
+
+	char const* skip_space(char const* p, char const* end)
+	{
+		while (p != end && is_blank(*p)) ++p;
+		return p;
+	}
+
+	// parses a dotted quad, allowing leading zeros in each part (as used by
+	// eMule lists). Returns the end of the address, or NULL
+	char const* parse_v4(char const* p, char const* end, address_v4::bytes_type& ret)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			if (i > 0)
+			{
+				if (p == end || *p != '.') return NULL;
+				++p;
+			}
+			int val = 0;
+			int digits = 0;
+			while (p != end && *p >= '0' && *p <= '9' && digits < 3)
+			{
+				val = val * 10 + (*p - '0');
+				++p;
+				++digits;
+			}
+			if (digits == 0 || val > 255) return NULL;
+			ret[i] = static_cast<unsigned char>(val);
+		}
+		return p;
+	}
+
+#if TORRENT_USE_IPV6
+	char const* parse_v6(char const* p, char const* end, address_v6::bytes_type& ret)
+	{
+		char const* start = p;
+		while (p != end && (std::isxdigit(static_cast<unsigned char>(*p))
+			|| *p == ':' || *p == '.')) ++p;
+		error_code ec;
+		address_v6 const a = address_v6::from_string(std::string(start, p), ec);
+		if (ec) return NULL;
+		ret = a.to_bytes();
+		return p;
+	}
+#endif
+
+	// first - last , level , description
+	bool parse_emule_line(char const* p, char const* end, ip_filter& f, int& num)
+	{
+		p = skip_space(p, end);
+		char const* sep = p;
+		while (sep != end && *sep != '-' && !is_blank(*sep)) ++sep;
+		bool const ipv6 = std::find(p, sep, ':') != sep;
+
+		address_v4::bytes_type first4, last4;
+#if TORRENT_USE_IPV6
+		address_v6::bytes_type first6, last6;
+		if (ipv6) p = parse_v6(p, sep, first6);
+		else
+#else
+		if (ipv6) return false;
+#endif
+		p = parse_v4(p, sep, first4);
+		if (p != sep) return false;
+
+		p = skip_space(p, end);
+		if (p == end || *p != '-') return false;
+		p = skip_space(p + 1, end);
+
+#if TORRENT_USE_IPV6
+		if (ipv6) p = parse_v6(p, end, last6);
+		else
+#endif
+		p = parse_v4(p, end, last4);
+		if (p == NULL) return false;
+
+		p = skip_space(p, end);
+		if (p != end)
+		{
+			if (*p != ',') return false;
+			p = skip_space(p + 1, end);
+			int level = 0;
+			int digits = 0;
+			while (p != end && *p >= '0' && *p <= '9' && digits < 4)
+			{
+				level = level * 10 + (*p - '0');
+				++p;
+				++digits;
+			}
+			// eMule only filters ranges below its default level of 128
+			if (digits > 0 && level > 127) return true;
+		}
+
+#if TORRENT_USE_IPV6
+		if (ipv6)
+		{
+			if (last6 < first6) return false;
+			f.add_rule(address_v6(first6), address_v6(last6), ip_filter::blocked);
+			++num;
+			return true;
+		}
+#endif
+		if (last4 < first4) return false;
+		f.add_rule(address_v4(first4), address_v4(last4), ip_filter::blocked);
+		++num;
+		return true;
+	}
+
+	// description:first-last
+	bool parse_p2p_line(char const* p, char const* end, ip_filter& f, int& num)
+	{
+		// the description may contain both ':' and '-', but the addresses
+		// don't
+		char const* dash = end;
+		while (dash != p && dash[-1] != '-') --dash;
+		if (dash == p) return false;
+		--dash;
+		char const* colon = dash;
+		while (colon != p && colon[-1] != ':') --colon;
+		if (colon == p) return false;
+
+		address_v4::bytes_type first, last;
+		char const* a = parse_v4(skip_space(colon, dash), dash, first);
+		if (a == NULL || skip_space(a, dash) != dash) return false;
+		a = parse_v4(skip_space(dash + 1, end), end, last);
+		if (a == NULL || skip_space(a, end) != end) return false;
+		if (last < first) return false;
+
+		f.add_rule(address_v4(first), address_v4(last), ip_filter::blocked);
+		++num;
+		return true;
+	}
+
+	} // anonymous namespace
+
+	int parse_blocklist(char const* buf, int size, ip_filter& f, error_code& ec)
+	{
+		ec.clear();
+
+		std::vector<char> inflated;
+		if (size >= 2 && boost::uint8_t(buf[0]) == 0x1f && boost::uint8_t(buf[1]) == 0x8b)
+		{
+			// a full list of a few million ranges inflates to a few hundred
+			// megabytes
+			inflate_gzip(buf, size, inflated, 1024 * 1024 * 1024, ec);
+			if (ec) return -1;
+			buf = inflated.empty() ? NULL : &inflated[0];
+			size = int(inflated.size());
+		}
+
+		int num = 0;
+		char const* const end = buf + size;
+		for (char const* line = buf; line < end;)
+		{
+			char const* eol = static_cast<char const*>(std::memchr(line, '\n', end - line));
+			if (eol == NULL) eol = end;
+			char const* next = eol + 1;
+
+			char const* e = eol;
+			while (e != line && (e[-1] == '\r' || is_blank(e[-1]))) --e;
+			char const* p = skip_space(line, e);
+			line = next;
+
+			if (p == e || *p == '#' || (e - p >= 2 && p[0] == '/' && p[1] == '/'))
+				continue;
+
+			// try the eMule format first, its lines start with the address
+			if (parse_emule_line(p, e, f, num)) continue;
+			parse_p2p_line(p, e, f, num);
+		}
+		return num;
+	}
+
 	void port_filter::add_rule(boost::uint16_t first, boost::uint16_t last, boost::uint32_t flags)
 	{
 		m_filter.add_rule(first, last, flags);
@@ -0,0 +1,889 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/kademlia/dht_storage.hpp"
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <libtorrent/aux_/time.hpp>
+#include <libtorrent/config.hpp>
+#include <libtorrent/time.hpp>
+#include <libtorrent/socket.hpp>
+#include <libtorrent/socket_io.hpp>
+#include <libtorrent/sha1_hash.hpp>
+#include <libtorrent/bloom_filter.hpp>
+#include <libtorrent/address.hpp>
+#include <libtorrent/session_settings.hpp>
+#include <libtorrent/random.hpp>
+#include <libtorrent/entry.hpp>
+#include <libtorrent/bdecode.hpp>
+
+#include <libtorrent/kademlia/item.hpp>
+#include <libtorrent/kademlia/node_id.hpp>
+
+#include <string.h> // for memcpy
+
+namespace libtorrent {
+namespace dht {
+namespace
+{
+	// peers are stamped with the generation of their last announce instead
+	// of a time_point. A generation lasts generation_minutes, and a peer
+	// that has not announced for peer_generations of them (40 to 45 minutes,
+	// like announce_interval * 1.5 in the default storage) is expired
+	enum { generation_minutes = 5, peer_generations = 9 };
+
+	// the tables are split by the top bits of the key hash, growing or
+	// shrinking one shard only rehashes a sixteenth of the entries
+	enum { shard_bits = 4, num_shards = 1 << shard_bits };
+
+	// 20 bytes per peer, stored by value in an array sorted by address
+	struct flat_peer
+	{
+		enum { v6 = 1, seed = 2 };
+
+		// IPv4 addresses use the first 4 bytes
+		boost::uint8_t addr[16];
+		boost::uint16_t port;
+		boost::uint8_t flags;
+		boost::uint8_t generation;
+
+		bool is_v6() const { return (flags & v6) != 0; }
+		bool is_seed() const { return (flags & seed) != 0; }
+
+		address get_address() const
+		{
+#if TORRENT_USE_IPV6
+			if (is_v6())
+			{
+				address_v6::bytes_type b;
+				memcpy(&b[0], addr, b.size());
+				return address_v6(b);
+			}
+#endif
+			address_v4::bytes_type b;
+			memcpy(&b[0], addr, b.size());
+			return address_v4(b);
+		}
+	};
+
+	flat_peer make_peer(tcp::endpoint const& ep, bool seed, boost::uint8_t generation)
+	{
+		flat_peer p;
+		memset(p.addr, 0, sizeof(p.addr));
+		p.flags = seed ? flat_peer::seed : 0;
+#if TORRENT_USE_IPV6
+		if (ep.address().is_v6())
+		{
+			address_v6::bytes_type const b = ep.address().to_v6().to_bytes();
+			memcpy(p.addr, &b[0], b.size());
+			p.flags |= flat_peer::v6;
+		}
+		else
+#endif
+		{
+			address_v4::bytes_type const b = ep.address().to_v4().to_bytes();
+			memcpy(p.addr, &b[0], b.size());
+		}
+		p.port = ep.port();
+		p.generation = generation;
+		return p;
+	}
+
+	// orders by address family, address and port. Flags other than the
+	// family and the generation are not part of the identity
+	bool operator<(flat_peer const& lhs, flat_peer const& rhs)
+	{
+		if (lhs.is_v6() != rhs.is_v6()) return rhs.is_v6();
+		int const cmp = memcmp(lhs.addr, rhs.addr, sizeof(lhs.addr));
+		if (cmp != 0) return cmp < 0;
+		return lhs.port < rhs.port;
+	}
+
+	bool same_endpoint(flat_peer const& lhs, flat_peer const& rhs)
+	{
+		return !(lhs < rhs) && !(rhs < lhs);
+	}
+
+	// appends the compact endpoint, as write_endpoint() does
+	void write_peer(flat_peer const& p, std::string& out)
+	{
+		int const len = p.is_v6() ? 16 : 4;
+		out.assign(reinterpret_cast<char const*>(p.addr), len);
+		out += char(p.port >> 8);
+		out += char(p.port & 0xff);
+	}
+
+	struct flat_torrent
+	{
+		std::string name;
+		std::vector<flat_peer> peers;
+
+		void swap(flat_torrent& rhs)
+		{
+			name.swap(rhs.name);
+			peers.swap(rhs.peers);
+		}
+
+		size_t heap_bytes() const
+		{ return name.size() + peers.capacity() * sizeof(flat_peer); }
+	};
+
+	// immutable and mutable items. The signature, key and sequence number
+	// are unused for immutable ones
+	struct flat_item
+	{
+		flat_item() : seq(0) {}
+
+		std::string value;
+		std::string salt;
+		// the last time we heard about this
+		time_point last_seen;
+		boost::int64_t seq;
+		char sig[item_sig_len];
+		char key[item_pk_len];
+
+		void swap(flat_item& rhs)
+		{
+			value.swap(rhs.value);
+			salt.swap(rhs.salt);
+			std::swap(last_seen, rhs.last_seen);
+			std::swap(seq, rhs.seq);
+			std::swap_ranges(sig, sig + sizeof(sig), rhs.sig);
+			std::swap_ranges(key, key + sizeof(key), rhs.key);
+		}
+
+		size_t heap_bytes() const { return value.size() + salt.size(); }
+	};
+
+	// the splitmix64 finalizer. Keys are mixed with a random seed, so nodes
+	// can't pick info-hashes that pile up in the same probe sequence
+	boost::uint64_t mix(boost::uint64_t x)
+	{
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebULL;
+		x ^= x >> 31;
+		return x;
+	}
+
+	// an open addressing hash table (linear probing, backward shift deletion)
+	// split into shards. The slots hold indices into a dense array of nodes,
+	// which are also linked in least recently used order. Removing a node
+	// moves the last one of its shard into its place, so node references are
+	// only valid until the next insert or erase.
+	template <class T>
+	class flat_table : boost::noncopyable
+	{
+	public:
+		struct node
+		{
+			node() : hash(0), used(0), prev(-1), next(-1) {}
+
+			sha1_hash key;
+			boost::uint64_t hash;
+			// the storage's clock when the node was last used
+			boost::uint64_t used;
+			boost::int32_t prev;
+			boost::int32_t next;
+			T value;
+		};
+
+		explicit flat_table(boost::uint64_t seed) : m_seed(seed), m_size(0) {}
+
+		int size() const { return m_size; }
+
+		node* find(sha1_hash const& key)
+		{
+			boost::uint64_t const h = hash(key);
+			shard& s = m_shards[h >> (64 - shard_bits)];
+			if (s.slots.empty()) return NULL;
+			size_t const mask = s.slots.size() - 1;
+			for (size_t i = h & mask;; i = (i + 1) & mask)
+			{
+				boost::int32_t const idx = s.slots[i];
+				if (idx < 0) return NULL;
+				node& n = s.nodes[idx];
+				if (n.hash == h && n.key == key) return &n;
+			}
+		}
+
+		node const* find(sha1_hash const& key) const
+		{ return const_cast<flat_table*>(this)->find(key); }
+
+		// key must not be in the table yet
+		node& insert(sha1_hash const& key, boost::uint64_t clock)
+		{
+			boost::uint64_t const h = hash(key);
+			shard& s = m_shards[h >> (64 - shard_bits)];
+			// keep the load at or below one half
+			if ((s.nodes.size() + 1) * 2 > s.slots.size())
+				rehash(s, (std::max)(size_t(16), s.slots.size() * 2));
+
+			boost::int32_t const idx = boost::int32_t(s.nodes.size());
+			s.nodes.push_back(node());
+			node& n = s.nodes.back();
+			n.key = key;
+			n.hash = h;
+			place(s, idx);
+			link_front(s, idx, clock);
+			++m_size;
+			return n;
+		}
+
+		// marks n as the most recently used node
+		void touch(node& n, boost::uint64_t clock)
+		{
+			shard& s = shard_of(n);
+			boost::int32_t const idx = index_of(s, n);
+			unlink(s, idx);
+			link_front(s, idx, clock);
+		}
+
+		void erase(node& n)
+		{
+			shard& s = shard_of(n);
+			boost::int32_t const idx = index_of(s, n);
+			unlink(s, idx);
+			remove_slot(s, idx);
+
+			boost::int32_t const last = boost::int32_t(s.nodes.size()) - 1;
+			if (idx != last)
+			{
+				// move the last node into the hole and repoint what refers to it
+				node& dst = s.nodes[idx];
+				node& src = s.nodes[last];
+				dst.key = src.key;
+				dst.hash = src.hash;
+				dst.used = src.used;
+				dst.prev = src.prev;
+				dst.next = src.next;
+				dst.value.swap(src.value);
+
+				*find_slot(s, dst.hash, last) = idx;
+				if (dst.prev >= 0) s.nodes[dst.prev].next = idx;
+				else s.head = idx;
+				if (dst.next >= 0) s.nodes[dst.next].prev = idx;
+				else s.tail = idx;
+			}
+			s.nodes.pop_back();
+			--m_size;
+
+			// give memory back once a shard is mostly empty
+			if (s.slots.size() > 16 && s.nodes.size() * 8 < s.slots.size())
+			{
+				std::vector<node>(s.nodes).swap(s.nodes);
+				rehash(s, s.slots.size() / 2);
+			}
+		}
+
+		// the least recently used node of the whole table, or NULL
+		node* oldest()
+		{
+			node* ret = NULL;
+			for (int i = 0; i < num_shards; ++i)
+			{
+				shard& s = m_shards[i];
+				if (s.tail < 0) continue;
+				node& n = s.nodes[s.tail];
+				if (ret == NULL || n.used < ret->used) ret = &n;
+			}
+			return ret;
+		}
+
+		// the bytes used by the tables themselves, not counting what the
+		// values allocate
+		size_t memory() const
+		{
+			size_t ret = 0;
+			for (int i = 0; i < num_shards; ++i)
+			{
+				ret += m_shards[i].nodes.capacity() * sizeof(node)
+					+ m_shards[i].slots.capacity() * sizeof(boost::int32_t);
+			}
+			return ret;
+		}
+
+		// for walking the table. Erasing node i of a shard while walking it
+		// from the back is fine, the node moved into its place has been seen
+		std::vector<node>& shard_nodes(int i) { return m_shards[i].nodes; }
+		std::vector<node> const& shard_nodes(int i) const { return m_shards[i].nodes; }
+
+	private:
+		struct shard
+		{
+			shard() : head(-1), tail(-1) {}
+
+			std::vector<node> nodes;
+			// -1 for empty slots. The size is a power of two
+			std::vector<boost::int32_t> slots;
+			boost::int32_t head;
+			boost::int32_t tail;
+		};
+
+		boost::uint64_t hash(sha1_hash const& key) const
+		{
+			boost::uint64_t x;
+			memcpy(&x, key.data(), sizeof(x));
+			return mix(x ^ m_seed);
+		}
+
+		shard& shard_of(node const& n)
+		{ return m_shards[n.hash >> (64 - shard_bits)]; }
+
+		static boost::int32_t index_of(shard const& s, node const& n)
+		{
+			TORRENT_ASSERT(&n >= &s.nodes[0] && &n < &s.nodes[0] + s.nodes.size());
+			return boost::int32_t(&n - &s.nodes[0]);
+		}
+
+		static boost::int32_t* find_slot(shard& s, boost::uint64_t h, boost::int32_t idx)
+		{
+			size_t const mask = s.slots.size() - 1;
+			size_t i = h & mask;
+			while (s.slots[i] != idx)
+			{
+				TORRENT_ASSERT(s.slots[i] >= 0);
+				i = (i + 1) & mask;
+			}
+			return &s.slots[i];
+		}
+
+		static void place(shard& s, boost::int32_t idx)
+		{
+			size_t const mask = s.slots.size() - 1;
+			size_t i = s.nodes[idx].hash & mask;
+			while (s.slots[i] >= 0) i = (i + 1) & mask;
+			s.slots[i] = idx;
+		}
+
+		static void remove_slot(shard& s, boost::int32_t idx)
+		{
+			size_t const mask = s.slots.size() - 1;
+			size_t hole = find_slot(s, s.nodes[idx].hash, idx) - &s.slots[0];
+
+			// shift back the entries of the probe sequence that follows, so
+			// that no lookup runs into the hole before reaching its entry
+			for (size_t i = (hole + 1) & mask; s.slots[i] >= 0; i = (i + 1) & mask)
+			{
+				size_t const home = s.nodes[s.slots[i]].hash & mask;
+				// the entry can fill the hole unless its home slot lies
+				// cyclically in (hole, i]
+				bool const stays = hole <= i
+					? (home > hole && home <= i)
+					: (home > hole || home <= i);
+				if (stays) continue;
+				s.slots[hole] = s.slots[i];
+				hole = i;
+			}
+			s.slots[hole] = -1;
+		}
+
+		static void rehash(shard& s, size_t num_slots)
+		{
+			s.slots.assign(num_slots, -1);
+			for (boost::int32_t i = 0; i < boost::int32_t(s.nodes.size()); ++i)
+				place(s, i);
+		}
+
+		static void unlink(shard& s, boost::int32_t idx)
+		{
+			node& n = s.nodes[idx];
+			if (n.prev >= 0) s.nodes[n.prev].next = n.next;
+			else s.head = n.next;
+			if (n.next >= 0) s.nodes[n.next].prev = n.prev;
+			else s.tail = n.prev;
+			n.prev = n.next = -1;
+		}
+
+		static void link_front(shard& s, boost::int32_t idx, boost::uint64_t clock)
+		{
+			node& n = s.nodes[idx];
+			n.used = clock;
+			n.prev = -1;
+			n.next = s.head;
+			if (s.head >= 0) s.nodes[s.head].prev = idx;
+			s.head = idx;
+			if (s.tail < 0) s.tail = idx;
+		}
+
+		boost::uint64_t const m_seed;
+		int m_size;
+		shard m_shards[num_shards];
+	};
+
+	// a dht_storage_interface for nodes holding a lot of data. Torrents and
+	// items live in flat_tables, the peers of a torrent in one sorted array.
+	// On top of the counts in dht_settings, the memory of the whole storage
+	// is capped by dht_settings::max_storage_memory, evicting the least
+	// recently used torrents and items first.
+	class dht_flat_storage TORRENT_FINAL : public dht_storage_interface, boost::noncopyable
+	{
+	typedef flat_table<flat_torrent> torrent_table_t;
+	typedef flat_table<flat_item> item_table_t;
+
+	public:
+
+		dht_flat_storage(sha1_hash const& id, dht_settings const& settings)
+			: m_id(id)
+			, m_settings(settings)
+			, m_clock(0)
+			, m_generation(0)
+			, m_next_generation(aux::time_now() + minutes(generation_minutes))
+			, m_torrents(random_seed())
+			, m_immutable_table(random_seed())
+			, m_mutable_table(random_seed())
+			, m_heap_bytes(0)
+		{
+			memset(&m_counters, 0, sizeof(m_counters));
+		}
+
+#ifndef TORRENT_NO_DEPRECATE
+		size_t num_torrents() const TORRENT_OVERRIDE { return m_torrents.size(); }
+		size_t num_peers() const TORRENT_OVERRIDE { return m_counters.peers; }
+#endif
+
+		bool get_peers(sha1_hash const& info_hash
+			, bool noseed, bool scrape
+			, entry& peers) const TORRENT_OVERRIDE
+		{
+			torrent_table_t::node* n = m_torrents.find(info_hash);
+			if (n == NULL) return false;
+			m_torrents.touch(*n, ++m_clock);
+
+			flat_torrent const& v = n->value;
+			if (!v.name.empty()) peers["n"] = v.name;
+
+			if (scrape)
+			{
+				bloom_filter<256> downloaders;
+				bloom_filter<256> seeds;
+
+				for (std::vector<flat_peer>::const_iterator i = v.peers.begin()
+					, end(v.peers.end()); i != end; ++i)
+				{
+					if (expired(*i)) continue;
+					sha1_hash iphash;
+					hash_address(i->get_address(), iphash);
+					if (i->is_seed()) seeds.set(iphash);
+					else downloaders.set(iphash);
+				}
+
+				peers["BFpe"] = downloaders.to_string();
+				peers["BFsd"] = seeds.to_string();
+				return true;
+			}
+
+			int candidates = 0;
+			for (std::vector<flat_peer>::const_iterator i = v.peers.begin()
+				, end(v.peers.end()); i != end; ++i)
+			{
+				if (eligible(*i, noseed)) ++candidates;
+			}
+
+			// pick max_peers_reply of the candidates uniformly, in a single
+			// pass: each one is taken with probability
+			// <peers left to pick> / <candidates left>
+			int to_pick = (std::min)(m_settings.max_peers_reply, candidates);
+			entry::list_type& pe = peers["values"].list();
+			std::string endpoint;
+			for (std::vector<flat_peer>::const_iterator i = v.peers.begin()
+				, end(v.peers.end()); to_pick > 0 && i != end; ++i)
+			{
+				if (!eligible(*i, noseed)) continue;
+				if (int(random() % candidates--) >= to_pick) continue;
+
+				write_peer(*i, endpoint);
+				pe.push_back(entry(endpoint));
+				--to_pick;
+			}
+			return true;
+		}
+
+		void announce_peer(sha1_hash const& info_hash
+			, tcp::endpoint const& endp
+			, std::string const& name, bool seed) TORRENT_OVERRIDE
+		{
+			torrent_table_t::node* n = m_torrents.find(info_hash);
+			if (n == NULL)
+			{
+				if (m_torrents.size() > 0 && m_torrents.size() >= m_settings.max_torrents)
+					erase_torrent(*m_torrents.oldest());
+				n = &m_torrents.insert(info_hash, ++m_clock);
+				m_counters.torrents += 1;
+			}
+			else
+			{
+				m_torrents.touch(*n, ++m_clock);
+			}
+
+			flat_torrent& v = n->value;
+			size_t const bytes_before = v.heap_bytes();
+
+			// the peer announces a torrent name, and we don't have a name
+			// for this torrent. Store it.
+			if (!name.empty() && v.name.empty())
+				v.name = name.substr(0, 100);
+
+			flat_peer const peer = make_peer(endp, seed, m_generation);
+			std::vector<flat_peer>::iterator i = std::lower_bound(
+				v.peers.begin(), v.peers.end(), peer);
+			if (i != v.peers.end() && same_endpoint(*i, peer))
+			{
+				*i = peer;
+			}
+			else
+			{
+				if (int(v.peers.size()) >= m_settings.max_peers)
+				{
+					// make room, preferably by dropping a peer that has expired.
+					// Otherwise, like the default storage, there's a 50/50
+					// chance of dropping the announcing peer or an existing one
+					std::vector<flat_peer>::iterator victim = std::find_if(
+						v.peers.begin(), v.peers.end(), expired_peer(m_generation));
+					if (victim == v.peers.end())
+					{
+						if (random() & 1) return;
+						victim = v.peers.begin() + random() % v.peers.size();
+					}
+					if (victim < i) --i;
+					v.peers.erase(victim);
+					m_counters.peers -= 1;
+				}
+				v.peers.insert(i, peer);
+				m_counters.peers += 1;
+			}
+
+			m_heap_bytes += v.heap_bytes() - bytes_before;
+			enforce_memory_limit();
+		}
+
+		bool get_immutable_item(sha1_hash const& target
+			, entry& item) const TORRENT_OVERRIDE
+		{
+			item_table_t::node* n = m_immutable_table.find(target);
+			if (n == NULL) return false;
+			m_immutable_table.touch(*n, ++m_clock);
+
+			std::string const& value = n->value.value;
+			item["v"] = bdecode(value.data(), value.data() + value.size());
+			return true;
+		}
+
+		void put_immutable_item(sha1_hash const& target
+			, char const* buf, int size
+			, address const& addr) TORRENT_OVERRIDE
+		{
+			// eviction is by last use, who stored the item doesn't matter
+			TORRENT_UNUSED(addr);
+
+			item_table_t::node* n = m_immutable_table.find(target);
+			if (n == NULL)
+			{
+				if (m_immutable_table.size() > 0
+					&& m_immutable_table.size() >= m_settings.max_dht_items)
+				{
+					erase_immutable(*m_immutable_table.oldest());
+				}
+				n = &m_immutable_table.insert(target, ++m_clock);
+				n->value.value.assign(buf, size);
+				m_heap_bytes += n->value.heap_bytes();
+				m_counters.immutable_data += 1;
+			}
+			else
+			{
+				m_immutable_table.touch(*n, ++m_clock);
+			}
+
+			n->value.last_seen = aux::time_now();
+			enforce_memory_limit();
+		}
+
+		bool get_mutable_item_seq(sha1_hash const& target
+			, boost::int64_t& seq) const TORRENT_OVERRIDE
+		{
+			item_table_t::node* n = m_mutable_table.find(target);
+			if (n == NULL) return false;
+			m_mutable_table.touch(*n, ++m_clock);
+
+			seq = n->value.seq;
+			return true;
+		}
+
+		bool get_mutable_item(sha1_hash const& target
+			, boost::int64_t seq, bool force_fill
+			, entry& item) const TORRENT_OVERRIDE
+		{
+			item_table_t::node* n = m_mutable_table.find(target);
+			if (n == NULL) return false;
+			m_mutable_table.touch(*n, ++m_clock);
+
+			flat_item const& f = n->value;
+			item["seq"] = f.seq;
+			if (force_fill || (0 <= seq && seq < f.seq))
+			{
+				item["v"] = bdecode(f.value.data(), f.value.data() + f.value.size());
+				item["sig"] = std::string(f.sig, f.sig + sizeof(f.sig));
+				item["k"] = std::string(f.key, f.key + sizeof(f.key));
+			}
+			return true;
+		}
+
+		void put_mutable_item(sha1_hash const& target
+			, char const* buf, int size
+			, char const* sig
+			, boost::int64_t seq
+			, char const* pk
+			, char const* salt, int salt_size
+			, address const& addr) TORRENT_OVERRIDE
+		{
+			TORRENT_UNUSED(addr);
+
+			item_table_t::node* n = m_mutable_table.find(target);
+			if (n == NULL)
+			{
+				if (m_mutable_table.size() > 0
+					&& m_mutable_table.size() >= m_settings.max_dht_items)
+				{
+					erase_mutable(*m_mutable_table.oldest());
+				}
+				n = &m_mutable_table.insert(target, ++m_clock);
+				flat_item& f = n->value;
+				f.value.assign(buf, size);
+				if (salt_size > 0) f.salt.assign(salt, salt_size);
+				f.seq = seq;
+				memcpy(f.sig, sig, sizeof(f.sig));
+				memcpy(f.key, pk, sizeof(f.key));
+				m_heap_bytes += f.heap_bytes();
+				m_counters.mutable_data += 1;
+			}
+			else
+			{
+				m_mutable_table.touch(*n, ++m_clock);
+				flat_item& f = n->value;
+				if (f.seq < seq)
+				{
+					m_heap_bytes -= f.heap_bytes();
+					f.value.assign(buf, size);
+					f.seq = seq;
+					memcpy(f.sig, sig, sizeof(f.sig));
+					m_heap_bytes += f.heap_bytes();
+				}
+			}
+
+			n->value.last_seen = aux::time_now();
+			enforce_memory_limit();
+		}
+
+		void tick() TORRENT_OVERRIDE
+		{
+			time_point const now(aux::time_now());
+
+			if (now >= m_next_generation)
+			{
+				++m_generation;
+				m_next_generation = now + minutes(generation_minutes);
+				purge_peers();
+			}
+
+			if (0 == m_settings.item_lifetime) return;
+
+			time_duration lifetime = seconds(m_settings.item_lifetime);
+			// item lifetime must >= 120 minutes.
+			if (lifetime < minutes(120)) lifetime = minutes(120);
+
+			for (int s = 0; s < num_shards; ++s)
+			{
+				std::vector<item_table_t::node>& nodes = m_immutable_table.shard_nodes(s);
+				for (int i = int(nodes.size()) - 1; i >= 0; --i)
+				{
+					if (nodes[i].value.last_seen + lifetime > now) continue;
+					erase_immutable(nodes[i]);
+				}
+			}
+
+			for (int s = 0; s < num_shards; ++s)
+			{
+				std::vector<item_table_t::node>& nodes = m_mutable_table.shard_nodes(s);
+				for (int i = int(nodes.size()) - 1; i >= 0; --i)
+				{
+					if (nodes[i].value.last_seen + lifetime > now) continue;
+					erase_mutable(nodes[i]);
+				}
+			}
+		}
+
+		virtual dht_storage_counters counters() const TORRENT_OVERRIDE
+		{
+			return m_counters;
+		}
+
+	private:
+
+		struct expired_peer
+		{
+			explicit expired_peer(boost::uint8_t g) : generation(g) {}
+			bool operator()(flat_peer const& p) const
+			{ return boost::uint8_t(generation - p.generation) >= peer_generations; }
+			boost::uint8_t generation;
+		};
+
+		bool expired(flat_peer const& p) const
+		{ return expired_peer(m_generation)(p); }
+
+		bool eligible(flat_peer const& p, bool noseed) const
+		{ return !expired(p) && !(noseed && p.is_seed()); }
+
+		static boost::uint64_t random_seed()
+		{ return (boost::uint64_t(random()) << 32) | random(); }
+
+		size_t memory() const
+		{
+			return m_heap_bytes + m_torrents.memory()
+				+ m_immutable_table.memory() + m_mutable_table.memory();
+		}
+
+		// evicts the least recently used torrents and items until the storage
+		// fits in max_storage_memory again. The entry just used is kept, even
+		// if it doesn't fit by itself.
+		void enforce_memory_limit()
+		{
+			if (m_settings.max_storage_memory <= 0) return;
+			size_t const limit = size_t(m_settings.max_storage_memory);
+
+			while (memory() > limit
+				&& m_torrents.size() + m_immutable_table.size() + m_mutable_table.size() > 1)
+			{
+				torrent_table_t::node* t = m_torrents.oldest();
+				item_table_t::node* im = m_immutable_table.oldest();
+				item_table_t::node* mu = m_mutable_table.oldest();
+
+				boost::uint64_t const t_used = t ? t->used : ~boost::uint64_t(0);
+				boost::uint64_t const im_used = im ? im->used : ~boost::uint64_t(0);
+				boost::uint64_t const mu_used = mu ? mu->used : ~boost::uint64_t(0);
+
+				if (t_used <= im_used && t_used <= mu_used) erase_torrent(*t);
+				else if (im_used <= mu_used) erase_immutable(*im);
+				else erase_mutable(*mu);
+			}
+		}
+
+		void erase_torrent(torrent_table_t::node& n)
+		{
+			m_counters.peers -= int(n.value.peers.size());
+			m_counters.torrents -= 1;
+			m_heap_bytes -= n.value.heap_bytes();
+			m_torrents.erase(n);
+		}
+
+		void erase_immutable(item_table_t::node& n)
+		{
+			m_counters.immutable_data -= 1;
+			m_heap_bytes -= n.value.heap_bytes();
+			m_immutable_table.erase(n);
+		}
+
+		void erase_mutable(item_table_t::node& n)
+		{
+			m_counters.mutable_data -= 1;
+			m_heap_bytes -= n.value.heap_bytes();
+			m_mutable_table.erase(n);
+		}
+
+		// drops the peers that haven't announced for peer_generations, and
+		// the torrents left without peers
+		void purge_peers()
+		{
+			for (int s = 0; s < num_shards; ++s)
+			{
+				std::vector<torrent_table_t::node>& nodes = m_torrents.shard_nodes(s);
+				for (int i = int(nodes.size()) - 1; i >= 0; --i)
+				{
+					flat_torrent& v = nodes[i].value;
+					size_t const bytes_before = v.heap_bytes();
+					std::vector<flat_peer>::iterator const end = std::remove_if(
+						v.peers.begin(), v.peers.end(), expired_peer(m_generation));
+					m_counters.peers -= int(v.peers.end() - end);
+					v.peers.erase(end, v.peers.end());
+
+					if (v.peers.empty())
+					{
+						m_heap_bytes -= bytes_before;
+						m_counters.torrents -= 1;
+						m_torrents.erase(nodes[i]);
+						continue;
+					}
+
+					// the array of a torrent that lost most of its swarm
+					if (v.peers.size() * 4 < v.peers.capacity())
+						std::vector<flat_peer>(v.peers).swap(v.peers);
+					m_heap_bytes += v.heap_bytes() - bytes_before;
+				}
+			}
+		}
+
+		sha1_hash m_id;
+		dht_settings const& m_settings;
+		dht_storage_counters m_counters;
+
+		// orders uses for the LRU eviction. Lookups count as uses, which is
+		// why the tables are mutable
+		mutable boost::uint64_t m_clock;
+		boost::uint8_t m_generation;
+		time_point m_next_generation;
+
+		mutable torrent_table_t m_torrents;
+		mutable item_table_t m_immutable_table;
+		mutable item_table_t m_mutable_table;
+
+		// what the names, peer arrays and item values allocate
+		size_t m_heap_bytes;
+	};
+}
+
+dht_storage_interface* dht_flat_storage_constructor(sha1_hash const& id
+	, dht_settings const& settings)
+{
+	return new dht_flat_storage(id, settings);
+}
+
+} } // namespace libtorrent::dht
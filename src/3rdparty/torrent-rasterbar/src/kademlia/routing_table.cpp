@@ -494,6 +494,22 @@ node_entry* routing_table::find_node(udp::endpoint const& ep
 	return 0;
 }
 
+int routing_table::node_rtt(node_id const& id, udp::endpoint const& ep)
+{
+	// only the node's own bucket needs to be searched, unlike find_node()
+	// with an endpoint
+	table_t::iterator i = find_bucket(id);
+	if (i == m_buckets.end()) return 0xffff;
+	for (bucket_t::iterator j = i->live_nodes.begin();
+		j != i->live_nodes.end(); ++j)
+	{
+		if (j->id != id) continue;
+		if (j->addr() != ep.address() || j->port() != ep.port()) return 0xffff;
+		return j->rtt;
+	}
+	return 0xffff;
+}
+
 void routing_table::remove_node(node_entry* n
 	, routing_table::table_t::iterator bucket)
 {
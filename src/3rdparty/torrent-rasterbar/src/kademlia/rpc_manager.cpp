@@ -65,6 +65,21 @@ namespace libtorrent { namespace dht
 
 namespace io = libtorrent::detail;
 
+namespace {
+
+	// the bounds of the adaptive timeouts, in milliseconds. Before the first
+	// reply the upper bounds are used, they are the fixed timeouts this used
+	// to have
+	const int min_short_timeout = 250;
+	const int max_short_timeout = 1000;
+	const int min_timeout = 3000;
+	const int max_timeout = 15000;
+
+	// rpc_manager::tick() runs at least this often while requests are in
+	// flight, it's the resolution of the short timeouts
+	const int tick_interval = 200;
+}
+
 void intrusive_ptr_add_ref(observer const* o)
 {
 	TORRENT_ASSERT(o != 0);
@@ -182,6 +197,8 @@ rpc_manager::rpc_manager(node_id const& our_id
 	, m_table(table)
 	, m_timer(aux::time_now())
 	, m_our_id(our_id)
+	, m_srtt(0)
+	, m_rttvar(0)
 	, m_allocated_observers(0)
 	, m_destructing(false)
 {}
@@ -371,6 +388,7 @@ bool rpc_manager::incoming(msg const& m, node_id* id)
 	*id = nid;
 
 	int rtt = int(total_milliseconds(now - o->sent()));
+	update_rtt(rtt);
 
 	// we found an observer for this reply, hence the node is not spoofing
 	// add it to the routing table
@@ -381,17 +399,14 @@ time_duration rpc_manager::tick()
 {
 	INVARIANT_CHECK;
 
-	static const int short_timeout = 1;
-	static const int timeout = 15;
-
 	// look for observers that have timed out
 
-	if (m_transactions.empty()) return seconds(short_timeout);
+	if (m_transactions.empty()) return milliseconds(tick_interval);
 
 	std::vector<observer_ptr> timeouts;
 	std::vector<observer_ptr> short_timeouts;
 
-	time_duration ret = seconds(short_timeout);
+	time_duration ret = milliseconds(max_short_timeout);
 	time_point now = aux::time_now();
 
 	for (transactions_t::iterator i = m_transactions.begin();
@@ -400,7 +415,7 @@ time_duration rpc_manager::tick()
 		observer_ptr o = i->second;
 
 		time_duration diff = now - o->sent();
-		if (diff >= seconds(timeout))
+		if (diff >= milliseconds(o->timeout_ms()))
 		{
 #ifndef TORRENT_DISABLE_LOGGING
 			m_log->log(dht_logger::rpc_manager, "[%p] timing out transaction id: %d from: %s"
@@ -414,7 +429,7 @@ time_duration rpc_manager::tick()
 
 		// don't call short_timeout() again if we've
 		// already called it once
-		if (diff >= seconds(short_timeout) && !o->has_short_timeout())
+		if (diff >= milliseconds(o->short_timeout_ms()) && !o->has_short_timeout())
 		{
 #ifndef TORRENT_DISABLE_LOGGING
 			m_log->log(dht_logger::rpc_manager, "[%p] short-timing out transaction id: %d from: %s"
@@ -427,14 +442,53 @@ time_duration rpc_manager::tick()
 			continue;
 		}
 
-		ret = std::min(seconds(timeout) - diff, ret);
+		time_duration const next = o->has_short_timeout()
+			? milliseconds(o->timeout_ms()) : milliseconds(o->short_timeout_ms());
+		ret = (std::min)(duration_cast<time_duration>(next - diff), ret);
 		++i;
 	}
 
 	std::for_each(timeouts.begin(), timeouts.end(), boost::bind(&observer::timeout, _1));
 	std::for_each(short_timeouts.begin(), short_timeouts.end(), boost::bind(&observer::short_timeout, _1));
 
-	return (std::max)(ret, duration_cast<time_duration>(milliseconds(200)));
+	// requests sent before the next tick may have short timeouts down to
+	// min_short_timeout, don't sleep past them
+	ret = (std::min)(ret, duration_cast<time_duration>(milliseconds(tick_interval)));
+	return (std::max)(ret, duration_cast<time_duration>(milliseconds(50)));
+}
+
+// the classic estimator from TCP (RFC 6298): the smoothed RTT with a gain of
+// 1/8 and its mean deviation with a gain of 1/4
+void rpc_manager::update_rtt(int rtt)
+{
+	if (m_srtt == 0)
+	{
+		m_srtt = (std::max)(rtt, 1);
+		m_rttvar = rtt / 2;
+		return;
+	}
+	int const err = rtt - m_srtt;
+	m_srtt = (std::max)(m_srtt + err / 8, 1);
+	m_rttvar += ((err < 0 ? -err : err) - m_rttvar) / 4;
+}
+
+// a request that takes longer than the node usually does (or the network
+// does, if we haven't heard from the node before) plus four deviations is
+// probably lost. short_timeout() lets the traversal send a speculative
+// request to the next node in its place. Once it's that late, giving up
+// after ten times as long loses very few replies
+void rpc_manager::set_timeouts(observer& o, udp::endpoint const& target)
+{
+	if (m_srtt == 0) return;
+
+	int expected = m_table.node_rtt(o.id(), target);
+	if (expected == 0xffff) expected = m_srtt;
+
+	int const short_timeout = (std::min)((std::max)(expected + 4 * m_rttvar
+		, min_short_timeout), max_short_timeout);
+	int const timeout = (std::min)((std::max)(short_timeout * 10
+		, min_timeout), max_timeout);
+	o.set_timeouts(short_timeout, timeout);
 }
 
 void rpc_manager::add_our_id(entry& e)
@@ -466,6 +520,7 @@ bool rpc_manager::invoke(entry& e, udp::endpoint target_addr
 
 	o->set_target(target_addr);
 	o->set_transaction_id(tid);
+	set_timeouts(*o, target_addr);
 
 #ifndef TORRENT_DISABLE_LOGGING
 	m_log->log(dht_logger::rpc_manager, "[%p] invoking %s -> %s"
@@ -324,12 +324,13 @@ void traversal_algorithm::failed(observer_ptr o, int flags)
 	TORRENT_ASSERT(o->flags & observer::flag_queried);
 	if (flags & short_timeout)
 	{
-		// short timeout means that it has been more than
-		// two seconds since we sent the request, and that
-		// we'll most likely not get a response. But, in case
-		// we do get a late response, keep the handler
-		// around for some more, but open up the slot
-		// by increasing the branch factor
+		// short timeout means that the request has taken
+		// well over the round trip time we expect from this
+		// node, and that we'll most likely not get a response.
+		// But, in case we do get a late response, keep the
+		// handler around for some more, but open up the slot
+		// by increasing the branch factor. add_requests() fills
+		// it with a speculative request to the next-closest node
 		if ((o->flags & observer::flag_short_timeout) == 0)
 		{
 			TORRENT_ASSERT(m_branch_factor < (std::numeric_limits<boost::int16_t>::max)());
@@ -459,6 +460,15 @@ bool traversal_algorithm::add_requests()
 	// we just keep any branch-factor outstanding requests
 	bool agg = m_node.settings().aggressive_lookups;
 
+	// the more of the nodes we're given turn out to be dead, the more
+	// requests we keep in flight, up to twice the branch factor when most of
+	// them time out. Requests that are merely late have already opened up a
+	// slot of their own through their short timeout (see failed()), which
+	// the rpc_manager fires based on the round trip times it has seen
+	int const answered = m_responses + m_timeouts;
+	int const branch_factor = m_branch_factor + (answered < 4 ? 0
+		: m_node.branch_factor() * m_timeouts / answered);
+
 	// Find the first node that hasn't already been queried.
 	// and make sure that the 'm_branch_factor' top nodes
 	// stay queried at all times (obviously ignoring failed nodes)
@@ -470,8 +480,8 @@ bool traversal_algorithm::add_requests()
 	for (std::vector<observer_ptr>::iterator i = m_results.begin()
 		, end(m_results.end()); i != end
 		&& results_target > 0
-		&& (agg ? outstanding < m_branch_factor
-			: m_invoke_count < m_branch_factor);
+		&& (agg ? outstanding < branch_factor
+			: m_invoke_count < branch_factor);
 		++i)
 	{
 		observer* o = i->get();
@@ -501,7 +511,7 @@ bool traversal_algorithm::add_requests()
 				"invoke-count: %d branch-factor: %d "
 				"distance: %d id: %s addr: %s type: %s"
 				, static_cast<void*>(this), int(m_results.end() - i), outstanding, int(m_invoke_count)
-				, int(m_branch_factor), distance_exp(m_target, o->id()), hex_id
+				, branch_factor, distance_exp(m_target, o->id()), hex_id
 				, print_address(o->target_addr()).c_str(), name());
 		}
 #endif
@@ -84,6 +84,13 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/close_reason.hpp"
 #include "libtorrent/aux_/time.hpp"
 
+#if TORRENT_USE_SENDFILE
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <errno.h>
+#endif
+
 //#define TORRENT_CORRUPT_DATA
 
 using boost::shared_ptr;
@@ -104,6 +111,16 @@ namespace libtorrent
 		return pb.send_buffer_offset != pending_block::not_in_buffer;
 	}
 
+#if TORRENT_USE_SENDFILE
+	// while corked, the kernel only sends full segments. Pulling the cork
+	// sends whatever is left
+	void set_cork(tcp::socket& s, bool corked)
+	{
+		int const val = corked ? 1 : 0;
+		::setsockopt(s.native_handle(), IPPROTO_TCP, TCP_CORK, &val, sizeof(val));
+	}
+#endif
+
 	}
 
 #if TORRENT_USE_ASSERTS
@@ -185,6 +202,9 @@ namespace libtorrent
 		, m_has_metadata(true)
 		, m_exceeded_limit(false)
 		, m_slow_start(true)
+#if TORRENT_USE_SENDFILE
+		, m_header_corked(false)
+#endif
 #if TORRENT_USE_ASSERTS
 		, m_in_constructor(true)
 		, m_disconnect_started(false)
@@ -5253,9 +5273,15 @@ namespace libtorrent
 				TORRENT_ASSERT(r.piece < t->torrent_file().num_pieces());
 
 				t->inc_refcount("async_read");
-				m_disk_thread.async_read(&t->storage(), r
-					, boost::bind(&peer_connection::on_disk_read_complete
-					, self(), _1, r, clock_type::now()), this);
+				if (!can_send_zero_copy()
+					|| !m_disk_thread.async_map_read(&t->storage(), r
+						, boost::bind(&peer_connection::on_disk_map_complete
+						, self(), _1, r, clock_type::now())))
+				{
+					m_disk_thread.async_read(&t->storage(), r
+						, boost::bind(&peer_connection::on_disk_read_complete
+						, self(), _1, r, clock_type::now()), this);
+				}
 			}
 			m_last_sent_payload = clock_type::now();
 			m_requests.erase(m_requests.begin() + i);
@@ -5425,6 +5451,66 @@ namespace libtorrent
 		write_piece(r, buffer);
 	}
 
+	void peer_connection::on_disk_map_complete(disk_io_job const* j
+		, peer_request r, time_point issue_time)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		// return value:
+		// 0: success, the block is in j->buffer.file_ranges
+		// 1: the block can't be sent from the files
+		// -1: disk failure
+
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::info, "FILE_ASYNC_MAP_COMPLETE"
+			, "ret: %d piece: %d s: %x l: %x ranges: %d e: %s"
+			, j->ret, r.piece, r.start, r.length
+			, int(j->buffer.file_ranges->size())
+			, j->error.ec.message().c_str());
+#endif
+
+		boost::shared_ptr<torrent> t = m_torrent.lock();
+		torrent_ref_holder h(t.get(), "async_read");
+		if (t) t->dec_refcount("async_read");
+
+		if (j->ret != 0)
+		{
+			if (!t || t->is_aborted() || m_disconnecting)
+			{
+				m_reading_bytes -= r.length;
+				return;
+			}
+
+			// read the block into a buffer instead. If this was a disk
+			// error, the read will report it
+			t->inc_refcount("async_read");
+			m_disk_thread.async_read(&t->storage(), r
+				, boost::bind(&peer_connection::on_disk_read_complete
+				, self(), _1, r, issue_time), this);
+			return;
+		}
+
+		m_reading_bytes -= r.length;
+		m_disk_read_failures = 0;
+
+		if (m_disconnecting) return;
+
+		if (!t)
+		{
+			disconnect(j->error.ec, op_file_read);
+			return;
+		}
+
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::outgoing_message
+			, "PIECE", "piece: %d s: %x l: %x (sendfile)", r.piece, r.start, r.length);
+#endif
+
+		int const disk_rtt = int(total_microseconds(clock_type::now() - issue_time));
+		m_counters.blend_stats_counter(counters::request_latency, disk_rtt, 5);
+
+		write_piece_from_files(r, *j->buffer.file_ranges);
+	}
+
 	void peer_connection::assign_bandwidth(int channel, int amount)
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -5562,11 +5648,18 @@ namespace libtorrent
 	void peer_connection::setup_send()
 	{
 		TORRENT_ASSERT(is_single_thread());
-		if (m_disconnecting) return;
+		if (m_disconnecting)
+		{
+#if TORRENT_USE_SENDFILE
+			release_header_cork();
+#endif
+			return;
+		}
 
 		// we may want to request more quota at this point
 		request_bandwidth(upload_channel);
 
+		// the send in flight calls back into here when it completes
 		if (m_channel_state[upload_channel] & peer_info::bw_network) return;
 
 		if (m_send_barrier == 0)
@@ -5590,6 +5683,11 @@ namespace libtorrent
 			&& !m_send_buffer.empty()
 			&& !m_connecting)
 		{
+#if TORRENT_USE_SENDFILE
+			// a piece header may be corked waiting for its payload. Don't
+			// hold it back for as long as it takes to get more quota
+			release_header_cork();
+#endif
 			return;
 		}
 
@@ -5659,6 +5757,9 @@ namespace libtorrent
 					, int(m_send_buffer.size()), m_connecting?"yes":"no"
 					, m_disconnecting?"yes":"no", m_reading_bytes);
 			}
+#endif
+#if TORRENT_USE_SENDFILE
+			release_header_cork();
 #endif
 			return;
 		}
@@ -5677,6 +5778,9 @@ namespace libtorrent
 #ifndef TORRENT_DISABLE_LOGGING
 			peer_log(peer_log_alert::outgoing, "CORKED_WRITE", "bytes: %d"
 				, amount_to_send);
+#endif
+#if TORRENT_USE_SENDFILE
+			release_header_cork();
 #endif
 			return;
 		}
@@ -5685,7 +5789,6 @@ namespace libtorrent
 #ifndef TORRENT_DISABLE_LOGGING
 		peer_log(peer_log_alert::outgoing, "ASYNC_WRITE", "bytes: %d", amount_to_send);
 #endif
-		std::vector<boost::asio::const_buffer> const& vec = m_send_buffer.build_iovec(amount_to_send);
 #if defined TORRENT_ASIO_DEBUGGING
 		add_outstanding_async("peer_connection::on_send_data");
 #endif
@@ -5695,6 +5798,45 @@ namespace libtorrent
 		m_socket_is_writing = true;
 #endif
 
+#if TORRENT_USE_SENDFILE
+		// the next thing to send is payload to be sent straight from a file.
+		// Wait for the socket to become writable and sendfile() it from
+		// on_send_file_ready(). Anything in memory queued up behind it is
+		// sent once it's done. The wait is a socket job like any other write,
+		// so it's issued from the same network thread as this peer's reads
+		file_range range;
+		if (m_send_buffer.front_file(range))
+		{
+			socket_job j;
+			j.type = socket_job::write_job;
+			j.peer = self();
+			m_ses.post_socket_job(j);
+			m_channel_state[upload_channel] |= peer_info::bw_network;
+			m_last_sent = aux::time_now();
+			return;
+		}
+#endif
+
+		std::vector<boost::asio::const_buffer> const& vec = m_send_buffer.build_iovec(amount_to_send);
+
+#if TORRENT_USE_SENDFILE
+		// this write ends with the header of a piece message whose payload is
+		// sent with sendfile(). Hold it back until the payload is written
+		// after it, or it goes out in a small packet of its own.
+		// on_send_file_ready() pulls the cork, or setup_send() if it returns
+		// without getting to the payload
+		if (m_send_buffer.reaches_file(amount_to_send) && !m_header_corked)
+		{
+			tcp::socket* s = m_socket->get<tcp::socket>();
+			TORRENT_ASSERT(s);
+			if (s)
+			{
+				set_cork(*s, true);
+				m_header_corked = true;
+			}
+		}
+#endif
+
 		// uTP sockets aren't thread safe...
 		if (is_utp(*m_socket))
 		{
@@ -5714,6 +5856,85 @@ namespace libtorrent
 		m_last_sent = aux::time_now();
 	}
 
+#if TORRENT_USE_SENDFILE
+	void peer_connection::on_send_file_ready(error_code const& error
+		, std::size_t)
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		file_range range;
+		if (error || m_disconnecting || !m_send_buffer.front_file(range))
+		{
+			on_send_data(error ? error : error_code(boost::asio::error::operation_aborted), 0);
+			return;
+		}
+
+		// the quota and the barrier can't have shrunk while we were waiting,
+		// they are only consumed by on_send_data()
+		int amount_to_send = range.size;
+		if (amount_to_send > m_quota[upload_channel])
+			amount_to_send = m_quota[upload_channel];
+		if (amount_to_send > m_send_barrier)
+			amount_to_send = m_send_barrier;
+		TORRENT_ASSERT(amount_to_send > 0);
+
+		// the wait for writability has put the socket in non-blocking mode.
+		// Its state mustn't be touched from here, the network thread may be
+		// issuing a read on it
+		tcp::socket* s = m_socket->get<tcp::socket>();
+		TORRENT_ASSERT(s);
+
+		off_t offset = range.offset;
+		ssize_t const ret = ::sendfile(s->native_handle()
+			, range.handle->native_handle(), &offset, amount_to_send);
+		bool const would_block = ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+		int const send_error = ret < 0 ? errno : 0;
+
+		// the header written before this is corked (see setup_send()), let it
+		// out with the payload
+		if (!would_block) release_header_cork();
+
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::outgoing, "SENDFILE"
+			, "offset: %" PRId64 " bytes: %d ret: %d"
+			, range.offset, amount_to_send, int(ret));
+#endif
+
+		if (would_block)
+		{
+			// the socket filled up again before we got to it
+			socket_job j;
+			j.type = socket_job::write_job;
+			j.peer = self();
+			m_ses.post_socket_job(j);
+			return;
+		}
+
+		if (ret < 0)
+		{
+			on_send_data(error_code(send_error, system_category()), 0);
+			return;
+		}
+
+		// the file is shorter than the torrent says it should be
+		if (ret == 0)
+		{
+			on_send_data(error_code(boost::asio::error::eof), 0);
+			return;
+		}
+
+		on_send_data(error_code(), std::size_t(ret));
+	}
+
+	void peer_connection::release_header_cork()
+	{
+		if (!m_header_corked) return;
+		m_header_corked = false;
+		tcp::socket* s = m_socket->get<tcp::socket>();
+		if (s) set_cork(*s, false);
+	}
+#endif
+
 	void peer_connection::on_disk()
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -5919,6 +6140,13 @@ namespace libtorrent
 			, userdata, ref);
 	}
 
+	void peer_connection::append_send_file(file_range const& r)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(can_send_zero_copy());
+		m_send_buffer.append_file(r);
+	}
+
 	boost::optional<piece_block_progress>
 	peer_connection::downloading_piece_progress() const
 	{
@@ -211,6 +211,17 @@ namespace libtorrent
 			(*i)->peer_rank = 0;
 	}
 
+	void peer_list::update_candidate_keys()
+	{
+		TORRENT_ASSERT(is_single_thread());
+		for (int i = 0; i < int(m_peers.size()); ++i)
+		{
+			// the number of candidates doesn't change, only their order
+			if (!is_candidate_key(m_candidate_keys[i])) continue;
+			m_candidate_keys[i] = candidate_key(*m_peers[i]);
+		}
+	}
+
 	// disconnects and removes all peers that are now filtered
 	// fills in 'erased' with torrent_peer pointers that were removed
 	// from the peer list. Any references to these peers must be cleared
@@ -295,10 +306,11 @@ namespace libtorrent
 			TORRENT_ASSERT(m_num_seeds > 0);
 			--m_num_seeds;
 		}
-		if (is_connect_candidate(**i))
+		int const index = int(i - m_peers.begin());
+		if (is_candidate_key(m_candidate_keys[index]))
 			update_connect_candidates(-1);
 		TORRENT_ASSERT(m_num_connect_candidates < int(m_peers.size()));
-		if (m_round_robin > i - m_peers.begin()) --m_round_robin;
+		if (m_round_robin > index) --m_round_robin;
 		if (m_round_robin >= int(m_peers.size())) m_round_robin = 0;
 
 		// if this peer is in the connect candidate
@@ -313,6 +325,7 @@ namespace libtorrent
 
 		m_peer_allocator.free_peer_entry(*i);
 		m_peers.erase(i);
+		m_candidate_keys.erase(m_candidate_keys.begin() + index);
 	}
 
 	bool peer_list::should_erase_immediately(torrent_peer const& p) const
@@ -371,14 +384,27 @@ namespace libtorrent
 
 			if (round_robin == int(m_peers.size())) round_robin = 0;
 
-			torrent_peer& pe = *m_peers[round_robin];
-			TORRENT_ASSERT(pe.in_use);
 			int current = round_robin;
 
-			if (is_erase_candidate(pe)
+			// the force erase candidates are all peers that aren't connected.
+			// Without the flag, only the keys of the erase candidates need to
+			// be looked at
+			if ((flags & force_erase) == 0
+				&& m_candidate_keys[current] != erasable_key)
+			{
+				++round_robin;
+				continue;
+			}
+
+			torrent_peer& pe = *m_peers[current];
+			TORRENT_ASSERT(pe.in_use);
+
+			if (m_candidate_keys[current] == erasable_key
+				&& &pe != m_locked_peer
 				&& (erase_candidate == -1
 					|| !compare_peer_erase(*m_peers[erase_candidate], pe)))
 			{
+				TORRENT_ASSERT(is_erase_candidate(pe));
 				if (should_erase_immediately(pe))
 				{
 					if (erase_candidate > current) --erase_candidate;
@@ -392,7 +418,8 @@ namespace libtorrent
 					erase_candidate = current;
 				}
 			}
-			if (is_force_erase_candidate(pe)
+			if ((flags & force_erase)
+				&& is_force_erase_candidate(pe)
 				&& (force_erase_candidate == -1
 					|| !compare_peer_erase(*m_peers[force_erase_candidate], pe)))
 			{
@@ -422,10 +449,8 @@ namespace libtorrent
 
 		TORRENT_ASSERT(p->in_use);
 
-		if (is_connect_candidate(*p))
-			update_connect_candidates(-1);
-
 		p->banned = true;
+		update_candidate(p);
 		TORRENT_ASSERT(!is_connect_candidate(*p));
 		return true;
 	}
@@ -438,9 +463,8 @@ namespace libtorrent
 		TORRENT_ASSERT(p->in_use);
 		TORRENT_ASSERT(c);
 
-		const bool was_conn_cand = is_connect_candidate(*p);
 		p->connection = c;
-		if (was_conn_cand) update_connect_candidates(-1);
+		update_candidate(p);
 	}
 
 	void peer_list::inc_failcount(torrent_peer* p)
@@ -448,10 +472,8 @@ namespace libtorrent
 		// failcount is a 5 bit value
 		if (p->failcount == 31) return;
 
-		const bool was_conn_cand = is_connect_candidate(*p);
 		++p->failcount;
-		if (was_conn_cand && !is_connect_candidate(*p))
-			update_connect_candidates(-1);
+		update_candidate(p);
 	}
 
 	void peer_list::set_failcount(torrent_peer* p, int f)
@@ -460,12 +482,8 @@ namespace libtorrent
 		INVARIANT_CHECK;
 
 		TORRENT_ASSERT(p->in_use);
-		const bool was_conn_cand = is_connect_candidate(*p);
 		p->failcount = f;
-		if (was_conn_cand != is_connect_candidate(*p))
-		{
-			update_connect_candidates(was_conn_cand ? -1 : 1);
-		}
+		update_candidate(p);
 	}
 
 	bool peer_list::is_connect_candidate(torrent_peer const& p) const
@@ -483,6 +501,67 @@ namespace libtorrent
 		return true;
 	}
 
+	boost::uint32_t peer_list::candidate_key(torrent_peer const& p) const
+	{
+		if (!is_connect_candidate(p))
+		{
+			// is_erase_candidate(), except for the locked peer
+			return p.connection == 0
+				&& (p.failcount > 0 || p.source == peer_info::resume_data)
+				? erasable_key : not_candidate;
+		}
+
+		// in the order of compare_peer(). The lowest 4 bits are never set, so
+		// a candidate can't end up with one of the keys above
+		return (boost::uint32_t(p.failcount) << 27)
+			| (boost::uint32_t(!is_local(p.address())) << 26)
+			| (boost::uint32_t(p.last_connected) << 10)
+			| (boost::uint32_t(63 - source_rank(p.source)) << 4);
+	}
+
+	// call after changing anything that may affect the candidate key of p.
+	// Updates the key and the number of connect candidates
+	void peer_list::update_candidate(torrent_peer const* p)
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		// web seeds aren't in m_peers, and never connect candidates
+		if (p->web_seed) return;
+
+		int const index = peer_index(p);
+		TORRENT_ASSERT(index >= 0);
+		if (index < 0) return;
+
+		boost::uint32_t const key = candidate_key(*p);
+		boost::uint32_t& old = m_candidate_keys[index];
+		if (is_candidate_key(old) != is_candidate_key(key))
+			update_connect_candidates(is_candidate_key(key) ? 1 : -1);
+		old = key;
+	}
+
+	int peer_list::peer_index(torrent_peer const* p) const
+	{
+		const_iterator begin;
+		const_iterator end;
+#if TORRENT_USE_I2P
+		if (p->is_i2p_addr)
+		{
+			begin = std::lower_bound(m_peers.begin(), m_peers.end()
+				, p->dest(), peer_address_compare());
+			end = m_peers.end();
+		}
+		else
+#endif
+		{
+			std::pair<const_iterator, const_iterator> range = find_peers(p->address());
+			begin = range.first;
+			end = range.second;
+		}
+
+		const_iterator i = std::find(begin, end, p);
+		return i == end ? -1 : int(i - m_peers.begin());
+	}
+
 	void peer_list::find_connect_candidates(std::vector<torrent_peer*>& peers
 		, int session_time, torrent_state* state)
 	{
@@ -504,31 +583,38 @@ namespace libtorrent
 
 		int max_peerlist_size = state->max_peerlist_size;
 
-		// TODO: 2 it would be nice if there was a way to iterate over these
-		// torrent_peer objects in the order they are allocated in the pool
-		// instead. It would probably be more efficient
-		for (int iterations = (std::min)(int(m_peers.size()), 300);
-			iterations > 0; --iterations)
+		// if the number of peers is growing large
+		// we need to start weeding. Like in erase_peers(), 300 peers at most
+		int weed_left = (max_peerlist_size > 0
+			&& int(m_peers.size()) >= max_peerlist_size * 0.95)
+			? (std::min)(int(m_peers.size()), 300) : 0;
+
+		// peers are skipped by their keys, without touching the torrent_peer
+		// objects, unless they're erase candidates while weeding or connect
+		// candidates that may be picked. That's cheap enough to look at all
+		// of them, so a sparse list still yields its candidates. Stop after
+		// a few times candidate_count connect candidates have been seen
+		int candidates_left = candidate_count * 3;
+		for (int iterations = int(m_peers.size());
+			iterations > 0 && candidates_left > 0; --iterations)
 		{
 			++state->loop_counter;
 
 			if (m_round_robin >= int(m_peers.size())) m_round_robin = 0;
 
-			torrent_peer& pe = *m_peers[m_round_robin];
-			TORRENT_ASSERT(pe.in_use);
 			int current = m_round_robin;
+			boost::uint32_t const key = m_candidate_keys[current];
 
-			// if the number of peers is growing large
-			// we need to start weeding.
-
-			if (int(m_peers.size()) >= max_peerlist_size * 0.95
-				&& max_peerlist_size > 0)
+			if (weed_left > 0)
 			{
-				if (is_erase_candidate(pe)
+				--weed_left;
+				torrent_peer* pe = m_peers[current];
+				if (key == erasable_key && pe != m_locked_peer
 					&& (erase_candidate == -1
-						|| !compare_peer_erase(*m_peers[erase_candidate], pe)))
+						|| !compare_peer_erase(*m_peers[erase_candidate], *pe)))
 				{
-					if (should_erase_immediately(pe))
+					TORRENT_ASSERT(is_erase_candidate(*pe));
+					if (should_erase_immediately(*pe))
 					{
 						if (erase_candidate > current) --erase_candidate;
 						erase_peer(m_peers.begin() + current, state);
@@ -543,28 +629,41 @@ namespace libtorrent
 
 			++m_round_robin;
 
-			if (!is_connect_candidate(pe)) continue;
+			if (!is_candidate_key(key)) continue;
+			--candidates_left;
 
-			if (pe.last_connected
-				&& session_time - pe.last_connected <
-				(int(pe.failcount) + 1) * state->min_reconnect_time)
+			int const failcount = key >> 27;
+			int const last_connected = (key >> 10) & 0xffff;
+			if (last_connected
+				&& session_time - last_connected <
+				(failcount + 1) * state->min_reconnect_time)
 				continue;
 
+			// the keys order peers the same way compare_peer() does, except
+			// for the peer rank. Only a peer that may be better than the worst
+			// one we have needs to be looked at
+			if (peers.size() == candidate_count
+				&& candidate_key(*peers.back()) < key) continue;
+
+			torrent_peer* pe = m_peers[current];
+			TORRENT_ASSERT(pe->in_use);
+			TORRENT_ASSERT(candidate_key(*pe) == key);
+
 			// compare peer returns true if lhs is better than rhs. In this
 			// case, it returns true if the current candidate is better than
 			// pe, which is the peer m_round_robin points to. If it is, just
 			// keep looking.
 			if (peers.size() == candidate_count
-				&& compare_peer(peers.back(), &pe, external, external_port)) continue;
+				&& compare_peer(peers.back(), pe, external, external_port)) continue;
 
 			if (peers.size() >= candidate_count)
 				peers.resize(candidate_count - 1);
 
 			// insert this candidate sorted into peers
 			std::vector<torrent_peer*>::iterator i = std::lower_bound(peers.begin(), peers.end()
-				, &pe, boost::bind(&peer_list::compare_peer, this, _1, _2, boost::cref(external), external_port));
+				, pe, boost::bind(&peer_list::compare_peer, this, _1, _2, boost::cref(external), external_port));
 
-			peers.insert(i, &pe);
+			peers.insert(i, pe);
 		}
 
 		if (erase_candidate > -1)
@@ -708,9 +807,6 @@ namespace libtorrent
 					m_locked_peer = NULL;
 				}
 			}
-
-			if (is_connect_candidate(*i))
-				update_connect_candidates(-1);
 		}
 		else
 		{
@@ -756,8 +852,11 @@ namespace libtorrent
 #endif
 
 			iter = m_peers.insert(iter, p);
+			int const index = int(iter - m_peers.begin());
+			m_candidate_keys.insert(m_candidate_keys.begin() + index
+				, boost::uint32_t(not_candidate));
 
-			if (m_round_robin >= iter - m_peers.begin()) ++m_round_robin;
+			if (m_round_robin >= index) ++m_round_robin;
 
 			i = *iter;
 
@@ -777,6 +876,7 @@ namespace libtorrent
 			i->last_connected = session_time;
 
 		// this cannot be a connect candidate anymore, since i->connection is set
+		update_candidate(i);
 		TORRENT_ASSERT(!is_connect_candidate(*i));
 		TORRENT_ASSERT(has_connection(&c));
 		return true;
@@ -805,13 +905,11 @@ namespace libtorrent
 				TORRENT_ASSERT(pp.in_use);
 				if (pp.connection)
 				{
-					bool was_conn_cand = is_connect_candidate(pp);
 					// if we already have an entry with this
 					// new endpoint, disconnect this one
 					pp.connectable = true;
 					pp.source |= src;
-					if (!was_conn_cand && is_connect_candidate(pp))
-						update_connect_candidates(1);
+					update_candidate(&pp);
 					// calling disconnect() on a peer, may actually end
 					// up "garbage collecting" its torrent_peer entry
 					// as well, if it's considered useless (which this specific)
@@ -841,13 +939,10 @@ namespace libtorrent
 		}
 #endif
 
-		bool was_conn_cand = is_connect_candidate(*p);
 		p->port = port;
 		p->source |= src;
 		p->connectable = true;
-
-		if (was_conn_cand != is_connect_candidate(*p))
-			update_connect_candidates(was_conn_cand ? -1 : 1);
+		update_candidate(p);
 		return true;
 	}
 
@@ -872,10 +967,8 @@ namespace libtorrent
 		if (p == 0) return;
 		TORRENT_ASSERT(p->in_use);
 		if (p->seed == s) return;
-		bool was_conn_cand = is_connect_candidate(*p);
 		p->seed = s;
-		if (was_conn_cand && !is_connect_candidate(*p))
-			update_connect_candidates(-1);
+		update_candidate(p);
 
 		if (p->web_seed) return;
 		if (s)
@@ -926,8 +1019,11 @@ namespace libtorrent
 		}
 
 		iter = m_peers.insert(iter, p);
+		int const index = int(iter - m_peers.begin());
+		m_candidate_keys.insert(m_candidate_keys.begin() + index
+			, boost::uint32_t(not_candidate));
 
-		if (m_round_robin >= iter - m_peers.begin()) ++m_round_robin;
+		if (m_round_robin >= index) ++m_round_robin;
 
 #if !defined(TORRENT_DISABLE_ENCRYPTION) && !defined(TORRENT_DISABLE_EXTENSIONS)
 		if (flags & flag_encryption) p->pe_support = true;
@@ -942,7 +1038,9 @@ namespace libtorrent
 			p->supports_utp = true;
 		if (flags & flag_holepunch)
 			p->supports_holepunch = true;
-		if (is_connect_candidate(*p))
+
+		m_candidate_keys[index] = candidate_key(*p);
+		if (is_candidate_key(m_candidate_keys[index]))
 			update_connect_candidates(1);
 
 		return true;
@@ -952,8 +1050,6 @@ namespace libtorrent
 		, tcp::endpoint const& remote, char const* /* destination*/)
 	{
 		TORRENT_ASSERT(is_single_thread());
-		bool was_conn_cand = is_connect_candidate(*p);
-
 		TORRENT_ASSERT(p->in_use);
 		p->connectable = true;
 
@@ -985,10 +1081,9 @@ namespace libtorrent
 		if (flags & flag_holepunch)
 			p->supports_holepunch = true;
 
-		if (was_conn_cand != is_connect_candidate(*p))
-		{
-			update_connect_candidates(was_conn_cand ? -1 : 1);
-		}
+		// the failcount and source may have changed the key, even if the
+		// peer was a connect candidate before
+		update_candidate(p);
 	}
 
 	void peer_list::update_connect_candidates(int delta)
@@ -1222,8 +1317,7 @@ namespace libtorrent
 			if (p->failcount < 31) ++p->failcount;
 		}
 
-		if (is_connect_candidate(*p))
-			update_connect_candidates(1);
+		update_candidate(p);
 
 		// if we're already a seed, it's not as important
 		// to keep all the possibly stale peers
@@ -1259,10 +1353,10 @@ namespace libtorrent
 		m_finished = state->is_finished;
 		m_max_failcount = state->max_failcount;
 
-		for (const_iterator i = m_peers.begin();
-			i != m_peers.end(); ++i)
+		for (int i = 0; i < int(m_peers.size()); ++i)
 		{
-			m_num_connect_candidates += is_connect_candidate(**i);
+			m_candidate_keys[i] = candidate_key(*m_peers[i]);
+			m_num_connect_candidates += is_candidate_key(m_candidate_keys[i]);
 		}
 
 #if TORRENT_USE_INVARIANT_CHECKS
@@ -1300,6 +1394,7 @@ namespace libtorrent
 		TORRENT_ASSERT(is_single_thread());
 		TORRENT_ASSERT(m_num_connect_candidates >= 0);
 		TORRENT_ASSERT(m_num_connect_candidates <= int(m_peers.size()));
+		TORRENT_ASSERT(m_candidate_keys.size() == m_peers.size());
 
 #ifdef TORRENT_EXPENSIVE_INVARIANT_CHECKS
 		int total_connections = 0;
@@ -1319,6 +1414,10 @@ namespace libtorrent
 			torrent_peer const& p = **i;
 			TORRENT_ASSERT(p.in_use);
 			if (is_connect_candidate(p)) ++connect_candidates;
+			// peers that are connected may have their last_connected changed
+			// by the connection, it's brought up to date when it's closed
+			TORRENT_ASSERT(p.connection
+				|| m_candidate_keys[i - m_peers.begin()] == candidate_key(p));
 			++total_connections;
 			if (!p.connection)
 			{
@@ -47,6 +47,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/bitfield.hpp"
 #include "libtorrent/random.hpp"
 #include "libtorrent/alloca.hpp"
+#include "libtorrent/aux_/byteswap.hpp"
 #include "libtorrent/performance_counters.hpp" // for counters
 #include "libtorrent/alert_types.hpp" // for picker_log_alert
 
@@ -71,6 +72,24 @@ POSSIBILITY OF SUCH DAMAGE.
 
 namespace libtorrent
 {
+	namespace {
+
+	// bitfields store their bits most significant first in network byte
+	// order. Returns the offset of the first piece that's set in such a word,
+	// after it's been converted to host byte order
+	inline int first_set_bit(boost::uint32_t v)
+	{
+		TORRENT_ASSERT(v != 0);
+#if defined __GNUC__
+		return __builtin_clz(v);
+#else
+		int ret = 0;
+		for (; (v & 0x80000000) == 0; v <<= 1) ++ret;
+		return ret;
+#endif
+	}
+
+	} // anonymous namespace
 
 	const piece_block piece_block::invalid((std::numeric_limits<int>::max)(), (std::numeric_limits<int>::max)());
 
@@ -235,10 +254,11 @@ namespace libtorrent
 		VALGRIND_CHECK_VALUE_IS_DEFINED(block_index);
 #endif
 		block_info* info = blocks_for_piece(ret);
+		boost::uint32_t const* pad = pad_row(piece);
 		for (int i = 0; i < m_blocks_per_piece; ++i)
 		{
 			info[i].num_peers = 0;
-			if (m_pad_blocks.count(piece_block(piece, i)))
+			if (pad && (pad[i / 32] & (boost::uint32_t(1) << (i & 31))))
 			{
 				info[i].state = block_info::state_finished;
 				++ret.finished;
@@ -1346,14 +1366,16 @@ namespace libtorrent
 			// and mark the picker as dirty, so we'll rebuild it next time we need it.
 			// this only matters if we're not already dirty, in which case the fasted
 			// thing to do is to just update the counters and be done
-			int index = 0;
-			for (bitfield::const_iterator i = bitmask.begin()
-				, end(bitmask.end()); i != end; ++i, ++index)
+			boost::uint32_t const* words = reinterpret_cast<boost::uint32_t const*>(bitmask.data());
+			for (int w = 0, end(bitmask.num_words()); w < end && num_inc < size; ++w)
 			{
-				if (!*i) continue;
-				if (num_inc < size) incremented[num_inc] = index;
-				++num_inc;
-				if (num_inc >= size) break;
+				for (boost::uint32_t bits = aux::network_to_host(words[w]);
+					bits != 0 && num_inc < size;)
+				{
+					int const k = first_set_bit(bits);
+					bits &= ~(0x80000000u >> k);
+					incremented[num_inc++] = w * 32 + k;
+				}
 			}
 
 			if (num_inc < size)
@@ -1382,23 +1404,30 @@ namespace libtorrent
 			}
 		}
 
-		int index = 0;
+		// many pieces are changing. Only update the counters, a word of the
+		// bitfield (32 pieces) at a time, skipping the empty ones. The
+		// priority buckets are rebuilt in one pass by update_pieces() the next
+		// time they're needed, instead of moving the pieces one by one
+		boost::uint32_t const* words = reinterpret_cast<boost::uint32_t const*>(bitmask.data());
 		bool updated = false;
-		for (bitfield::const_iterator i = bitmask.begin()
-			, end(bitmask.end()); i != end; ++i, ++index)
+		for (int w = 0, end(bitmask.num_words()); w < end; ++w)
 		{
-			if (*i)
+			boost::uint32_t bits = aux::network_to_host(words[w]);
+			if (bits == 0) continue;
+			updated = true;
+			piece_pos* p = &m_piece_map[w * 32];
+			do
 			{
+				int const k = first_set_bit(bits);
+				bits &= ~(0x80000000u >> k);
 #ifdef TORRENT_DEBUG_REFCOUNTS
-				TORRENT_ASSERT(m_piece_map[index].have_peers.count(peer) == 0);
-				m_piece_map[index].have_peers.insert(peer);
+				TORRENT_ASSERT(p[k].have_peers.count(peer) == 0);
+				p[k].have_peers.insert(peer);
 #else
 				TORRENT_UNUSED(peer);
 #endif
-
-				++m_piece_map[index].peer_count;
-				updated = true;
-			}
+				++p[k].peer_count;
+			} while (bits != 0);
 		}
 
 		// if we're already dirty, no point in doing anything more
@@ -1443,14 +1472,16 @@ namespace libtorrent
 			// and mark the picker as dirty, so we'll rebuild it next time we need it.
 			// this only matters if we're not already dirty, in which case the fasted
 			// thing to do is to just update the counters and be done
-			int index = 0;
-			for (bitfield::const_iterator i = bitmask.begin()
-				, end(bitmask.end()); i != end; ++i, ++index)
+			boost::uint32_t const* words = reinterpret_cast<boost::uint32_t const*>(bitmask.data());
+			for (int w = 0, end(bitmask.num_words()); w < end && num_dec < size; ++w)
 			{
-				if (!*i) continue;
-				if (num_dec < size) decremented[num_dec] = index;
-				++num_dec;
-				if (num_dec >= size) break;
+				for (boost::uint32_t bits = aux::network_to_host(words[w]);
+					bits != 0 && num_dec < size;)
+				{
+					int const k = first_set_bit(bits);
+					bits &= ~(0x80000000u >> k);
+					decremented[num_dec++] = w * 32 + k;
+				}
 			}
 
 			if (num_dec < size)
@@ -1488,15 +1519,20 @@ namespace libtorrent
 			}
 		}
 
-		int index = 0;
+		// same as in inc_refcount(), a word of the bitfield at a time
+		boost::uint32_t const* words = reinterpret_cast<boost::uint32_t const*>(bitmask.data());
 		bool updated = false;
-		for (bitfield::const_iterator i = bitmask.begin()
-			, end(bitmask.end()); i != end; ++i, ++index)
+		for (int w = 0, end(bitmask.num_words()); w < end; ++w)
 		{
-			if (*i)
+			boost::uint32_t bits = aux::network_to_host(words[w]);
+			if (bits == 0) continue;
+			updated = true;
+			piece_pos* p = &m_piece_map[w * 32];
+			do
 			{
-				piece_pos& p = m_piece_map[index];
-				if (p.peer_count == 0)
+				int const k = first_set_bit(bits);
+				bits &= ~(0x80000000u >> k);
+				if (p[k].peer_count == 0)
 				{
 					TORRENT_ASSERT(m_seeds > 0);
 					// this is the case where we have one or more
@@ -1507,16 +1543,15 @@ namespace libtorrent
 				}
 
 #ifdef TORRENT_DEBUG_REFCOUNTS
-				TORRENT_ASSERT(p.have_peers.count(peer) == 1);
-				p.have_peers.erase(peer);
+				TORRENT_ASSERT(p[k].have_peers.count(peer) == 1);
+				p[k].have_peers.erase(peer);
 #else
 				TORRENT_UNUSED(peer);
 #endif
 
-				TORRENT_ASSERT(p.peer_count > 0);
-				--p.peer_count;
-				updated = true;
-			}
+				TORRENT_ASSERT(p[k].peer_count > 0);
+				--p[k].peer_count;
+			} while (bits != 0);
 		}
 
 		// if we're already dirty, no point in doing anything more
@@ -3640,20 +3675,64 @@ get_out:
 
 	void piece_picker::mark_as_pad(piece_block block)
 	{
-		m_pad_blocks.insert(block);
+		TORRENT_ASSERT(block.piece_index >= 0);
+		TORRENT_ASSERT(block.piece_index < int(m_piece_map.size()));
+		TORRENT_ASSERT(int(block.block_index) < blocks_in_piece(block.piece_index));
+
+		int const words = pad_row_words();
+		std::vector<int>::iterator i = std::lower_bound(m_pad_pieces.begin()
+			, m_pad_pieces.end(), int(block.piece_index));
+		int const row = int(i - m_pad_pieces.begin());
+		if (i == m_pad_pieces.end() || *i != block.piece_index)
+		{
+			// pad files are marked in piece order, so this is almost always
+			// an append
+			m_pad_pieces.insert(i, block.piece_index);
+			m_pad_blocks.insert(m_pad_blocks.begin() + row * words, words, 0);
+		}
+
+		boost::uint32_t& w = m_pad_blocks[row * words + block.block_index / 32];
+		boost::uint32_t const mask = boost::uint32_t(1) << (block.block_index & 31);
+		if (w & mask) return;
+		w |= mask;
+
 		// if we mark and entire piece as a pad file, we need to also
 		// consder that piece as "had" and increment some counters
-		typedef std::set<piece_block>::iterator iter;
-		iter begin = m_pad_blocks.lower_bound(piece_block(block.piece_index, 0));
-		int const blocks = blocks_in_piece(block.piece_index);
-		iter end = m_pad_blocks.upper_bound(piece_block(block.piece_index, blocks));
-		if (std::distance(begin, end) == blocks)
+		if (pad_blocks_in_piece(block.piece_index) == blocks_in_piece(block.piece_index))
 		{
 			// the entire piece is a pad file
 			we_have(block.piece_index);
 		}
 	}
 
+	boost::uint32_t const* piece_picker::pad_row(int piece) const
+	{
+		std::vector<int>::const_iterator i = std::lower_bound(m_pad_pieces.begin()
+			, m_pad_pieces.end(), piece);
+		if (i == m_pad_pieces.end() || *i != piece) return NULL;
+		return &m_pad_blocks[(i - m_pad_pieces.begin()) * pad_row_words()];
+	}
+
+	bool piece_picker::is_pad(piece_block block) const
+	{
+		boost::uint32_t const* pad = pad_row(block.piece_index);
+		if (pad == NULL) return false;
+		return (pad[block.block_index / 32]
+			& (boost::uint32_t(1) << (block.block_index & 31))) != 0;
+	}
+
+	int piece_picker::pad_blocks_in_piece(int index) const
+	{
+		boost::uint32_t const* pad = pad_row(index);
+		if (pad == NULL) return 0;
+		int ret = 0;
+		for (int i = 0, end(pad_row_words()); i < end; ++i)
+		{
+			for (boost::uint32_t w = pad[i]; w != 0; w &= w - 1) ++ret;
+		}
+		return ret;
+	}
+
 /*
 	void piece_picker::mark_as_checking(int index)
 	{
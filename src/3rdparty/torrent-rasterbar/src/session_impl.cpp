@@ -200,6 +200,19 @@ void network_thread_pool::process_job(socket_job const& j, bool post)
 	if (j.type == socket_job::write_job)
 	{
 		TORRENT_ASSERT(j.peer->m_socket_is_writing);
+#if TORRENT_USE_SENDFILE
+		if (j.vec == NULL)
+		{
+			// a write job without buffers waits for the socket to become
+			// writable, to send the payload at the front of the send buffer
+			// straight from its file
+			tcp::socket* s = j.peer->get_socket()->get<tcp::socket>();
+			TORRENT_ASSERT(s);
+			s->async_write_some(null_buffers(), j.peer->make_write_handler(
+				boost::bind(&peer_connection::on_send_file_ready, j.peer, _1, _2)));
+			return;
+		}
+#endif
 		j.peer->get_socket()->async_write_some(
 			*j.vec, j.peer->make_write_handler(boost::bind(
 				&peer_connection::on_send_data, j.peer, _1, _2)));
@@ -363,7 +376,7 @@ namespace aux {
 		, m_tcp_peer_class(0)
 		, m_local_peer_class(0)
 		, m_host_resolver(m_io_service)
-		, m_tracker_manager(m_udp_socket, m_stats_counters, m_host_resolver
+		, m_tracker_manager(m_io_service, m_udp_socket, m_stats_counters, m_host_resolver
 			, m_settings
 #if !defined TORRENT_DISABLE_LOGGING || TORRENT_USE_ASSERTS
 			, *this
@@ -697,6 +710,7 @@ namespace aux {
 			dht_sett["max_dht_items"] = m_dht_settings.max_dht_items;
 			dht_sett["max_peers"] = m_dht_settings.max_peers;
 			dht_sett["max_torrent_search_reply"] = m_dht_settings.max_torrent_search_reply;
+			dht_sett["max_storage_memory"] = m_dht_settings.max_storage_memory;
 			dht_sett["restrict_routing_ips"] = m_dht_settings.restrict_routing_ips;
 			dht_sett["restrict_search_ips"] = m_dht_settings.restrict_search_ips;
 			dht_sett["extended_routing_table"] = m_dht_settings.extended_routing_table;
@@ -776,6 +790,8 @@ namespace aux {
 				if (val) m_dht_settings.max_peers = val.int_value();
 				val = settings.dict_find_int("max_torrent_search_reply");
 				if (val) m_dht_settings.max_torrent_search_reply = val.int_value();
+				val = settings.dict_find_int("max_storage_memory");
+				if (val) m_dht_settings.max_storage_memory = val.int_value();
 				val = settings.dict_find_int("restrict_routing_ips");
 				if (val) m_dht_settings.restrict_routing_ips = val.int_value();
 				val = settings.dict_find_int("restrict_search_ips");
@@ -1164,6 +1180,12 @@ namespace aux {
 		// thread until they're all dead (via m_work).
 		m_disk_thread.abort(false);
 
+		// the network threads finish issuing any socket jobs still queued
+		// before they exit
+		for (std::vector<boost::shared_ptr<network_thread_pool> >::iterator i
+			= m_net_thread_pool.begin(), end(m_net_thread_pool.end()); i != end; ++i)
+			(*i)->stop();
+
 		// now it's OK for the network thread to exit
 		m_work.reset();
 	}
@@ -4975,7 +4997,8 @@ retry:
 			session_log("adding magnet link with resume data");
 #endif
 			if (bdecode(&params.resume_data[0], &params.resume_data[0]
-					+ params.resume_data.size(), root, err, &pos) == 0
+					+ params.resume_data.size(), root, err, &pos, 100
+					, torrent_file_token_limit) == 0
 				&& root.type() == bdecode_node::dict_t
 				&& (info = root.dict_find_dict("info")))
 			{
@@ -6337,6 +6360,8 @@ retry:
 
 		while (num_pools < m_net_thread_pool.size())
 		{
+			// the pool's thread must not outlive it
+			m_net_thread_pool.back()->stop();
 			m_net_thread_pool.erase(m_net_thread_pool.end() - 1);
 		}
 
@@ -223,6 +223,7 @@ namespace libtorrent
 		SET_NOPREV(proxy_peer_connections, true, 0),
 		SET_NOPREV(auto_sequential, true, &session_impl::update_auto_sequential),
 		SET_NOPREV(proxy_tracker_connections, true, 0),
+		SET_NOPREV(zero_copy_send, false, 0),
 	};
 
 	int_setting_entry_t int_settings[settings_pack::num_int_settings] =
@@ -241,7 +242,7 @@ namespace libtorrent
 		SET(urlseed_timeout, 20, 0),
 		SET(urlseed_pipeline_size, 5, 0),
 		SET(urlseed_wait_retry, 30, 0),
-		SET(file_pool_size, 40, 0),
+		SET(file_pool_size, 0, 0),
 		SET(max_failcount, 3, &session_impl::update_max_failcount),
 		SET(min_reconnect_time, 60, 0),
 		SET(peer_connect_timeout, 15, 0),
@@ -12,11 +12,45 @@ changelog at the end of the file.
 
 #include <cstdio>
 #include <cstring>
+#include <algorithm> // for std::min
 
 #include "libtorrent/sha1.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
 
 #include <boost/detail/endian.hpp> // for BIG_ENDIAN and LITTLE_ENDIAN macros
 
+// the hardware accelerated transforms are compiled with per-function target
+// attributes on GCC and clang, which means we don't have to pass -msha or
+// -mavx2 on the command line (which would allow the compiler to use those
+// instructions everywhere). They are only called when the CPU supports them
+// (see cpuid.cpp)
+#if TORRENT_HAS_SSE && defined __clang__
+#define TORRENT_HAS_SHA_NI 1
+#define TORRENT_HAS_AVX2 1
+#elif TORRENT_HAS_SSE && defined __GNUC__ \
+	&& (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define TORRENT_HAS_SHA_NI 1
+#define TORRENT_HAS_AVX2 1
+#elif TORRENT_HAS_SSE && defined _MSC_VER && _MSC_VER >= 1900
+#define TORRENT_HAS_SHA_NI 1
+#define TORRENT_HAS_AVX2 1
+#else
+#define TORRENT_HAS_SHA_NI 0
+#define TORRENT_HAS_AVX2 0
+#endif
+
+#if TORRENT_HAS_SHA_NI || TORRENT_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined __GNUC__
+#define TORRENT_TARGET_SHA __attribute__((target("sha,ssse3,sse4.1")))
+#define TORRENT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TORRENT_TARGET_SHA
+#define TORRENT_TARGET_AVX2
+#endif
+
 typedef boost::uint32_t u32;
 typedef boost::uint8_t u8;
 
@@ -117,6 +151,97 @@ namespace
 		state[4] += e;
 	}
 
+#if TORRENT_HAS_SHA_NI
+
+// one group of 4 rounds of the SHA extension transform. ``g`` is the group
+// index (0-19), ``m`` is the message schedule for this group and m1, m2, m3 are
+// the schedules for the following groups, which are being computed
+#define SHANI_ROUNDS(g, e_in, e_out, m, m1, m2, m3) \
+	e_in = _mm_sha1nexte_epu32(e_in, m); \
+	e_out = abcd; \
+	if (g >= 3 && g <= 18) m1 = _mm_sha1msg2_epu32(m1, m); \
+	abcd = _mm_sha1rnds4_epu32(abcd, e_in, g / 5); \
+	if (g >= 1 && g <= 16) m3 = _mm_sha1msg1_epu32(m3, m); \
+	if (g >= 2 && g <= 17) m2 = _mm_xor_si128(m2, m)
+
+	// hash ``blocks`` consecutive 512-bit blocks using the SHA extensions
+	TORRENT_TARGET_SHA
+	void SHA1transform_shani(u32 state[5], u8 const* data, u32 blocks)
+	{
+		__m128i const mask = _mm_set_epi64x(0x0001020304050607ULL
+			, 0x08090a0b0c0d0e0fULL);
+
+		__m128i abcd = _mm_loadu_si128(reinterpret_cast<__m128i const*>(state));
+		abcd = _mm_shuffle_epi32(abcd, 0x1b);
+		__m128i e0 = _mm_set_epi32(int(state[4]), 0, 0, 0);
+		__m128i e1;
+
+		for (; blocks > 0; --blocks, data += 64)
+		{
+			__m128i const abcd_save = abcd;
+			__m128i const e0_save = e0;
+
+			__m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data)), mask);
+			__m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 16)), mask);
+			__m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 32)), mask);
+			__m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 48)), mask);
+
+			// the first group adds E directly, rather than through sha1nexte
+			e0 = _mm_add_epi32(e0, msg0);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+			SHANI_ROUNDS(1, e1, e0, msg1, msg2, msg3, msg0);
+			SHANI_ROUNDS(2, e0, e1, msg2, msg3, msg0, msg1);
+			SHANI_ROUNDS(3, e1, e0, msg3, msg0, msg1, msg2);
+			SHANI_ROUNDS(4, e0, e1, msg0, msg1, msg2, msg3);
+			SHANI_ROUNDS(5, e1, e0, msg1, msg2, msg3, msg0);
+			SHANI_ROUNDS(6, e0, e1, msg2, msg3, msg0, msg1);
+			SHANI_ROUNDS(7, e1, e0, msg3, msg0, msg1, msg2);
+			SHANI_ROUNDS(8, e0, e1, msg0, msg1, msg2, msg3);
+			SHANI_ROUNDS(9, e1, e0, msg1, msg2, msg3, msg0);
+			SHANI_ROUNDS(10, e0, e1, msg2, msg3, msg0, msg1);
+			SHANI_ROUNDS(11, e1, e0, msg3, msg0, msg1, msg2);
+			SHANI_ROUNDS(12, e0, e1, msg0, msg1, msg2, msg3);
+			SHANI_ROUNDS(13, e1, e0, msg1, msg2, msg3, msg0);
+			SHANI_ROUNDS(14, e0, e1, msg2, msg3, msg0, msg1);
+			SHANI_ROUNDS(15, e1, e0, msg3, msg0, msg1, msg2);
+			SHANI_ROUNDS(16, e0, e1, msg0, msg1, msg2, msg3);
+			SHANI_ROUNDS(17, e1, e0, msg1, msg2, msg3, msg0);
+			SHANI_ROUNDS(18, e0, e1, msg2, msg3, msg0, msg1);
+			SHANI_ROUNDS(19, e1, e0, msg3, msg0, msg1, msg2);
+
+			e0 = _mm_sha1nexte_epu32(e0, e0_save);
+			abcd = _mm_add_epi32(abcd, abcd_save);
+		}
+
+		abcd = _mm_shuffle_epi32(abcd, 0x1b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state), abcd);
+		state[4] = u32(_mm_extract_epi32(e0, 3));
+	}
+
+#undef SHANI_ROUNDS
+
+#endif // TORRENT_HAS_SHA_NI
+
+	template <class BlkFun>
+	void SHA1transform_blocks(u32 state[5], u8 const* data, u32 blocks)
+	{
+#if TORRENT_HAS_SHA_NI
+		if (aux::sha_support)
+		{
+			SHA1transform_shani(state, data, blocks);
+			return;
+		}
+#endif
+		for (; blocks > 0; --blocks, data += 64)
+			SHA1transform<BlkFun>(state, data);
+	}
+
 #ifdef VERBOSE
 	void SHAPrintContext(sha_ctx *context, char *msg)
 	{
@@ -147,11 +272,10 @@ namespace
 		if ((j + len) > 63)
 		{
 			memcpy(&context->buffer[j], data, (i = 64-j));
-			SHA1transform<BlkFun>(context->state, context->buffer);
-			for ( ; i + 63 < len; i += 64)
-			{
-				SHA1transform<BlkFun>(context->state, &data[i]);
-			}
+			SHA1transform_blocks<BlkFun>(context->state, context->buffer, 1);
+			u32 const blocks = (len - i) / 64;
+			SHA1transform_blocks<BlkFun>(context->state, &data[i], blocks);
+			i += blocks * 64;
 			j = 0;
 		}
 		else
@@ -164,6 +288,156 @@ namespace
 #endif
 	}
 
+#if TORRENT_HAS_AVX2
+	u32 load_be32(u8 const* p)
+	{
+		return (u32(p[0]) << 24) | (u32(p[1]) << 16) | (u32(p[2]) << 8) | u32(p[3]);
+	}
+
+	// the last partial block of a message followed by the padding and the
+	// message length. This is either one or two blocks
+	struct sha1_tail
+	{
+		u8 buf[128];
+		u32 blocks;
+	};
+
+	void make_tail(sha1_tail& t, u8 const* data, u32 len)
+	{
+		u32 const rem = len & 63;
+		memset(t.buf, 0, sizeof(t.buf));
+		memcpy(t.buf, data + len - rem, rem);
+		t.buf[rem] = 0x80;
+		t.blocks = rem < 56 ? 1 : 2;
+		boost::uint64_t const bits = boost::uint64_t(len) * 8;
+		u8* end = t.buf + t.blocks * 64;
+		for (int i = 1; i <= 8; ++i)
+			end[-i] = u8(bits >> ((i - 1) * 8));
+	}
+
+#define MB_ROL(x, n) _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+
+#define MB_SCHEDULE(t) \
+	if (t >= 16) w[t & 15] = MB_ROL(_mm256_xor_si256( \
+		_mm256_xor_si256(w[(t - 3) & 15], w[(t - 8) & 15]) \
+		, _mm256_xor_si256(w[(t - 14) & 15], w[t & 15])), 1)
+
+#define MB_ROUND(t, f, k) { \
+	MB_SCHEDULE(t); \
+	__m256i const tmp = _mm256_add_epi32(_mm256_add_epi32(MB_ROL(a, 5), f) \
+		, _mm256_add_epi32(_mm256_add_epi32(e, k), w[t & 15])); \
+	e = d; d = c; c = MB_ROL(b, 30); b = a; a = tmp; }
+
+	// hashes up to 8 independent messages at a time, one per 32 bit lane of
+	// the ymm registers. Lanes whose message is shorter than the longest one
+	// are masked off once they run out of blocks
+	TORRENT_TARGET_AVX2
+	void SHA1_multi_avx2(u8 const* const* data, u32 const* len, u8* digests
+		, int num)
+	{
+		static u8 const zero_block[64] = { 0 };
+
+		sha1_tail tail[8];
+		u32 full[8];
+		u32 total[8];
+		u32 max_blocks = 0;
+		for (int l = 0; l < 8; ++l)
+		{
+			if (l < num)
+			{
+				full[l] = len[l] / 64;
+				make_tail(tail[l], data[l], len[l]);
+				total[l] = full[l] + tail[l].blocks;
+			}
+			else
+			{
+				full[l] = 0;
+				total[l] = 0;
+			}
+			if (total[l] > max_blocks) max_blocks = total[l];
+		}
+
+		__m256i const total_blocks = _mm256_setr_epi32(int(total[0]), int(total[1])
+			, int(total[2]), int(total[3]), int(total[4]), int(total[5])
+			, int(total[6]), int(total[7]));
+
+		__m256i h0 = _mm256_set1_epi32(0x67452301);
+		__m256i h1 = _mm256_set1_epi32(int(0xEFCDAB89));
+		__m256i h2 = _mm256_set1_epi32(int(0x98BADCFE));
+		__m256i h3 = _mm256_set1_epi32(0x10325476);
+		__m256i h4 = _mm256_set1_epi32(int(0xC3D2E1F0));
+
+		__m256i const k0 = _mm256_set1_epi32(0x5A827999);
+		__m256i const k1 = _mm256_set1_epi32(0x6ED9EBA1);
+		__m256i const k2 = _mm256_set1_epi32(int(0x8F1BBCDC));
+		__m256i const k3 = _mm256_set1_epi32(int(0xCA62C1D6));
+
+		__m256i w[16];
+		for (u32 n = 0; n < max_blocks; ++n)
+		{
+			u8 const* blk[8];
+			for (int l = 0; l < 8; ++l)
+			{
+				if (n < full[l]) blk[l] = data[l] + n * 64;
+				else if (n < total[l]) blk[l] = tail[l].buf + (n - full[l]) * 64;
+				else blk[l] = zero_block;
+			}
+
+			for (int t = 0; t < 16; ++t)
+			{
+				w[t] = _mm256_setr_epi32(int(load_be32(blk[0] + t * 4))
+					, int(load_be32(blk[1] + t * 4)), int(load_be32(blk[2] + t * 4))
+					, int(load_be32(blk[3] + t * 4)), int(load_be32(blk[4] + t * 4))
+					, int(load_be32(blk[5] + t * 4)), int(load_be32(blk[6] + t * 4))
+					, int(load_be32(blk[7] + t * 4)));
+			}
+
+			__m256i a = h0;
+			__m256i b = h1;
+			__m256i c = h2;
+			__m256i d = h3;
+			__m256i e = h4;
+			for (int t = 0; t < 20; ++t)
+				MB_ROUND(t, _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d))), k0)
+			for (int t = 20; t < 40; ++t)
+				MB_ROUND(t, _mm256_xor_si256(_mm256_xor_si256(b, c), d), k1)
+			for (int t = 40; t < 60; ++t)
+				MB_ROUND(t, _mm256_or_si256(_mm256_and_si256(b, c)
+					, _mm256_and_si256(d, _mm256_or_si256(b, c))), k2)
+			for (int t = 60; t < 80; ++t)
+				MB_ROUND(t, _mm256_xor_si256(_mm256_xor_si256(b, c), d), k3)
+
+			// only the lanes that still have blocks left are updated
+			__m256i const active = _mm256_cmpgt_epi32(total_blocks
+				, _mm256_set1_epi32(int(n)));
+			h0 = _mm256_blendv_epi8(h0, _mm256_add_epi32(h0, a), active);
+			h1 = _mm256_blendv_epi8(h1, _mm256_add_epi32(h1, b), active);
+			h2 = _mm256_blendv_epi8(h2, _mm256_add_epi32(h2, c), active);
+			h3 = _mm256_blendv_epi8(h3, _mm256_add_epi32(h3, d), active);
+			h4 = _mm256_blendv_epi8(h4, _mm256_add_epi32(h4, e), active);
+		}
+
+		u32 state[5][8];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state[0]), h0);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state[1]), h1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state[2]), h2);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state[3]), h3);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state[4]), h4);
+
+		for (int l = 0; l < num; ++l)
+		{
+			u8* digest = digests + l * 20;
+			for (int i = 0; i < 20; ++i)
+				digest[i] = u8(state[i >> 2][l] >> ((3 - (i & 3)) * 8));
+		}
+	}
+
+#undef MB_ROUND
+#undef MB_SCHEDULE
+#undef MB_ROL
+
+#endif // TORRENT_HAS_AVX2
+
 #if !defined BOOST_BIG_ENDIAN && !defined BOOST_LITTLE_ENDIAN
 	bool is_big_endian()
 	{
@@ -234,6 +508,38 @@ void SHA1_final(u8* digest, sha_ctx* context)
 	}
 }
 
+// Hash a number of independent messages, storing the 20 byte digests
+// back-to-back in ``digests``.
+
+void SHA1_multi(u8 const* const* data, u32 const* len, u8* digests, int num)
+{
+#if TORRENT_HAS_AVX2
+	// 8 lanes of AVX2 outperform the SHA extensions on a single stream, see
+	// test/hasher_benchmark.cpp. A single message left over is cheaper to
+	// hash on its own though
+	if (aux::avx2_support)
+	{
+		while (num > 1)
+		{
+			int const lanes = (std::min)(num, 8);
+			SHA1_multi_avx2(data, len, digests, lanes);
+			data += lanes;
+			len += lanes;
+			digests += lanes * 20;
+			num -= lanes;
+		}
+	}
+#endif
+
+	for (int i = 0; i < num; ++i)
+	{
+		sha_ctx ctx;
+		SHA1_init(&ctx);
+		SHA1_update(&ctx, data[i], len[i]);
+		SHA1_final(digests + i * 20, &ctx);
+	}
+}
+
 } // libtorrent namespace
 
 /************************************************************
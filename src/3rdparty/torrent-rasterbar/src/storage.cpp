@@ -405,7 +405,9 @@ namespace libtorrent
 		: m_files(*params.files)
 		, m_use_part_file(true)
 		, m_pool(*params.pool)
-		, m_allocate_files(params.mode == storage_mode_allocate)
+		, m_allocate_files(params.mode == storage_mode_allocate
+			|| params.mode == storage_mode_fast_allocate)
+		, m_fast_allocate(params.mode == storage_mode_fast_allocate)
 	{
 		if (params.mapped_files) m_mapped_files.reset(new file_storage(*params.mapped_files));
 		if (params.priorities) m_file_priority = *params.priorities;
@@ -1410,6 +1412,49 @@ namespace libtorrent
 		return readwritev(files(), bufs, piece, offset, num_bufs, op, ec);
 	}
 
+	bool default_storage::map_file_ranges(int piece, int offset, int size
+		, int flags, std::vector<file_range>& ranges, storage_error& ec)
+	{
+		TORRENT_ASSERT(piece >= 0);
+		TORRENT_ASSERT(piece < files().num_pieces());
+		TORRENT_ASSERT(offset >= 0);
+		TORRENT_ASSERT(size > 0);
+
+		// with the OS cache disabled, files are opened for unbuffered I/O,
+		// which can't be used as the source of a sendfile()
+		if (m_settings && settings().get_int(settings_pack::disk_io_write_mode)
+			== settings_pack::disable_os_cache)
+			return false;
+
+		std::vector<file_slice> const slices = files().map_block(piece, offset, size);
+		for (std::vector<file_slice>::const_iterator i = slices.begin()
+			, end(slices.end()); i != end; ++i)
+		{
+			// pad files and pieces that belong to files we're not downloading
+			// (which live in the part file) are not stored verbatim on disk
+			if (files().pad_file_at(i->file_index)) return false;
+			if (i->file_index < int(m_file_priority.size())
+				&& m_file_priority[i->file_index] == 0
+				&& m_use_part_file)
+				return false;
+
+			file_handle handle = open_file(i->file_index
+				, file::read_only | flags, ec);
+			if (ec) return false;
+
+			file_range r;
+			r.handle = handle;
+			r.offset =
+#ifndef TORRENT_NO_DEPRECATE
+				files().file_base_deprecated(i->file_index) +
+#endif
+				i->offset;
+			r.size = int(i->size);
+			ranges.push_back(r);
+		}
+		return true;
+	}
+
 	// much of what needs to be done when reading and writing is buffer
 	// management and piece to file mapping. Most of that is the same for reading
 	// and writing. This function is a template, and the fileop decides what to
@@ -1593,6 +1638,7 @@ namespace libtorrent
 		if (lock_files) mode |= file::lock_file;
 
 		if (!m_allocate_files) mode |= file::sparse;
+		else if (m_fast_allocate) mode |= file::fast_allocate;
 
 		// files with priority 0 should always be sparse
 		if (int(m_file_priority.size()) > file && m_file_priority[file] == 0)
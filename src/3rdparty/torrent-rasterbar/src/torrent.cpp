@@ -840,7 +840,8 @@ namespace libtorrent
 			int pos;
 			error_code ec;
 			if (bdecode(&m_resume_data->buf[0], &m_resume_data->buf[0]
-					+ m_resume_data->buf.size(), m_resume_data->node, ec, &pos) != 0)
+					+ m_resume_data->buf.size(), m_resume_data->node, ec, &pos, 100
+					, torrent_file_token_limit) != 0)
 			{
 				m_resume_data.reset();
 #ifndef TORRENT_DISABLE_LOGGING
@@ -1170,6 +1171,7 @@ namespace libtorrent
 			{
 				(*i)->last_connected = 0;
 			}
+			m_peer_list->update_candidate_keys();
 
 			// send_block_requests on all peers
 			for (peer_iterator i = m_connections.begin()
@@ -2016,6 +2018,12 @@ namespace libtorrent
 			update_gauge();
 			update_state_list();
 		}
+		else if (!has_picker() && resumes_as_seed())
+		{
+			// don't allocate a piece picker only to drop it again once the
+			// resume data has been checked. If it's rejected,
+			// on_resume_data_checked() creates the picker then
+		}
 		else
 		{
 			need_picker();
@@ -2351,6 +2359,32 @@ namespace libtorrent
 		return 0;
 	}
 
+	bool torrent::resumes_as_seed() const
+	{
+		if (!m_resume_data || m_resume_data->node.type() != bdecode_node::dict_t)
+			return false;
+
+		if (settings().get_int(settings_pack::suggest_mode) == settings_pack::suggest_read_cache)
+			return false;
+
+		bdecode_node pieces = m_resume_data->node.dict_find_string("pieces");
+		if (!pieces || pieces.string_length() != m_torrent_file->num_pieces())
+			return false;
+
+		char const* pieces_str = pieces.string_ptr();
+		for (int i = 0, end(pieces.string_length()); i < end; ++i)
+			if ((pieces_str[i] & 1) == 0) return false;
+
+		bdecode_node unfinished = m_resume_data->node.dict_find_list("unfinished");
+		if (unfinished && unfinished.list_size() > 0) return false;
+
+		file_storage const& fs = m_torrent_file->files();
+		for (int i = 0; i < fs.num_files(); ++i)
+			if (fs.pad_file_at(i) && fs.file_size(i) > 0) return false;
+
+		return true;
+	}
+
 	void torrent::on_resume_data_checked(disk_io_job const* j)
 	{
 		// hold a reference until this function returns
@@ -2528,13 +2562,25 @@ namespace libtorrent
 				if (pieces && pieces.type() == bdecode_node::string_t
 					&& int(pieces.string_length()) == m_torrent_file->num_pieces())
 				{
+					// a seed goes straight to having all pieces, without
+					// filling in a piece picker first
+					if (!has_picker() && resumes_as_seed())
+					{
+						m_have_all = true;
+						update_gauge();
+						update_state_list();
+					}
+
 					char const* pieces_str = pieces.string_ptr();
 					for (int i = 0, end(pieces.string_length()); i < end; ++i)
 					{
 						if (pieces_str[i] & 1)
 						{
-							need_picker();
-							m_picker->we_have(i);
+							if (!m_have_all)
+							{
+								need_picker();
+								m_picker->we_have(i);
+							}
 							inc_stats_counter(counters::num_piece_passed);
 							update_gauge();
 							we_have(i);
@@ -2614,10 +2660,15 @@ namespace libtorrent
 				}
 			}
 
+			// init() may have left the picker to be created here
+			if (!m_have_all) need_picker();
+
 			files_checked();
 		}
 		else
 		{
+			if (!m_have_all) need_picker();
+
 			// either the fastresume data was rejected or there are
 			// some files
 			set_state(torrent_status::checking_files);
@@ -2740,17 +2791,18 @@ namespace {
 		}
 	}
 
+	namespace {
+
+	// the largest number of consecutive pieces read and hashed by a single
+	// check job
+	int const max_check_extent = 8;
+
+	}
+
 	void torrent::start_checking()
 	{
 		TORRENT_ASSERT(should_check_files());
 
-		int num_outstanding = settings().get_int(settings_pack::checking_mem_usage) * block_size()
-			/ m_torrent_file->piece_length();
-		// if we only keep a single read operation in-flight at a time, we suffer
-		// significant performance degradation. Always keep at least two jobs
-		// outstanding
-		if (num_outstanding < 2) num_outstanding = 2;
-
 		// we might already have some outstanding jobs, if we were paused and
 		// resumed quickly, before the outstanding jobs completed
 		if (m_checking_piece >= m_torrent_file->num_pieces())
@@ -2762,10 +2814,6 @@ namespace {
 			return;
 		}
 
-		// subtract the number of pieces we already have outstanding
-		num_outstanding -= (m_checking_piece - m_num_checked_pieces);
-		if (num_outstanding < 0) num_outstanding = 0;
-
 		if (!need_loaded())
 		{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -2774,23 +2822,57 @@ namespace {
 			return;
 		}
 
-		for (int i = 0; i < num_outstanding; ++i)
+		issue_check_jobs();
+	}
+
+	// issues check jobs for the pieces following m_checking_piece, until the
+	// checking_mem_usage budget is used up by outstanding jobs. Each job reads
+	// a run of up to max_check_extent pieces in one go. The budget is split
+	// so that there are at least two jobs per disk thread in flight, to keep
+	// all of them busy and have the next extent being read while the previous
+	// one is hashed
+	void torrent::issue_check_jobs()
+	{
+		int const num_pieces = m_torrent_file->num_pieces();
+		int const piece_length = m_torrent_file->piece_length();
+		int const num_threads = (std::max)(1
+			, settings().get_int(settings_pack::aio_threads));
+		boost::int64_t const mem_budget = boost::int64_t(block_size())
+			* settings().get_int(settings_pack::checking_mem_usage);
+
+		int pieces_per_job = int(mem_budget / (boost::int64_t(piece_length) * num_threads * 2));
+		if (pieces_per_job > max_check_extent) pieces_per_job = max_check_extent;
+		if (pieces_per_job < 1) pieces_per_job = 1;
+
+		// if we only keep a single read operation in-flight at a time, we suffer
+		// significant performance degradation. Always keep at least two jobs
+		// outstanding
+		int max_outstanding = int(mem_budget / piece_length);
+		if (max_outstanding < pieces_per_job * 2) max_outstanding = pieces_per_job * 2;
+
+		while (m_checking_piece < num_pieces
+			&& m_checking_piece - m_num_checked_pieces + pieces_per_job <= max_outstanding)
 		{
-			inc_refcount("start_checking");
-			m_ses.disk_thread().async_hash(m_storage.get(), m_checking_piece++
-				, disk_io_job::sequential_access | disk_io_job::volatile_read
-				, boost::bind(&torrent::on_piece_hashed
-					, shared_from_this(), _1), reinterpret_cast<void*>(1));
-			if (m_checking_piece >= m_torrent_file->num_pieces()) break;
+			int const n = (std::min)(pieces_per_job, num_pieces - m_checking_piece);
+			issue_check_job(m_checking_piece, n);
+			m_checking_piece += n;
 		}
 #ifndef TORRENT_DISABLE_LOGGING
-		debug_log("start_checking, m_checking_piece: %d", m_checking_piece);
+		debug_log("issue_check_jobs, m_checking_piece: %d", m_checking_piece);
 #endif
 	}
 
+	void torrent::issue_check_job(int const piece, int const num_pieces)
+	{
+		inc_refcount("start_checking");
+		m_ses.disk_thread().async_check_pieces(m_storage.get(), piece, num_pieces
+			, disk_io_job::sequential_access | disk_io_job::volatile_read
+			, boost::bind(&torrent::on_pieces_checked, shared_from_this(), _1));
+	}
+
 	// This is only used for checking of torrents. i.e. force-recheck or initial checking
 	// of existing files
-	void torrent::on_piece_hashed(disk_io_job const* j)
+	void torrent::on_pieces_checked(disk_io_job const* j)
 	{
 		// hold a reference until this function returns
 		torrent_ref_holder h(this, "start_checking");
@@ -2807,7 +2889,7 @@ namespace {
 			m_checking_piece = 0;
 			m_num_checked_pieces = 0;
 #ifndef TORRENT_DISABLE_LOGGING
-			debug_log("on_piece_hashed, disk_check_aborted");
+			debug_log("on_pieces_checked, disk_check_aborted");
 #endif
 			pause();
 			return;
@@ -2815,10 +2897,20 @@ namespace {
 
 		state_updated();
 
-		++m_num_checked_pieces;
+		int const first = j->piece;
+		int const job_end = first + j->d.check.num_pieces;
+		int const num_hashed = j->ret < 0 ? j->d.check.num_hashed : j->d.check.num_pieces;
+
+		m_num_checked_pieces += num_hashed;
+
+		// if the job failed in the middle of its extent, and the rest of it
+		// lies beyond the file that failed, this is the first piece that
+		// still needs to be checked
+		int resume_piece = job_end;
 
 		if (j->ret < 0)
 		{
+			int const failed = first + num_hashed;
 			if (j->error.ec == boost::system::errc::no_such_file_or_directory
 				|| j->error.ec == boost::asio::error::eof
 #ifdef TORRENT_WINDOWS
@@ -2828,11 +2920,18 @@ namespace {
 			{
 				TORRENT_ASSERT(j->error.file >= 0);
 
-				// skip this file by updating m_checking_piece to the first piece following it
+				// skip this file by moving on to the first piece following it
 				file_storage const& st = m_torrent_file->files();
 				boost::uint64_t file_size = st.file_size(j->error.file);
-				int last = st.map_file(j->error.file, file_size, 0).piece;
-				if (m_checking_piece < last)
+				int const last = (std::max)(failed + 1
+					, st.map_file(j->error.file, file_size, 0).piece);
+				m_num_checked_pieces += (std::min)(last, job_end) - failed;
+
+				if (last < job_end)
+				{
+					resume_piece = last;
+				}
+				else if (m_checking_piece < last)
 				{
 					int diff = last - m_checking_piece;
 					m_num_checked_pieces += diff;
@@ -2848,7 +2947,7 @@ namespace {
 						resolve_filename(j->error.file), j->error.operation_str(), get_handle());
 
 #ifndef TORRENT_DISABLE_LOGGING
-				debug_log("on_piece_hashed, fatal disk error: (%d) %s", j->error.ec.value(), j->error.ec.message().c_str());
+				debug_log("on_pieces_checked, fatal disk error: (%d) %s", j->error.ec.value(), j->error.ec.message().c_str());
 #endif
 				auto_managed(false);
 				pause();
@@ -2867,32 +2966,42 @@ namespace {
 		if (!need_loaded())
 		{
 #ifndef TORRENT_DISABLE_LOGGING
-			debug_log("on_piece_hashed, need_loaded failed");
+			debug_log("on_pieces_checked, need_loaded failed");
 #endif
 			return;
 		}
 
-		if (settings().get_bool(settings_pack::disable_hash_checks)
-			|| sha1_hash(j->d.piece_hash) == m_torrent_file->hash_for_piece(j->piece))
+		// the remainder of this job is still outstanding, it's not affected by
+		// pausing
+		if (resume_piece < job_end)
+			issue_check_job(resume_piece, job_end - resume_piece);
+
+		bool const disable_hash_checks = settings().get_bool(settings_pack::disable_hash_checks);
+		for (int i = 0; i < num_hashed; ++i)
 		{
-			if (has_picker() || !m_have_all)
+			int const piece = first + i;
+			if (disable_hash_checks
+				|| sha1_hash(j->buffer.piece_hashes + i * 20) == m_torrent_file->hash_for_piece(piece))
 			{
-				need_picker();
-				m_picker->we_have(j->piece);
-				update_gauge();
+				if (has_picker() || !m_have_all)
+				{
+					need_picker();
+					m_picker->we_have(piece);
+					update_gauge();
+				}
+				we_have(piece);
+			}
+			else
+			{
+				// if the hash failed, remove it from the cache
+				if (m_storage)
+					m_ses.disk_thread().clear_piece(m_storage.get(), piece);
 			}
-			we_have(j->piece);
-		}
-		else
-		{
-			// if the hash failed, remove it from the cache
-			if (m_storage)
-				m_ses.disk_thread().clear_piece(m_storage.get(), j->piece);
 		}
 
 		if (m_num_checked_pieces < m_torrent_file->num_pieces())
 		{
-			// we're not done yet, issue another job
+			// we're not done yet, issue more jobs
 			if (m_checking_piece >= m_torrent_file->num_pieces())
 			{
 				// actually, we already have outstanding jobs for
@@ -2905,7 +3014,7 @@ namespace {
 			if (!should_check_files())
 			{
 #ifndef TORRENT_DISABLE_LOGGING
-				debug_log("on_piece_hashed, checking paused");
+				debug_log("on_pieces_checked, checking paused");
 #endif
 				if (m_checking_piece == m_num_checked_pieces)
 				{
@@ -2917,27 +3026,12 @@ namespace {
 				return;
 			}
 
-			if (!need_loaded())
-			{
-#ifndef TORRENT_DISABLE_LOGGING
-				debug_log("on_piece_hashed, need_loaded failed");
-#endif
-				return;
-			}
-
-			inc_refcount("start_checking");
-			m_ses.disk_thread().async_hash(m_storage.get(), m_checking_piece++
-				, disk_io_job::sequential_access | disk_io_job::volatile_read
-				, boost::bind(&torrent::on_piece_hashed
-					, shared_from_this(), _1), reinterpret_cast<void*>(1));
-#ifndef TORRENT_DISABLE_LOGGING
-			debug_log("on_piece_hashed, m_checking_piece: %d", m_checking_piece);
-#endif
+			issue_check_jobs();
 			return;
 		}
 
 #ifndef TORRENT_DISABLE_LOGGING
-		debug_log("on_piece_hashed, completed");
+		debug_log("on_pieces_checked, completed");
 #endif
 		if (m_auto_managed)
 		{
@@ -7739,6 +7833,7 @@ namespace {
 		if (m_abort) return false;
 
 		peerinfo->last_connected = m_ses.session_time();
+		if (m_peer_list) m_peer_list->update_candidate(peerinfo);
 #if TORRENT_USE_ASSERTS
 		if (!settings().get_bool(settings_pack::allow_multiple_connections_per_ip))
 		{
@@ -7952,7 +8047,8 @@ namespace {
 
 		bdecode_node metadata;
 		error_code ec;
-		int ret = bdecode(metadata_buf, metadata_buf + metadata_size, metadata, ec);
+		int ret = bdecode(metadata_buf, metadata_buf + metadata_size, metadata, ec
+			, NULL, 100, torrent_file_token_limit);
 		if (ret != 0 || !m_torrent_file->parse_info_section(metadata, ec, 0))
 		{
 			update_gauge();
@@ -9614,6 +9710,7 @@ namespace {
 					= clamped_subtract(pe->last_optimistically_unchoked, seconds);
 				pe->last_connected = clamped_subtract(pe->last_connected, seconds);
 			}
+			m_peer_list->update_candidate_keys();
 		}
 
 		// m_active_time, m_seeding_time and m_finished_time are absolute cunters
@@ -735,7 +735,8 @@ namespace libtorrent
 		TORRENT_UNUSED(flags);
 		std::pair<char const*, int> buf = torrent_file.data_section();
 		bdecode_node e;
-		if (bdecode(buf.first, buf.first + buf.second, e, ec) != 0)
+		if (bdecode(buf.first, buf.first + buf.second, e, ec
+			, NULL, 100, torrent_file_token_limit) != 0)
 			return;
 		parse_torrent_file(e, ec, 0);
 	}
@@ -753,7 +754,8 @@ namespace libtorrent
 		std::pair<char const*, int> buf = torrent_file.data_section();
 		bdecode_node e;
 		error_code ec;
-		if (bdecode(buf.first, buf.first + buf.second, e, ec) != 0)
+		if (bdecode(buf.first, buf.first + buf.second, e, ec
+			, NULL, 100, torrent_file_token_limit) != 0)
 		{
 #ifndef BOOST_NO_EXCEPTIONS
 			throw invalid_torrent_file(ec);
@@ -785,7 +787,8 @@ namespace libtorrent
 
 		bdecode_node e;
 		error_code ec;
-		if (tmp.size() == 0 || bdecode(&tmp[0], &tmp[0] + tmp.size(), e, ec) != 0)
+		if (tmp.size() == 0 || bdecode(&tmp[0], &tmp[0] + tmp.size(), e, ec
+			, NULL, 100, torrent_file_token_limit) != 0)
 		{
 #ifndef BOOST_NO_EXCEPTIONS
 			throw invalid_torrent_file(ec);
@@ -831,7 +834,8 @@ namespace libtorrent
 	{
 		error_code ec;
 		bdecode_node e;
-		if (bdecode(buffer, buffer + size, e, ec) != 0)
+		if (bdecode(buffer, buffer + size, e, ec, NULL, 100
+			, torrent_file_token_limit) != 0)
 			throw invalid_torrent_file(ec);
 
 		if (!parse_torrent_file(e, ec, flags))
@@ -855,7 +859,8 @@ namespace libtorrent
 		if (ret < 0) throw invalid_torrent_file(ec);
 
 		bdecode_node e;
-		if (buf.size() == 0 || bdecode(&buf[0], &buf[0] + buf.size(), e, ec) != 0)
+		if (buf.size() == 0 || bdecode(&buf[0], &buf[0] + buf.size(), e, ec
+			, NULL, 100, torrent_file_token_limit) != 0)
 			throw invalid_torrent_file(ec);
 
 		if (!parse_torrent_file(e, ec, flags))
@@ -883,7 +888,8 @@ namespace libtorrent
 		if (ret < 0) throw invalid_torrent_file(ec);
 
 		bdecode_node e;
-		if (buf.size() == 0 || bdecode(&buf[0], &buf[0] + buf.size(), e, ec) != 0)
+		if (buf.size() == 0 || bdecode(&buf[0], &buf[0] + buf.size(), e, ec
+			, NULL, 100, torrent_file_token_limit) != 0)
 			throw invalid_torrent_file(ec);
 
 		if (!parse_torrent_file(e, ec, flags))
@@ -927,7 +933,8 @@ namespace libtorrent
 		, m_i2p(false)
 	{
 		bdecode_node e;
-		if (bdecode(buffer, buffer + size, e, ec) != 0)
+		if (bdecode(buffer, buffer + size, e, ec, NULL, 100
+			, torrent_file_token_limit) != 0)
 			return;
 		parse_torrent_file(e, ec, flags);
 
@@ -948,7 +955,8 @@ namespace libtorrent
 		if (ret < 0) return;
 
 		bdecode_node e;
-		if (buf.size() == 0 || bdecode(&buf[0], &buf[0] + buf.size(), e, ec) != 0)
+		if (buf.size() == 0 || bdecode(&buf[0], &buf[0] + buf.size(), e, ec
+			, NULL, 100, torrent_file_token_limit) != 0)
 			return;
 		parse_torrent_file(e, ec, flags);
 
@@ -974,7 +982,8 @@ namespace libtorrent
 		if (ret < 0) return;
 
 		bdecode_node e;
-		if (buf.size() == 0 || bdecode(&buf[0], &buf[0] + buf.size(), e, ec) != 0)
+		if (buf.size() == 0 || bdecode(&buf[0], &buf[0] + buf.size(), e, ec
+			, NULL, 100, torrent_file_token_limit) != 0)
 			return;
 		parse_torrent_file(e, ec, flags);
 
@@ -1006,7 +1015,8 @@ namespace libtorrent
 	void torrent_info::load(char const* buffer, int size, error_code& ec)
 	{
 		bdecode_node e;
-		if (bdecode(buffer, buffer + size, e, ec) != 0)
+		if (bdecode(buffer, buffer + size, e, ec, NULL, 100
+			, torrent_file_token_limit) != 0)
 			return;
 
 		if (!parse_torrent_file(e, ec, 0))
@@ -1089,7 +1099,8 @@ namespace libtorrent
 		{
 			error_code ec;
 			bdecode(m_info_section.get(), m_info_section.get()
-				+ m_info_section_size, m_info_dict, ec);
+				+ m_info_section_size, m_info_dict, ec, NULL, 100
+				, torrent_file_token_limit);
 			if (ec) return "";
 		}
 		if (m_info_dict.type() != bdecode_node::dict_t) return "";
@@ -1338,7 +1349,8 @@ namespace libtorrent
 		{
 			error_code ec;
 			bdecode(m_info_section.get(), m_info_section.get()
-				+ m_info_section_size, m_info_dict, ec);
+				+ m_info_section_size, m_info_dict, ec, NULL, 100
+				, torrent_file_token_limit);
 			if (ec) return bdecode_node();
 		}
 		return m_info_dict.dict_find(key);
@@ -1679,7 +1691,8 @@ namespace libtorrent
 		if (le.type() == lazy_entry::none_t) return false;
 		std::pair<char const*, int> buf = le.data_section();
 		bdecode_node e;
-		if (bdecode(buf.first, buf.first + buf.second, e, ec) != 0)
+		if (bdecode(buf.first, buf.first + buf.second, e, ec
+			, NULL, 100, torrent_file_token_limit) != 0)
 			return false;
 
 		return parse_info_section(e, ec, flags);
@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <vector>
 #include <cctype>
+#include <algorithm>
 
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
@@ -57,7 +58,9 @@ namespace
 	enum
 	{
 		minimum_tracker_response_length = 3,
-		http_buffer_size = 2048
+		http_buffer_size = 2048,
+		// how long scrapes to a UDP tracker are collected before they're sent
+		udp_scrape_batch_ms = 200
 	};
 }
 
@@ -202,7 +205,8 @@ namespace libtorrent
 
 	// TODO: 2 some of these arguments could probably be moved to the
 	// tracker request itself. like the ip_filter and settings
-	tracker_manager::tracker_manager(class udp_socket& sock
+	tracker_manager::tracker_manager(io_service& ios
+		, class udp_socket& sock
 		, counters& stats_counters
 		, resolver_interface& resolver
 		, aux::session_settings const& sett
@@ -210,7 +214,9 @@ namespace libtorrent
 		, aux::session_logger& ses
 #endif
 		)
-		: m_udp_socket(sock)
+		: m_udp_scrape_timer(ios)
+		, m_udp_scrape_timer_active(false)
+		, m_udp_socket(sock)
 		, m_host_resolver(resolver)
 		, m_settings(sett)
 		, m_stats_counters(stats_counters)
@@ -270,6 +276,97 @@ namespace libtorrent
 		m_udp_conns[tid] = c;
 	}
 
+	bool tracker_manager::join_udp_connect(
+		boost::shared_ptr<udp_tracker_connection> const& c
+		, address const& tracker)
+	{
+		mutex_t::scoped_lock l(m_mutex);
+		udp_connects_t::iterator i = m_udp_connects.find(tracker);
+		if (i == m_udp_connects.end() || i->second.connecting == c.get())
+		{
+			m_udp_connects[tracker].connecting = c.get();
+			return false;
+		}
+		i->second.waiting.push_back(c);
+		return true;
+	}
+
+	void tracker_manager::udp_connect_finished(udp_tracker_connection const* c
+		, address const& tracker)
+	{
+		mutex_t::scoped_lock l(m_mutex);
+		udp_connects_t::iterator i = m_udp_connects.find(tracker);
+		if (i == m_udp_connects.end() || i->second.connecting != c) return;
+		std::vector<boost::shared_ptr<udp_tracker_connection> > waiting;
+		waiting.swap(i->second.waiting);
+		m_udp_connects.erase(i);
+		l.unlock();
+
+		// if the connect succeeded, they'll find the connection ID in the
+		// cache. If it didn't, the first one of them tries again
+		for (std::vector<boost::shared_ptr<udp_tracker_connection> >::iterator j
+			= waiting.begin(), end(waiting.end()); j != end; ++j)
+		{
+			if ((*j)->cancelled()) continue;
+			(*j)->get_io_service().post(boost::bind(
+				&udp_tracker_connection::start_announce, *j));
+		}
+	}
+
+	void tracker_manager::queue_udp_scrape(
+		boost::shared_ptr<udp_tracker_connection> const& c)
+	{
+		mutex_t::scoped_lock l(m_mutex);
+		std::vector<boost::shared_ptr<udp_tracker_connection> >& batch
+			= m_udp_scrapes[c->m_target];
+		batch.push_back(c);
+
+		if (m_udp_scrape_timer_active) return;
+		m_udp_scrape_timer_active = true;
+#if defined TORRENT_ASIO_DEBUGGING
+		add_outstanding_async("tracker_manager::send_udp_scrapes");
+#endif
+		error_code ec;
+		m_udp_scrape_timer.expires_from_now(milliseconds(udp_scrape_batch_ms), ec);
+		m_udp_scrape_timer.async_wait(boost::bind(
+			&tracker_manager::send_udp_scrapes, this, _1));
+	}
+
+	void tracker_manager::send_udp_scrapes(error_code const& ec)
+	{
+#if defined TORRENT_ASIO_DEBUGGING
+		complete_async("tracker_manager::send_udp_scrapes");
+#endif
+		// the tracker manager may be gone if the timer was cancelled
+		if (ec) return;
+
+		mutex_t::scoped_lock l(m_mutex);
+		m_udp_scrape_timer_active = false;
+		udp_scrapes_t scrapes;
+		scrapes.swap(m_udp_scrapes);
+		l.unlock();
+
+		for (udp_scrapes_t::iterator i = scrapes.begin(), end(scrapes.end());
+			i != end; ++i)
+		{
+			std::vector<boost::shared_ptr<udp_tracker_connection> >& conns = i->second;
+			conns.erase(std::remove_if(conns.begin(), conns.end()
+				, boost::bind(&udp_tracker_connection::cancelled, _1)), conns.end());
+
+			// the first request of each packet sends it, with its transaction
+			// ID, and hands the response out to the others
+			for (int first = 0; first < int(conns.size());
+				first += udp_tracker_connection::max_scrape_hashes)
+			{
+				int const last = (std::min)(int(conns.size())
+					, first + udp_tracker_connection::max_scrape_hashes);
+				boost::shared_ptr<udp_tracker_connection> const& c = conns[first];
+				c->m_batch.assign(conns.begin() + first + 1, conns.begin() + last);
+				c->send_udp_scrape();
+			}
+		}
+	}
+
 	void tracker_manager::queue_request(
 		io_service& ios
 		, tracker_request req
@@ -43,6 +43,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/time.hpp" // for aux::time_now()
 
 #include <stdlib.h>
+#include <algorithm>
 #include <boost/bind.hpp>
 #include <boost/array.hpp>
 #include <boost/system/system_error.hpp>
@@ -54,8 +55,37 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/debug.hpp"
 #endif
 
+#if TORRENT_USE_MMSG
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <cerrno>
+#include <cstring>
+
+// UDP_SEGMENT was added in linux 4.18, older headers don't have it. Whether
+// the running kernel supports it is checked when binding
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#endif
+
 using namespace libtorrent;
 
+#if TORRENT_USE_MMSG
+namespace {
+
+	bool supports_gso(udp::socket& s)
+	{
+		int val = 0;
+		socklen_t len = sizeof(val);
+		return ::getsockopt(s.native_handle(), SOL_UDP, UDP_SEGMENT, &val, &len) == 0;
+	}
+}
+#endif
+
 udp_socket::udp_socket(io_service& ios)
 	: m_observers_locked(false)
 	, m_ipv4_sock(ios)
@@ -85,6 +115,12 @@ udp_socket::udp_socket(io_service& ios)
 	, m_v6_write_subscribed(false)
 #endif
 	, m_v4_write_subscribed(false)
+	, m_batched_io(true)
+	, m_in_batch(false)
+	, m_v4_gso_limit(0)
+#if TORRENT_USE_IPV6
+	, m_v6_gso_limit(0)
+#endif
 {
 #if TORRENT_USE_ASSERTS
 	m_magic = 0x1337;
@@ -98,7 +134,11 @@ udp_socket::udp_socket(io_service& ios)
 
 	m_buf_size = 2048;
 	m_new_buf_size = m_buf_size;
+#if TORRENT_USE_MMSG
+	m_buf = static_cast<char*>(std::malloc(m_buf_size * recv_batch_size));
+#else
 	m_buf = static_cast<char*>(std::malloc(m_buf_size));
+#endif
 }
 
 udp_socket::~udp_socket()
@@ -220,37 +260,282 @@ void udp_socket::send(udp::endpoint const& ep, char const* p, int len
 
 	if (m_force_proxy) return;
 
+#if TORRENT_USE_MMSG
+	// packets of an earlier batch still waiting for the socket to become
+	// writable go first, or this one would overtake them
+	if (!m_in_batch && !m_send_batch.empty())
+		flush_batched();
+
+	if (m_in_batch || !m_send_batch.empty())
+	{
+		// we're handling a batch of incoming packets, hold on to this one and
+		// send it together with the other responses once the batch is done.
+		// Or the earlier packets are still stuck, queue this one behind them
+		queue_batched(ep, p, len, ec);
+		return;
+	}
+#endif
+
 #if TORRENT_USE_IPV6
-	if (ep.address().is_v6() && m_ipv6_sock.is_open())
-		m_ipv6_sock.send_to(boost::asio::buffer(p, len), ep, 0, ec);
-	else
+	udp::socket* s = ep.address().is_v6() && m_ipv6_sock.is_open()
+		? &m_ipv6_sock : &m_ipv4_sock;
+#else
+	udp::socket* s = &m_ipv4_sock;
 #endif
-		m_ipv4_sock.send_to(boost::asio::buffer(p, len), ep, 0, ec);
+	s->send_to(boost::asio::buffer(p, len), ep, 0, ec);
 
 	if (ec == error::would_block || ec == error::try_again)
-	{
+		subscribe_writable(s);
+}
+
+void udp_socket::subscribe_writable(udp::socket* s)
+{
 #if TORRENT_USE_IPV6
-		if (ep.address().is_v6() && m_ipv6_sock.is_open())
+	if (s == &m_ipv6_sock)
+	{
+		if (!m_v6_write_subscribed)
 		{
-			if (!m_v6_write_subscribed)
+			m_ipv6_sock.async_send(null_buffers()
+				, boost::bind(&udp_socket::on_writable, this, _1, &m_ipv6_sock));
+			m_v6_write_subscribed = true;
+		}
+	}
+	else
+#endif
+	{
+		TORRENT_ASSERT(s == &m_ipv4_sock);
+		if (!m_v4_write_subscribed)
+		{
+			m_ipv4_sock.async_send(null_buffers()
+				, boost::bind(&udp_socket::on_writable, this, _1, &m_ipv4_sock));
+			m_v4_write_subscribed = true;
+		}
+	}
+}
+
+void udp_socket::set_batched_io(bool b)
+{
+#if TORRENT_USE_MMSG
+	TORRENT_ASSERT(!m_in_batch);
+	m_batched_io = b;
+#else
+	TORRENT_UNUSED(b);
+#endif
+}
+
+#if TORRENT_USE_MMSG
+void udp_socket::read_batched(udp::socket* s)
+{
+	mmsghdr msgs[recv_batch_size];
+	iovec iov[recv_batch_size];
+	sockaddr_storage addrs[recv_batch_size];
+
+	m_in_batch = true;
+	for (;;)
+	{
+		for (int i = 0; i < recv_batch_size; ++i)
+		{
+			iov[i].iov_base = m_buf + i * m_buf_size;
+			iov[i].iov_len = m_buf_size;
+			std::memset(&msgs[i], 0, sizeof(msgs[i]));
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int const num = ::recvmmsg(s->native_handle(), msgs, recv_batch_size
+			, MSG_DONTWAIT, NULL);
+		if (num < 0)
+		{
+			error_code err(errno, system_category());
+			if (err == boost::asio::error::would_block || err == boost::asio::error::try_again) break;
+			on_read_impl(udp::endpoint(), err, NULL, 0);
+
+			if (err == boost::asio::error::not_connected || err == boost::asio::error::bad_descriptor)
 			{
-				m_ipv6_sock.async_send(null_buffers()
-					, boost::bind(&udp_socket::on_writable, this, _1, &m_ipv6_sock));
-				m_v6_write_subscribed = true;
+				m_in_batch = false;
+				m_send_batch.clear();
+				m_send_buf.clear();
+				udp::endpoint ep = s->local_endpoint(err);
+				if (!err) bind(ep, err);
+				return;
 			}
+			continue;
 		}
-		else
+
+		for (int i = 0; i < num; ++i)
+		{
+			udp::endpoint ep;
+			std::size_t const addr_len = msgs[i].msg_hdr.msg_namelen;
+			if (addr_len > ep.capacity()) continue;
+			std::memcpy(ep.data(), &addrs[i], addr_len);
+			ep.resize(addr_len);
+			on_read_impl(ep, error_code(), m_buf + i * m_buf_size, msgs[i].msg_len);
+		}
+
+		// a short batch means the socket is drained, don't spend another
+		// system call to find out
+		if (num < recv_batch_size) break;
+	}
+
+	call_drained_handler();
+	m_in_batch = false;
+	flush_batched();
+	if (m_new_buf_size != m_buf_size)
+		set_buf_size(m_new_buf_size);
+	setup_read(s);
+}
+
+void udp_socket::queue_batched(udp::endpoint const& ep, char const* p, int len
+	, error_code& ec)
+{
+	if (int(m_send_batch.size()) >= send_batch_size)
+	{
+		flush_batched();
+		if (!m_send_batch.empty())
+		{
+			// the socket still isn't writable. We've subscribed to be told
+			// when it is
+			ec = error_code(boost::asio::error::would_block);
+			return;
+		}
+	}
+
+	batched_packet bp;
+	bp.ep = ep;
+	bp.offset = int(m_send_buf.size());
+	bp.len = len;
+	m_send_buf.insert(m_send_buf.end(), p, p + len);
+	m_send_batch.push_back(bp);
+}
+
+void udp_socket::flush_batched()
+{
+	mmsghdr msgs[send_batch_size];
+	iovec iov[send_batch_size];
+	union
+	{
+		char buf[CMSG_SPACE(sizeof(boost::uint16_t))];
+		cmsghdr align;
+	} control[send_batch_size];
+
+	// the number of packets in each message
+	int packets[send_batch_size];
+
+	// the number of packets, from the front of m_send_batch, that have been
+	// sent or dropped
+	int sent = 0;
+	int const num_packets = int(m_send_batch.size());
+	TORRENT_ASSERT(num_packets <= send_batch_size);
+
+	while (sent < num_packets)
+	{
+#if TORRENT_USE_IPV6
+		bool const v6 = m_send_batch[sent].ep.address().is_v6() && m_ipv6_sock.is_open();
+		udp::socket& s = v6 ? m_ipv6_sock : m_ipv4_sock;
+		int const gso_limit = v6 ? m_v6_gso_limit : m_v4_gso_limit;
+#else
+		udp::socket& s = m_ipv4_sock;
+		int const gso_limit = m_v4_gso_limit;
 #endif
+
+		// build one message per destination run of packets going out the
+		// same socket
+		int num_msgs = 0;
+		int i = sent;
+		while (i < num_packets)
 		{
-			if (!m_v4_write_subscribed)
+			batched_packet const& first = m_send_batch[i];
+#if TORRENT_USE_IPV6
+			if ((first.ep.address().is_v6() && m_ipv6_sock.is_open()) != v6) break;
+#endif
+
+			int n = 1;
+			if (first.len < gso_limit)
+			{
+				// the kernel cuts the payload into segments the size of the
+				// first packet, so only the last one may be shorter
+				int total = first.len;
+				while (i + n < num_packets
+					&& m_send_batch[i + n].ep == first.ep
+					&& m_send_batch[i + n].len <= first.len
+					&& m_send_batch[i + n - 1].len == first.len
+					&& total + m_send_batch[i + n].len <= 0xffff - 100)
+				{
+					total += m_send_batch[i + n].len;
+					++n;
+				}
+			}
+
+			mmsghdr& m = msgs[num_msgs];
+			std::memset(&m, 0, sizeof(m));
+			m.msg_hdr.msg_name = const_cast<sockaddr*>(first.ep.data());
+			m.msg_hdr.msg_namelen = first.ep.size();
+			for (int k = 0; k < n; ++k)
 			{
-				m_ipv4_sock.async_send(null_buffers()
-					, boost::bind(&udp_socket::on_writable, this, _1, &m_ipv4_sock));
-				m_v4_write_subscribed = true;
+				batched_packet const& bp = m_send_batch[i + k];
+				iov[i - sent + k].iov_base = &m_send_buf[bp.offset];
+				iov[i - sent + k].iov_len = bp.len;
 			}
+			m.msg_hdr.msg_iov = &iov[i - sent];
+			m.msg_hdr.msg_iovlen = n;
+			if (n > 1)
+			{
+				m.msg_hdr.msg_control = control[num_msgs].buf;
+				m.msg_hdr.msg_controllen = sizeof(control[num_msgs].buf);
+				cmsghdr* cm = CMSG_FIRSTHDR(&m.msg_hdr);
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(boost::uint16_t));
+				boost::uint16_t const segment_size = boost::uint16_t(first.len);
+				std::memcpy(CMSG_DATA(cm), &segment_size, sizeof(segment_size));
+			}
+			packets[num_msgs] = n;
+			++num_msgs;
+			i += n;
+		}
+
+		int const ret = ::sendmmsg(s.native_handle(), msgs, num_msgs, MSG_DONTWAIT);
+
+		// when only some messages go out, the next call reports the error of
+		// the first one that didn't
+		if (ret > 0)
+		{
+			for (int k = 0; k < ret; ++k) sent += packets[k];
+			continue;
+		}
+
+		error_code const ec(errno, system_category());
+		if (ec == boost::asio::error::would_block || ec == boost::asio::error::try_again)
+		{
+			subscribe_writable(&s);
+			break;
+		}
+
+		if (packets[0] > 1 && (ec == boost::system::errc::io_error
+			|| ec == boost::system::errc::invalid_argument))
+		{
+			// the kernel knows about UDP_SEGMENT but the route or device
+			// can't take segments this large (typically they exceed its MTU).
+			// Only stop coalescing packets of this size and up on this socket
+			int const segment_size = m_send_batch[sent].len;
+#if TORRENT_USE_IPV6
+			if (v6) m_v6_gso_limit = (std::min)(m_v6_gso_limit, segment_size);
+			else
+#endif
+				m_v4_gso_limit = (std::min)(m_v4_gso_limit, segment_size);
+			continue;
 		}
+
+		// just like with a failing send_to(), the packet is dropped
+		sent += packets[0];
 	}
+
+	m_send_batch.erase(m_send_batch.begin(), m_send_batch.begin() + sent);
+	if (m_send_batch.empty()) m_send_buf.clear();
 }
+#endif // TORRENT_USE_MMSG
 
 void udp_socket::on_writable(error_code const& ec, udp::socket* s)
 {
@@ -265,6 +550,15 @@ void udp_socket::on_writable(error_code const& ec, udp::socket* s)
 
 	if (ec == boost::asio::error::operation_aborted) return;
 
+#if TORRENT_USE_MMSG
+	if (!m_send_batch.empty())
+	{
+		flush_batched();
+		// still not writable, wait for the next notification
+		if (!m_send_batch.empty()) return;
+	}
+#endif
+
 	call_writable_handler();
 }
 
@@ -321,6 +615,14 @@ void udp_socket::on_read(error_code const& ec, udp::socket* s)
 
 	CHECK_MAGIC;
 
+#if TORRENT_USE_MMSG
+	if (m_batched_io)
+	{
+		read_batched(s);
+		return;
+	}
+#endif
+
 	for (;;)
 	{
 		error_code err;
@@ -342,7 +644,7 @@ void udp_socket::on_read(error_code const& ec, udp::socket* s)
 #endif
 
 		if (err == boost::asio::error::would_block || err == boost::asio::error::try_again) break;
-		on_read_impl(ep, err, bytes_transferred);
+		on_read_impl(ep, err, m_buf, bytes_transferred);
 
 		// found on iOS, socket will be disconnected when app goes backgroud. try to reopen it.
 		if (err == boost::asio::error::not_connected || err == boost::asio::error::bad_descriptor)
@@ -470,7 +772,7 @@ void udp_socket::unsubscribe(udp_socket_observer* o)
 }
 
 void udp_socket::on_read_impl(udp::endpoint const& ep
-	, error_code const& e, std::size_t bytes_transferred)
+	, error_code const& e, char const* buf, std::size_t bytes_transferred)
 {
 	TORRENT_ASSERT(m_magic == 0x1337);
 	TORRENT_ASSERT(is_single_thread());
@@ -518,11 +820,11 @@ void udp_socket::on_read_impl(udp::endpoint const& ep
 		{
 			// if the source IP doesn't match the proxy's, ignore the packet
 			if (ep == m_udp_proxy_addr)
-				unwrap(e, m_buf, bytes_transferred);
+				unwrap(e, buf, bytes_transferred);
 		}
 		else if (!m_force_proxy) // block incoming packets that aren't coming via the proxy
 		{
-			call_handler(e, ep, m_buf, bytes_transferred);
+			call_handler(e, ep, buf, bytes_transferred);
 		}
 
 	} TORRENT_CATCH (std::exception&) {}
@@ -712,6 +1014,11 @@ void udp_socket::close()
 	m_timer.cancel();
 	m_abort = true;
 
+#if TORRENT_USE_MMSG
+	m_send_batch.clear();
+	m_send_buf.clear();
+#endif
+
 #if TORRENT_USE_ASSERTS
 	m_outstanding_when_aborted = num_outstanding();
 #endif
@@ -721,11 +1028,12 @@ void udp_socket::set_buf_size(int s)
 {
 	TORRENT_ASSERT(is_single_thread());
 
-	if (m_observers_locked)
+	if (m_observers_locked || m_in_batch)
 	{
 		// we can't actually reallocate the buffer while
-		// it's being used by the observers, we have to
-		// do that once we're done iterating over them
+		// it's being used by the observers, or while there
+		// are more packets of a batch in it, we have to
+		// do that once we're done with them
 		m_new_buf_size = s;
 		return;
 	}
@@ -733,7 +1041,11 @@ void udp_socket::set_buf_size(int s)
 	if (s == m_buf_size) return;
 
 	bool no_mem = false;
+#if TORRENT_USE_MMSG
+	char* tmp = static_cast<char*>(realloc(m_buf, s * recv_batch_size));
+#else
 	char* tmp = static_cast<char*>(realloc(m_buf, s));
+#endif
 	if (tmp != 0)
 	{
 		m_buf = tmp;
@@ -808,6 +1120,9 @@ void udp_socket::bind(udp::endpoint const& ep, error_code& ec)
 		if (ec) return;
 		m_ipv4_sock.non_blocking(true, ec);
 		if (ec) return;
+#if TORRENT_USE_MMSG
+		m_v4_gso_limit = supports_gso(m_ipv4_sock) ? 0x10000 : 0;
+#endif
 		setup_read(&m_ipv4_sock);
 	}
 
@@ -838,6 +1153,9 @@ void udp_socket::bind(udp::endpoint const& ep, error_code& ec)
 			if (ec) return;
 			m_ipv6_sock.non_blocking(true, ec);
 			if (ec) return;
+#if TORRENT_USE_MMSG
+			m_v6_gso_limit = supports_gso(m_ipv6_sock) ? 0x10000 : 0;
+#endif
 			setup_read(&m_ipv6_sock);
 		}
 		else
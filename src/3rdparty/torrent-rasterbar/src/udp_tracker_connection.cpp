@@ -137,6 +137,18 @@ namespace libtorrent
 	void udp_tracker_connection::fail(error_code const& ec, int code
 		, char const* msg, int interval, int min_interval)
 	{
+		// the scrapes we sent along with ours failed as well
+		std::vector<boost::shared_ptr<udp_tracker_connection> > batch;
+		batch.swap(m_batch);
+		for (std::vector<boost::shared_ptr<udp_tracker_connection> >::iterator i
+			= batch.begin(), end(batch.end()); i != end; ++i)
+		{
+			if (!(*i)->cancelled()) (*i)->fail(ec, code, msg, interval, min_interval);
+		}
+
+		// let the requests waiting for our connect try on their own
+		m_man.udp_connect_finished(this, m_target.address());
+
 		// m_target failed. remove it from the endpoint list
 		std::vector<tcp::endpoint>::iterator i = std::find(m_endpoints.begin()
 			, m_endpoints.end(), tcp::endpoint(m_target.address(), m_target.port()));
@@ -290,7 +302,7 @@ namespace libtorrent
 				if (0 == (tracker_req().kind & tracker_request::scrape_request))
 					send_udp_announce();
 				else if (0 != (tracker_req().kind & tracker_request::scrape_request))
-					send_udp_scrape();
+					queue_udp_scrape();
 				return;
 			}
 			// if it expired, remove it from the cache
@@ -298,6 +310,19 @@ namespace libtorrent
 		}
 		l.unlock();
 
+		// when many torrents talk to the same tracker, only one of them asks
+		// for a connection ID, the others wait for it and use the same one
+		if (m_hostname.empty()
+			&& m_man.join_udp_connect(shared_from_this(), m_target.address()))
+		{
+#ifndef TORRENT_DISABLE_LOGGING
+			boost::shared_ptr<request_callback> cb = requester();
+			if (cb) cb->debug_log("*** UDP_TRACKER [ waiting for connect in flight to: %s ]"
+				, print_endpoint(m_target).c_str());
+#endif
+			return;
+		}
+
 		send_udp_connect();
 	}
 
@@ -318,7 +343,18 @@ namespace libtorrent
 
 	void udp_tracker_connection::close()
 	{
-		error_code ec;
+		m_man.udp_connect_finished(this, m_target.address());
+
+		// we're closed before the response to our scrape arrived, the ones
+		// we sent along with it have to go out again
+		std::vector<boost::shared_ptr<udp_tracker_connection> > batch;
+		batch.swap(m_batch);
+		for (std::vector<boost::shared_ptr<udp_tracker_connection> >::iterator i
+			= batch.begin(), end(batch.end()); i != end; ++i)
+		{
+			if (!(*i)->cancelled()) m_man.queue_udp_scrape(*i);
+		}
+
 		tracker_connection::close();
 	}
 
@@ -466,11 +502,14 @@ namespace libtorrent
 		connection_cache_entry& cce = m_connection_cache[m_target.address()];
 		cce.connection_id = connection_id;
 		cce.expires = aux::time_now() + seconds(m_man.settings().get_int(settings_pack::udp_tracker_token_expiry));
+		l.unlock();
+
+		m_man.udp_connect_finished(this, m_target.address());
 
 		if (0 == (tracker_req().kind & tracker_request::scrape_request))
 			send_udp_announce();
 		else if (0 != (tracker_req().kind & tracker_request::scrape_request))
-			send_udp_scrape();
+			queue_udp_scrape();
 		return true;
 	}
 
@@ -550,32 +589,47 @@ namespace libtorrent
 		TORRENT_ASSERT(i != m_connection_cache.end());
 		if (i == m_connection_cache.end()) return;
 
-		char buf[8 + 4 + 4 + 20];
+		TORRENT_ASSERT(int(m_batch.size()) < max_scrape_hashes);
+
+		char buf[8 + 4 + 4 + 20 * max_scrape_hashes];
 		char* out = buf;
 
 		detail::write_int64(i->second.connection_id, out); // connection_id
 		detail::write_int32(action_scrape, out); // action (scrape)
 		detail::write_int32(m_transaction_id, out); // transaction_id
-		// info_hash
+		// info_hash, then the ones of the scrapes batched with ours
 		std::copy(tracker_req().info_hash.begin(), tracker_req().info_hash.end(), out);
-#if defined TORRENT_DEBUG || defined TORRENT_RELEASE_ASSERTS
 		out += 20;
-		TORRENT_ASSERT(out - buf == sizeof(buf));
+		for (std::vector<boost::shared_ptr<udp_tracker_connection> >::iterator j
+			= m_batch.begin(), end(m_batch.end()); j != end; ++j)
+		{
+			udp_tracker_connection& c = **j;
+			std::copy(c.tracker_req().info_hash.begin(), c.tracker_req().info_hash.end(), out);
+			out += 20;
+			c.m_state = action_scrape;
+			++c.m_attempts;
+		}
+		TORRENT_ASSERT(out - buf <= int(sizeof(buf)));
+
+#ifndef TORRENT_DISABLE_LOGGING
+		boost::shared_ptr<request_callback> cb = requester();
+		if (cb) cb->debug_log("==> UDP_TRACKER_SCRAPE [ to: %s info-hashes: %d ]"
+			, print_endpoint(m_target).c_str(), int(m_batch.size()) + 1);
 #endif
 
 		error_code ec;
 		if (!m_hostname.empty())
 		{
 			m_man.get_udp_socket().send_hostname(m_hostname.c_str(), m_target.port()
-				, buf, sizeof(buf), ec, udp_socket::tracker_connection);
+				, buf, out - buf, ec, udp_socket::tracker_connection);
 		}
 		else
 		{
-			m_man.get_udp_socket().send(m_target, buf, sizeof(buf), ec
+			m_man.get_udp_socket().send(m_target, buf, out - buf, ec
 				, udp_socket::tracker_connection);
 		}
 		m_state = action_scrape;
-		sent_bytes(sizeof(buf) + 28); // assuming UDP/IP header
+		sent_bytes(out - buf + 28); // assuming UDP/IP header
 		++m_attempts;
 		if (ec)
 		{
@@ -700,20 +754,57 @@ namespace libtorrent
 		int downloaded = detail::read_int32(buf);
 		int incomplete = detail::read_int32(buf);
 
-		boost::shared_ptr<request_callback> cb = requester();
-		if (!cb)
+		// the entries for the scrapes batched with ours follow, in the order
+		// we sent their info-hashes
+		std::vector<boost::shared_ptr<udp_tracker_connection> > batch;
+		batch.swap(m_batch);
+		int const entries = (size - 20) / 12;
+		for (int i = 0; i < int(batch.size()); ++i)
 		{
-			close();
-			return true;
+			udp_tracker_connection& c = *batch[i];
+			if (c.cancelled()) continue;
+			if (i >= entries)
+			{
+				c.fail(error_code(errors::invalid_tracker_response_length));
+				continue;
+			}
+			char const* entry = buf + i * 12;
+			int const c_complete = detail::read_int32(entry);
+			int const c_downloaded = detail::read_int32(entry);
+			int const c_incomplete = detail::read_int32(entry);
+			c.scrape_done(c_complete, c_downloaded, c_incomplete);
 		}
-		
-		cb->tracker_scrape_response(tracker_req()
-			, complete, incomplete, downloaded, -1);
 
-		close();
+		scrape_done(complete, downloaded, incomplete);
 		return true;
 	}
 
+	void udp_tracker_connection::scrape_done(int complete, int downloaded
+		, int incomplete)
+	{
+		boost::shared_ptr<request_callback> cb = requester();
+		if (cb)
+		{
+			cb->tracker_scrape_response(tracker_req()
+				, complete, incomplete, downloaded, -1);
+		}
+		close();
+	}
+
+	void udp_tracker_connection::queue_udp_scrape()
+	{
+		if (m_abort) return;
+
+		// with a proxy that resolves the tracker's name, we don't know which
+		// endpoint we're talking to
+		if (!m_hostname.empty())
+		{
+			send_udp_scrape();
+			return;
+		}
+		m_man.queue_udp_scrape(shared_from_this());
+	}
+
 	void udp_tracker_connection::send_udp_announce()
 	{
 		if (m_abort) return;
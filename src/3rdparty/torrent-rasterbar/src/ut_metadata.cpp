@@ -78,6 +78,17 @@ namespace libtorrent { namespace
 		// doesn't throttle its requests)
 		max_incoming_requests = 1024,
 
+		// the number of metadata blocks we keep requested from a
+		// single peer at a time
+		max_outstanding_requests = 2,
+
+		// seconds after which a request to a peer is considered slow.
+		// the block is handed to other peers, but a late reply is still
+		// accepted until request_expiry seconds have passed. Until then
+		// the request keeps occupying one of the peer's request slots
+		request_timeout = 5,
+		request_expiry = 60,
+
 		metadata_req = 0,
 		metadata_piece = 1,
 		metadata_dont_have = 2
@@ -175,6 +186,19 @@ namespace libtorrent { namespace
 				metadata();
 		}
 
+		// called when a request for a metadata block timed out, was
+		// rejected or the peer disconnected. The block can be requested
+		// from another peer right away
+		void cancel_request(int piece)
+		{
+			if (piece < 0 || piece >= int(m_requested_metadata.size())) return;
+			metadata_piece& p = m_requested_metadata[piece];
+			if (p.num_requests == 0
+				|| p.num_requests == (std::numeric_limits<int>::max)()) return;
+			--p.num_requests;
+			if (p.num_requests == 0) p.last_request = min_time();
+		}
+
 		void metadata_size(int size)
 		{
 			if (m_metadata_size > 0 || size <= 0 || size > 4 * 1024 * 1024) return;
@@ -205,8 +229,8 @@ namespace libtorrent { namespace
 			{ return num_requests < rhs.num_requests; }
 		};
 
-		// this vector keeps track of how many times each metadata
-		// block has been requested and who we ended up getting it from
+		// this vector keeps track of how many requests are outstanding for
+		// each metadata block and who we ended up getting it from.
 		// std::numeric_limits<int>::max() means we have the piece
 		std::vector<metadata_piece> m_requested_metadata;
 
@@ -403,11 +427,10 @@ namespace libtorrent { namespace
 				break;
 				case metadata_piece:
 				{
-					std::vector<int>::iterator i = std::find(m_sent_requests.begin()
-						, m_sent_requests.end(), piece);
-
-					// unwanted piece?
-					if (i == m_sent_requests.end())
+					// a reply to a slow request is still welcome, the block may
+					// not have arrived from anyone else yet
+					if (!remove_request(m_sent_requests, piece)
+						&& !remove_request(m_timed_out_requests, piece))
 					{
 #ifndef TORRENT_DISABLE_LOGGING
 						m_pc.peer_log(peer_log_alert::info, "UT_METADATA"
@@ -416,7 +439,6 @@ namespace libtorrent { namespace
 						return true;
 					}
 
-					m_sent_requests.erase(i);
 					entry const* total_size = msg.find_key("total_size");
 					m_tp.received_metadata(*this, body.begin + len, body.left() - len, piece
 						, (total_size && total_size->type() == entry::int_t) ? total_size->integer() : 0);
@@ -426,11 +448,10 @@ namespace libtorrent { namespace
 				case metadata_dont_have:
 				{
 					m_request_limit = (std::max)(aux::time_now() + minutes(1), m_request_limit);
-					std::vector<int>::iterator i = std::find(m_sent_requests.begin()
-						, m_sent_requests.end(), piece);
-					// unwanted piece?
-					if (i == m_sent_requests.end()) return true;
-					m_sent_requests.erase(i);
+					if (remove_request(m_sent_requests, piece))
+						m_tp.cancel_request(piece);
+					else
+						remove_request(m_timed_out_requests, piece);
 				}
 				break;
 			default:
@@ -443,8 +464,19 @@ namespace libtorrent { namespace
 			return true;
 		}
 
+		virtual void on_disconnect(error_code const&) TORRENT_OVERRIDE
+		{
+			// let other peers pick up the blocks we were waiting for
+			for (std::vector<sent_request>::iterator i = m_sent_requests.begin()
+				, end(m_sent_requests.end()); i != end; ++i)
+				m_tp.cancel_request(i->piece);
+			m_sent_requests.clear();
+			m_timed_out_requests.clear();
+		}
+
 		virtual void tick() TORRENT_OVERRIDE
 		{
+			expire_requests();
 			maybe_send_request();
 			while (!m_incoming_requests.empty()
 				&& m_pc.send_buffer_size() < send_buffer_limit)
@@ -463,19 +495,48 @@ namespace libtorrent { namespace
 			// supports the request metadata extension
 			// and we aren't currently waiting for a request
 			// reply. Then, send a request for some metadata.
-			if (!m_torrent.valid_metadata()
+			// requests to several peers are in flight at the same time, each
+			// for a different block, so one slow peer only holds up its own
+			// blocks until they time out
+			while (!m_torrent.valid_metadata()
 				&& m_message_index != 0
-				&& m_sent_requests.size() < 2
+				&& m_sent_requests.size() + m_timed_out_requests.size()
+					< max_outstanding_requests
 				&& has_metadata())
 			{
 				int piece = m_tp.metadata_request(m_pc.has_metadata());
 				if (piece == -1) return;
 
-				m_sent_requests.push_back(piece);
+				sent_request r = { piece, aux::time_now() };
+				m_sent_requests.push_back(r);
 				write_metadata_packet(metadata_req, piece);
 			}
 		}
 
+		// hands blocks this peer is slow to deliver over to other peers
+		void expire_requests()
+		{
+			time_point const now = aux::time_now();
+			for (int i = 0; i < int(m_timed_out_requests.size());)
+			{
+				if (now - m_timed_out_requests[i].sent < seconds(request_expiry)) { ++i; continue; }
+				m_timed_out_requests.erase(m_timed_out_requests.begin() + i);
+			}
+
+			for (int i = 0; i < int(m_sent_requests.size());)
+			{
+				sent_request const r = m_sent_requests[i];
+				if (now - r.sent < seconds(request_timeout)) { ++i; continue; }
+#ifndef TORRENT_DISABLE_LOGGING
+				m_pc.peer_log(peer_log_alert::info, "UT_METADATA"
+					, "request timed out, piece: %d", r.piece);
+#endif
+				m_sent_requests.erase(m_sent_requests.begin() + i);
+				m_timed_out_requests.push_back(r);
+				m_tp.cancel_request(r.piece);
+			}
+		}
+
 		bool has_metadata() const
 		{
 			return m_pc.has_metadata() || (aux::time_now() > m_request_limit);
@@ -488,6 +549,24 @@ namespace libtorrent { namespace
 
 	private:
 
+		struct sent_request
+		{
+			int piece;
+			time_point sent;
+		};
+
+		static bool remove_request(std::vector<sent_request>& requests, int piece)
+		{
+			for (std::vector<sent_request>::iterator i = requests.begin()
+				, end(requests.end()); i != end; ++i)
+			{
+				if (i->piece != piece) continue;
+				requests.erase(i);
+				return true;
+			}
+			return false;
+		}
+
 		// this is the message index the remote peer uses
 		// for metadata extension messages.
 		int m_message_index;
@@ -498,8 +577,10 @@ namespace libtorrent { namespace
 		// we receive metadata that fails the infohash check
 		time_point m_request_limit;
 
-		// request queues
-		std::vector<int> m_sent_requests;
+		// request queues. m_timed_out_requests are requests we stopped
+		// waiting for, but whose reply we would still take
+		std::vector<sent_request> m_sent_requests;
+		std::vector<sent_request> m_timed_out_requests;
 		std::vector<int> m_incoming_requests;
 
 		torrent& m_torrent;
@@ -525,24 +606,33 @@ namespace libtorrent { namespace
 	// from requesting this block by setting a timeout on it.
 	int ut_metadata_plugin::metadata_request(bool has_metadata)
 	{
-		std::vector<metadata_piece>::iterator i = std::min_element(
-			m_requested_metadata.begin(), m_requested_metadata.end());
-
 		if (m_requested_metadata.empty())
 		{
 			// if we don't know how many pieces there are
 			// just ask for piece 0
 			m_requested_metadata.resize(1);
-			i = m_requested_metadata.begin();
 		}
 
-		int piece = i - m_requested_metadata.begin();
-
-		// don't request the same block more than once every 3 seconds
+		// pick the block with the fewest outstanding requests. Blocks nobody
+		// is working on come first, a block already requested from a peer
+		// that has not delivered for 3 seconds is requested again, from us
 		time_point now = aux::time_now();
-		if (m_requested_metadata[piece].last_request != min_time()
-			&& total_seconds(now - m_requested_metadata[piece].last_request) < 3)
-			return -1;
+		int piece = -1;
+		for (int i = 0; i < int(m_requested_metadata.size()); ++i)
+		{
+			metadata_piece const& p = m_requested_metadata[i];
+			if (p.num_requests == (std::numeric_limits<int>::max)()) continue;
+
+			// don't request the same block more than once every 3 seconds
+			if (p.last_request != min_time()
+				&& total_seconds(now - p.last_request) < 3)
+				continue;
+
+			if (piece == -1 || p.num_requests < m_requested_metadata[piece].num_requests)
+				piece = i;
+			if (p.num_requests == 0) break;
+		}
+		if (piece == -1) return -1;
 
 		++m_requested_metadata[piece].num_requests;
 
@@ -90,6 +90,8 @@ namespace libtorrent
 			tick_utp_impl(i->second, now);
 			++i;
 		}
+
+		m_packet_pool.decay();
 	}
 
 	void utp_socket_manager::mtu_for_dest(address const& addr, int& link_mtu, int& utp_mtu)
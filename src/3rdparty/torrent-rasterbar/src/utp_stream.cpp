@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/utp_stream.hpp"
 #include "libtorrent/sliding_average.hpp"
 #include "libtorrent/utp_socket_manager.hpp"
+#include "libtorrent/packet_pool.hpp"
 #include "libtorrent/alloca.hpp"
 #include "libtorrent/timestamp_history.hpp"
 #include "libtorrent/error.hpp"
@@ -171,44 +172,6 @@ TORRENT_EXTRA_EXPORT bool compare_less_wrap(boost::uint32_t lhs
 	return dist_up < dist_down;
 }
 
-// used for out-of-order incoming packets
-// as well as sent packets that are waiting to be ACKed
-struct packet
-{
-	// the last time this packet was sent
-	time_point send_time;
-
-	// the number of bytes actually allocated in 'buf'
-	boost::uint16_t allocated;
-
-	// the size of the buffer 'buf' points to
-	boost::uint16_t size;
-
-	// this is the offset to the payload inside the buffer
-	// this is also used as a cursor to describe where the
-	// next payload that hasn't been consumed yet starts
-	boost::uint16_t header_size;
-
-	// the number of times this packet has been sent
-	boost::uint8_t num_transmissions:6;
-
-	// true if we need to send this packet again. All
-	// outstanding packets are marked as needing to be
-	// resent on timeouts
-	bool need_resend:1;
-
-	// this is set to true for packets that were
-	// sent with the DF bit set (Don't Fragment)
-	bool mtu_probe:1;
-
-#ifdef TORRENT_DEBUG
-	int num_fast_resend;
-#endif
-
-	// the actual packet buffer
-	boost::uint8_t buf[1];
-};
-
 // since the uTP socket state may be needed after the
 // utp_stream is closed, it's kept in a separate struct
 // whose lifetime is not tied to the lifetime of utp_stream
@@ -1122,7 +1085,7 @@ size_t utp_stream::read_some(bool clear_buffers)
 		// Consumed entire packet
 		if (p->header_size == p->size)
 		{
-			free(p);
+			m_impl->m_sm->release_packet(p);
 			++pop_packets;
 			*i = 0;
 			++i;
@@ -1218,23 +1181,23 @@ utp_socket_impl::~utp_socket_impl()
 		i != end; i = (i + 1) & ACK_MASK)
 	{
 		packet* p = m_inbuf.remove(i);
-		free(p);
+		m_sm->release_packet(p);
 	}
 	for (boost::uint16_t i = m_outbuf.cursor(), end((m_outbuf.cursor()
 		+ m_outbuf.capacity()) & ACK_MASK);
 		i != end; i = (i + 1) & ACK_MASK)
 	{
 		packet* p = m_outbuf.remove(i);
-		free(p);
+		m_sm->release_packet(p);
 	}
 
 	for (std::vector<packet*>::iterator i = m_receive_buffer.begin()
 		, end = m_receive_buffer.end(); i != end; ++i)
 	{
-		free(*i);
+		m_sm->release_packet(*i);
 	}
 
-	free(m_nagle_packet);
+	m_sm->release_packet(m_nagle_packet);
 	m_nagle_packet = NULL;
 }
 
@@ -1364,7 +1327,7 @@ void utp_socket_impl::send_syn()
 	m_ack_nr = 0;
 	m_fast_resend_seq_nr = m_seq_nr;
 
-	packet* p = static_cast<packet*>(malloc(sizeof(packet) + sizeof(utp_header)));
+	packet* p = m_sm->acquire_packet(sizeof(utp_header));
 	p->size = sizeof(utp_header);
 	p->header_size = sizeof(utp_header);
 	p->num_transmissions = 0;
@@ -1414,7 +1377,7 @@ void utp_socket_impl::send_syn()
 	}
 	else if (ec)
 	{
-		free(p);
+		m_sm->release_packet(p);
 		m_error = ec;
 		set_state(UTP_STATE_ERROR_WAIT);
 		test_socket_state();
@@ -1723,18 +1686,18 @@ void utp_socket_impl::remove_sack_header(packet* p)
 
 struct holder
 {
-	holder(char* buf = NULL): m_buf(buf) {}
-	~holder() { free(m_buf); }
+	holder(utp_socket_manager* sm): m_sm(sm), m_buf(NULL) {}
+	~holder() { m_sm->release_packet(m_buf); }
 
-	void reset(char* buf)
+	void reset(packet* buf)
 	{
-		free(m_buf);
+		m_sm->release_packet(m_buf);
 		m_buf = buf;
 	}
 
-	char* release()
+	packet* release()
 	{
-		char* ret = m_buf;
+		packet* ret = m_buf;
 		m_buf = NULL;
 		return ret;
 	}
@@ -1745,7 +1708,8 @@ private:
 	holder(holder const&);
 	holder& operator=(holder const&);
 
-	char* m_buf;
+	utp_socket_manager* m_sm;
+	packet* m_buf;
 };
 
 // sends a packet, pulls data from the write buffer (if there's any)
@@ -1887,7 +1851,7 @@ bool utp_socket_impl::send_pkt(int const flags)
 
 	// used to free the packet buffer in case we exit the
 	// function early
-	holder buf_holder;
+	holder buf_holder(m_sm);
 
 	// payload size being zero means we're just sending
 	// an force. We should not pick up the nagle packet
@@ -1897,9 +1861,8 @@ bool utp_socket_impl::send_pkt(int const flags)
 		// need to keep the packet around (in the outbuf)
 		if (payload_size)
 		{
-			p = static_cast<packet*>(malloc(sizeof(packet) + effective_mtu));
-			p->allocated = effective_mtu;
-			buf_holder.reset(reinterpret_cast<char*>(p));
+			p = m_sm->acquire_packet(effective_mtu);
+			buf_holder.reset(p);
 
 			m_sm->inc_stats_counter(counters::utp_payload_pkts_out);
 		}
@@ -2159,7 +2122,7 @@ bool utp_socket_impl::send_pkt(int const flags)
 		{
 			TORRENT_ASSERT(reinterpret_cast<utp_header*>(old->buf)->seq_nr == m_seq_nr);
 			if (!old->need_resend) m_bytes_in_flight -= old->size - old->header_size;
-			free(old);
+			m_sm->release_packet(old);
 		}
 		TORRENT_ASSERT(h->seq_nr == m_seq_nr);
 		m_seq_nr = (m_seq_nr + 1) & ACK_MASK;
@@ -2442,7 +2405,7 @@ void utp_socket_impl::ack_packet(packet* p, time_point const& receive_time
 
 	m_rtt.add_sample(rtt / 1000);
 	if (rtt < min_rtt) min_rtt = rtt;
-	free(p);
+	m_sm->release_packet(p);
 }
 
 void utp_socket_impl::incoming(boost::uint8_t const* buf, int size, packet* p
@@ -2482,7 +2445,7 @@ void utp_socket_impl::incoming(boost::uint8_t const* buf, int size, packet* p
 		if (size == 0)
 		{
 			TORRENT_ASSERT(p == 0 || p->header_size == p->size);
-			free(p);
+			m_sm->release_packet(p);
 			return;
 		}
 	}
@@ -2492,7 +2455,7 @@ void utp_socket_impl::incoming(boost::uint8_t const* buf, int size, packet* p
 	if (!p)
 	{
 		TORRENT_ASSERT(buf);
-		p = static_cast<packet*>(malloc(sizeof(packet) + size));
+		p = m_sm->acquire_packet(size);
 		p->size = size;
 		p->header_size = 0;
 		memcpy(p->buf, buf, size);
@@ -2628,7 +2591,7 @@ bool utp_socket_impl::consume_incoming_data(
 		}
 
 		// we don't need to save the packet header, just the payload
-		packet* p = static_cast<packet*>(malloc(sizeof(packet) + payload_size));
+		packet* p = m_sm->acquire_packet(payload_size);
 		p->size = payload_size;
 		p->header_size = 0;
 		p->num_transmissions = 0;
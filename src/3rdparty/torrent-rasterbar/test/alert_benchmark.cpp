@@ -0,0 +1,159 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/alert_manager.hpp"
+#include "libtorrent/alert_types.hpp"
+#include "libtorrent/torrent_handle.hpp"
+#include "libtorrent/thread.hpp"
+#include "libtorrent/time.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace libtorrent;
+
+// floods an alert_manager from one thread while another drains it the way
+// a client's alert loop does: wait_for_alert() followed by get_all(). With
+// a notify function installed, the number of notify calls is the number of
+// events a GUI client would post to its event loop.
+//
+// usage: alert_benchmark [alerts-per-second] [seconds] [queue-size]
+
+namespace {
+
+	struct consumer_state
+	{
+		consumer_state() : received(0), batches(0), max_batch(0), done(false) {}
+		boost::atomic<boost::int64_t> received;
+		boost::int64_t batches;
+		int max_batch;
+		boost::atomic<bool> done;
+	};
+
+	void consume(alert_manager* mgr, consumer_state* st)
+	{
+		std::vector<alert*> alerts;
+		int num_resume = 0;
+		boost::uint64_t checksum = 0;
+		for (;;)
+		{
+			bool const last = st->done;
+			mgr->wait_for_alert(milliseconds(100));
+			mgr->get_all(alerts, num_resume);
+			// touch every alert, like a dispatcher switching on the type
+			for (std::vector<alert*>::iterator i = alerts.begin()
+				, end(alerts.end()); i != end; ++i)
+				checksum += (*i)->type();
+			if (!alerts.empty())
+			{
+				++st->batches;
+				if (int(alerts.size()) > st->max_batch) st->max_batch = int(alerts.size());
+				st->received += alerts.size();
+			}
+			else if (last) break;
+		}
+		if (checksum == 1) std::printf(" ");
+	}
+
+	void count_notify(boost::atomic<int>* cnt) { ++*cnt; }
+
+	// rate 0 posts the alerts as fast as possible
+	void run(char const* name, int rate, boost::int64_t total, int queue_size)
+	{
+		alert_manager mgr(queue_size, 0xffffffff);
+		boost::atomic<int> notifications(0);
+		mgr.set_notify_function(boost::bind(&count_notify, &notifications));
+
+		consumer_state st;
+		thread consumer(boost::bind(&consume, &mgr, &st));
+
+		time_point const start = clock_type::now();
+		boost::int64_t posted = 0;
+		boost::int64_t max_post_us = 0;
+		while (posted < total)
+		{
+			time_point const now = clock_type::now();
+			boost::int64_t target = rate == 0 ? total
+				: (std::min)(total, total_microseconds(now - start) * rate / 1000000);
+			if (target <= posted)
+			{
+				sleep(1);
+				continue;
+			}
+			for (; posted < target; ++posted)
+			{
+				time_point const t0 = rate == 0 ? now : clock_type::now();
+				mgr.emplace_alert<state_changed_alert>(torrent_handle()
+					, torrent_status::downloading, torrent_status::seeding);
+				if (rate != 0)
+				{
+					boost::int64_t const us = total_microseconds(clock_type::now() - t0);
+					if (us > max_post_us) max_post_us = us;
+				}
+			}
+		}
+		time_point const posted_all = clock_type::now();
+
+		st.done = true;
+		consumer.join();
+		time_point const end = clock_type::now();
+
+		double const secs = total_microseconds(end - start) / 1000000.0;
+		std::printf("%s: posted %" PRId64 " alerts in %.2f s (%.0f alerts/s)\n"
+			, name, posted, secs, posted / secs);
+		std::printf("  received: %" PRId64 " dropped: %" PRId64 "\n"
+			, boost::int64_t(st.received), posted - st.received);
+		std::printf("  batches: %" PRId64 " average: %.1f largest: %d notify calls: %d\n"
+			, st.batches, st.batches ? double(st.received) / st.batches : 0.0
+			, st.max_batch, int(notifications));
+		std::printf("  producer: %.2f s posting, slowest emplace_alert: %" PRId64 " us\n"
+			, total_microseconds(posted_all - start) / 1000000.0, max_post_us);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int const rate = argc > 1 ? std::atoi(argv[1]) : 100000;
+	int const duration = argc > 2 ? std::atoi(argv[2]) : 5;
+	int const queue_size = argc > 3 ? std::atoi(argv[3]) : rate;
+
+	boost::int64_t const total = boost::int64_t(rate) * duration;
+
+	run("paced", rate, total, queue_size);
+	run("unpaced", 0, total, int(total));
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include "libtorrent/storage.hpp"
+#include "libtorrent/file_pool.hpp"
+#include "libtorrent/file_storage.hpp"
+#include "libtorrent/file.hpp"
+#include "libtorrent/time.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#ifndef TORRENT_WINDOWS
+#include <sys/stat.h>
+#endif
+
+using namespace libtorrent;
+
+namespace {
+
+	int const piece_size = 4 * 1024 * 1024;
+
+	// measures the time it takes from opening a fresh file for writing until
+	// the first block has been written to it, and how much of the file was
+	// allocated on disk at that point
+	void bench_mode(char const* name, storage_mode_t const mode
+		, std::string const& path, boost::int64_t const file_size)
+	{
+		std::string const filename = combine_path(path, "allocation_benchmark.tmp");
+		error_code ec;
+		remove(filename, ec);
+
+		file_storage fs;
+		fs.add_file("allocation_benchmark.tmp", file_size);
+		fs.set_piece_length(piece_size);
+		fs.set_num_pieces(int((file_size + piece_size - 1) / piece_size));
+
+		file_pool fp;
+		storage_params p;
+		p.files = &fs;
+		p.path = path;
+		p.pool = &fp;
+		p.mode = mode;
+		default_storage st(p);
+
+		std::vector<char> block(0x4000, 'x');
+		file::iovec_t b = { &block[0], block.size() };
+
+		storage_error se;
+		time_point const start = clock_type::now();
+		st.writev(&b, 1, fs.num_pieces() / 2, 0, 0, se);
+		time_point const first_byte = clock_type::now();
+
+		if (se)
+		{
+			std::fprintf(stderr, "%-15s failed: %s\n", name, se.ec.message().c_str());
+			remove(filename, ec);
+			return;
+		}
+
+		boost::int64_t allocated = -1;
+#ifndef TORRENT_WINDOWS
+		struct stat s;
+		if (::stat(filename.c_str(), &s) == 0)
+			allocated = boost::int64_t(s.st_blocks) * 512;
+#endif
+
+		std::fprintf(stderr, "%-15s time-to-first-byte: %8.2f ms  allocated: %6" PRId64 " MiB\n"
+			, name, total_microseconds(first_byte - start) / 1000.0
+			, allocated / 1024 / 1024);
+
+		fp.release();
+		remove(filename, ec);
+	}
+}
+
+// usage: allocation_benchmark [directory] [file size in MiB]
+int main(int argc, char const* argv[])
+{
+	std::string const path = argc > 1 ? argv[1] : current_working_directory();
+	boost::int64_t const file_size = boost::int64_t(argc > 2 ? std::atoi(argv[2]) : 1024)
+		* 1024 * 1024;
+
+	std::fprintf(stderr, "writing a %" PRId64 " MiB file in \"%s\"\n"
+		, file_size / 1024 / 1024, path.c_str());
+
+	bench_mode("sparse", storage_mode_sparse, path, file_size);
+	bench_mode("fast-allocate", storage_mode_fast_allocate, path, file_size);
+	bench_mode("allocate", storage_mode_allocate, path, file_size);
+
+	return 0;
+}
+
@@ -33,11 +33,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/lazy_entry.hpp"
 #include "libtorrent/bdecode.hpp"
 #include "libtorrent/bencode.hpp"
-#include "libtorrent/sha1_hash.hpp"
-#include <iostream>
-
-#include "test.hpp"
+#include "libtorrent/entry.hpp"
 #include "libtorrent/time.hpp"
+#include <boost/cstdint.hpp>
+#include <cstdio>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <algorithm>
 
 using namespace libtorrent;
 
@@ -103,79 +107,180 @@ int load_file(std::string const& filename, std::vector<char>& v
 	return 0;
 }
 
-int main(int argc, char* argv[])
+namespace {
+
+// test/bdecode_corpus, parsed when no files are given on the command line.
+// Torrent files, resume data and DHT messages as they are seen in the wild
+char const* corpus[] =
 {
-	using namespace libtorrent;
+	"bdecode_corpus/single_file.torrent",
+	"bdecode_corpus/multi_file.torrent",
+	"bdecode_corpus/multi_file.fastresume",
+	"bdecode_corpus/dht_get_peers.dat",
+	"bdecode_corpus/dht_find_node.dat",
+};
 
-	if (argc != 2)
+// a torrent with a 100k entry file list, larger than anything worth keeping
+// in the source tree
+std::vector<char> large_torrent(int const num_files)
+{
+	entry e;
+	entry& info = e["info"];
+	entry::list_type& files = info["files"].list();
+	boost::int64_t total_size = 0;
+	char name[100];
+	for (int i = 0; i < num_files; ++i)
 	{
-		fputs("usage: bdecode_benchmark torrent-file\n", stderr);
-		return 1;
+		entry f;
+		f["length"] = boost::int64_t(1000 + (i * 7919) % 5000000);
+		total_size += f["length"].integer();
+		entry::list_type& path = f["path"].list();
+		snprintf(name, sizeof(name), "dir%03d", i % 300);
+		path.push_back(std::string(name));
+		snprintf(name, sizeof(name), "file_%06d.dat", i);
+		path.push_back(std::string(name));
+		files.push_back(f);
 	}
+	int const piece_size = 4 * 1024 * 1024;
+	info["name"] = "large";
+	info["piece length"] = piece_size;
+	std::string& pieces = info["pieces"].string();
+	pieces.resize((total_size + piece_size - 1) / piece_size * 20);
+	for (int i = 0; i < int(pieces.size()); ++i) pieces[i] = char(i * 131);
+	e["announce"] = "udp://tracker.example.com:1337/announce";
 
-	std::vector<char> buf;
-	error_code ec;
-	int ret = load_file(argv[1], buf, ec, 40 * 1000000);
-	if (ret == -1)
-	{
-		fprintf(stderr, "file too big, aborting\n");
-		return 1;
-	}
+	std::vector<char> ret;
+	bencode(std::back_inserter(ret), e);
+	return ret;
+}
 
-	if (ret != 0)
-	{
-		fprintf(stderr, "failed to load file: %s\n", ec.message().c_str());
-		return 1;
-	}
+enum parser_t
+{
+	// a new node for every message, the token vector is allocated from
+	// scratch each time (like parsing a .torrent file)
+	new_node,
+	// the same node parsing one message after the other keeps its token
+	// storage (like the DHT)
+	reused_node,
+#ifndef TORRENT_NO_DEPRECATE
+	lazy,
+#endif
+	// the (slow) entry parser, for reference
+	entry_parser,
+	num_parsers
+};
 
+char const* parser_names[] =
+{
+	"bdecode (new node)",
+	"bdecode (reused node)",
+#ifndef TORRENT_NO_DEPRECATE
+	"lazy_bdecode",
+#endif
+	"bdecode (entry)",
+};
+
+// microseconds per message
+double time_parser(parser_t const p, std::vector<char> const& buf
+	, int const loops, error_code& ec)
+{
+	char const* const start = &buf[0];
+	char const* const end = start + buf.size();
+
+	bdecode_node node;
+#ifndef TORRENT_NO_DEPRECATE
+	lazy_entry le;
+#endif
+	time_point const start_time = clock_type::now();
+	for (int i = 0; i < loops; ++i)
 	{
-	time_point start(clock_type::now());
-	entry e;
-	for (int i = 0; i < 1000000; ++i)
-	{
-		int len;
-		e = bdecode(&buf[0], &buf[0] + buf.size(), len);
-//		entry& info = e["info"];
+		switch (p)
+		{
+			case new_node:
+			{
+				bdecode_node e;
+				bdecode(start, end, e, ec, NULL, 100, 10000000);
+				break;
+			}
+			case reused_node:
+				bdecode(start, end, node, ec, NULL, 100, 10000000);
+				break;
+#ifndef TORRENT_NO_DEPRECATE
+			case lazy:
+				lazy_bdecode(start, end, le, ec, NULL, 100, 10000000);
+				break;
+#endif
+			default:
+			{
+				int len;
+				entry e = bdecode(start, end, len);
+				break;
+			}
+		}
 	}
-	ptime stop(time_now_hires());
+	return double(total_microseconds(clock_type::now() - start_time)) / loops;
+}
 
-	fprintf(stderr, "(slow) bdecode done in %5d ns per message\n"
-		, int(total_microseconds(stop - start) / 1000));
-	}
+void benchmark(char const* name, std::vector<char> const& buf)
+{
+	fprintf(stderr, "%s (%d bytes)\n", name, int(buf.size()));
 
-	// ===============================================
+	// roughly the same amount of input for every file, but not too few
+	// rounds for the large ones. The best of a few rounds is reported, to
+	// filter out noise from other processes
+	int const loops = (std::max)(4, int(40000000 / buf.size()));
+	int const rounds = 5;
 
+	for (int p = 0; p < num_parsers; ++p)
 	{
-	ptime start(time_now_hires());
-	lazy_entry e;
-	for (int i = 0; i < 1000000; ++i)
-	{
+		int const parser_loops = p == entry_parser
+			? (std::max)(1, loops / 10) : loops;
+		double best = 0;
 		error_code ec;
-		lazy_bdecode(&buf[0], &buf[0] + buf.size(), e, ec);
-//		lazy_entry* info = e.dict_find("info");
-	}
-	time_point stop(clock_type::now());
-
-	fprintf(stderr, "lazy_bdecode done in   %5d ns per message\n"
-		, int(total_microseconds(stop - start) / 1000));
+		for (int r = 0; r < rounds; ++r)
+		{
+			double const us = time_parser(parser_t(p), buf, parser_loops, ec);
+			if (r == 0 || us < best) best = us;
+		}
+		if (ec)
+		{
+			fprintf(stderr, "  failed to parse: %s\n", ec.message().c_str());
+			return;
+		}
+		fprintf(stderr, "  %-22s %10.2f us  %7.1f MB/s\n", parser_names[p]
+			, best, buf.size() / best);
 	}
+}
 
-	// ===============================================
+} // anonymous namespace
 
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files(argv + 1, argv + argc);
+	if (files.empty())
 	{
-	ptime start(time_now_hires());
-	bdecode_node e;
-	e.reserve(100);
-	for (int i = 0; i < 1000000; ++i)
-	{
-		error_code ec;
-		bdecode(&buf[0], &buf[0] + buf.size(), e, ec);
-//		bdecode_node info = e.dict_find("info");
+		files.assign(corpus, corpus + sizeof(corpus) / sizeof(corpus[0]));
+		benchmark("100k files torrent (generated)", large_torrent(100000));
 	}
-	ptime stop(time_now_hires());
 
-	fprintf(stderr, "bdecode done in        %5d ns per message\n"
-		, int(total_microseconds(stop - start) / 1000));
+	std::vector<char> buf;
+	for (std::vector<std::string>::iterator i = files.begin()
+		, end(files.end()); i != end; ++i)
+	{
+		error_code ec;
+		int const ret = load_file(*i, buf, ec, 40 * 1000000);
+		if (ret == -2)
+		{
+			fprintf(stderr, "%s: file too big, skipping\n", i->c_str());
+			continue;
+		}
+		if (ret != 0 || buf.empty())
+		{
+			fprintf(stderr, "%s: failed to load file: %s\n", i->c_str()
+				, ec.message().c_str());
+			continue;
+		}
+		benchmark(i->c_str(), buf);
 	}
 
 	return 0;
@@ -0,0 +1,157 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/kademlia/dht_storage.hpp"
+#include "libtorrent/session_settings.hpp"
+#include "libtorrent/entry.hpp"
+#include "libtorrent/random.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/aux_/time.hpp"
+
+#include <boost/scoped_ptr.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace libtorrent;
+using namespace libtorrent::dht;
+
+// loads a DHT storage the way a busy node sees it: announces for a skewed
+// set of torrents (a few very popular ones, a long tail of small ones),
+// get_peers lookups and scrapes in between, and a tick() every now and then.
+// Run it once per storage, the resident memory it reports is the process'.
+//
+// usage: dht_storage_benchmark [flat|default] [torrents] [operations] [memory-limit-MiB]
+
+namespace {
+
+	sha1_hash rand_hash()
+	{
+		sha1_hash ret;
+		for (int i = 0; i < 20; ++i) ret[i] = boost::uint8_t(libtorrent::random());
+		return ret;
+	}
+
+	// in KiB, 0 where it can't be read
+	long resident_memory()
+	{
+#ifdef __linux__
+		long pages = 0;
+		long resident = 0;
+		FILE* f = std::fopen("/proc/self/statm", "r");
+		if (f == NULL) return 0;
+		if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+		std::fclose(f);
+		return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+		return 0;
+#endif
+	}
+
+	struct operation
+	{
+		int torrent;
+		int kind; // 0: announce, 1: get_peers, 2: scrape
+		tcp::endpoint peer;
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	bool const flat = argc <= 1 || std::strcmp(argv[1], "default") != 0;
+	int const num_torrents = argc > 2 ? std::atoi(argv[2]) : 100000;
+	int const num_ops = argc > 3 ? std::atoi(argv[3]) : 2000000;
+	int const memory_limit = argc > 4 ? std::atoi(argv[4]) : 64;
+
+	dht_settings sett;
+	sett.max_torrents = num_torrents;
+	sett.max_storage_memory = memory_limit * 1024 * 1024;
+
+	// generated up front, so the random number generator isn't measured
+	std::vector<sha1_hash> hashes;
+	for (int i = 0; i < num_torrents; ++i) hashes.push_back(rand_hash());
+
+	std::vector<operation> ops(num_ops);
+	for (int i = 0; i < num_ops; ++i)
+	{
+		// r^3 puts half of the operations on the first 12% of the torrents
+		double const r = double(libtorrent::random()) / 0xffffffffu;
+		ops[i].torrent = int(r * r * r * (num_torrents - 1));
+		int const k = libtorrent::random() % 64;
+		ops[i].kind = k == 0 ? 2 : k < 16 ? 1 : 0;
+		ops[i].peer = tcp::endpoint(address_v4(libtorrent::random()), boost::uint16_t(libtorrent::random()));
+	}
+
+	long const rss_before = resident_memory();
+	boost::scoped_ptr<dht_storage_interface> s(flat
+		? dht_flat_storage_constructor(sha1_hash(), sett)
+		: dht_default_storage_constructor(sha1_hash(), sett));
+
+	int found = 0;
+	time_point const start = clock_type::now();
+	for (int i = 0; i < num_ops; ++i)
+	{
+		operation const& op = ops[i];
+		if (op.kind == 0)
+		{
+			s->announce_peer(hashes[op.torrent], op.peer, "", (i & 7) == 0);
+		}
+		else
+		{
+			entry e;
+			if (s->get_peers(hashes[op.torrent], false, op.kind == 2, e)) ++found;
+		}
+
+		if ((i & 0xffff) == 0)
+		{
+			aux::update_time_now();
+			s->tick();
+		}
+	}
+	time_point const end = clock_type::now();
+
+	double const secs = total_microseconds(end - start) / 1000000.0;
+	dht_storage_counters const cnt = s->counters();
+	std::printf("%s storage: %d operations on %d torrents in %.2f s (%.0f ops/s)\n"
+		, flat ? "flat" : "default", num_ops, num_torrents, secs, num_ops / secs);
+	std::printf("  stored: %d torrents, %d peers; lookups answered: %d\n"
+		, cnt.torrents, cnt.peers, found);
+	std::printf("  resident memory: +%ld KiB (limit %d MiB, flat storage only)\n"
+		, resident_memory() - rss_before, memory_limit);
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/sha1.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/time.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace libtorrent;
+
+namespace {
+
+	int const piece_size = 4 * 1024 * 1024;
+	int const num_pieces = 8;
+	int const rounds = 8;
+
+	void print_rate(char const* name, time_point start, time_point stop)
+	{
+		double const bytes = double(piece_size) * num_pieces * rounds;
+		double const seconds = total_microseconds(stop - start) / 1000000.0;
+		std::fprintf(stderr, "%-22s %6.2f GB/s\n", name, bytes / seconds / 1e9);
+	}
+
+	void bench_single(char const* name, std::vector<char> const& buf)
+	{
+		time_point const start = clock_type::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			for (int p = 0; p < num_pieces; ++p)
+			{
+				sha_ctx ctx;
+				SHA1_init(&ctx);
+				SHA1_update(&ctx, reinterpret_cast<boost::uint8_t const*>(&buf[p * piece_size])
+					, piece_size);
+				boost::uint8_t digest[20];
+				SHA1_final(digest, &ctx);
+			}
+		}
+		print_rate(name, start, clock_type::now());
+	}
+}
+
+int main()
+{
+	std::vector<char> buf(piece_size * num_pieces);
+	for (int i = 0; i < int(buf.size()); ++i)
+		buf[i] = char(std::rand());
+
+	bool const sha = aux::sha_support;
+	bool const avx2 = aux::avx2_support;
+	std::fprintf(stderr, "SHA extensions: %s  AVX2: %s\n"
+		, sha ? "yes" : "no", avx2 ? "yes" : "no");
+
+	{
+		time_point const start = clock_type::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			for (int p = 0; p < num_pieces; ++p)
+			{
+				hasher h(&buf[p * piece_size], piece_size);
+				h.final();
+			}
+		}
+		print_rate("hasher", start, clock_type::now());
+	}
+
+	aux::sha_support = false;
+	aux::avx2_support = false;
+	bench_single("built-in (portable)", buf);
+
+	if (sha)
+	{
+		aux::sha_support = true;
+		bench_single("built-in (SHA-NI)", buf);
+		aux::sha_support = false;
+	}
+
+	if (avx2)
+	{
+		aux::avx2_support = true;
+		boost::uint8_t const* data[num_pieces];
+		boost::uint32_t len[num_pieces];
+		for (int p = 0; p < num_pieces; ++p)
+		{
+			data[p] = reinterpret_cast<boost::uint8_t const*>(&buf[p * piece_size]);
+			len[p] = piece_size;
+		}
+		boost::uint8_t digests[num_pieces * 20];
+
+		time_point const start = clock_type::now();
+		for (int r = 0; r < rounds; ++r)
+			SHA1_multi(data, len, digests, num_pieces);
+		print_rate("multi-buffer (AVX2 x8)", start, clock_type::now());
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,165 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/ip_filter.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/file.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <string>
+
+using namespace libtorrent;
+
+namespace {
+
+	boost::uint32_t random_u32()
+	{
+		return (boost::uint32_t(std::rand() & 0xffff) << 16)
+			| boost::uint32_t(std::rand() & 0xffff);
+	}
+
+	double elapsed_ms(time_point start, time_point stop)
+	{
+		return total_microseconds(stop - start) / 1000.0;
+	}
+
+	// a PeerGuardian style list of num_ranges random IPv4 ranges
+	std::vector<char> make_blocklist(int num_ranges)
+	{
+		std::vector<char> ret;
+		ret.reserve(num_ranges * 40);
+		char line[100];
+		for (int i = 0; i < num_ranges; ++i)
+		{
+			boost::uint32_t const first = random_u32();
+			boost::uint32_t last = first + (std::rand() & 0xff);
+			if (last < first) last = 0xffffffff;
+			int const len = std::snprintf(line, sizeof(line)
+				, "Range %d:%u.%u.%u.%u-%u.%u.%u.%u\n", i
+				, first >> 24, (first >> 16) & 0xff, (first >> 8) & 0xff, first & 0xff
+				, last >> 24, (last >> 16) & 0xff, (last >> 8) & 0xff, last & 0xff);
+			ret.insert(ret.end(), line, line + len);
+		}
+		return ret;
+	}
+
+	void bench_lookups(char const* name, ip_filter const& f)
+	{
+		int const num_lookups = 10000000;
+		std::vector<address_v4> addrs;
+		addrs.reserve(1024);
+		for (int i = 0; i < 1024; ++i) addrs.push_back(address_v4(random_u32()));
+
+		int blocked = 0;
+		time_point const start = clock_type::now();
+		for (int i = 0; i < num_lookups; ++i)
+			blocked += f.access(addrs[i & 1023]);
+		time_point const stop = clock_type::now();
+		std::fprintf(stderr, "%-24s %8.1f ns/lookup (%d blocked)\n", name
+			, elapsed_ms(start, stop) * 1000000.0 / num_lookups, blocked);
+	}
+}
+
+// usage: ip_filter_benchmark [number of ranges]
+int main(int argc, char* argv[])
+{
+	int const num_ranges = argc > 1 ? std::atoi(argv[1]) : 3000000;
+	std::srand(0x1337);
+
+	std::vector<char> list = make_blocklist(num_ranges);
+	std::fprintf(stderr, "blocklist: %d ranges, %d MiB\n", num_ranges
+		, int(list.size() / 1024 / 1024));
+
+	error_code ec;
+	ip_filter f;
+	{
+		time_point const start = clock_type::now();
+		parse_blocklist(&list[0], int(list.size()), f, ec);
+		time_point const parsed = clock_type::now();
+		// the rules are merged on the first query
+		f.access(address_v4());
+		time_point const stop = clock_type::now();
+		std::fprintf(stderr, "%-24s %8.1f ms (parse: %.1f ms, merge: %.1f ms)\n"
+			, "load blocklist", elapsed_ms(start, stop)
+			, elapsed_ms(start, parsed), elapsed_ms(parsed, stop));
+	}
+	std::vector<char>().swap(list);
+
+	{
+		time_point const start = clock_type::now();
+		f.save_cache("ip_filter_benchmark.cache", ec);
+		std::fprintf(stderr, "%-24s %8.1f ms\n", "save cache"
+			, elapsed_ms(start, clock_type::now()));
+		if (ec)
+		{
+			std::fprintf(stderr, "failed to save cache: %s\n", ec.message().c_str());
+			return 1;
+		}
+	}
+
+	ip_filter cached;
+	{
+		time_point const start = clock_type::now();
+		if (!cached.load_cache("ip_filter_benchmark.cache", ec))
+		{
+			std::fprintf(stderr, "failed to load cache: %s\n", ec.message().c_str());
+			return 1;
+		}
+		std::fprintf(stderr, "%-24s %8.1f ms\n", "load cache"
+			, elapsed_ms(start, clock_type::now()));
+	}
+	remove("ip_filter_benchmark.cache", ec);
+
+	bench_lookups("lookup", cached);
+
+	{
+		// the same number of rules added one at a time, querying the filter
+		// in between, is the worst case for the lazy merge. Only a sample is
+		// timed
+		ip_filter small;
+		int const num_single = 2000;
+		time_point const start = clock_type::now();
+		for (int i = 0; i < num_single; ++i)
+		{
+			boost::uint32_t const first = random_u32();
+			small.add_rule(address_v4(first), address_v4(first), ip_filter::blocked);
+			small.access(address_v4(first));
+		}
+		std::fprintf(stderr, "%-24s %8.1f us/rule (%d rules, query after each)\n"
+			, "interleaved add_rule", elapsed_ms(start, clock_type::now())
+			* 1000.0 / num_single, num_single);
+	}
+
+	return 0;
+}
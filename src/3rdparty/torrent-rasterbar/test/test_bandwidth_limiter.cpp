@@ -456,6 +456,58 @@ void test_no_starvation(int limit)
 	TEST_CHECK(close_to(p->m_quota / sample_time, limit / 200 / num_peers, 5));
 }
 
+void test_many_peers(int num_peers)
+{
+	std::cout << "\ntest many peers " << num_peers << std::endl;
+	bandwidth_manager manager(0);
+	global_bwc.throttle(0);
+
+	// the peers are split across 4 classes with different limits
+	int const num_classes = 4;
+	int const limits[num_classes] = { 1000000, 2000000, 3000000, 4000000 };
+	bandwidth_channel classes[num_classes];
+	connections_t v[num_classes];
+	connections_t all;
+	for (int c = 0; c < num_classes; ++c)
+	{
+		classes[c].throttle(limits[c]);
+		spawn_connections(v[c], manager, classes[c], num_peers / num_classes, "p");
+		std::copy(v[c].begin(), v[c].end(), std::back_inserter(all));
+	}
+
+	time_point const start = clock_type::now();
+	run_test(all, manager);
+	boost::int64_t const elapsed = total_microseconds(clock_type::now() - start);
+
+	libtorrent::aux::session_settings s;
+	int const ticks = int(sample_time * 1000 / s.get_int(settings_pack::tick_interval));
+	std::cout << "update_quotas(): " << (elapsed / ticks) << " us per tick" << std::endl;
+
+	for (int c = 0; c < num_classes; ++c)
+	{
+		float const target = float(limits[c]) / v[c].size();
+		float sum = 0.f;
+		float min_rate = limits[c];
+		float max_rate = 0.f;
+		for (connections_t::iterator i = v[c].begin()
+			, end(v[c].end()); i != end; ++i)
+		{
+			float const rate = (*i)->m_quota / sample_time;
+			sum += rate;
+			min_rate = (std::min)(min_rate, rate);
+			max_rate = (std::max)(max_rate, rate);
+		}
+		std::cout << "class " << c << ": " << sum << " target: " << limits[c]
+			<< " per peer: " << min_rate << " - " << max_rate
+			<< " target: " << target << std::endl;
+		// quota is handed out about a packet at a time, the last one may
+		// still be owed when the sample ends
+		TEST_CHECK(close_to(sum, limits[c], limits[c] * 0.05f));
+		TEST_CHECK(close_to(min_rate, target, target * 0.05f));
+		TEST_CHECK(close_to(max_rate, target, target * 0.05f));
+	}
+}
+
 TORRENT_TEST(equal_connection)
 {
 	test_equal_connections( 2,      20);
@@ -514,4 +566,8 @@ TORRENT_TEST(no_starvation)
 	test_no_starvation(40000);
 }
 
+TORRENT_TEST(many_peers)
+{
+	test_many_peers(10000);
+}
 
@@ -1294,3 +1294,95 @@ TORRENT_TEST(switch_buffer)
 	TEST_EQUAL(string1, string2);
 }
 
+// string length prefixes and integers of every width, both where the
+// tokenizer can scan 16 bytes ahead and right at the end of the buffer
+TORRENT_TEST(digit_runs)
+{
+	for (int digits = 1; digits <= 19; ++digits)
+	{
+		std::string num(digits, '0');
+		num[digits - 1] = '7';
+		num[0] = digits > 1 ? '1' : '7';
+		boost::int64_t const val = strtoll(num.c_str(), NULL, 10);
+
+		for (int tail = 0; tail < 2; ++tail)
+		{
+			std::string const pad = tail ? "" : "i0ei0ei0ei0ei0ei0ei0ei0e";
+			std::string b = "li" + num + "ei-" + num + "e" + pad + "e";
+
+			bdecode_node e;
+			error_code ec;
+			int ret = bdecode(&b[0], &b[0] + b.size(), e, ec);
+			TEST_EQUAL(ret, 0);
+			TEST_EQUAL(e.list_int_value_at(0), val);
+			TEST_EQUAL(e.list_int_value_at(1), -val);
+
+			// the length prefixes are zero padded to the same width. Tokens
+			// only have room for 8 digits of string header
+			std::string len(digits, '0');
+			len[digits - 1] = '3';
+			b = pad.empty() ? len + ":foo" : "l" + len + ":foo" + pad + "e";
+			ret = bdecode(&b[0], &b[0] + b.size(), e, ec);
+			if (digits > 8)
+			{
+				TEST_EQUAL(ret, -1);
+				TEST_EQUAL(ec, error_code(bdecode_errors::limit_exceeded));
+				continue;
+			}
+			TEST_EQUAL(ret, 0);
+			bdecode_node s = pad.empty() ? e : e.list_at(0);
+			TEST_EQUAL(s.string_value(), "foo");
+		}
+	}
+}
+
+// malformed digit runs report the same errors and positions whether or not
+// there are 16 bytes left to scan
+TORRENT_TEST(digit_run_errors)
+{
+	char const* inputs[] = { "i12a4e", "i-e", "ie", "i1234567890123456789012e"
+		, "12a4:foo", "123456789012345678:" };
+	std::string const pad(32, 'x');
+
+	for (int i = 0; i < int(sizeof(inputs)/sizeof(inputs[0])); ++i)
+	{
+		std::string const b1 = inputs[i];
+		bdecode_node e;
+		error_code ec1;
+		int pos1 = -1;
+		int ret = bdecode(&b1[0], &b1[0] + b1.size(), e, ec1, &pos1);
+		TEST_EQUAL(ret, -1);
+
+		std::string const b2 = b1 + pad;
+		error_code ec2;
+		int pos2 = -1;
+		ret = bdecode(&b2[0], &b2[0] + b2.size(), e, ec2, &pos2);
+		TEST_EQUAL(ret, -1);
+
+		// running out of input is only an error for the short buffer
+		if (ec1 == error_code(bdecode_errors::unexpected_eof)) continue;
+		TEST_EQUAL(ec1, ec2);
+		TEST_EQUAL(pos1, pos2);
+	}
+}
+
+// a node parsing a large input without a reserve() ends up with a token
+// vector sized to what it holds
+TORRENT_TEST(presized_tokens)
+{
+	std::string b = "d6:pieces100000:" + std::string(100000, 'a') + "e";
+	bdecode_node e;
+	error_code ec;
+	int ret = bdecode(&b[0], &b[0] + b.size(), e, ec);
+	TEST_EQUAL(ret, 0);
+	TEST_EQUAL(e.dict_find_string_value("pieces").size(), 100000);
+
+	std::string l = "l";
+	for (int i = 0; i < 10000; ++i) l += "i1e3:foo";
+	l += "e";
+	ret = bdecode(&l[0], &l[0] + l.size(), e, ec);
+	TEST_EQUAL(ret, 0);
+	TEST_EQUAL(e.list_size(), 20000);
+	TEST_EQUAL(e.list_string_value_at(19999), "foo");
+}
+
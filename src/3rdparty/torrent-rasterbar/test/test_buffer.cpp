@@ -38,6 +38,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/buffer.hpp"
 #include "libtorrent/chained_buffer.hpp"
 #include "libtorrent/socket.hpp"
+#include "libtorrent/file.hpp"
 
 #include "test.hpp"
 
@@ -319,3 +320,67 @@ TORRENT_TEST(chained_buffer)
 	TEST_CHECK(buffer_list.empty());
 }
 
+TORRENT_TEST(chained_buffer_file)
+{
+	char data[] = "foobar";
+	{
+		chained_buffer b;
+
+		char* b1 = allocate_buffer(512);
+		std::memcpy(b1, data, 6);
+		b.append_buffer(b1, 512, 6, &free_buffer, (void*)0x1337);
+
+		file_range r;
+		r.handle.reset(new file);
+		r.offset = 100;
+		r.size = 16;
+		b.append_file(r);
+
+		TEST_EQUAL(b.size(), 6 + 16);
+		TEST_EQUAL(b.capacity(), 512 + 16);
+
+		// nothing can be appended to a file range
+		TEST_EQUAL(b.space_in_last_buffer(), 0);
+		TEST_EQUAL(b.allocate_appendix(1), static_cast<char*>(NULL));
+
+		char* b2 = allocate_buffer(512);
+		std::memcpy(b2, data, 6);
+		b.append_buffer(b2, 512, 6, &free_buffer, (void*)0x1337);
+		TEST_EQUAL(b.size(), 6 + 16 + 6);
+
+		// the iovec stops at the file range
+		std::vector<boost::asio::const_buffer> const& vec = b.build_iovec(b.size());
+		TEST_EQUAL(vec.size(), 1);
+		TEST_EQUAL(boost::asio::buffer_size(vec[0]), 6);
+
+		// only a send of all the memory in front of it reaches the file range
+		TEST_CHECK(!b.reaches_file(5));
+		TEST_CHECK(b.reaches_file(6));
+		TEST_CHECK(b.reaches_file(b.size()));
+
+		file_range front;
+		TEST_CHECK(!b.front_file(front));
+		b.pop_front(6);
+		TEST_EQUAL(buffer_list.size(), 1);
+
+		// once the memory in front of it is sent, the file range is next
+		TEST_CHECK(b.front_file(front));
+		TEST_CHECK(front.handle == r.handle);
+		TEST_EQUAL(front.offset, 100);
+		TEST_EQUAL(front.size, 16);
+		TEST_CHECK(b.build_iovec(b.size()).empty());
+
+		b.pop_front(10);
+		TEST_CHECK(b.front_file(front));
+		TEST_EQUAL(front.offset, 110);
+		TEST_EQUAL(front.size, 6);
+
+		b.pop_front(6);
+		TEST_CHECK(!b.front_file(front));
+		TEST_CHECK(!b.reaches_file(b.size()));
+		TEST_CHECK(compare_chained_buffer(b, "foobar", 6));
+		TEST_EQUAL(b.size(), 6);
+	}
+	TEST_CHECK(buffer_list.empty());
+}
+
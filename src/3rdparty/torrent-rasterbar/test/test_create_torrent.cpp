@@ -36,8 +36,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/create_torrent.hpp"
 #include "libtorrent/bencode.hpp"
 #include "libtorrent/aux_/escape_string.hpp" // for convert_path_to_posix
+#include "libtorrent/file.hpp"
+#include "libtorrent/hasher.hpp"
 #include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
 #include <cstring>
+#include <cstdio>
 
 namespace lt = libtorrent;
 
@@ -65,3 +69,114 @@ TORRENT_TEST(create_verbatim_torrent)
 	TEST_CHECK(memcmp(dest_info, test_torrent + 1, sizeof(test_torrent)-3) == 0);
 }
 
+
+namespace {
+
+// writes files of the given sizes with pseudo random content under
+// "create_torrent_files" and returns a file_storage describing them
+lt::file_storage write_test_files(int const* sizes, int num_files)
+{
+	lt::error_code ec;
+	lt::create_directory("create_torrent_files", ec);
+
+	lt::file_storage fs;
+	for (int i = 0; i < num_files; ++i)
+	{
+		char name[100];
+		snprintf(name, sizeof(name), "create_torrent_files/file-%d", i);
+		std::vector<char> data(sizes[i]);
+		for (int j = 0; j < sizes[i]; ++j) data[j] = char((j * 7919 + i) >> 3);
+		FILE* f = fopen(name, "wb+");
+		TEST_CHECK(f != NULL);
+		if (f == NULL) return fs;
+		if (!data.empty()) fwrite(&data[0], 1, data.size(), f);
+		fclose(f);
+		fs.add_file(name, sizes[i]);
+	}
+	return fs;
+}
+
+// hashes the files the slow way, one piece at a time
+std::vector<lt::sha1_hash> reference_hashes(lt::file_storage const& fs)
+{
+	std::vector<char> all;
+	for (int i = 0; i < fs.num_files(); ++i)
+	{
+		FILE* f = fopen(fs.file_path(i).c_str(), "rb");
+		TEST_CHECK(f != NULL);
+		if (f == NULL) return std::vector<lt::sha1_hash>();
+		std::vector<char> data(fs.file_size(i));
+		if (!data.empty()) TEST_EQUAL(fread(&data[0], 1, data.size(), f), data.size());
+		fclose(f);
+		all.insert(all.end(), data.begin(), data.end());
+	}
+
+	std::vector<lt::sha1_hash> ret;
+	for (int i = 0; i < fs.num_pieces(); ++i)
+		ret.push_back(lt::hasher(&all[0] + i * fs.piece_length(), fs.piece_size(i)).final());
+	return ret;
+}
+
+bool count_progress(int* calls, int piece)
+{
+	TEST_EQUAL(piece, *calls);
+	++*calls;
+	return true;
+}
+
+bool stop_at(int stop, int piece) { return piece < stop; }
+
+} // anonymous namespace
+
+TORRENT_TEST(set_piece_hashes_threads)
+{
+	// pieces span file boundaries, and the 16 kiB pieces put many pieces
+	// in one read chunk
+	int const sizes[] = { 5 * 1024 * 1024 + 17, 3, 2 * 1024 * 1024 - 1000 };
+	lt::file_storage fs = write_test_files(sizes, 3);
+
+	int const piece_sizes[] = { 16 * 1024, 1024 * 1024, 8 * 1024 * 1024 };
+	for (int p = 0; p < 3; ++p)
+	{
+		for (int threads = 1; threads <= 4; threads += 3)
+		{
+			lt::create_torrent t(fs, piece_sizes[p]);
+			int calls = 0;
+			lt::error_code ec;
+			lt::set_piece_hashes(t, ".", boost::bind(&count_progress, &calls, _1)
+				, threads, ec);
+			TEST_CHECK(!ec);
+			TEST_EQUAL(calls, t.num_pieces());
+
+			std::vector<lt::sha1_hash> const ref = reference_hashes(t.files());
+			std::string const pieces = t.generate()["info"]["pieces"].string();
+			TEST_EQUAL(int(ref.size()), t.num_pieces());
+			TEST_EQUAL(pieces.size(), ref.size() * 20);
+			for (int i = 0; i < int(ref.size()) && i * 20 < int(pieces.size()); ++i)
+				TEST_CHECK(lt::sha1_hash(pieces.c_str() + i * 20) == ref[i]);
+		}
+	}
+}
+
+TORRENT_TEST(set_piece_hashes_abort)
+{
+	int const sizes[] = { 3 * 1024 * 1024 };
+	lt::file_storage fs = write_test_files(sizes, 1);
+	lt::create_torrent t(fs, 16 * 1024);
+
+	lt::error_code ec;
+	lt::set_piece_hashes(t, ".", boost::bind(&stop_at, 10, _1), 2, ec);
+	TEST_EQUAL(ec, lt::error_code(boost::asio::error::operation_aborted));
+}
+
+TORRENT_TEST(set_piece_hashes_missing_file)
+{
+	int const sizes[] = { 100000 };
+	lt::file_storage fs = write_test_files(sizes, 1);
+	fs.add_file("create_torrent_files/missing", 100000);
+	lt::create_torrent t(fs, 16 * 1024);
+
+	lt::error_code ec;
+	lt::set_piece_hashes(t, ".", ec);
+	TEST_CHECK(ec);
+}
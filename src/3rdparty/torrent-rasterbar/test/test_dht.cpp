@@ -2589,6 +2589,79 @@ TORRENT_TEST(rpc_invalid_error_msg)
 }
 #endif
 
+namespace {
+
+observer_ptr send_ping(dht::rpc_manager& rpc
+	, boost::intrusive_ptr<traversal_algorithm> const& algo
+	, udp::endpoint const& ep)
+{
+	entry req;
+	req["q"] = "ping";
+
+	observer_ptr o(new (rpc.allocate_observer()) null_observer(algo, ep, node_id()));
+#if defined TORRENT_DEBUG || defined TORRENT_RELEASE_ASSERTS
+	o->m_in_constructor = false;
+#endif
+	g_sent_packets.clear();
+	rpc.invoke(req, ep, o);
+	return o;
+}
+
+void reply_to_ping(dht::rpc_manager& rpc, udp::endpoint const& ep)
+{
+	entry rsp;
+	rsp["y"] = "r";
+	rsp["t"] = g_sent_packets.begin()->second["t"].string();
+	rsp["r"]["id"] = to_hash("1111111111111111111111111111111111111111").to_string();
+	char msg_buf[1500];
+	int size = bencode(msg_buf, rsp);
+
+	bdecode_node decoded;
+	error_code ec;
+	bdecode(msg_buf, msg_buf + size, decoded, ec);
+	TEST_CHECK(!ec);
+
+	dht::msg m(decoded, ep);
+	node_id nid;
+	rpc.incoming(m, &nid);
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(rpc_adaptive_timeouts)
+{
+	dht_settings sett = test_settings();
+	mock_socket s;
+	obs observer;
+	counters cnt;
+
+	dht::routing_table table(node_id(), 8, sett, &observer);
+	dht::rpc_manager rpc(node_id(), sett, table, &s, &observer);
+	dht::node node(&s, sett, node_id(0), &observer, cnt);
+	boost::intrusive_ptr<traversal_algorithm> algo(new dht::traversal_algorithm(
+			node, node_id()));
+
+	udp::endpoint source(address::from_string("10.0.0.1"), 20);
+
+	// without any round trip time measured, the fixed timeouts are used
+	observer_ptr o = send_ping(rpc, algo, source);
+	TEST_EQUAL(o->short_timeout_ms(), 1000);
+	TEST_EQUAL(o->timeout_ms(), 15000);
+	TEST_EQUAL(rpc.rtt_estimate(), 0);
+	reply_to_ping(rpc, source);
+	TEST_CHECK(o->flags & observer::flag_done);
+
+	// the reply came back right away, so the next request to this network
+	// gives up on its reply much sooner
+	TEST_CHECK(rpc.rtt_estimate() > 0);
+	TEST_CHECK(rpc.rtt_estimate() < 250);
+	o = send_ping(rpc, algo, source);
+	TEST_EQUAL(o->short_timeout_ms(), 250);
+	TEST_EQUAL(o->timeout_ms(), 3000);
+	reply_to_ping(rpc, source);
+	TEST_CHECK(o->flags & observer::flag_done);
+}
+
 // test bucket distribution
 TORRENT_TEST(node_id_bucket_distribution)
 {
@@ -244,114 +244,274 @@ TORRENT_TEST(default_set_custom)
 	TEST_EQUAL(g_storage_constructor_invoked, true);
 }
 
-TORRENT_TEST(peer_limit)
+namespace
 {
-	dht_settings sett = test_settings();
-	sett.max_peers = 42;
-	boost::scoped_ptr<dht_storage_interface> s(dht_default_storage_constructor(node_id(0), sett));
-	TEST_CHECK(s.get() != NULL);
+	void test_peer_limit(dht_storage_constructor_type construct)
+	{
+		dht_settings sett = test_settings();
+		sett.max_peers = 42;
+		boost::scoped_ptr<dht_storage_interface> s(construct(node_id(0), sett));
+		TEST_CHECK(s.get() != NULL);
 
-	for (int i = 0; i < 200; ++i)
+		for (int i = 0; i < 200; ++i)
+		{
+			s->announce_peer(n1, tcp::endpoint(rand_v4(), lt::random())
+				, "torrent_name", false);
+			dht_storage_counters cnt = s->counters();
+			TEST_CHECK(cnt.peers <= 42);
+		}
+		dht_storage_counters cnt = s->counters();
+		TEST_EQUAL(cnt.peers, 42);
+	}
+
+	void test_torrent_limit(dht_storage_constructor_type construct)
 	{
-		s->announce_peer(n1, tcp::endpoint(rand_v4(), lt::random())
-			, "torrent_name", false);
+		dht_settings sett = test_settings();
+		sett.max_torrents = 42;
+		boost::scoped_ptr<dht_storage_interface> s(construct(node_id(0), sett));
+		TEST_CHECK(s.get() != NULL);
+
+		for (int i = 0; i < 200; ++i)
+		{
+			s->announce_peer(rand_hash(), tcp::endpoint(rand_v4(), lt::random())
+				, "", false);
+			dht_storage_counters cnt = s->counters();
+			TEST_CHECK(cnt.torrents <= 42);
+		}
 		dht_storage_counters cnt = s->counters();
-		TEST_CHECK(cnt.peers <= 42);
+		TEST_EQUAL(cnt.torrents, 42);
 	}
-	dht_storage_counters cnt = s->counters();
-	TEST_EQUAL(cnt.peers, 42);
-}
 
-TORRENT_TEST(torrent_limit)
-{
-	dht_settings sett = test_settings();
-	sett.max_torrents = 42;
-	boost::scoped_ptr<dht_storage_interface> s(dht_default_storage_constructor(node_id(0), sett));
-	TEST_CHECK(s.get() != NULL);
+	void test_immutable_item_limit(dht_storage_constructor_type construct)
+	{
+		dht_settings sett = test_settings();
+		sett.max_dht_items = 42;
+		boost::scoped_ptr<dht_storage_interface> s(construct(node_id(0), sett));
+		TEST_CHECK(s.get() != NULL);
 
-	for (int i = 0; i < 200; ++i)
+		for (int i = 0; i < 200; ++i)
+		{
+			s->put_immutable_item(rand_hash(), "123", 3, rand_v4());
+			dht_storage_counters cnt = s->counters();
+			TEST_CHECK(cnt.immutable_data <= 42);
+		}
+		dht_storage_counters cnt = s->counters();
+		TEST_EQUAL(cnt.immutable_data, 42);
+	}
+
+	void test_mutable_item_limit(dht_storage_constructor_type construct)
 	{
-		s->announce_peer(rand_hash(), tcp::endpoint(rand_v4(), lt::random())
-			, "", false);
+		dht_settings sett = test_settings();
+		sett.max_dht_items = 42;
+		boost::scoped_ptr<dht_storage_interface> s(construct(node_id(0), sett));
+		TEST_CHECK(s.get() != NULL);
+
+		char public_key[item_pk_len];
+		char signature[item_sig_len];
+		for (int i = 0; i < 200; ++i)
+		{
+			s->put_mutable_item(rand_hash(), "123", 3, signature, 1, public_key, "salt", 4, rand_v4());
+			dht_storage_counters cnt = s->counters();
+			TEST_CHECK(cnt.mutable_data <= 42);
+		}
 		dht_storage_counters cnt = s->counters();
-		TEST_CHECK(cnt.torrents <= 42);
+		TEST_EQUAL(cnt.mutable_data, 42);
 	}
-	dht_storage_counters cnt = s->counters();
-	TEST_EQUAL(cnt.torrents, 42);
+
+	void test_get_peers_dist(dht_storage_constructor_type construct)
+	{
+		// test that get_peers returns reasonably disjoint sets of peers with each call
+		// take two samples of 100 peers from 1000 and make sure there aren't too many
+		// peers found in both lists
+		dht_settings sett = test_settings();
+		sett.max_peers = 1000;
+		sett.max_peers_reply = 100;
+		boost::scoped_ptr<dht_storage_interface> s(construct(node_id(0), sett));
+
+		address addr = rand_v4();
+		for (int i = 0; i < 1000; ++i)
+		{
+			s->announce_peer(n1, tcp::endpoint(addr, uint16_t(i))
+				, "torrent_name", false);
+		}
+
+		std::set<int> peer_set;
+		int duplicates = 0;
+		for (int i = 0; i < 2; ++i)
+		{
+			entry peers;
+			s->get_peers(n1, false, false, peers);
+			TEST_EQUAL(peers["values"].list().size(), 100);
+			entry::list_type const& peers_list = peers["values"].list();
+			for (entry::list_type::const_iterator p = peers_list.begin();
+				p != peers_list.end(); ++p)
+			{
+				std::string::const_iterator it = p->string().begin();
+				int port = detail::read_v4_endpoint<tcp::endpoint>(it).port();
+				if (!peer_set.insert(port).second)
+					++duplicates;
+			}
+		}
+		std::printf("duplicate peers found: %d\n", duplicates);
+		TEST_CHECK(duplicates < 20);
+	}
+}
+
+TORRENT_TEST(peer_limit)
+{
+	test_peer_limit(dht_default_storage_constructor);
+	test_peer_limit(dht_flat_storage_constructor);
+}
+
+TORRENT_TEST(torrent_limit)
+{
+	test_torrent_limit(dht_default_storage_constructor);
+	test_torrent_limit(dht_flat_storage_constructor);
 }
 
 TORRENT_TEST(immutable_item_limit)
+{
+	test_immutable_item_limit(dht_default_storage_constructor);
+	test_immutable_item_limit(dht_flat_storage_constructor);
+}
+
+TORRENT_TEST(mutable_item_limit)
+{
+	test_mutable_item_limit(dht_default_storage_constructor);
+	test_mutable_item_limit(dht_flat_storage_constructor);
+}
+
+TORRENT_TEST(get_peers_dist)
+{
+	test_get_peers_dist(dht_default_storage_constructor);
+	test_get_peers_dist(dht_flat_storage_constructor);
+}
+
+TORRENT_TEST(flat_announce_peer)
 {
 	dht_settings sett = test_settings();
-	sett.max_dht_items = 42;
-	boost::scoped_ptr<dht_storage_interface> s(dht_default_storage_constructor(node_id(0), sett));
-	TEST_CHECK(s.get() != NULL);
+	boost::scoped_ptr<dht_storage_interface> s(dht_flat_storage_constructor(node_id(0), sett));
+
+	tcp::endpoint p1 = ep("124.31.75.21", 1);
+	tcp::endpoint p2 = ep("124.31.75.22", 1);
+
+	s->announce_peer(n1, p1, "torrent_name", false);
+	s->announce_peer(n1, p2, "other_name", true);
+	// announcing again replaces the peer
+	s->announce_peer(n1, p1, "", true);
+	TEST_EQUAL(s->counters().peers, 2);
+	TEST_EQUAL(s->counters().torrents, 1);
 
-	for (int i = 0; i < 200; ++i)
+	entry peers;
+	TEST_CHECK(s->get_peers(n1, false, false, peers));
+	TEST_EQUAL(peers["n"].string(), "torrent_name");
+	TEST_EQUAL(peers["values"].list().size(), 2);
+
+	// both are seeds now
+	entry downloaders;
+	TEST_CHECK(s->get_peers(n1, true, false, downloaders));
+	TEST_CHECK(downloaders["values"].list().empty());
+
+	entry scrape;
+	TEST_CHECK(s->get_peers(n1, false, true, scrape));
+	TEST_EQUAL(scrape["BFsd"].string().size(), 256);
+	TEST_EQUAL(scrape["BFpe"].string().size(), 256);
+	TEST_CHECK(scrape["BFsd"].string() != scrape["BFpe"].string());
+
+	if (supports_ipv6())
 	{
-		s->put_immutable_item(rand_hash(), "123", 3, rand_v4());
-		dht_storage_counters cnt = s->counters();
-		TEST_CHECK(cnt.immutable_data <= 42);
+		s->announce_peer(n1, ep("2001::1", 6881), "", false);
+		entry all;
+		s->get_peers(n1, false, false, all);
+		entry::list_type const& l = all["values"].list();
+		TEST_EQUAL(l.size(), 3);
+		int v6 = 0;
+		for (entry::list_type::const_iterator i = l.begin(); i != l.end(); ++i)
+			if (i->string().size() == 18) ++v6;
+		TEST_EQUAL(v6, 1);
 	}
-	dht_storage_counters cnt = s->counters();
-	TEST_EQUAL(cnt.immutable_data, 42);
 }
 
-TORRENT_TEST(mutable_item_limit)
+TORRENT_TEST(flat_lru_eviction)
 {
+	// looking up a torrent makes it the last one to be evicted
 	dht_settings sett = test_settings();
-	sett.max_dht_items = 42;
-	boost::scoped_ptr<dht_storage_interface> s(dht_default_storage_constructor(node_id(0), sett));
-	TEST_CHECK(s.get() != NULL);
+	boost::scoped_ptr<dht_storage_interface> s(dht_flat_storage_constructor(node_id(0), sett));
 
-	char public_key[item_pk_len];
-	char signature[item_sig_len];
-	for (int i = 0; i < 200; ++i)
-	{
-		s->put_mutable_item(rand_hash(), "123", 3, signature, 1, public_key, "salt", 4, rand_v4());
-		dht_storage_counters cnt = s->counters();
-		TEST_CHECK(cnt.mutable_data <= 42);
-	}
-	dht_storage_counters cnt = s->counters();
-	TEST_EQUAL(cnt.mutable_data, 42);
+	s->announce_peer(n1, ep("124.31.75.21", 1), "", false);
+	s->announce_peer(n2, ep("124.31.75.22", 1), "", false);
+	entry peers;
+	TEST_CHECK(s->get_peers(n1, false, false, peers));
+
+	s->announce_peer(n3, ep("124.31.75.23", 1), "", false);
+	TEST_EQUAL(s->counters().torrents, 2);
+	TEST_EQUAL(s->counters().peers, 2);
+	entry e1, e2, e3;
+	TEST_CHECK(s->get_peers(n1, false, false, e1));
+	TEST_CHECK(!s->get_peers(n2, false, false, e2));
+	TEST_CHECK(s->get_peers(n3, false, false, e3));
 }
 
-TORRENT_TEST(get_peers_dist)
+TORRENT_TEST(flat_item_lru_eviction)
 {
-	// test that get_peers returns reasonably disjoint sets of peers with each call
-	// take two samples of 100 peers from 1000 and make sure there aren't too many
-	// peers found in both lists
+	// looking up an item makes it the last one to be evicted
 	dht_settings sett = test_settings();
-	sett.max_peers = 1000;
-	sett.max_peers_reply = 100;
-	boost::scoped_ptr<dht_storage_interface> s(dht_default_storage_constructor(node_id(0), sett));
+	boost::scoped_ptr<dht_storage_interface> s(dht_flat_storage_constructor(node_id(0), sett));
+	address const addr = address::from_string("124.31.75.21");
 
-	address addr = rand_v4();
-	for (int i = 0; i < 1000; ++i)
-	{
-		s->announce_peer(n1, tcp::endpoint(addr, uint16_t(i))
-			, "torrent_name", false);
-	}
+	s->put_immutable_item(n1, "123", 3, addr);
+	s->put_immutable_item(n2, "123", 3, addr);
+	entry item;
+	TEST_CHECK(s->get_immutable_item(n1, item));
+	s->put_immutable_item(n3, "123", 3, addr);
+	TEST_EQUAL(s->counters().immutable_data, 2);
+	TEST_CHECK(s->get_immutable_item(n1, item));
+	TEST_CHECK(!s->get_immutable_item(n2, item));
+	TEST_CHECK(s->get_immutable_item(n3, item));
+
+	char public_key[item_pk_len] = {0};
+	char signature[item_sig_len] = {0};
+	s->put_mutable_item(n1, "123", 3, signature, 1, public_key, "salt", 4, addr);
+	s->put_mutable_item(n2, "123", 3, signature, 1, public_key, "salt", 4, addr);
+	boost::int64_t seq;
+	TEST_CHECK(s->get_mutable_item_seq(n1, seq));
+	s->put_mutable_item(n3, "123", 3, signature, 1, public_key, "salt", 4, addr);
+	TEST_EQUAL(s->counters().mutable_data, 2);
+	TEST_CHECK(s->get_mutable_item(n1, 0, false, item));
+	TEST_CHECK(!s->get_mutable_item(n2, 0, false, item));
+	TEST_CHECK(s->get_mutable_item(n3, 0, false, item));
+}
 
-	std::set<int> peer_set;
-	int duplicates = 0;
-	for (int i = 0; i < 2; ++i)
+TORRENT_TEST(flat_memory_limit)
+{
+	dht_settings sett = test_settings();
+	sett.max_torrents = 100000;
+	sett.max_dht_items = 100000;
+	sett.max_storage_memory = 512 * 1024;
+	boost::scoped_ptr<dht_storage_interface> s(dht_flat_storage_constructor(node_id(0), sett));
+
+	// far more than fits: each torrent needs a node and an array of 20 peers
+	std::vector<sha1_hash> hashes;
+	for (int i = 0; i < 5000; ++i)
 	{
-		entry peers;
-		s->get_peers(n1, false, false, peers);
-		TEST_EQUAL(peers["values"].list().size(), 100);
-		entry::list_type const& peers_list = peers["values"].list();
-		for (entry::list_type::const_iterator p = peers_list.begin();
-			p != peers_list.end(); ++p)
-		{
-			std::string::const_iterator it = p->string().begin();
-			int port = detail::read_v4_endpoint<tcp::endpoint>(it).port();
-			if (!peer_set.insert(port).second)
-				++duplicates;
-		}
+		hashes.push_back(rand_hash());
+		for (int p = 0; p < 20; ++p)
+			s->announce_peer(hashes.back(), tcp::endpoint(rand_v4(), uint16_t(p + 1)), "", false);
+		s->put_immutable_item(rand_hash(), "123", 3, rand_v4());
 	}
-	std::printf("duplicate peers found: %d\n", duplicates);
-	TEST_CHECK(duplicates < 20);
+
+	dht_storage_counters cnt = s->counters();
+	std::printf("kept %d torrents, %d peers, %d items\n"
+		, cnt.torrents, cnt.peers, cnt.immutable_data);
+	TEST_CHECK(cnt.torrents > 100);
+	TEST_CHECK(cnt.torrents < 5000);
+	TEST_EQUAL(cnt.peers, cnt.torrents * 20);
+
+	// the oldest entries went first
+	entry peers;
+	TEST_CHECK(!s->get_peers(hashes.front(), false, false, peers));
+	TEST_CHECK(s->get_peers(hashes.back(), false, false, peers));
+	TEST_EQUAL(peers["values"].list().size(), 20);
 }
 
 #endif
@@ -50,6 +50,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <boost/bind.hpp>
 #include <iostream>
 #include <cstdarg>
+#include <set>
 
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
@@ -240,14 +241,16 @@ void send_bitfield(tcp::socket& s, char const* bits)
 	if (ec) TEST_ERROR(ec.message());
 }
 
-void do_handshake(tcp::socket& s, sha1_hash const& ih, char* buffer)
+void do_handshake(tcp::socket& s, sha1_hash const& ih, char* buffer
+	, char const* pid = "aaaaaaaaaaaaaaaaaaaa")
 {
 	char handshake[] = "\x13" "BitTorrent protocol\0\0\0\0\0\x10\0\x04"
 		"                    " // space for info-hash
-		"aaaaaaaaaaaaaaaaaaaa"; // peer-id
+		"                    "; // space for peer-id
 	log("==> handshake");
 	error_code ec;
 	std::memcpy(handshake + 28, ih.begin(), 20);
+	std::memcpy(handshake + 48, pid, 20);
 	boost::asio::write(s, boost::asio::buffer(handshake, sizeof(handshake) - 1)
 		, boost::asio::transfer_all(), ec);
 	if (ec)
@@ -944,6 +947,131 @@ TORRENT_TEST(invalid_metadata_request)
 	print_session_log(*ses);
 }
 
+void send_ut_metadata_piece(tcp::socket& s, int ut_metadata_msg, int piece
+	, int total_size)
+{
+	std::vector<char> buf(4 + 1 + 1);
+
+	entry e;
+	e["msg_type"] = 1;
+	e["piece"] = piece;
+	e["total_size"] = total_size;
+	bencode(std::back_inserter(buf), e);
+	buf.resize(buf.size() + 16 * 1024);
+
+	using namespace libtorrent::detail;
+
+	char* ptr = &buf[0];
+	write_uint32(buf.size() - 4, ptr);
+	write_uint8(20, ptr);
+	write_uint8(ut_metadata_msg, ptr);
+
+	log("==> ut_metadata [ type: 1 piece: %d ]", piece);
+
+	error_code ec;
+	boost::asio::write(s, boost::asio::buffer(&buf[0], buf.size())
+		, boost::asio::transfer_all(), ec);
+	if (ec) TEST_ERROR(ec.message());
+}
+
+// connects a peer advertising metadata of the given size to a session that
+// is downloading the metadata of ih, and returns the ut_metadata message id
+// the session expects from that peer
+int connect_metadata_peer(tcp::socket& s, sha1_hash const& ih, lt::session& ses
+	, char const* pid, int metadata_size, char* recv_buffer, int size)
+{
+	error_code ec;
+	s.connect(tcp::endpoint(address::from_string("127.0.0.1", ec), ses.listen_port()), ec);
+	if (ec) TEST_ERROR(ec.message());
+
+	do_handshake(s, ih, recv_buffer, pid);
+	send_have_none(s);
+
+	entry extensions;
+	extensions["m"]["ut_metadata"] = 1;
+	extensions["metadata_size"] = metadata_size;
+	send_extension_handshake(s, extensions);
+	extensions = read_extension_handshake(s, recv_buffer, size);
+	return int(extensions["m"]["ut_metadata"].integer());
+}
+
+// metadata blocks are spread over all peers that have it, and the blocks of
+// a peer that disconnects are requested from another one
+TORRENT_TEST(parallel_metadata_requests)
+{
+	std::cerr << "\n === test parallel metadata requests ===\n" << std::endl;
+
+	sha1_hash ih;
+	ih.assign("abababababababababab");
+
+	settings_pack sett;
+	sett.set_str(settings_pack::listen_interfaces, "0.0.0.0:48900");
+	sett.set_int(settings_pack::alert_mask, alert::all_categories);
+	sett.set_bool(settings_pack::enable_upnp, false);
+	sett.set_bool(settings_pack::enable_natpmp, false);
+	sett.set_bool(settings_pack::enable_lsd, false);
+	sett.set_bool(settings_pack::enable_dht, false);
+	sett.set_bool(settings_pack::allow_multiple_connections_per_ip, true);
+	sett.set_int(settings_pack::in_enc_policy, settings_pack::pe_disabled);
+	sett.set_int(settings_pack::out_enc_policy, settings_pack::pe_disabled);
+	sett.set_bool(settings_pack::enable_outgoing_utp, false);
+	sett.set_bool(settings_pack::enable_incoming_utp, false);
+	lt::session ses(sett, lt::session::add_default_plugins);
+
+	error_code ec;
+	add_torrent_params p;
+	p.flags &= ~add_torrent_params::flag_paused;
+	p.flags &= ~add_torrent_params::flag_auto_managed;
+	p.info_hash = ih;
+	p.save_path = "./tmp1_fast";
+	ses.add_torrent(p, ec);
+	if (ec) TEST_ERROR(ec.message());
+
+	// three 16 kiB blocks
+	int const metadata_size = 3 * 16 * 1024;
+
+	io_service ios;
+	tcp::socket slow(ios);
+	tcp::socket fast(ios);
+	char recv_buffer[1000];
+
+	// the first peer is asked for two blocks and never answers
+	connect_metadata_peer(slow, ih, ses, "slowslowslowslowslow", metadata_size
+		, recv_buffer, sizeof(recv_buffer));
+	std::set<int> slow_pieces;
+	for (int i = 0; i < 2; ++i)
+	{
+		entry msg = read_ut_metadata_msg(slow, recv_buffer, sizeof(recv_buffer));
+		TEST_EQUAL(msg["msg_type"].integer(), 0);
+		slow_pieces.insert(int(msg["piece"].integer()));
+		log("slow peer asked for %d", int(msg["piece"].integer()));
+	}
+	TEST_EQUAL(slow_pieces.size(), 2);
+
+	// the second peer gets the remaining block first
+	int const ut_metadata = connect_metadata_peer(fast, ih, ses
+		, "fastfastfastfastfast", metadata_size, recv_buffer, sizeof(recv_buffer));
+	entry msg = read_ut_metadata_msg(fast, recv_buffer, sizeof(recv_buffer));
+	TEST_EQUAL(msg["msg_type"].integer(), 0);
+	int const piece = int(msg["piece"].integer());
+	TEST_CHECK(slow_pieces.count(piece) == 0);
+
+	send_ut_metadata_piece(fast, ut_metadata, piece, metadata_size);
+
+	// when the slow peer goes away, its blocks move over right away rather
+	// than after the 3 second re-request delay
+	time_point const start = clock_type::now();
+	slow.close();
+	msg = read_ut_metadata_msg(fast, recv_buffer, sizeof(recv_buffer));
+	int const elapsed = int(total_milliseconds(clock_type::now() - start));
+	log("fail over after %d ms", elapsed);
+	TEST_EQUAL(msg["msg_type"].integer(), 0);
+	TEST_CHECK(slow_pieces.count(int(msg["piece"].integer())) == 1);
+	TEST_CHECK(elapsed < 2500);
+
+	print_session_log(ses);
+}
+
 TORRENT_TEST(invalid_request)
 {
 	std::cerr << "\n === test request ===\n" << std::endl;
@@ -0,0 +1,151 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include "test.hpp"
+#include "libtorrent/file_pool.hpp"
+#include "libtorrent/file_storage.hpp"
+#include "libtorrent/file.hpp"
+
+#include <vector>
+
+using namespace libtorrent;
+
+namespace {
+
+file_storage make_files(std::string const& root, int const num_files)
+{
+	error_code ec;
+	create_directory(root, ec);
+
+	file_storage fs;
+	for (int i = 0; i < num_files; ++i)
+	{
+		char name[30];
+		snprintf(name, sizeof(name), "%d", i);
+		fs.add_file(combine_path("file_pool_test", name), 1);
+	}
+	fs.set_piece_length(0x4000);
+	fs.set_num_pieces(1);
+	return fs;
+}
+
+bool is_open(file_pool const& fp, void* st, int const file_index)
+{
+	std::vector<pool_file_status> status;
+	fp.get_status(&status, st);
+	for (int i = 0; i < int(status.size()); ++i)
+		if (status[i].file_index == file_index) return true;
+	return false;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(evict_least_recently_used)
+{
+	std::string const cwd = current_working_directory();
+	file_storage fs = make_files(combine_path(cwd, "file_pool_test"), 3);
+
+	// two storages, likely to land in different shards
+	int storage1 = 0;
+	int storage2 = 0;
+	void* st1 = &storage1;
+	void* st2 = &storage2;
+
+	file_pool fp(2);
+	error_code ec;
+	TEST_CHECK(fp.open_file(st1, cwd, 0, fs, file::read_write, ec));
+	TEST_CHECK(fp.open_file(st1, cwd, 1, fs, file::read_write, ec));
+	TEST_CHECK(is_open(fp, st1, 0));
+	TEST_CHECK(is_open(fp, st1, 1));
+
+	// file 0 is the least recently used one
+	TEST_CHECK(fp.open_file(st2, cwd, 2, fs, file::read_write, ec));
+	TEST_CHECK(!is_open(fp, st1, 0));
+	TEST_CHECK(is_open(fp, st1, 1));
+	TEST_CHECK(is_open(fp, st2, 2));
+
+	// touching file 1 makes file 2 the least recently used one
+	TEST_CHECK(fp.open_file(st1, cwd, 1, fs, file::read_only, ec));
+	TEST_CHECK(fp.open_file(st1, cwd, 0, fs, file::read_write, ec));
+	TEST_CHECK(is_open(fp, st1, 0));
+	TEST_CHECK(is_open(fp, st1, 1));
+	TEST_CHECK(!is_open(fp, st2, 2));
+
+	fp.resize(1);
+	TEST_CHECK(is_open(fp, st1, 0));
+	TEST_CHECK(!is_open(fp, st1, 1));
+
+	fp.release();
+	TEST_CHECK(!is_open(fp, st1, 0));
+	remove_all(combine_path(cwd, "file_pool_test"), ec);
+}
+
+TORRENT_TEST(release_storage)
+{
+	std::string const cwd = current_working_directory();
+	file_storage fs = make_files(combine_path(cwd, "file_pool_test"), 3);
+
+	int storage1 = 0;
+	int storage2 = 0;
+	void* st1 = &storage1;
+	void* st2 = &storage2;
+
+	file_pool fp(10);
+	error_code ec;
+	TEST_CHECK(fp.open_file(st1, cwd, 0, fs, file::read_write, ec));
+	TEST_CHECK(fp.open_file(st1, cwd, 1, fs, file::read_write, ec));
+	TEST_CHECK(fp.open_file(st2, cwd, 2, fs, file::read_write, ec));
+
+	std::vector<pool_file_status> status;
+	fp.get_status(&status, st1);
+	TEST_EQUAL(status.size(), 2);
+	if (status.size() == 2)
+	{
+		// reported in file index order
+		TEST_EQUAL(status[0].file_index, 0);
+		TEST_EQUAL(status[1].file_index, 1);
+	}
+
+	fp.release(st1);
+	TEST_CHECK(!is_open(fp, st1, 0));
+	TEST_CHECK(!is_open(fp, st1, 1));
+	TEST_CHECK(is_open(fp, st2, 2));
+
+	fp.release(st2, 2);
+	TEST_CHECK(!is_open(fp, st2, 2));
+	remove_all(combine_path(cwd, "file_pool_test"), ec);
+}
+
+TORRENT_TEST(default_size_limit)
+{
+	TEST_CHECK(file_pool::default_size_limit() >= 40);
+}
+
@@ -304,6 +304,40 @@ TORRENT_TEST(optimize_pad_fillers)
 	TEST_EQUAL(fs.pad_file_at(3), false);
 }
 
+// directories are interned, files in the same directory share one entry in
+// paths() no matter in which order they are added
+TORRENT_TEST(interned_paths)
+{
+	file_storage fs;
+	char dir[50];
+	char name[50];
+	for (int i = 0; i < 3000; ++i)
+	{
+		snprintf(dir, sizeof(dir), "dir%d", i % 1000);
+		snprintf(name, sizeof(name), "file%d", i);
+		fs.add_file(combine_path("test", combine_path(dir, name)), 1);
+	}
+	TEST_EQUAL(fs.paths().size(), 1000);
+	TEST_EQUAL(fs.file_path(2999), combine_path("test", combine_path("dir999", "file2999")));
+
+	// copies keep finding the directories they already have
+	file_storage copy(fs);
+	copy.add_file(combine_path("test", combine_path("dir5", "extra")), 1);
+	TEST_EQUAL(copy.paths().size(), 1000);
+	copy.add_file(combine_path("test", combine_path("dir1000", "extra")), 1);
+	TEST_EQUAL(copy.paths().size(), 1001);
+
+	fs.swap(copy);
+	TEST_EQUAL(fs.num_files(), 3002);
+	fs.rename_file(0, combine_path("test", combine_path("dir1000", "renamed")));
+	TEST_EQUAL(fs.paths().size(), 1001);
+	TEST_EQUAL(fs.file_path(0), combine_path("test", combine_path("dir1000", "renamed")));
+
+	copy = fs;
+	copy.add_file(combine_path("test", combine_path("dir7", "extra")), 1);
+	TEST_EQUAL(copy.paths().size(), 1001);
+}
+
 // TODO: add more optimize() tests
 // TODO: test map_block
 // TODO: test piece_size(int piece)
@@ -31,8 +31,12 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "libtorrent/hasher.hpp"
+#include "libtorrent/sha1.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
 #include "libtorrent/hex.hpp" // from_hex
 
+#include <vector>
+
 #include "test.hpp"
 
 using namespace libtorrent;
@@ -75,3 +79,117 @@ TORRENT_TEST(hasher)
 	}
 }
 
+
+namespace {
+
+	// hash every buffer both one at a time (fed in odd sized chunks) and
+	// through SHA1_multi(), with the given CPU features enabled
+	void hash_buffers(std::vector<std::vector<boost::uint8_t> > const& bufs
+		, bool sha, bool avx2
+		, std::vector<sha1_hash>& single
+		, std::vector<sha1_hash>& multi)
+	{
+		bool const sha_save = aux::sha_support;
+		bool const avx2_save = aux::avx2_support;
+		aux::sha_support = sha;
+		aux::avx2_support = avx2;
+
+		single.resize(bufs.size());
+		multi.resize(bufs.size());
+
+		std::vector<boost::uint8_t const*> data;
+		std::vector<boost::uint32_t> len;
+		for (int i = 0; i < int(bufs.size()); ++i)
+		{
+			sha_ctx ctx;
+			SHA1_init(&ctx);
+			int const chunk = 77;
+			for (int pos = 0; pos < int(bufs[i].size()); pos += chunk)
+			{
+				int const n = (std::min)(chunk, int(bufs[i].size()) - pos);
+				SHA1_update(&ctx, &bufs[i][pos], n);
+			}
+			SHA1_final(single[i].begin(), &ctx);
+
+			data.push_back(bufs[i].empty() ? NULL : &bufs[i][0]);
+			len.push_back(boost::uint32_t(bufs[i].size()));
+		}
+
+		std::vector<boost::uint8_t> digests(bufs.size() * 20);
+		SHA1_multi(&data[0], &len[0], &digests[0], int(bufs.size()));
+		for (int i = 0; i < int(bufs.size()); ++i)
+			multi[i].assign(reinterpret_cast<char const*>(&digests[i * 20]));
+
+		aux::sha_support = sha_save;
+		aux::avx2_support = avx2_save;
+	}
+}
+
+TORRENT_TEST(sha1_test_vectors)
+{
+	for (int test = 0; test < 4; ++test)
+	{
+		sha_ctx ctx;
+		SHA1_init(&ctx);
+		for (int i = 0; i < repeat_count[test]; ++i)
+		{
+			SHA1_update(&ctx, reinterpret_cast<boost::uint8_t const*>(test_array[test])
+				, std::strlen(test_array[test]));
+		}
+
+		sha1_hash result;
+		sha1_hash expected;
+		SHA1_final(result.begin(), &ctx);
+		from_hex(result_array[test], 40, (char*)&expected[0]);
+		TEST_EQUAL(result, expected);
+	}
+}
+
+TORRENT_TEST(sha1_kernels)
+{
+	// sizes around the block and padding boundaries, and some piece sized
+	// buffers (of different lengths, to exercise the lane masking in the
+	// multi-buffer kernel)
+	int const sizes[] = { 0, 1, 3, 55, 56, 57, 63, 64, 65, 119, 120, 127
+		, 128, 129, 1000, 16384, 16384 + 13, 65536, 65536, 65536, 65536 - 1
+		, 65536, 65536, 65536, 262144 };
+	int const num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+	std::vector<std::vector<boost::uint8_t> > bufs;
+	boost::uint32_t seed = 0x1337;
+	for (int i = 0; i < num_sizes; ++i)
+	{
+		bufs.push_back(std::vector<boost::uint8_t>(sizes[i]));
+		for (int k = 0; k < sizes[i]; ++k)
+		{
+			seed = seed * 1103515245 + 12345;
+			bufs.back()[k] = boost::uint8_t(seed >> 16);
+		}
+	}
+
+	std::vector<sha1_hash> ref_single;
+	std::vector<sha1_hash> ref_multi;
+	hash_buffers(bufs, false, false, ref_single, ref_multi);
+	TEST_CHECK(ref_single == ref_multi);
+
+	// the kernels are only exercised if this CPU supports them. The
+	// reference implementation is always the portable one
+	std::vector<sha1_hash> single;
+	std::vector<sha1_hash> multi;
+	hash_buffers(bufs, aux::sha_support, false, single, multi);
+	TEST_CHECK(single == ref_single);
+	TEST_CHECK(multi == ref_single);
+
+	hash_buffers(bufs, false, aux::avx2_support, single, multi);
+	TEST_CHECK(single == ref_single);
+	TEST_CHECK(multi == ref_single);
+
+	// fewer buffers than lanes
+	std::vector<std::vector<boost::uint8_t> > few(bufs.begin() + 10, bufs.begin() + 13);
+	hash_buffers(few, false, aux::avx2_support, single, multi);
+	for (int i = 0; i < int(few.size()); ++i)
+	{
+		TEST_EQUAL(single[i], ref_single[10 + i]);
+		TEST_EQUAL(multi[i], ref_single[10 + i]);
+	}
+}
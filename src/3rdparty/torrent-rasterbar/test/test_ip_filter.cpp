@@ -37,6 +37,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "settings.hpp"
 #include "libtorrent/socket_io.hpp"
 #include "libtorrent/session.hpp"
+#include "libtorrent/file.hpp" // for combine_path
+#include "setup_transfer.hpp" // for load_file
+#include <cstdlib>
+#include <cstdio>
 
 /*
 
@@ -301,3 +305,204 @@ TORRENT_TEST(ip_filter)
 	TEST_CHECK(pf.access(65535) == 0);
 }
 
+
+namespace {
+
+address_v4 random_v4()
+{
+	return address_v4((boost::uint32_t(std::rand() & 0xffff) << 16)
+		| boost::uint32_t(std::rand() & 0xffff));
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(batched_rules)
+{
+	// rules are merged lazily, in batches. The result must be the same as
+	// applying them one at a time
+	std::srand(0x1337);
+	for (int round = 0; round < 20; ++round)
+	{
+		ip_filter f1;
+		ip_filter f2;
+		for (int i = 0; i < 300; ++i)
+		{
+			address_v4 a = random_v4();
+			// mix short ranges, which tend to be adjacent or overlap, with
+			// long ones
+			address_v4 b = (i % 2) ? address_v4(a.to_ulong() + std::rand() % 4)
+				: random_v4();
+			if (b < a) std::swap(a, b);
+			// mostly runs of blocked rules, with the odd other flag in between
+			int const flags = (std::rand() % 10 == 0) ? std::rand() % 3 : ip_filter::blocked;
+			f1.add_rule(a, b, flags);
+			// querying the filter applies the queued rule
+			f1.access(a);
+			f2.add_rule(a, b, flags);
+		}
+		if (round == 0)
+		{
+			error_code ec;
+			f1.add_rule(IP4("0.0.0.0"), IP4("0.0.0.10"), ip_filter::blocked);
+			f1.access(IP4("0.0.0.0"));
+			f1.add_rule(IP4("255.255.255.0"), IP4("255.255.255.255"), ip_filter::blocked);
+			f2.add_rule(IP4("0.0.0.0"), IP4("0.0.0.10"), ip_filter::blocked);
+			f2.add_rule(IP4("255.255.255.0"), IP4("255.255.255.255"), ip_filter::blocked);
+		}
+
+#if TORRENT_USE_IPV6
+		std::vector<ip_range<address_v4> > r1 = boost::get<0>(f1.export_filter());
+		std::vector<ip_range<address_v4> > r2 = boost::get<0>(f2.export_filter());
+#else
+		std::vector<ip_range<address_v4> > r1 = f1.export_filter();
+		std::vector<ip_range<address_v4> > r2 = f2.export_filter();
+#endif
+		TEST_EQUAL(r1.size(), r2.size());
+		TEST_CHECK(r1 == r2);
+		test_rules_invariant(r2, f2);
+	}
+}
+
+TORRENT_TEST(port_filter_model)
+{
+	// the port space is small enough to check every value against a plain
+	// array
+	std::srand(0x4242);
+	for (int round = 0; round < 10; ++round)
+	{
+		std::vector<int> model(65536, 0);
+		port_filter pf;
+		for (int i = 0; i < 100; ++i)
+		{
+			int first = std::rand() % 65536;
+			int last = (i % 3) ? first + std::rand() % 50 : std::rand() % 65536;
+			if (last > 65535) last = 65535;
+			if (last < first) std::swap(first, last);
+			int const flags = (i % 7 == 0) ? 0 : (std::rand() % 4 == 0 ? 2 : 1);
+			pf.add_rule(boost::uint16_t(first), boost::uint16_t(last), flags);
+			std::fill(model.begin() + first, model.begin() + last + 1, flags);
+			// query in the middle of the batch every now and then
+			if (std::rand() % 20 == 0) pf.access(0);
+		}
+		for (int p = 0; p < 65536; ++p)
+		{
+			if (pf.access(boost::uint16_t(p)) == model[p]) continue;
+			TEST_EQUAL(pf.access(boost::uint16_t(p)), model[p]);
+			break;
+		}
+	}
+}
+
+TORRENT_TEST(parse_blocklist)
+{
+	char const list[] =
+		"# comment\r\n"
+		"// another comment\n"
+		"\n"
+		"Some Org:1.2.3.0-1.2.3.255\n"
+		"Org with a - dash: and colon:10.0.0.0-10.0.255.255\r\n"
+		"001.002.004.000 - 001.002.004.255 , 000 , eMule entry\n"
+		"001.002.005.000 - 001.002.005.255 , 200 , allowed by level\n"
+		"002.000.000.000 - 002.000.000.010\n"
+		"not a range\n"
+		"Backwards:9.9.9.9-9.9.9.0\n"
+#if TORRENT_USE_IPV6
+		"2001:db8:: - 2001:db8::ffff , 100 , v6 entry\n"
+#endif
+		"Last:200.1.1.1-200.1.1.2";
+
+	ip_filter f;
+	error_code ec;
+	int const num = parse_blocklist(list, sizeof(list) - 1, f, ec);
+	TEST_CHECK(!ec);
+#if TORRENT_USE_IPV6
+	TEST_EQUAL(num, 6);
+#else
+	TEST_EQUAL(num, 5);
+#endif
+
+	TEST_EQUAL(f.access(IP("1.2.2.255")), 0);
+	TEST_EQUAL(f.access(IP("1.2.3.0")), ip_filter::blocked);
+	TEST_EQUAL(f.access(IP("1.2.3.255")), ip_filter::blocked);
+	TEST_EQUAL(f.access(IP("10.0.128.1")), ip_filter::blocked);
+	TEST_EQUAL(f.access(IP("10.1.0.0")), 0);
+	TEST_EQUAL(f.access(IP("1.2.4.100")), ip_filter::blocked);
+	TEST_EQUAL(f.access(IP("1.2.5.100")), 0);
+	TEST_EQUAL(f.access(IP("2.0.0.10")), ip_filter::blocked);
+	TEST_EQUAL(f.access(IP("2.0.0.11")), 0);
+	TEST_EQUAL(f.access(IP("9.9.9.5")), 0);
+	TEST_EQUAL(f.access(IP("200.1.1.2")), ip_filter::blocked);
+#if TORRENT_USE_IPV6
+	TEST_EQUAL(f.access(IP("2001:db8::1")), ip_filter::blocked);
+	TEST_EQUAL(f.access(IP("2001:db8::1:0")), 0);
+#endif
+}
+
+TORRENT_TEST(parse_blocklist_gzip)
+{
+	std::vector<char> zipped;
+	error_code ec;
+	load_file(combine_path("..", "blocklist.p2p.gz"), zipped, ec, 1000000);
+	TEST_CHECK(!ec);
+	if (ec) return;
+
+	ip_filter f;
+	int const num = parse_blocklist(&zipped[0], int(zipped.size()), f, ec);
+	TEST_CHECK(!ec);
+	TEST_EQUAL(num, 2);
+	TEST_EQUAL(f.access(IP("1.2.3.4")), ip_filter::blocked);
+	TEST_EQUAL(f.access(IP("10.0.1.1")), ip_filter::blocked);
+	TEST_EQUAL(f.access(IP("10.1.0.0")), 0);
+
+	// a corrupt gzip stream is an error
+	zipped.resize(zipped.size() / 2);
+	ip_filter f2;
+	TEST_EQUAL(parse_blocklist(&zipped[0], int(zipped.size()), f2, ec), -1);
+	TEST_CHECK(ec);
+}
+
+TORRENT_TEST(ip_filter_cache)
+{
+	error_code ec;
+	ip_filter f;
+	f.add_rule(IP("1.0.0.0"), IP("1.255.255.255"), ip_filter::blocked);
+	f.add_rule(IP("5.5.5.5"), IP("5.5.5.5"), ip_filter::blocked);
+#if TORRENT_USE_IPV6
+	f.add_rule(IP("2001:db8::"), IP("2001:db8::ffff"), ip_filter::blocked);
+#endif
+
+	f.save_cache("ip_filter.cache", ec);
+	TEST_CHECK(!ec);
+
+	ip_filter f2;
+	TEST_CHECK(f2.load_cache("ip_filter.cache", ec));
+	TEST_CHECK(!ec);
+#if TORRENT_USE_IPV6
+	TEST_CHECK(boost::get<0>(f.export_filter()) == boost::get<0>(f2.export_filter()));
+	TEST_CHECK(boost::get<1>(f.export_filter()) == boost::get<1>(f2.export_filter()));
+	TEST_EQUAL(f2.access(IP("2001:db8::5")), ip_filter::blocked);
+#else
+	TEST_CHECK(f.export_filter() == f2.export_filter());
+#endif
+	TEST_EQUAL(f2.access(IP("1.2.3.4")), ip_filter::blocked);
+	TEST_EQUAL(f2.access(IP("5.5.5.5")), ip_filter::blocked);
+	TEST_EQUAL(f2.access(IP("5.5.5.6")), 0);
+
+	// a truncated cache is rejected and leaves the filter alone
+	std::vector<char> buf;
+	load_file("ip_filter.cache", buf, ec, 1000000);
+	TEST_CHECK(!ec);
+	FILE* out = fopen("ip_filter.cache", "wb");
+	fwrite(&buf[0], 1, buf.size() - 3, out);
+	fclose(out);
+
+	ip_filter f3;
+	f3.add_rule(IP("7.7.7.7"), IP("7.7.7.7"), ip_filter::blocked);
+	TEST_CHECK(!f3.load_cache("ip_filter.cache", ec));
+	TEST_CHECK(ec);
+	TEST_EQUAL(f3.access(IP("7.7.7.7")), ip_filter::blocked);
+	TEST_EQUAL(f3.access(IP("1.2.3.4")), 0);
+
+	TEST_CHECK(!f3.load_cache("does-not-exist.cache", ec));
+	TEST_CHECK(ec);
+}
@@ -973,6 +973,47 @@ TORRENT_TEST(new_peer_size_limit)
 		, 5);
 }
 
+// connect candidates are handed out best first, by failcount and then by
+// where we heard about them (tracker, dht, pex, in that order). They're all
+// at the end of a long list of failed peers, and still expected to be found
+TORRENT_TEST(connect_candidates_order)
+{
+	torrent_state st = init_state(ext_ip);
+	mock_torrent t(&st);
+	peer_list p(allocator);
+	t.m_p = &p;
+
+	int const sources[] = { peer_info::pex, peer_info::dht, peer_info::tracker };
+	for (int i = 0; i < 600; ++i)
+	{
+		torrent_peer* peer = p.add_peer(tcp::endpoint(
+			address_v4((10 << 24) + (i << 8) + 1), 6881), sources[i % 3], 0, &st);
+		TEST_CHECK(peer);
+		if (peer == NULL) continue;
+		p.set_failcount(peer, i < 580 ? st.max_failcount : (i / 3) % 3);
+	}
+	TEST_EQUAL(p.num_peers(), 600);
+	TEST_EQUAL(p.num_connect_candidates(), 20);
+
+	int prev_failcount = 0;
+	int prev_source = 0;
+	int connected = 0;
+	while (torrent_peer* tp = p.connect_one_peer(0, &st))
+	{
+		TEST_CHECK(int(tp->failcount) >= prev_failcount);
+		if (int(tp->failcount) == prev_failcount)
+			TEST_CHECK(int(tp->source) >= prev_source);
+		prev_failcount = tp->failcount;
+		prev_source = tp->source;
+
+		t.connect_to_peer(tp);
+		st.erased.clear();
+		++connected;
+	}
+	TEST_EQUAL(connected, 20);
+	TEST_EQUAL(p.num_connect_candidates(), 0);
+}
+
 // TODO: test erasing peers
 // TODO: test update_peer_port with allow_multiple_connections_per_ip and without
 // TODO: test add i2p peers
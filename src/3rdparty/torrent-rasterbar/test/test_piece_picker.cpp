@@ -1892,6 +1892,34 @@ TORRENT_TEST(piece_picker)
 		TEST_EQUAL(blocks[3].state, piece_picker::block_info::state_none);
 	}
 
+	{
+		print_title("test mark_as_pad out of order");
+
+		p = setup_picker("1111111", "       ", "4444444", "");
+		p->mark_as_pad(piece_block(5, 3));
+		p->mark_as_pad(piece_block(1, 0));
+		p->mark_as_pad(piece_block(3, 2));
+		p->mark_as_pad(piece_block(1, 2));
+		p->mark_as_pad(piece_block(1, 2));
+
+		TEST_EQUAL(p->pad_blocks_in_piece(0), 0);
+		TEST_EQUAL(p->pad_blocks_in_piece(1), 2);
+		TEST_EQUAL(p->pad_blocks_in_piece(3), 1);
+		TEST_EQUAL(p->pad_blocks_in_piece(5), 1);
+		TEST_CHECK(p->is_pad(piece_block(1, 0)));
+		TEST_CHECK(!p->is_pad(piece_block(1, 1)));
+		TEST_CHECK(p->is_pad(piece_block(1, 2)));
+		TEST_CHECK(p->is_pad(piece_block(3, 2)));
+		TEST_CHECK(p->is_pad(piece_block(5, 3)));
+		TEST_CHECK(!p->is_pad(piece_block(6, 3)));
+
+		// the whole piece, marked backwards
+		for (int i = 3; i >= 0; --i) p->mark_as_pad(piece_block(4, i));
+		TEST_EQUAL(p->pad_blocks_in_piece(4), 4);
+		TEST_CHECK(p->have_piece(4));
+		TEST_EQUAL(p->num_have(), 1);
+	}
+
 	{
 		print_title("test mark_as_pad downloading");
 
@@ -1957,3 +1985,74 @@ TORRENT_TEST(piece_picker)
 	}
 }
 
+
+// the bitfield versions of inc_refcount() and dec_refcount() must leave the
+// picker in the same state as updating the pieces one at a time, whether they
+// take the path updating a few pieces or the one rebuilding the whole picker
+TORRENT_TEST(bitfield_refcount)
+{
+	// not a multiple of 32, to cover the last, partial word
+	const int num_pieces = 1003;
+	torrent_peer* peers[10] = { &tmp0, &tmp1, &tmp2
+		, &tmp3, &tmp4, &tmp5, &tmp6, &tmp7, &tmp8, &tmp9 };
+
+	piece_picker bulk;
+	piece_picker single;
+	bulk.init(blocks_per_piece, blocks_per_piece, num_pieces);
+	single.init(blocks_per_piece, blocks_per_piece, num_pieces);
+
+	// from a handful of pieces to nearly all of them
+	std::vector<bitfield> have(10);
+	for (int i = 0; i < 10; ++i)
+	{
+		have[i].resize(num_pieces, false);
+		int const density = i < 3 ? 1000 : 10 - i;
+		for (int k = 0; k < num_pieces; ++k)
+			if (libtorrent::random() % density == 0) have[i].set_bit(k);
+	}
+
+	for (int i = 0; i < 10; ++i)
+	{
+		bulk.inc_refcount(have[i], peers[i]);
+		for (int k = 0; k < num_pieces; ++k)
+			if (have[i][k]) single.inc_refcount(k, peers[i]);
+	}
+
+	for (int i = 0; i < 10; i += 2)
+	{
+		bulk.dec_refcount(have[i], peers[i]);
+		for (int k = 0; k < num_pieces; ++k)
+			if (have[i][k]) single.dec_refcount(k, peers[i]);
+	}
+
+	std::vector<int> bulk_avail;
+	std::vector<int> single_avail;
+	bulk.get_availability(bulk_avail);
+	single.get_availability(single_avail);
+	TEST_CHECK(bulk_avail == single_avail);
+
+	// the order pieces are picked in is only defined by their availability,
+	// pieces that are equally rare may come in any order
+	bitfield all(num_pieces, true);
+	std::vector<int> bulk_order;
+	std::vector<int> single_order;
+	for (int j = 0; j < 2; ++j)
+	{
+		piece_picker& p = j == 0 ? bulk : single;
+		std::vector<int>& order = j == 0 ? bulk_order : single_order;
+		std::vector<piece_block> picked;
+		counters pc;
+		p.pick_pieces(all, picked, num_pieces * blocks_per_piece, 0, &tmp0
+			, piece_picker::rarest_first, empty_vector, 20, pc);
+		for (std::vector<piece_block>::iterator i = picked.begin()
+			, end(picked.end()); i != end; ++i)
+		{
+			if (i->block_index != 0) continue;
+			order.push_back(bulk_avail[i->piece_index]);
+		}
+	}
+	TEST_EQUAL(int(bulk_order.size()), num_pieces);
+	TEST_CHECK(bulk_order == single_order);
+	for (int i = 1; i < int(bulk_order.size()); ++i)
+		TEST_CHECK(bulk_order[i - 1] <= bulk_order[i]);
+}
@@ -487,6 +487,116 @@ void test_check_files(std::string const& test_path
 	io.set_num_threads(0);
 }
 
+struct check_pieces_result
+{
+	int ret;
+	int num_hashed;
+	storage_error error;
+	std::vector<sha1_hash> hashes;
+};
+
+void on_check_pieces(disk_io_job const* j, check_pieces_result* r, bool* done)
+{
+	std::cerr << time_now_string() << " on_check_pieces ret: " << j->ret
+		<< " hashed: " << j->d.check.num_hashed << std::endl;
+	r->ret = j->ret;
+	r->num_hashed = j->d.check.num_hashed;
+	r->error = j->error;
+	for (int i = 0; i < j->d.check.num_hashed; ++i)
+		r->hashes.push_back(sha1_hash(j->buffer.piece_hashes + i * 20));
+	*done = true;
+}
+
+TORRENT_TEST(check_pieces)
+{
+	std::string test_path = current_working_directory();
+	error_code ec;
+	const int piece_size = 16 * 1024;
+	remove_all(combine_path(test_path, "temp_storage"), ec);
+	file_storage fs;
+	fs.add_file("temp_storage/test1.tmp", piece_size);
+	fs.add_file("temp_storage/test2.tmp", piece_size * 2);
+	fs.add_file("temp_storage/test3.tmp", piece_size);
+	fs.add_file("temp_storage/test4.tmp", piece_size + 100);
+	fs.set_piece_length(piece_size);
+	fs.set_num_pieces(int((fs.total_size() + piece_size - 1) / piece_size));
+
+	buf_ptr piece0 = new_piece(piece_size);
+	buf_ptr piece3 = new_piece(piece_size);
+	buf_ptr piece4 = new_piece(piece_size + 100);
+
+	create_directory(combine_path(test_path, "temp_storage"), ec);
+	if (ec) std::cerr << "create_directory: " << ec.message() << std::endl;
+
+	// test2.tmp is missing
+	std::ofstream f;
+	f.open(combine_path(test_path, combine_path("temp_storage", "test1.tmp")).c_str()
+		, std::ios::trunc | std::ios::binary);
+	f.write(piece0.get(), piece_size);
+	f.close();
+	f.open(combine_path(test_path, combine_path("temp_storage", "test3.tmp")).c_str()
+		, std::ios::trunc | std::ios::binary);
+	f.write(piece3.get(), piece_size);
+	f.close();
+	f.open(combine_path(test_path, combine_path("temp_storage", "test4.tmp")).c_str()
+		, std::ios::trunc | std::ios::binary);
+	f.write(piece4.get(), piece_size + 100);
+	f.close();
+
+	file_pool fp;
+	boost::asio::io_service ios;
+	counters cnt;
+	disk_io_thread io(ios, cnt, NULL);
+	io.set_num_threads(1);
+	storage_params p;
+	p.files = &fs;
+	p.path = test_path;
+	p.pool = &fp;
+	p.mode = storage_mode_sparse;
+
+	boost::shared_ptr<void> dummy;
+	boost::shared_ptr<piece_manager> pm = boost::make_shared<piece_manager>(new default_storage(p), dummy, &fs);
+
+	// the extent covers the missing file. The pieces before it are hashed and
+	// the error refers to the first piece of the missing file
+	bool done = false;
+	check_pieces_result r;
+	io.async_check_pieces(pm.get(), 0, 4, disk_io_job::sequential_access
+		, boost::bind(&on_check_pieces, _1, &r, &done));
+	io.submit_jobs();
+	ios.reset();
+	run_until(ios, done);
+
+	TEST_EQUAL(r.ret, -1);
+	TEST_EQUAL(r.num_hashed, 1);
+	TEST_EQUAL(r.error.ec, boost::system::errc::no_such_file_or_directory);
+	TEST_EQUAL(r.error.file, 1);
+	TEST_EQUAL(r.hashes.size(), 1);
+	if (r.hashes.size() == 1)
+		TEST_EQUAL(r.hashes[0], hasher(piece0.get(), piece_size).final());
+
+	// the extent spans two files, and ends with a short piece
+	done = false;
+	r = check_pieces_result();
+	io.async_check_pieces(pm.get(), 3, 3, disk_io_job::sequential_access
+		, boost::bind(&on_check_pieces, _1, &r, &done));
+	io.submit_jobs();
+	ios.reset();
+	run_until(ios, done);
+
+	TEST_EQUAL(r.ret, 0);
+	TEST_EQUAL(r.num_hashed, 3);
+	TEST_EQUAL(r.hashes.size(), 3);
+	if (r.hashes.size() == 3)
+	{
+		TEST_EQUAL(r.hashes[0], hasher(piece3.get(), piece_size).final());
+		TEST_EQUAL(r.hashes[1], hasher(piece4.get(), piece_size).final());
+		TEST_EQUAL(r.hashes[2], hasher(piece4.get() + piece_size, 100).final());
+	}
+
+	io.set_num_threads(0);
+}
+
 // TODO: 2 split this test up into smaller parts
 void run_test(bool unbuffered)
 {
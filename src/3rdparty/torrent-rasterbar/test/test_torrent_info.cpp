@@ -1011,3 +1011,36 @@ TORRENT_TEST(copy)
 }
 
 
+
+TORRENT_TEST(large_file_list)
+{
+	// more files than fit in the default bdecode token limit. Loading a
+	// .torrent file uses the larger torrent_file_token_limit
+	file_storage fs;
+	char path[100];
+	for (int i = 0; i < 150000; ++i)
+	{
+		snprintf(path, sizeof(path), "test/dir-%d/file-%d", i % 100, i);
+		fs.add_file(path, 1);
+	}
+
+	libtorrent::create_torrent t(fs, 0x4000);
+	sha1_hash ph;
+	for (int i = 0; i < t.num_pieces(); ++i)
+		t.set_hash(i, ph);
+
+	std::vector<char> tmp;
+	bencode(std::back_inserter(tmp), t.generate());
+
+	bdecode_node n;
+	error_code ec;
+	bdecode(&tmp[0], &tmp[0] + tmp.size(), n, ec);
+	TEST_EQUAL(ec, error_code(bdecode_errors::limit_exceeded, get_bdecode_category()));
+
+	ec.clear();
+	torrent_info ti(&tmp[0], tmp.size(), ec);
+	TEST_CHECK(!ec);
+	TEST_EQUAL(ti.num_files(), 150000);
+	TEST_EQUAL(ti.files().file_path(149999), combine_path("test", combine_path("dir-99", "file-149999")));
+	TEST_EQUAL(ti.files().paths().size(), 100);
+}
@@ -409,6 +409,77 @@ TORRENT_TEST(udp_tracker_v6)
 }
 #endif
 
+// scrapes of many torrents to the same UDP tracker share one connection ID and
+// go out as multi-info-hash requests
+TORRENT_TEST(udp_tracker_scrape_batch)
+{
+	int const udp_port = start_udp_tracker(address_v4::from_string("127.0.0.1"));
+	int const num_torrents = 100;
+
+	int const prev_connects = num_udp_connects();
+	int const prev_scrapes = num_udp_scrapes();
+	int const prev_hashes = num_udp_scraped_hashes();
+
+	settings_pack pack = settings();
+	pack.set_str(settings_pack::listen_interfaces, "127.0.0.1:48875");
+	boost::scoped_ptr<lt::session> s(new lt::session(pack));
+
+	char tracker_url[200];
+	snprintf(tracker_url, sizeof(tracker_url), "udp://127.0.0.1:%d/announce", udp_port);
+
+	std::vector<torrent_handle> handles;
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		char name[50];
+		snprintf(name, sizeof(name), "temporary_%d", i);
+		boost::shared_ptr<torrent_info> t = ::create_torrent(NULL, name, 16 * 1024, 1, false);
+		t->add_tracker(tracker_url, 0);
+
+		// paused, so they only talk to the tracker when we scrape
+		add_torrent_params addp;
+		addp.flags |= add_torrent_params::flag_paused;
+		addp.flags &= ~add_torrent_params::flag_auto_managed;
+		addp.ti = t;
+		addp.save_path = ".";
+		handles.push_back(s->add_torrent(addp));
+	}
+
+	for (int i = 0; i < num_torrents; ++i)
+		handles[i].scrape_tracker();
+
+	int replies = 0;
+	for (int i = 0; i < 50 && replies < num_torrents; ++i)
+	{
+		std::vector<alert*> alerts;
+		s->pop_alerts(&alerts);
+		for (std::vector<alert*>::iterator a = alerts.begin(); a != alerts.end(); ++a)
+		{
+			scrape_reply_alert const* sr = alert_cast<scrape_reply_alert>(*a);
+			if (sr == NULL) continue;
+			TEST_EQUAL(sr->complete, 5);
+			TEST_EQUAL(sr->incomplete, 2);
+			++replies;
+		}
+		if (replies < num_torrents) test_sleep(100);
+	}
+
+	int const connects = num_udp_connects() - prev_connects;
+	int const scrapes = num_udp_scrapes() - prev_scrapes;
+	std::printf("scrape replies: %d connects: %d scrape requests: %d\n"
+		, replies, connects, scrapes);
+
+	TEST_EQUAL(replies, num_torrents);
+	TEST_EQUAL(num_udp_scraped_hashes() - prev_hashes, num_torrents);
+	TEST_CHECK(connects <= 1);
+	// 74 info-hashes fit in one request. Depending on how the name lookups
+	// finish, the scrapes may be split over a few more
+	TEST_CHECK(scrapes >= 2);
+	TEST_CHECK(scrapes <= 6);
+
+	s.reset();
+	stop_udp_tracker();
+}
+
 TORRENT_TEST(http_peers)
 {
 	int http_port = start_web_server();
@@ -448,6 +448,44 @@ TORRENT_TEST(coalesce_writes)
 }
 
 
+TORRENT_TEST(zero_copy_send)
+{
+	using namespace libtorrent;
+	// send the payload with sendfile(), where supported. Blocks in the read
+	// cache are sent from memory, so keep them out of it
+	settings_pack p;
+	p.set_bool(settings_pack::zero_copy_send, true);
+	p.set_bool(settings_pack::use_read_cache, false);
+	test_transfer(0, p, false);
+
+	cleanup();
+}
+
+TORRENT_TEST(zero_copy_send_network_threads)
+{
+	using namespace libtorrent;
+	// the wait for the socket to become writable before a sendfile() is
+	// issued from the peer's network thread, like its reads
+	settings_pack p;
+	p.set_bool(settings_pack::zero_copy_send, true);
+	p.set_bool(settings_pack::use_read_cache, false);
+	p.set_int(settings_pack::network_threads, 4);
+	test_transfer(0, p, false);
+
+	cleanup();
+}
+
+TORRENT_TEST(network_threads)
+{
+	using namespace libtorrent;
+	// issue socket reads and writes from a pool of network threads
+	settings_pack p;
+	p.set_int(settings_pack::network_threads, 4);
+	test_transfer(0, p, false);
+
+	cleanup();
+}
+
 TORRENT_TEST(allocate)
 {
 	using namespace libtorrent;
@@ -0,0 +1,185 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/udp_socket.hpp"
+#include "libtorrent/io_service.hpp"
+#include "libtorrent/deadline_timer.hpp"
+#include "libtorrent/socket.hpp"
+#include "libtorrent/address.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/error_code.hpp"
+
+#include <boost/bind.hpp>
+#include <cstring>
+#include <vector>
+
+using namespace libtorrent;
+
+namespace {
+
+	int reply_size(int i) { return i % 3 == 2 ? 200 : 500; }
+
+	// answers every request with three packets, two full ones and a short
+	// one, like a uTP socket sending data. With batched I/O they're sent while
+	// the requests are handled, so they're queued and coalesced
+	struct responder : udp_socket_observer
+	{
+		explicit responder(udp_socket& s) : sock(s) {}
+
+		virtual bool incoming_packet(error_code const& ec
+			, udp::endpoint const& ep, char const* buf, int size)
+		{
+			if (ec || size < 4) return false;
+			boost::uint32_t seq;
+			std::memcpy(&seq, buf, 4);
+			char reply[500];
+			std::memset(reply, 'x', sizeof(reply));
+			for (int i = 0; i < 3; ++i)
+			{
+				boost::uint32_t const r = seq * 3 + i;
+				std::memcpy(reply, &r, 4);
+				error_code err;
+				sock.send(ep, reply, reply_size(i), err);
+			}
+			return true;
+		}
+
+		udp_socket& sock;
+	};
+
+	struct collector : udp_socket_observer
+	{
+		collector(io_service& i, int n) : ios(i), expected(n) {}
+
+		virtual bool incoming_packet(error_code const& ec
+			, udp::endpoint const&, char const* buf, int size)
+		{
+			if (ec || size < 4) return false;
+			boost::uint32_t seq;
+			std::memcpy(&seq, buf, 4);
+			received.push_back(seq);
+			sizes.push_back(size);
+			if (int(received.size()) == expected) ios.stop();
+			return true;
+		}
+
+		io_service& ios;
+		int expected;
+		std::vector<boost::uint32_t> received;
+		std::vector<int> sizes;
+	};
+
+	void on_timeout(error_code const& ec, io_service* ios)
+	{
+		if (!ec) ios->stop();
+	}
+
+	// 32 requests make 96 replies, more than fit in one send batch
+	int const requests_per_round = 32;
+
+	void test_replies(bool batched, int rounds)
+	{
+		io_service ios;
+		error_code ec;
+
+		udp_socket server(ios);
+		server.set_batched_io(batched);
+		server.bind(udp::endpoint(address_v4::loopback(), 0), ec);
+		TEST_CHECK(!ec);
+		responder resp(server);
+		server.subscribe(&resp);
+
+		udp_socket client(ios);
+		client.set_batched_io(false);
+		client.bind(udp::endpoint(address_v4::loopback(), 0), ec);
+		TEST_CHECK(!ec);
+		collector col(ios, 0);
+		client.subscribe(&col);
+
+		udp::endpoint const server_ep(address_v4::loopback(), server.local_port());
+		deadline_timer timeout(ios);
+		boost::uint32_t seq = 0;
+		for (int r = 0; r < rounds; ++r)
+		{
+			// the requests are all waiting when the server first reads, so
+			// they're handled in one batch. Only as many as the client's
+			// receive buffer can take replies to while nobody reads it
+			for (int i = 0; i < requests_per_round; ++i, ++seq)
+			{
+				char req[4];
+				std::memcpy(req, &seq, 4);
+				client.send(server_ep, req, 4, ec);
+				TEST_CHECK(!ec);
+			}
+			col.expected = int(seq) * 3;
+
+			timeout.expires_from_now(seconds(5));
+			timeout.async_wait(boost::bind(&on_timeout, _1, &ios));
+			ios.reset();
+			ios.run();
+			timeout.cancel(ec);
+			if (int(col.received.size()) != col.expected) break;
+		}
+
+		// loopback doesn't drop or reorder, every reply arrives in the order
+		// it was sent
+		TEST_EQUAL(int(col.received.size()), rounds * requests_per_round * 3);
+		for (int i = 0; i < int(col.received.size()); ++i)
+		{
+			TEST_EQUAL(col.received[i], boost::uint32_t(i));
+			TEST_EQUAL(col.sizes[i], reply_size(i));
+		}
+
+		server.unsubscribe(&resp);
+		client.unsubscribe(&col);
+		server.close();
+		client.close();
+		ios.reset();
+		ios.poll(ec);
+	}
+}
+
+TORRENT_TEST(single)
+{
+	test_replies(false, 1);
+}
+
+TORRENT_TEST(batched)
+{
+	test_replies(true, 1);
+}
+
+TORRENT_TEST(batched_many)
+{
+	test_replies(true, 10);
+}
@@ -38,6 +38,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/thread.hpp"
 #include "libtorrent/time.hpp"
 #include "libtorrent/file.hpp"
+#include "libtorrent/packet_pool.hpp"
+#include "libtorrent/random.hpp"
 #include <boost/tuple/tuple.hpp>
 #include <boost/bind.hpp>
 
@@ -45,6 +47,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "setup_transfer.hpp"
 #include <fstream>
 #include <iostream>
+#include <vector>
+#include <cstdlib>
 
 using namespace libtorrent;
 namespace lt = libtorrent;
@@ -150,3 +154,102 @@ TORRENT_TEST(utp)
 	remove_all("./tmp2_utp", ec);
 }
 
+
+TORRENT_TEST(packet_pool)
+{
+	packet_pool pool;
+
+	// packets remember the size they were asked for, not the size of the
+	// size class they were carved from
+	packet* p = pool.acquire(1000);
+	TEST_EQUAL(p->allocated, 1000);
+	pool.release(p);
+	TEST_EQUAL(pool.num_cached(), 1);
+
+	// the buffer is handed out again, for any size in the same class
+	packet* p2 = pool.acquire(1400);
+	TEST_CHECK(p2 == p);
+	TEST_EQUAL(p2->allocated, 1400);
+	TEST_EQUAL(pool.num_allocations(), 1);
+	TEST_EQUAL(pool.num_cached(), 0);
+
+	// smaller packets come from a different class
+	packet* p3 = pool.acquire(20);
+	TEST_CHECK(p3 != p2);
+	TEST_EQUAL(pool.num_allocations(), 2);
+
+	// jumbo packets bypass the cache
+	packet* p4 = pool.acquire(9000);
+	TEST_EQUAL(p4->allocated, 9000);
+	pool.release(p4);
+	TEST_EQUAL(pool.num_cached(), 0);
+
+	pool.release(p3);
+	pool.release(p2);
+	pool.release(NULL);
+	TEST_EQUAL(pool.num_cached(), 2);
+
+	pool.decay();
+	TEST_EQUAL(pool.num_cached(), 0);
+}
+
+namespace {
+
+	// mimics a uTP socket's send window: a window of packets is kept in
+	// flight, and every round some of them are ACKed (released) and
+	// replaced with new ones, with the odd ACK and inbound packet mixed in
+	template <class Alloc, class Free>
+	boost::int64_t churn_packets(Alloc alloc, Free release, int rounds)
+	{
+		int const window = 256;
+		std::vector<packet*> in_flight(window, static_cast<packet*>(NULL));
+		boost::uint32_t seed = 0x1337;
+
+		time_point const start = clock_type::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			seed = seed * 1103515245 + 12345;
+			int const slot = (seed >> 8) % window;
+			release(in_flight[slot]);
+			int const size = (seed >> 4) % 16 == 0 ? 20
+				: (seed >> 4) % 16 == 1 ? 548 : 1452;
+			in_flight[slot] = alloc(size);
+			in_flight[slot]->size = boost::uint16_t(size);
+		}
+		for (int i = 0; i < window; ++i) release(in_flight[i]);
+		return total_microseconds(clock_type::now() - start);
+	}
+
+	int malloc_calls = 0;
+	packet* malloc_packet(int size)
+	{
+		++malloc_calls;
+		packet* p = static_cast<packet*>(std::malloc(sizeof(packet) + size));
+		p->allocated = boost::uint16_t(size);
+		return p;
+	}
+	void free_packet(packet* p) { std::free(p); }
+}
+
+TORRENT_TEST(packet_pool_stress)
+{
+	int const rounds = 2000000;
+
+	packet_pool pool;
+	boost::int64_t const pool_time = churn_packets(
+		boost::bind(&packet_pool::acquire, &pool, _1)
+		, boost::bind(&packet_pool::release, &pool, _1), rounds);
+	boost::int64_t const malloc_time = churn_packets(&malloc_packet
+		, &free_packet, rounds);
+
+	std::printf("packet churn, %d packets:\n"
+		"  malloc/free: %d heap allocations, %" PRId64 " us\n"
+		"  packet_pool: %d heap allocations, %" PRId64 " us\n"
+		, rounds, malloc_calls, malloc_time
+		, int(pool.num_allocations()), pool_time);
+
+	TEST_EQUAL(pool.num_acquired(), rounds);
+	// once the window has been filled, every packet is recycled
+	TEST_CHECK(pool.num_allocations() <= 256 * 3);
+	TEST_CHECK(pool.num_allocations() * 100 < malloc_calls);
+}
@@ -0,0 +1,188 @@
+/*
+
+Copyright (c) 2019, the LIII contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include "libtorrent/udp_socket.hpp"
+#include "libtorrent/io_service.hpp"
+#include "libtorrent/socket.hpp"
+#include "libtorrent/address.hpp"
+#include "libtorrent/thread.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/error_code.hpp"
+
+#include <boost/bind.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#ifndef TORRENT_WINDOWS
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+using namespace libtorrent;
+
+namespace {
+
+	int const packet_size = 1200;
+
+	// the number of packets the client keeps in flight
+	int const window = 64;
+
+	// echoes every packet back to where it came from, like a DHT node
+	// answering requests or a uTP socket acking data
+	struct echo_observer : udp_socket_observer
+	{
+		explicit echo_observer(udp_socket& s) : sock(s), received(0) {}
+
+		virtual bool incoming_packet(error_code const& ec
+			, udp::endpoint const& ep, char const* buf, int size)
+		{
+			if (ec) return false;
+			error_code err;
+			sock.send(ep, buf, size, err);
+			++received;
+			return true;
+		}
+
+		udp_socket& sock;
+		int received;
+	};
+
+	boost::int64_t thread_cpu_microseconds()
+	{
+#if defined RUSAGE_THREAD
+		rusage ru;
+		getrusage(RUSAGE_THREAD, &ru);
+		return boost::int64_t(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000
+			+ ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+#else
+		return 0;
+#endif
+	}
+
+	void run_client(io_service* server_ios, int port, int num_packets, int* echoed)
+	{
+		io_service ios;
+		udp::socket s(ios);
+		error_code ec;
+		s.open(udp::v4(), ec);
+		s.bind(udp::endpoint(address_v4::loopback(), 0), ec);
+		if (ec) return;
+
+		// don't block forever on a lost packet
+#ifdef TORRENT_WINDOWS
+		DWORD timeout = 200;
+#else
+		timeval timeout = { 0, 200000 };
+#endif
+		setsockopt(s.native_handle(), SOL_SOCKET, SO_RCVTIMEO
+			, reinterpret_cast<char const*>(&timeout), sizeof(timeout));
+
+		udp::endpoint const server(address_v4::loopback(), port);
+		std::vector<char> buf(packet_size, 'x');
+		int sent = 0;
+		int in_flight = 0;
+		while (*echoed < num_packets)
+		{
+			while (in_flight < window && sent < num_packets)
+			{
+				s.send_to(boost::asio::buffer(&buf[0], buf.size()), server, 0, ec);
+				++sent;
+				++in_flight;
+			}
+
+			// asio's blocking receive ignores SO_RCVTIMEO, call recv() directly
+			int const ret = recv(s.native_handle(), &buf[0], int(buf.size()), 0);
+			if (ret < 0)
+			{
+				// the rest of the window was lost. Send more to make up for it
+				if (sent == num_packets) break;
+				in_flight = 0;
+				continue;
+			}
+			++*echoed;
+			--in_flight;
+		}
+		server_ios->stop();
+	}
+
+	void bench(char const* name, bool batched, int num_packets)
+	{
+		io_service ios;
+		udp_socket sock(ios);
+		sock.set_batched_io(batched);
+		error_code ec;
+		sock.bind(udp::endpoint(address_v4::loopback(), 0), ec);
+		if (ec)
+		{
+			std::fprintf(stderr, "bind failed: %s\n", ec.message().c_str());
+			return;
+		}
+		echo_observer echo(sock);
+		sock.subscribe(&echo);
+
+		int echoed = 0;
+		boost::int64_t const cpu_start = thread_cpu_microseconds();
+		time_point const start = clock_type::now();
+		thread client(boost::bind(&run_client, &ios, sock.local_port(), num_packets, &echoed));
+
+		ios.run();
+
+		time_point const stop = clock_type::now();
+		boost::int64_t const cpu = thread_cpu_microseconds() - cpu_start;
+		client.join();
+		sock.unsubscribe(&echo);
+		sock.close();
+		ios.reset();
+		ios.poll();
+
+		double const seconds = total_microseconds(stop - start) / 1000000.0;
+		std::fprintf(stderr, "%-10s %9.0f packets/s  server CPU: %5.2f us/packet  (%d of %d echoed)\n"
+			, name, echo.received / seconds
+			, echo.received ? double(cpu) / echo.received : 0.
+			, echoed, num_packets);
+	}
+}
+
+// usage: udp_benchmark [number of packets]
+int main(int argc, char const* argv[])
+{
+	int const num_packets = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+	std::fprintf(stderr, "echoing %d packets of %d bytes over loopback\n"
+		, num_packets, packet_size);
+
+	bench("single", false, num_packets);
+	bench("batched", true, num_packets);
+
+	return 0;
+}
+
@@ -58,6 +58,9 @@ struct udp_tracker
 
 	libtorrent::io_service m_ios;
 	boost::detail::atomic_count m_udp_announces;
+	boost::detail::atomic_count m_udp_connects;
+	boost::detail::atomic_count m_udp_scrapes;
+	boost::detail::atomic_count m_udp_scraped_hashes;
 	udp::socket m_socket;
 	int m_port;
 	bool m_abort;
@@ -96,6 +99,7 @@ struct udp_tracker
 		{
 			case 0: // connect
 
+				++m_udp_connects;
 				fprintf(stderr, "%s: UDP connect from %s\n", time_now_string()
 					, print_endpoint(*from).c_str());
 				ptr = buffer;
@@ -148,10 +152,29 @@ struct udp_tracker
 				else fprintf(stderr, "%s: UDP sent response to: %s\n"
 					, time_now_string(), print_endpoint(*from).c_str());
 				break;
-			case 2:
-				// ignore scrapes
-				fprintf(stderr, "%s: UDP scrape (ignored)\n", time_now_string());
+			case 2: // scrape
+			{
+				// every torrent has 5 seeds, 2 downloaders and has been
+				// downloaded 10 times
+				int const num_hashes = (int(bytes_transferred) - 16) / 20;
+				++m_udp_scrapes;
+				for (int i = 0; i < num_hashes; ++i) ++m_udp_scraped_hashes;
+				fprintf(stderr, "%s: UDP scrape [%d] info-hashes: %d\n"
+					, time_now_string(), int(m_udp_scrapes), num_hashes);
+				ptr = buffer;
+				detail::write_uint32(2, ptr); // action = scrape
+				detail::write_uint32(transaction_id, ptr); // transaction_id
+				for (int i = 0; i < num_hashes; ++i)
+				{
+					detail::write_uint32(5, ptr); // complete
+					detail::write_uint32(10, ptr); // downloaded
+					detail::write_uint32(2, ptr); // incomplete
+				}
+				m_socket.send_to(boost::asio::buffer(buffer, ptr - buffer), *from, 0, e);
+				if (e) fprintf(stderr, "%s: UDP send_to failed. ERROR: %s\n"
+					, time_now_string(), e.message().c_str());
 				break;
+			}
 			default:
 				fprintf(stderr, "%s: UDP unknown message: %d\n", time_now_string()
 					, action);
@@ -165,6 +188,9 @@ struct udp_tracker
 
 	udp_tracker(address iface)
 		: m_udp_announces(0)
+		, m_udp_connects(0)
+		, m_udp_scrapes(0)
+		, m_udp_scraped_hashes(0)
 		, m_socket(m_ios)
 		, m_port(0)
 		, m_abort(false)
@@ -212,6 +238,9 @@ struct udp_tracker
 	int port() const { return m_port; }
 
 	int num_hits() const { return m_udp_announces; }
+	int num_connects() const { return m_udp_connects; }
+	int num_scrapes() const { return m_udp_scrapes; }
+	int num_scraped_hashes() const { return m_udp_scraped_hashes; }
 
 	static void incoming_packet(error_code const& ec, size_t bytes_transferred, size_t *ret, error_code* error, bool* done)
 	{
@@ -257,6 +286,24 @@ int num_udp_announces()
 	return 0;
 }
 
+int num_udp_connects()
+{
+	if (g_udp_tracker) return g_udp_tracker->num_connects();
+	return 0;
+}
+
+int num_udp_scrapes()
+{
+	if (g_udp_tracker) return g_udp_tracker->num_scrapes();
+	return 0;
+}
+
+int num_udp_scraped_hashes()
+{
+	if (g_udp_tracker) return g_udp_tracker->num_scraped_hashes();
+	return 0;
+}
+
 void stop_udp_tracker()
 {
 	g_udp_tracker.reset();
@@ -40,5 +40,11 @@ int EXPORT start_udp_tracker(libtorrent::address iface
 // the number of udp tracker announces received
 int EXPORT num_udp_announces();
 
+// the number of connect and scrape requests received, and the total number
+// of info-hashes in the scrapes
+int EXPORT num_udp_connects();
+int EXPORT num_udp_scrapes();
+int EXPORT num_udp_scraped_hashes();
+
 void EXPORT stop_udp_tracker();
 
@@ -127,7 +127,7 @@ void AddTorrentForm::updateDiskSpaceLabel()
         {
             if (priorities[i] > 0)
             {
-                torrent_size += m_torrentInfo->file_at(i).size;
+                torrent_size += m_torrentInfo->files().file_size(i);
             }
         }
     }
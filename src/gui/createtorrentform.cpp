@@ -0,0 +1,158 @@
+#include "createtorrentform.h"
+#include "ui_createtorrentform.h"
+
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTime>
+
+#include "torrentcreator.h"
+#include "utilities/utils.h"
+#include "globals.h"
+
+
+CreateTorrentForm::CreateTorrentForm(QWidget* parent)
+    : QDialog(parent)
+    , ui(new Ui::CreateTorrentForm)
+    , m_creator(nullptr)
+{
+    ui->setupUi(this);
+    setWindowIcon(QIcon(PROJECT_ICON));
+
+    ui->buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Create"));
+    VERIFY(connect(ui->buttonBox, SIGNAL(accepted()), SLOT(startCreation())));
+    VERIFY(connect(ui->buttonBox, SIGNAL(rejected()), SLOT(reject())));
+
+    setRunning(false);
+}
+
+CreateTorrentForm::~CreateTorrentForm()
+{
+    delete m_creator;
+    delete ui;
+}
+
+void CreateTorrentForm::setSourcePath(const QString& path)
+{
+    ui->sourceEdit->setText(QDir::toNativeSeparators(path));
+}
+
+void CreateTorrentForm::on_browseFileButton_clicked()
+{
+    const QString path = QFileDialog::getOpenFileName(this, tr("Select a file to share"), ui->sourceEdit->text());
+    if (!path.isEmpty())
+    {
+        setSourcePath(path);
+    }
+}
+
+void CreateTorrentForm::on_browseFolderButton_clicked()
+{
+    const QString path = QFileDialog::getExistingDirectory(this, tr("Select a folder to share"), ui->sourceEdit->text());
+    if (!path.isEmpty())
+    {
+        setSourcePath(path);
+    }
+}
+
+void CreateTorrentForm::startCreation()
+{
+    const QString source = QDir::fromNativeSeparators(ui->sourceEdit->text().trimmed());
+    if (source.isEmpty() || !QFileInfo(source).exists())
+    {
+        QMessageBox::warning(this, windowTitle(), tr("Choose an existing file or folder to share."));
+        return;
+    }
+
+    const QString torrentPath = QFileDialog::getSaveFileName(this, tr("Save torrent as"),
+        TorrentCreator::defaultTorrentPath(source), "Torrent Files(*.torrent)");
+    if (torrentPath.isEmpty())
+    {
+        return;
+    }
+
+    start(source, torrentPath);
+}
+
+void CreateTorrentForm::createFrom(const QString& sourcePath)
+{
+    setSourcePath(sourcePath);
+    start(sourcePath, TorrentCreator::defaultTorrentPath(sourcePath));
+}
+
+void CreateTorrentForm::start(const QString& source, const QString& torrentPath)
+{
+    QStringList trackers;
+    for (const QString& line : ui->trackersEdit->toPlainText().split('\n', QString::SkipEmptyParts))
+    {
+        if (!line.trimmed().isEmpty())
+        {
+            trackers << line.trimmed();
+        }
+    }
+
+    delete m_creator;
+    m_creator = new TorrentCreator(source, torrentPath);
+    m_creator->setTrackers(trackers);
+    m_creator->setPrivate(ui->privateCheckBox->isChecked());
+    VERIFY(connect(m_creator, SIGNAL(progress(int, int)), SLOT(onProgress(int, int))));
+    VERIFY(connect(m_creator, SIGNAL(finished(QString, QString)), SLOT(onFinished(QString, QString))));
+    VERIFY(connect(m_creator, SIGNAL(failed(QString)), SLOT(onFailed(QString))));
+
+    setRunning(true);
+    m_creator->start();
+}
+
+void CreateTorrentForm::onProgress(int percent, int secondsLeft)
+{
+    ui->progressBar->setValue(percent);
+    ui->etaLabel->setText(tr("%1 left").arg(QTime(0, 0).addSecs(secondsLeft).toString("hh:mm:ss")));
+}
+
+void CreateTorrentForm::onFinished(const QString& torrentPath, const QString& savePath)
+{
+    emit torrentCreated(torrentPath, savePath);
+    accept();
+}
+
+void CreateTorrentForm::onFailed(const QString& error)
+{
+    setRunning(false);
+    QMessageBox::warning(this, windowTitle(), tr("Could not create the torrent: %1").arg(error));
+}
+
+void CreateTorrentForm::reject()
+{
+    if (m_creator)
+    {
+        // set_piece_hashes stops at the next piece; the destructor waits for it
+        m_creator->cancel();
+    }
+    QDialog::reject();
+}
+
+void CreateTorrentForm::setRunning(bool running)
+{
+    ui->sourceEdit->setEnabled(!running);
+    ui->browseFileButton->setEnabled(!running);
+    ui->browseFolderButton->setEnabled(!running);
+    ui->trackersEdit->setEnabled(!running);
+    ui->privateCheckBox->setEnabled(!running);
+    ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(!running);
+    ui->progressBar->setVisible(running);
+    ui->etaLabel->setVisible(running);
+    if (running)
+    {
+        ui->progressBar->setValue(0);
+        ui->etaLabel->clear();
+    }
+}
+
+void CreateTorrentForm::changeEvent(QEvent* e)
+{
+    QDialog::changeEvent(e);
+    if (e->type() == QEvent::LanguageChange)
+        ui->retranslateUi(this);
+}
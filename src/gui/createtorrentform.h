@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QDialog>
+
+class TorrentCreator;
+
+namespace Ui
+{
+class CreateTorrentForm;
+}
+
+class CreateTorrentForm : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit CreateTorrentForm(QWidget* parent = 0);
+    ~CreateTorrentForm();
+
+    void setSourcePath(const QString& path);
+    // starts hashing right away, writing <source>.torrent next to the source
+    void createFrom(const QString& sourcePath);
+
+public Q_SLOTS:
+    void startCreation();
+
+Q_SIGNALS:
+    void torrentCreated(const QString& torrentPath, const QString& savePath);
+
+protected:
+    void changeEvent(QEvent* e) override;
+    void reject() override;
+
+private:
+    void start(const QString& source, const QString& torrentPath);
+    void setRunning(bool running);
+
+    Ui::CreateTorrentForm* ui;
+    TorrentCreator* m_creator;
+
+private Q_SLOTS:
+    void on_browseFileButton_clicked();
+    void on_browseFolderButton_clicked();
+    void onProgress(int percent, int secondsLeft);
+    void onFinished(const QString& torrentPath, const QString& savePath);
+    void onFailed(const QString& error);
+};
@@ -29,6 +29,8 @@
 #include "torrentmanager.h"
 
 #include "add_links.h"
+#include "createtorrentform.h"
+#include "statisticsform.h"
 #include "preferences.h"
 #include "settings_declaration.h"
 #include "global_functions.h"
@@ -120,6 +122,7 @@ MainWindow::MainWindow()
     VERIFY(connect(ui->listUrls, SIGNAL(signalDownloadFinished(QString)), SLOT(showTrayNotifDwnldFinish(QString))));
 
     VERIFY(connect(ui->actionOpen, SIGNAL(triggered()), SLOT(on_openTorrent_clicked())));
+    VERIFY(connect(ui->actionCreate_torrent, SIGNAL(triggered()), SLOT(createTorrent())));
     VERIFY(connect(ui->actionClose_Link, SIGNAL(triggered()), SLOT(onActionCloseLinkClicked())));
     VERIFY(connect(ui->actionExit_Link, SIGNAL(triggered()), SLOT(closeApp())));
     VERIFY(connect(ui->actionPaste_Links, SIGNAL(triggered()), SLOT(on_buttonPaste_clicked())));
@@ -149,6 +152,7 @@ MainWindow::MainWindow()
 #endif //Q_OS_MAC
 
     VERIFY(connect(ui->actionPreferences, SIGNAL(triggered()), SLOT(on_buttonOptions_clicked())));
+    VERIFY(connect(ui->actionStatistics, SIGNAL(triggered()), SLOT(showStatistics())));
 
     populateTrayMenu();
 
@@ -613,6 +617,32 @@ void MainWindow::on_openTorrent_clicked()
 }
 
 
+void MainWindow::createTorrent(const QString& sourcePath)
+{
+    auto* form = new CreateTorrentForm(this);
+    form->setAttribute(Qt::WA_DeleteOnClose);
+    VERIFY(connect(form, SIGNAL(torrentCreated(QString, QString)), SLOT(onTorrentCreated(QString, QString))));
+    form->show();
+    if (!sourcePath.isEmpty())
+    {
+        form->createFrom(sourcePath);
+    }
+}
+
+void MainWindow::onTorrentCreated(const QString& torrentPath, const QString& savePath)
+{
+    TorrentManager::Instance()->expectCreatedTorrent(torrentPath, savePath);
+    addLinks(QStringList() << torrentPath);
+}
+
+void MainWindow::showStatistics()
+{
+    auto* form = new StatisticsForm(this);
+    form->setAttribute(Qt::WA_DeleteOnClose);
+    form->show();
+}
+
+
 void MainWindow::keyPressEvent(QKeyEvent* event)
 {
 #ifdef DEVELOPER_FEATURES
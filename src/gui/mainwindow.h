@@ -71,6 +71,10 @@ public Q_SLOTS:
     void closeApp();
     void onAboutClicked();
     void on_openTorrent_clicked();
+    // hashes the file or folder and seeds the resulting torrent; empty path opens the dialog blank
+    void createTorrent(const QString& sourcePath = QString());
+    void onTorrentCreated(const QString& torrentPath, const QString& savePath);
+    void showStatistics();
     void onlblClearTextClicked();
 
 private Q_SLOTS:
@@ -0,0 +1,170 @@
+#include "statisticsform.h"
+#include "ui_statisticsform.h"
+
+#include <QDateTime>
+#include <QHeaderView>
+#include <QPainter>
+#include <QTableWidgetItem>
+
+#include <algorithm>
+
+#include "sessionmetrics.h"
+#include "globals.h"
+
+
+// Line chart of one history series, newest sample on the right
+class HistoryChart : public QWidget
+{
+public:
+    explicit HistoryChart(QWidget* parent) : QWidget(parent)
+    {
+        setMinimumHeight(140);
+        setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    }
+
+    void setValues(std::vector<double> values, int capacity)
+    {
+        m_values = std::move(values);
+        m_capacity = std::max<int>(capacity, m_values.size());
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent*) override
+    {
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+        const QRect area = rect().adjusted(4, 4, -4, -4);
+        painter.fillRect(area, palette().base());
+        painter.setPen(palette().mid().color());
+        painter.drawRect(area);
+
+        if (m_values.empty() || m_capacity < 2)
+        {
+            return;
+        }
+
+        const double maxValue = *std::max_element(m_values.begin(), m_values.end());
+        const double top = maxValue > 0 ? maxValue * 1.1 : 1;
+        const double step = double(area.width()) / (m_capacity - 1);
+        const int first = m_capacity - int(m_values.size());
+
+        QPolygonF line;
+        for (size_t i = 0; i < m_values.size(); ++i)
+        {
+            line << QPointF(area.left() + (first + int(i)) * step,
+                area.bottom() - m_values[i] / top * area.height());
+        }
+        painter.setPen(QPen(palette().highlight().color(), 1.5));
+        painter.drawPolyline(line);
+
+        painter.setPen(palette().text().color());
+        painter.drawText(area.adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop,
+            StatisticsForm::tr("max %1, now %2").arg(maxValue, 0, 'f', 1).arg(m_values.back(), 0, 'f', 1));
+    }
+
+private:
+    std::vector<double> m_values;
+    int m_capacity = 0;
+};
+
+
+StatisticsForm::StatisticsForm(QWidget* parent)
+    : QDialog(parent)
+    , ui(new Ui::StatisticsForm)
+    , m_chart(new HistoryChart(this))
+{
+    ui->setupUi(this);
+    setWindowIcon(QIcon(PROJECT_ICON));
+
+    ui->chartLayout->addWidget(m_chart);
+    ui->seriesCombo->addItems(SessionMetrics::instance().historySeries());
+    ui->metricsTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    ui->metricsTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+
+    VERIFY(connect(ui->buttonBox, SIGNAL(rejected()), SLOT(reject())));
+    VERIFY(connect(ui->seriesCombo, SIGNAL(currentIndexChanged(int)), SLOT(onSampled())));
+    VERIFY(connect(ui->filterEdit, SIGNAL(textChanged(QString)), SLOT(applyFilter())));
+    VERIFY(connect(&SessionMetrics::instance(), SIGNAL(sampled()), SLOT(onSampled())));
+
+    onSampled();
+}
+
+StatisticsForm::~StatisticsForm()
+{
+    delete ui;
+}
+
+void StatisticsForm::onSampled()
+{
+    const auto& metrics = SessionMetrics::instance().metrics();
+    QTableWidget* table = ui->metricsTable;
+    const bool rebuild = table->rowCount() != int(metrics.size());
+    if (rebuild)
+    {
+        table->setRowCount(metrics.size());
+    }
+
+    for (int row = 0; row < int(metrics.size()); ++row)
+    {
+        const SessionMetrics::Metric& m = metrics[row];
+        if (rebuild)
+        {
+            table->setItem(row, 0, new QTableWidgetItem(m.name));
+            for (int column = 1; column < 3; ++column)
+            {
+                auto* item = new QTableWidgetItem;
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                table->setItem(row, column, item);
+            }
+        }
+        table->item(row, 1)->setText(QString::number(m.value, 'g', 12));
+        table->item(row, 2)->setText(m.isCounter ? QString::number(m.rate, 'f', 1) : QString());
+    }
+
+    if (rebuild)
+    {
+        applyFilter();
+    }
+    updateChart();
+}
+
+void StatisticsForm::updateChart()
+{
+    const int series = ui->seriesCombo->currentIndex();
+    if (series < 0)
+    {
+        return;
+    }
+
+    std::vector<double> values;
+    for (const MetricsSample& sample : SessionMetrics::instance().history())
+    {
+        values.push_back(sample.values.value(series));
+    }
+
+    m_chart->setValues(std::move(values), SessionMetrics::HistorySize);
+}
+
+void StatisticsForm::applyFilter()
+{
+    const QString filter = ui->filterEdit->text().trimmed();
+    for (int row = 0; row < ui->metricsTable->rowCount(); ++row)
+    {
+        ui->metricsTable->setRowHidden(row,
+            !filter.isEmpty() && !ui->metricsTable->item(row, 0)->text().contains(filter, Qt::CaseInsensitive));
+    }
+}
+
+void StatisticsForm::changeEvent(QEvent* e)
+{
+    QDialog::changeEvent(e);
+    if (e->type() == QEvent::LanguageChange)
+    {
+        ui->retranslateUi(this);
+        const int series = ui->seriesCombo->currentIndex();
+        ui->seriesCombo->clear();
+        ui->seriesCombo->addItems(SessionMetrics::instance().historySeries());
+        ui->seriesCombo->setCurrentIndex(series);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QDialog>
+
+class HistoryChart;
+
+namespace Ui
+{
+class StatisticsForm;
+}
+
+// Session and application counters with the recent history of a few of them
+class StatisticsForm : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit StatisticsForm(QWidget* parent = 0);
+    ~StatisticsForm();
+
+protected:
+    void changeEvent(QEvent* e) override;
+
+private:
+    void updateChart();
+
+    Ui::StatisticsForm* ui;
+    HistoryChart* m_chart;
+
+private Q_SLOTS:
+    void onSampled();
+    void applyFilter();
+};
@@ -193,7 +193,7 @@ void TorrentDetailsForm::updateDiskSpaceLabel()
         {
             if (priorities[i] > 0)
             {
-                torrent_size += m_torrentInfo->file_at(i).size;
+                torrent_size += m_torrentInfo->files().file_size(i);
             }
         }
     }
@@ -19,6 +19,20 @@ bool isAutorunMode(const QStringList& args)
     return autostartParam != args.constEnd();
 }
 
+// "-create-torrent <path>" makes a torrent of the path and seeds it; the pair is taken out of params
+void createTorrents(MainWindow* mainWindow, QStringList& params)
+{
+    int i;
+    while ((i = params.indexOf("-create-torrent")) != -1)
+    {
+        params.removeAt(i);
+        if (i < params.size())
+        {
+            mainWindow->createTorrent(params.takeAt(i));
+        }
+    }
+}
+
 void treatParams(MainWindow* mainWindow, QStringList params)
 {
     auto* myApp = dynamic_cast<Application*>(qApp);
@@ -30,6 +44,7 @@ void treatParams(MainWindow* mainWindow, QStringList params)
         }
         else
         {
+            createTorrents(mainWindow, params);
             mainWindow->addLinks(std::move(params));
         }
     }
@@ -1,12 +1,16 @@
 #include "downloadcollectionmodel.h"
 
 #include <string>
+#include <climits>
+#include <algorithm>
+#include <QHash>
 #include <QFile>
 #include <QXmlStreamWriter>
 #include <QXmlStreamReader>
 #include <QMimeData>
 #include <QMessageBox>
 #include <QDebug>
+#include <QElapsedTimer>
 
 #include "utilities/utils.h"
 #include "utilities/translation.h"
@@ -20,7 +24,9 @@
 #include "branding.hxx"
 
 #include "torrentslistener.h"
+#include "torrentupdatequeue.h"
 #include "torrentmanager.h"
+#include "sessionmetrics.h"
 #include "addtorrentform.h"
 #include "treeitem.h"
 
@@ -35,10 +41,6 @@ DownloadCollectionModel::DownloadCollectionModel()
     rootItem->setStatus(ItemDC::eROOTSTATUS);
 
     VERIFY(qRegisterMetaType<ItemDC>("ItemDC"));
-    VERIFY(connect(&TorrentsListener::instance(), SIGNAL(statusChange(ItemDC)), SLOT(on_statusChange(ItemDC))));
-    VERIFY(connect(&TorrentsListener::instance(), SIGNAL(sizeChange(ItemDC)), SLOT(on_sizeChange(ItemDC))));
-    VERIFY(connect(&TorrentsListener::instance(), SIGNAL(sizeCurrDownlChange(ItemDC)), SLOT(on_sizeCurrDownlChange(ItemDC))));
-    VERIFY(connect(&TorrentsListener::instance(), SIGNAL(speedChange(ItemDC)), SLOT(on_speedChange(ItemDC))));
     VERIFY(connect(&TorrentsListener::instance(), SIGNAL(itemMetadataReceived(ItemDC)), SLOT(on_magnetLinkInfoReceived(ItemDC))));
     VERIFY(connect(&TorrentsListener::instance(), SIGNAL(torrentMoved(ItemDC)), SLOT(on_torrentMoved(ItemDC))));
 }
@@ -572,6 +574,72 @@ void DownloadCollectionModel::on_sizeCurrDownlChange(const ItemDC& a_item)
     emit dataChanged(index(item, eDC_Size), index(item, eDC_Size));
 }
 
+void DownloadCollectionModel::applyTorrentUpdates(const std::vector<TorrentUpdate>& updates)
+{
+    if (updates.empty())
+    {
+        return;
+    }
+
+    // torrents are top level items: one pass instead of a search per update
+    TreeItem* root = getRootItem();
+    QHash<ItemID, int> rows;
+    rows.reserve(root->childCount());
+    for (int i = 0; i < root->childCount(); ++i)
+    {
+        rows.insert(root->child(i)->getID(), i);
+    }
+
+    int firstRow = INT_MAX;
+    int lastRow = -1;
+    bool progressChanged = false;
+    for (const TorrentUpdate& u : updates)
+    {
+        const auto it = rows.constFind(u.id);
+        if (it == rows.constEnd())
+        {
+            continue;
+        }
+        TreeItem* item = root->child(it.value());
+
+        if ((u.fields & TorrentUpdate::Status) && item->getStatus() != u.status)
+        {
+            ItemDC itm;
+            itm.setID(u.id);
+            itm.setStatus(u.status);
+            itm.setErrorDescription(u.errorDescription);
+            on_statusChange(itm);
+        }
+        if (u.fields & TorrentUpdate::Speed)
+        {
+            item->setSpeed(u.speed);
+            item->setSpeedUpload(u.speedUpload);
+        }
+        if (u.fields & TorrentUpdate::Progress)
+        {
+            const qint64 size = (u.size > 0) ? u.size : item->size();
+            item->setSizeCurrDownl(u.sizeDone);
+            if (size < u.sizeDone)
+            {
+                item->setSize(u.sizeDone);
+            }
+            progressChanged = true;
+        }
+
+        firstRow = std::min(firstRow, it.value());
+        lastRow = std::max(lastRow, it.value());
+    }
+
+    if (lastRow >= 0)
+    {
+        emit dataChanged(index(firstRow, eDC_Speed), index(lastRow, eDC_Size));
+    }
+    if (progressChanged)
+    {
+        calculateAllProgress();
+    }
+}
+
 void DownloadCollectionModel::calculateAllProgress()
 {
     unsigned long long total = 0;
@@ -883,6 +951,29 @@ void DownloadCollectionModel::doSetPauseStopDownloadItem(TreeItem* itmSource, It
     emit signalPauseDownloadItemWithID(id, itmSource->downloadType());
 }
 
+void DownloadCollectionModel::setRecheckDownloadItem(const QModelIndex& a_index)
+{
+    if (!a_index.isValid())
+    {
+        return;
+    }
+
+    TreeItem* itmSource = getItem(a_index);
+    if (!itmSource || itmSource->downloadType() != DownloadType::TorrentFile)
+    {
+        return;
+    }
+
+    if (TorrentManager::Instance()->recheckTorrent(itmSource->getID()))
+    {
+        // set directly: status changes of failed items are ignored by on_statusChange
+        itmSource->setStatus(ItemDC::eCHECKING);
+        itmSource->setErrorDescription(QString());
+        emit dataChanged(index(itmSource, eDC_url), index(itmSource, eDC_Status));
+        emit statusChanged();
+    }
+}
+
 void DownloadCollectionModel::setContinueDownloadItem(const QModelIndex& a_index)
 {
     if (!a_index.isValid())
@@ -968,6 +1059,8 @@ bool DownloadCollectionModel::loadFromFile()
 void DownloadCollectionModel::saveToFile()
 {
     qDebug() << __FUNCTION__;
+    QElapsedTimer timer;
+    timer.start();
     const QString filePath = utilities::PrepareCacheFolder() + MODEL_STATE_FILE_NAME;
 
 #ifdef Q_OS_WIN32
@@ -1003,6 +1096,8 @@ void DownloadCollectionModel::saveToFile()
         if (!failed)
         {
             fileSafer.ok();
+            SessionMetrics::instance().add(SessionMetrics::ModelSaves);
+            SessionMetrics::instance().add(SessionMetrics::ModelSaveMicroseconds, timer.nsecsElapsed() / 1000);
         }
     }
     else
@@ -1120,6 +1215,19 @@ void DownloadCollectionModel::init()
                 for (const auto& p : list)
                     file_priorities.push_back(p.toInt());
             }
+
+            // Nothing is going to start these, so they are only loaded when asked for
+            const ItemDC::eSTATUSDC status = ti.getStatus();
+            if ((status == ItemDC::eFINISHED || status == ItemDC::ePAUSED || status == ItemDC::eSTOPPED)
+                && TorrentManager::Instance()->addHibernatedTorrent(
+                    hexstring,
+                    ti.getID(),
+                    ti.torrentSavePath(),
+                    file_priorities.empty()? nullptr : &file_priorities))
+            {
+                return;
+            }
+
             libtorrent::torrent_handle handle = TorrentManager::Instance()->addTorrent(
                 torrOrMagnet, 
                 ti.getID(), 
@@ -5,9 +5,13 @@
 #include <QUrl>
 #include <QByteArray>
 
+#include <vector>
+
 #include "treeitem.h"
 #include "downloadtype.h"
 
+struct TorrentUpdate;
+
 
 enum eDCMODEL
 {
@@ -69,6 +73,7 @@ public:
     Q_PROPERTY(QObject* rootItem READ getRootItem WRITE setRootItem)
     TreeItem* getRootItem() const { return rootItem; }
 
+    // Legacy: read only to migrate older model files, the state now lives in its own file
     Q_PROPERTY(QString torrentSessionState READ getTorrentSessionState WRITE setTorrentSessionState)
     QString getTorrentSessionState() const
     {
@@ -94,6 +99,7 @@ public:
     void setContinueDownloadItem(TreeItem* itmSource);
     void setStopDownloadItem(const QModelIndex& a_index);
     void setStopDownloadItem(TreeItem* itmSource);
+    void setRecheckDownloadItem(const QModelIndex& a_index);
 
     void deactivateDownloadItem(TreeItem* itmSource);
 
@@ -110,6 +116,9 @@ public:
 
     void setTorrentFilesPriorities(ItemID a_ID, QStringList priorities);
 
+    // Applies a batch of torrent changes with one dataChanged() for all of them
+    void applyTorrentUpdates(const std::vector<TorrentUpdate>& updates);
+
 public slots:
     void saveToFile();
 
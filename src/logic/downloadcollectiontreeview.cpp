@@ -316,11 +316,13 @@ void DownloadCollectionTreeView::on_showContextMenu(const QPoint& a_point)
             openFolder->setEnabled(QFile::exists(path));
         }
 
-        // Torrent Details menu item
+        // Torrent Details and Recheck menu items
         if (DownloadType::isTorrentDownload(dlType))
         {
             menu.addAction(QIcon(":/icons/Drop-down-torrent-icon-normal.png"), utilities::Tr::Tr(TORRENT_DETAILS_INFO), this, SLOT(on_showTorrentDetails()))
             ->setEnabled(dlType == DownloadType::TorrentFile);
+            menu.addAction(utilities::Tr::Tr(TREEVIEW_MENU_RECHECK), this, SLOT(on_ItemRecheck()))
+            ->setEnabled(dlType == DownloadType::TorrentFile && model()->getItem(index)->getStatus() != ItemDC::eCHECKING);
         }
 
         menu.addSeparator();
@@ -389,6 +391,15 @@ void DownloadCollectionTreeView::on_ItemCancel()
     deleteSelectedRows();
 }
 
+void DownloadCollectionTreeView::on_ItemRecheck()
+{
+    for (const QModelIndex& ind : selectionModel()->selectedRows())
+    {
+        model()->setRecheckDownloadItem(ind);
+    }
+    getUpdateItem();
+}
+
 void DownloadCollectionTreeView::moveImpl(int step)
 {
     QModelIndexList newInds = model()->moveItems(selectionModel()->selectedRows(), step);
@@ -486,10 +497,10 @@ void DownloadCollectionTreeView::showTorrentDetailsDialog(TreeItem* item)
             const auto id = item->getID();
             auto progressConnection = connect(
                 &TorrentsListener::instance(),
-                &TorrentsListener::sizeCurrDownlChange,
-                [id, weakPtr = std::weak_ptr<TorrentDetailsForm>(dlg)](const ItemDC& it)
+                &TorrentsListener::progressUpdated,
+                [id, weakPtr = std::weak_ptr<TorrentDetailsForm>(dlg)](ItemID updated)
                 {
-                    if (it.getID() == id)
+                    if (updated == id)
                     {
                         if (auto obj = weakPtr.lock())
                         {
@@ -499,10 +510,10 @@ void DownloadCollectionTreeView::showTorrentDetailsDialog(TreeItem* item)
                 });
             auto peersConnection = connect(
                 &TorrentsListener::instance(),
-                &TorrentsListener::speedChange,
-                [id, weakPtr = std::weak_ptr<TorrentDetailsForm>(dlg)](const ItemDC& it)
+                &TorrentsListener::speedUpdated,
+                [id, weakPtr = std::weak_ptr<TorrentDetailsForm>(dlg)](ItemID updated)
             {
-                if (it.getID() == id)
+                if (updated == id)
                 {
                     if (auto obj = weakPtr.lock())
                     {
@@ -41,6 +41,7 @@ public slots:
     void on_ItemResume();
     void on_ItemPause();
     void on_ItemCancel();
+    void on_ItemRecheck();
     void on_MoveUp();
     void on_MoveDown();
     void getUpdateItem();
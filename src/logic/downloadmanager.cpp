@@ -438,5 +438,6 @@ bool DownloadManager::isActiveTask(const TreeItem& ti) const
     return (ItemDC::eDOWNLOADING == status
             || ItemDC::eCONNECTING == status
             || ItemDC::eSTARTING == status
+            || ItemDC::eCHECKING == status
             || (ItemDC::eSTALLED == status && QDateTime::currentDateTimeUtc() < ti.statusLastChanged().addSecs(30)));
 }
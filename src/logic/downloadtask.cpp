@@ -9,6 +9,7 @@
 #include "settings_declaration.h"
 #include "global_functions.h"
 #include "logindialog.h"
+#include "sessionmetrics.h"
 
 #include <QApplication>
 #include <QMainWindow>
@@ -70,6 +71,7 @@ DownloadTask::DownloadTask(int task_id, QString  url, QObject* parent)
     network_manager_(new QNetworkAccessManager(this)),
     url_(std::move(url)),
     total_file_size_(0),
+    reported_size_(-1),
     task_id_(task_id),
     tree_item_(DownloadCollectionModel::instance().getRootItem()->findItemByID(task_id)),
     ready_to_download_(false),
@@ -172,6 +174,13 @@ void DownloadTask::notifyIfFinished()
 
 void DownloadTask::onProgress(qint64 downloadedSize)
 {
+    // a resumed download starts from what is already on disk, only count what arrives
+    if (reported_size_ >= 0 && downloadedSize > reported_size_)
+    {
+        SessionMetrics::instance().add(SessionMetrics::HttpBytesReceived, downloadedSize - reported_size_);
+    }
+    reported_size_ = downloadedSize;
+
     ItemDC it;
     it.setID(task_id_);
 
@@ -207,6 +216,7 @@ void DownloadTask::onFinished()
     it.setSize(fsize);
     it.setSpeed(0.f);
     DownloadCollectionModel::instance().on_ItemDCchange(it);
+    SessionMetrics::instance().add(SessionMetrics::HttpTasksFinished);
 
     notifyIfFinished();
 }
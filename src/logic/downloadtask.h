@@ -68,6 +68,7 @@ private:
     QScopedPointer<QNetworkAccessManager> network_manager_;
     QString url_, filename_;
     qint64 total_file_size_;
+    qint64 reported_size_; // last size counted in the metrics, -1 before the first progress
     int task_id_;
     QPointer<TreeItem> tree_item_;
     bool ready_to_download_;
@@ -0,0 +1,369 @@
+#include "sessionmetrics.h"
+
+#include <libtorrent/session.hpp>
+
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QEvent>
+#include <QHostAddress>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSettings>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "settings_declaration.h"
+#include "utilities/filesystem_utils.h"
+#include "globals.h"
+
+namespace {
+
+// Posted to the metrics when the alert thread has received a session_stats_alert
+const QEvent::Type SessionStatsEvent = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+const char METRICS_FILE_NAME[] = "metrics.prom";
+
+// Longest request line the loopback endpoint accepts
+const int MAX_REQUEST_SIZE = 8192;
+
+struct AppCounter
+{
+    const char* name;
+    double scale; // from the stored value to the exported unit
+};
+
+const AppCounter APP_COUNTERS[SessionMetrics::CounterCount] =
+{
+    { "liii_model_updates_total", 1 },
+    { "liii_http_tasks_finished_total", 1 },
+    { "liii_http_received_bytes_total", 1 },
+    { "liii_model_saves_total", 1 },
+    { "liii_model_save_seconds_total", 1e-6 },
+};
+
+struct HistorySeries
+{
+    const char* title;
+    const char* metric;
+    const char* per;    // if set, the series is delta(metric) / delta(per)
+    bool rate;          // per second instead of the value
+    double scale;
+};
+
+const HistorySeries HISTORY_SERIES[] =
+{
+    { QT_TRANSLATE_NOOP("SessionMetrics", "Download, KB/s"), "libtorrent_net_recv_bytes_total", nullptr, true, 1. / 1024 },
+    { QT_TRANSLATE_NOOP("SessionMetrics", "Upload, KB/s"), "libtorrent_net_sent_bytes_total", nullptr, true, 1. / 1024 },
+    { QT_TRANSLATE_NOOP("SessionMetrics", "Connected peers"), "libtorrent_peer_num_peers_connected", nullptr, false, 1 },
+    { QT_TRANSLATE_NOOP("SessionMetrics", "Queued disk jobs"), "libtorrent_disk_queued_disk_jobs", nullptr, false, 1 },
+    { QT_TRANSLATE_NOOP("SessionMetrics", "DHT nodes"), "libtorrent_dht_dht_nodes", nullptr, false, 1 },
+    { QT_TRANSLATE_NOOP("SessionMetrics", "Model updates per second"), "liii_model_updates_total", nullptr, true, 1 },
+    { QT_TRANSLATE_NOOP("SessionMetrics", "HTTP download, KB/s"), "liii_http_received_bytes_total", nullptr, true, 1. / 1024 },
+    { QT_TRANSLATE_NOOP("SessionMetrics", "Model save latency, ms"), "liii_model_save_seconds_total", "liii_model_saves_total", false, 1000 },
+};
+
+// net.recv_bytes -> libtorrent_net_recv_bytes_total
+QString prometheusName(const libtorrent::stats_metric& metric)
+{
+    QString name = QLatin1String("libtorrent_") + QString::fromLatin1(metric.name).replace('.', '_');
+    if (metric.type == libtorrent::stats_metric::type_counter)
+    {
+        name += QLatin1String("_total");
+    }
+    return name;
+}
+
+} // namespace
+
+
+SessionMetrics::SessionMetrics()
+    : m_session(nullptr)
+    , m_server(nullptr)
+    , m_sessionMetrics(libtorrent::session_stats_metrics())
+    , m_pendingPosted(false)
+    , m_historyHead(0)
+{
+    for (auto& counter : m_counters)
+    {
+        counter = 0;
+    }
+
+    for (const auto& metric : m_sessionMetrics)
+    {
+        const bool isCounter = metric.type == libtorrent::stats_metric::type_counter;
+        m_metrics.push_back({ prometheusName(metric), isCounter, 0, 0, 0 });
+    }
+    for (const auto& counter : APP_COUNTERS)
+    {
+        m_metrics.push_back({ QString::fromLatin1(counter.name), true, 0, 0, 0 });
+    }
+
+    for (const auto& series : HISTORY_SERIES)
+    {
+        const auto it = std::find_if(m_metrics.begin(), m_metrics.end(),
+            [&series](const Metric& m) { return m.name == QLatin1String(series.metric); });
+        Q_ASSERT_X(it != m_metrics.end(), Q_FUNC_INFO, series.metric);
+        m_historyIndices.push_back(it != m_metrics.end() ? int(it - m_metrics.begin()) : -1);
+    }
+
+    VERIFY(connect(&m_timer, SIGNAL(timeout()), SLOT(requestSample())));
+}
+
+SessionMetrics::~SessionMetrics()
+{
+    stop();
+}
+
+void SessionMetrics::start(libtorrent::session* s)
+{
+    QSettings settings;
+    const int interval = settings.value(MetricsIntervalSec, MetricsIntervalSec_Default).toInt();
+    if (interval <= 0)
+    {
+        return;
+    }
+
+    m_session = s;
+    m_filePath = utilities::PrepareCacheFolder() + METRICS_FILE_NAME;
+    m_timer.start(interval * 1000);
+
+    const int port = settings.value(MetricsPort, MetricsPort_Default).toInt();
+    if (port > 0)
+    {
+        listen(port);
+    }
+}
+
+void SessionMetrics::stop()
+{
+    m_timer.stop();
+    m_session = nullptr;
+    delete m_server;
+    m_server = nullptr;
+    if (m_fileWrite.valid())
+    {
+        m_fileWrite.wait();
+    }
+}
+
+void SessionMetrics::requestSample()
+{
+    if (m_session)
+    {
+        // answered by a session_stats_alert, see postSample()
+        m_session->post_session_stats();
+    }
+}
+
+void SessionMetrics::postSample(std::vector<quint64> values)
+{
+    QMutexLocker lock(&m_pendingLock);
+    // a sample the GUI thread hasn't picked up yet is simply replaced
+    m_pending.swap(values);
+    m_pendingTime = std::chrono::steady_clock::now();
+    if (!m_pendingPosted)
+    {
+        m_pendingPosted = true;
+        QCoreApplication::postEvent(this, new QEvent(SessionStatsEvent));
+    }
+}
+
+void SessionMetrics::customEvent(QEvent* event)
+{
+    if (event->type() != SessionStatsEvent)
+    {
+        QObject::customEvent(event);
+        return;
+    }
+
+    std::vector<quint64> values;
+    std::chrono::steady_clock::time_point time;
+    {
+        QMutexLocker lock(&m_pendingLock);
+        values.swap(m_pending);
+        time = m_pendingTime;
+        m_pendingPosted = false;
+    }
+
+    if (!values.empty() && m_session)
+    {
+        applySample(values, time);
+        appendHistory();
+        publish();
+        emit sampled();
+    }
+}
+
+void SessionMetrics::applySample(const std::vector<quint64>& values, std::chrono::steady_clock::time_point time)
+{
+    // session values first, our counters after them, in the order of m_metrics
+    std::vector<quint64> current;
+    current.reserve(m_metrics.size());
+    for (const auto& metric : m_sessionMetrics)
+    {
+        current.push_back(metric.value_index < int(values.size()) ? values[metric.value_index] : 0);
+    }
+    for (const auto& counter : m_counters)
+    {
+        current.push_back(counter.load(std::memory_order_relaxed));
+    }
+
+    const bool havePrevious = m_previous.size() == current.size();
+    const double seconds = havePrevious
+        ? std::chrono::duration<double>(time - m_previousTime).count() : 0;
+    const size_t firstAppCounter = m_sessionMetrics.size();
+
+    for (size_t i = 0; i < m_metrics.size(); ++i)
+    {
+        Metric& m = m_metrics[i];
+        const double scale = i < firstAppCounter ? 1 : APP_COUNTERS[i - firstAppCounter].scale;
+        m.value = current[i] * scale;
+        // counters restart from zero with the session, don't report that as a drop
+        m.delta = m.isCounter && havePrevious && current[i] >= m_previous[i]
+            ? (current[i] - m_previous[i]) * scale : 0;
+        m.rate = seconds > 0 ? m.delta / seconds : 0;
+    }
+
+    m_previous.swap(current);
+    m_previousTime = time;
+}
+
+void SessionMetrics::appendHistory()
+{
+    MetricsSample sample;
+    sample.time = QDateTime::currentMSecsSinceEpoch();
+    for (size_t i = 0; i < m_historyIndices.size(); ++i)
+    {
+        const HistorySeries& series = HISTORY_SERIES[i];
+        const int index = m_historyIndices[i];
+        double value = 0;
+        if (index >= 0)
+        {
+            const Metric& m = m_metrics[index];
+            if (series.per)
+            {
+                const auto per = std::find_if(m_metrics.begin(), m_metrics.end(),
+                    [&series](const Metric& p) { return p.name == QLatin1String(series.per); });
+                value = per != m_metrics.end() && per->delta > 0 ? m.delta / per->delta : 0;
+            }
+            else
+            {
+                value = series.rate ? m.rate : m.value;
+            }
+        }
+        sample.values.push_back(value * series.scale);
+    }
+
+    if (m_history.size() < size_t(HistorySize))
+    {
+        m_history.push_back(std::move(sample));
+    }
+    else
+    {
+        m_history[m_historyHead] = std::move(sample);
+        m_historyHead = (m_historyHead + 1) % HistorySize;
+    }
+}
+
+QStringList SessionMetrics::historySeries() const
+{
+    QStringList titles;
+    for (const auto& series : HISTORY_SERIES)
+    {
+        titles << QCoreApplication::translate("SessionMetrics", series.title);
+    }
+    return titles;
+}
+
+std::vector<MetricsSample> SessionMetrics::history() const
+{
+    std::vector<MetricsSample> result(m_history.begin() + m_historyHead, m_history.end());
+    result.insert(result.end(), m_history.begin(), m_history.begin() + m_historyHead);
+    return result;
+}
+
+void SessionMetrics::publish()
+{
+    QByteArray text;
+    text.reserve(m_exposition.size());
+    for (const Metric& m : m_metrics)
+    {
+        const QByteArray name = m.name.toLatin1();
+        text += "# TYPE " + name + (m.isCounter ? " counter\n" : " gauge\n");
+        text += name + ' ' + QByteArray::number(m.value, 'g', 15) + '\n';
+    }
+    m_exposition = text;
+
+    // QSaveFile syncs the file to disk, keep that off the GUI thread. A write still
+    // running from the previous sample means a slow disk, this sample is skipped then
+    if (m_fileWrite.valid()
+        && m_fileWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return;
+    }
+    const QString path = m_filePath;
+    m_fileWrite = std::async(std::launch::async, [path, text]
+    {
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(text) != text.size() || !file.commit())
+        {
+            qWarning() << "SessionMetrics::publish could not write" << path << file.errorString();
+        }
+    });
+}
+
+void SessionMetrics::listen(int port)
+{
+    m_server = new QTcpServer(this);
+    if (!m_server->listen(QHostAddress::LocalHost, port))
+    {
+        qWarning() << __FUNCTION__ << "could not listen on port" << port << m_server->errorString();
+        delete m_server;
+        m_server = nullptr;
+        return;
+    }
+    VERIFY(connect(m_server, SIGNAL(newConnection()), SLOT(onNewConnection())));
+}
+
+void SessionMetrics::onNewConnection()
+{
+    while (QTcpSocket* socket = m_server->nextPendingConnection())
+    {
+        VERIFY(connect(socket, SIGNAL(readyRead()), SLOT(onReadyRead())));
+        VERIFY(connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater())));
+    }
+}
+
+// Answers the request line, the rest of the request is ignored
+void SessionMetrics::onReadyRead()
+{
+    auto* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket)
+    {
+        return;
+    }
+    if (!socket->canReadLine())
+    {
+        if (socket->bytesAvailable() > MAX_REQUEST_SIZE)
+        {
+            socket->abort();
+        }
+        return;
+    }
+
+    const QList<QByteArray> request = socket->readLine(MAX_REQUEST_SIZE).simplified().split(' ');
+    disconnect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+
+    const bool found = request.size() >= 2 && request[0] == "GET"
+        && (request[1] == "/metrics" || request[1] == "/");
+    const QByteArray body = found ? m_exposition : QByteArray("not found\n");
+    socket->write(QByteArray(found ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 404 Not Found\r\n")
+        + "Content-Type: text/plain; version=0.0.4\r\n"
+        + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+        + "Connection: close\r\n\r\n"
+        + body);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QObject>
+#include <QMutex>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include <libtorrent/session_stats.hpp>
+
+#include "utilities/singleton.h"
+
+namespace libtorrent
+{
+class session;
+}
+
+class QTcpServer;
+
+// One point of the history shown by the statistics panel
+struct MetricsSample
+{
+    qint64 time; // msecs since epoch
+    QVector<double> values; // one per SessionMetrics::historySeries()
+};
+
+// Samples the session's performance counters (post_session_stats) together with our
+// own counters, computes per-interval deltas and rates and publishes the result as a
+// Prometheus text file in the cache folder and, if a port is configured, on a
+// loopback HTTP endpoint. The last samples of a few key series are kept for the GUI.
+class SessionMetrics : public QObject, public Singleton<SessionMetrics>
+{
+    Q_OBJECT
+
+friend class Singleton<SessionMetrics>;
+
+public:
+    // Application counters, may be incremented from any thread
+    enum Counter
+    {
+        ModelUpdates,           // torrent updates applied to the download model
+        HttpTasksFinished,
+        HttpBytesReceived,
+        ModelSaves,
+        ModelSaveMicroseconds,  // time spent saving the download model
+        CounterCount
+    };
+
+    struct Metric
+    {
+        QString name;       // Prometheus name
+        bool isCounter;     // counters are monotonic, gauges are not
+        double value;
+        double delta;       // since the previous sample, counters only
+        double rate;        // delta per second
+    };
+
+    // samples kept for the statistics panel
+    static const int HistorySize = 120;
+
+    void start(libtorrent::session* s);
+    void stop();
+
+    void add(Counter counter, quint64 n = 1)
+    {
+        m_counters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // alert thread: the values of a session_stats_alert
+    void postSample(std::vector<quint64> values);
+
+    const std::vector<Metric>& metrics() const { return m_metrics; }
+    QStringList historySeries() const;
+    std::vector<MetricsSample> history() const; // oldest first
+
+Q_SIGNALS:
+    // emitted in the GUI thread after metrics() and history() were updated
+    void sampled();
+
+private:
+    SessionMetrics();
+    ~SessionMetrics();
+
+    void customEvent(QEvent* event) override;
+    void applySample(const std::vector<quint64>& values, std::chrono::steady_clock::time_point time);
+    void appendHistory();
+    void publish();
+    void listen(int port);
+
+private Q_SLOTS:
+    void requestSample();
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    libtorrent::session* m_session;
+    QTimer m_timer;
+    QTcpServer* m_server;
+    QString m_filePath;
+
+    std::vector<libtorrent::stats_metric> m_sessionMetrics;
+    std::atomic<quint64> m_counters[CounterCount];
+
+    // handed over from the alert thread
+    QMutex m_pendingLock;
+    std::vector<quint64> m_pending;
+    std::chrono::steady_clock::time_point m_pendingTime;
+    bool m_pendingPosted;
+
+    std::vector<quint64> m_previous; // session values, then our counters
+    std::chrono::steady_clock::time_point m_previousTime;
+    std::vector<Metric> m_metrics;
+
+    std::vector<int> m_historyIndices; // into m_metrics, per series
+    std::vector<MetricsSample> m_history; // ring
+    size_t m_historyHead;
+
+    QByteArray m_exposition; // last published text
+    std::future<void> m_fileWrite; // of the last published text to m_filePath
+};
@@ -3,6 +3,10 @@
 #include "torrentslistener.h"
 
 #include <QDir>
+#include <QHash>
+#include <QRegExp>
+
+#include <algorithm>
 
 namespace {
 
@@ -273,37 +277,50 @@ void TorrentContentModel::setupModelData(const libtorrent::torrent_info& t, cons
     qDebug("Torrent contains %d files", t.num_files());
     m_filesIndex.reserve(t.num_files());
 
-    // Iterate over files
-    for (int i = 0; i < t.num_files(); ++i)
+    // Iterate over files; the folder chain of each directory is resolved once and cached by path
+    const libtorrent::file_storage& files = t.files();
+    const QRegExp separators("[/\\\\]");
+    QHash<QString, TorrentContentModelItem*> folderByPath;
+    for (int i = 0; i < files.num_files(); ++i)
     {
-        const libtorrent::file_entry& fentry = t.file_at(i);
         TorrentContentModelItem* current_parent = m_rootItem;
 
-        QString path = QString::fromStdString(fentry.path);
+        const QString path = QString::fromStdString(files.file_path(i));
+        const int lastSeparator = std::max(path.lastIndexOf('/'), path.lastIndexOf('\\'));
+        const QString dirPath = (lastSeparator > 0) ? path.left(lastSeparator) : QString();
 
-        // Iterate of parts of the path to create necessary folders
-        QStringList pathFolders = path.split(QRegExp("[/\\\\]"), QString::SkipEmptyParts);
-        pathFolders.removeLast();
-        for (const QString& pathPart : qAsConst(pathFolders))
+        auto it = folderByPath.constFind(dirPath);
+        if (it != folderByPath.constEnd())
         {
-            if (pathPart == ".unwanted")
-            {
-                continue;
-            }
-            TorrentContentModelItem* new_parent = current_parent->childWithName(pathPart);
-            if (!new_parent)
+            current_parent = it.value();
+        }
+        else
+        {
+            // Iterate of parts of the path to create necessary folders
+            const QStringList pathFolders = dirPath.split(separators, QString::SkipEmptyParts);
+            for (const QString& pathPart : pathFolders)
             {
-                new_parent = new TorrentContentModelItem(pathPart, current_parent);
+                if (pathPart == ".unwanted")
+                {
+                    continue;
+                }
+                TorrentContentModelItem* new_parent = current_parent->childWithName(pathPart);
+                if (!new_parent)
+                {
+                    new_parent = new TorrentContentModelItem(pathPart, current_parent);
+                }
+                current_parent = new_parent;
             }
-            current_parent = new_parent;
+            folderByPath.insert(dirPath, current_parent);
         }
         // Actually create the file
         if (current_parent != m_rootItem)
         {
             current_parent->setStatus(torrentStatus2ItemDCStatus(tStatus.state));
         }
-        m_filesIndex.push_back(new TorrentContentModelItem(fentry, current_parent));
+        m_filesIndex.push_back(new TorrentContentModelItem(path, files.file_size(i), current_parent));
     }
+    m_rootItem->updateSizes();
     emit layoutChanged();
 }
 
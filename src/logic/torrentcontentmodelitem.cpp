@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <numeric>
 
 
 void TorrentContentModelItem::init(QString name, const qlonglong size)
@@ -25,27 +26,24 @@ void TorrentContentModelItem::init(QString name, const qlonglong size)
 
 
 TorrentContentModelItem::TorrentContentModelItem(
-    const libtorrent::file_entry& f,
+    const QString& path, qlonglong size,
     TorrentContentModelItem* parent)
-    : m_parentItem(parent), m_type(TFILE), m_totalDone(0)
+    : m_parentItem(parent), m_type(TFILE), m_totalDone(0), m_path(path), m_row(0)
 {
     Q_ASSERT(parent);
-    m_path = QString::fromStdString(f.path);
     QString name = QFileInfo(m_path).fileName();
 
-    init(name, f.size);
-
-    m_parentItem->updateSize();
+    init(name, size);
 }
 
 TorrentContentModelItem::TorrentContentModelItem(const QString& name, TorrentContentModelItem* parent)
-    : m_parentItem(parent), m_type(FOLDER), m_totalDone(0)
+    : m_parentItem(parent), m_type(FOLDER), m_totalDone(0), m_row(0)
 {
     init(name, 0);
 }
 
 TorrentContentModelItem::TorrentContentModelItem(const QList<QVariant>& data)
-    : m_parentItem(0), m_type(ROOT), m_itemData(data), m_totalDone(0)
+    : m_parentItem(0), m_type(ROOT), m_itemData(data), m_totalDone(0), m_row(0)
 {
     Q_ASSERT(data.size() == NB_COL);
 }
@@ -65,6 +63,7 @@ void TorrentContentModelItem::deleteAllChildren()
     Q_ASSERT(m_type == ROOT);
     qDeleteAll(m_childItems);
     m_childItems.clear();
+    m_folders.clear();
 }
 
 const QList<TorrentContentModelItem*>& TorrentContentModelItem::children() const
@@ -85,6 +84,11 @@ QString TorrentContentModelItem::getName() const
 void TorrentContentModelItem::setName(const QString& name)
 {
     Q_ASSERT(m_type != ROOT);
+    if (m_type == FOLDER && m_parentItem->m_folders.value(getName()) == this)
+    {
+        m_parentItem->m_folders.remove(getName());
+        m_parentItem->m_folders.insert(name, this);
+    }
     m_itemData.replace(COL_NAME, name);
 }
 
@@ -119,6 +123,26 @@ void TorrentContentModelItem::updateSize()
     setSize(size);
 }
 
+void TorrentContentModelItem::updateSizes()
+{
+    qulonglong size = 0;
+    for (TorrentContentModelItem* child : qAsConst(m_childItems))
+    {
+        if (child->m_type == FOLDER)
+        {
+            child->updateSizes();
+        }
+        if (child->getPriority() != prio::IGNORED)
+        {
+            size += child->getSize();
+        }
+    }
+    if (m_type == FOLDER)
+    {
+        m_itemData.replace(COL_SIZE, size);
+    }
+}
+
 void TorrentContentModelItem::setProgress(qulonglong done)
 {
     Q_ASSERT(m_type != ROOT);
@@ -265,14 +289,7 @@ void TorrentContentModelItem::updatePriority()
 
 TorrentContentModelItem* TorrentContentModelItem::childWithName(const QString& name) const
 {
-    for (TorrentContentModelItem* child : qAsConst(m_childItems))
-    {
-        if (child->getName() == name)
-        {
-            return child;
-        }
-    }
-    return 0;
+    return m_folders.value(name, 0);
 }
 
 bool TorrentContentModelItem::isFolder() const
@@ -284,7 +301,12 @@ void TorrentContentModelItem::appendChild(TorrentContentModelItem* item)
 {
     Q_ASSERT(item);
     Q_ASSERT(m_type != TFILE);
+    item->m_row = m_childItems.count();
     m_childItems.append(item);
+    if (item->m_type == FOLDER && !m_folders.contains(item->getName()))
+    {
+        m_folders.insert(item->getName(), item);
+    }
 }
 
 TorrentContentModelItem* TorrentContentModelItem::child(int row) const
@@ -321,7 +343,7 @@ QVariant TorrentContentModelItem::data(int column) const
 
 int TorrentContentModelItem::row() const
 {
-    return m_parentItem ? m_parentItem->children().indexOf(const_cast<TorrentContentModelItem*>(this)) : 0;
+    return m_row;
 }
 
 TorrentContentModelItem* TorrentContentModelItem::parent() const
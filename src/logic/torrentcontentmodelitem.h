@@ -1,8 +1,8 @@
 #pragma once
 
+#include <QHash>
 #include <QList>
 #include <QVariant>
-#include <libtorrent/torrent_info.hpp>
 #include "treeitem.h"
 
 namespace prio
@@ -16,8 +16,8 @@ public:
     enum TreeItemColumns {COL_NAME, COL_SIZE, COL_STATUS, COL_PROGRESS, COL_PRIO, NB_COL};
     enum FileType {TFILE, FOLDER, ROOT};
 
-    // File Construction
-    TorrentContentModelItem(const libtorrent::file_entry& f,
+    // File Construction; the parent's size is not updated, call updateSizes() on the root once all files are added
+    TorrentContentModelItem(const QString& path, qlonglong size,
                             TorrentContentModelItem* parent);
     // Folder constructor
     TorrentContentModelItem(const QString& name, TorrentContentModelItem* parent = 0);
@@ -35,6 +35,8 @@ public:
     qulonglong getSize() const;
     void setSize(qulonglong size);
     void updateSize();
+    // Recomputes folder sizes of the whole subtree in a single bottom-up pass
+    void updateSizes();
     qulonglong getTotalDone() const;
 
     ItemDC::eSTATUSDC getStatus() const;
@@ -49,6 +51,7 @@ public:
     void setPriority(int new_prio, bool update_parent = true);
     void updatePriority();
 
+    // Returns the child folder with the given name, 0 if there is none
     TorrentContentModelItem* childWithName(const QString& name) const;
     bool isFolder() const;
 
@@ -68,8 +71,10 @@ private:
     FileType m_type;
     QList<TorrentContentModelItem*> m_childItems;
     QList<QVariant> m_itemData;
+    QHash<QString, TorrentContentModelItem*> m_folders;
     qulonglong m_totalDone;
     QString m_path;
+    int m_row;
 
     void init(QString name, const qlonglong size);
 };
@@ -0,0 +1,147 @@
+#include "torrentcreator.h"
+
+#include <vector>
+#include <iterator>
+#include <libtorrent/create_torrent.hpp>
+#include <libtorrent/bencode.hpp>
+#include <libtorrent/file.hpp>
+#include <boost/bind.hpp>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <QSaveFile>
+
+#include "version.hxx"
+
+
+namespace {
+
+bool skipHidden(const std::string& path)
+{
+    const std::string name = libtorrent::filename(path);
+    return !name.empty() && name[0] != '.';
+}
+
+} // namespace
+
+
+TorrentCreator::TorrentCreator(const QString& sourcePath, const QString& torrentPath, QObject* parent)
+    : QObject(parent)
+    , m_sourcePath(QDir::cleanPath(QFileInfo(sourcePath).absoluteFilePath()))
+    , m_torrentPath(torrentPath)
+    , m_private(false)
+    , m_thread(new QThread(this))
+    , m_lastPercent(-1)
+    , m_canceled(false)
+{
+    // create() runs on m_thread itself: a functor connection without a context object is direct
+    connect(m_thread, &QThread::started, [this] { create(); });
+}
+
+TorrentCreator::~TorrentCreator()
+{
+    cancel();
+    m_thread->wait();
+}
+
+QString TorrentCreator::savePath() const
+{
+    return QFileInfo(m_sourcePath).absolutePath();
+}
+
+QString TorrentCreator::defaultTorrentPath(const QString& sourcePath)
+{
+    return QDir::cleanPath(QFileInfo(sourcePath).absoluteFilePath()) + ".torrent";
+}
+
+void TorrentCreator::start()
+{
+    if (m_thread->isRunning())
+    {
+        return;
+    }
+    m_canceled = false;
+    m_lastPercent = -1;
+    m_thread->start(QThread::LowPriority);
+}
+
+void TorrentCreator::cancel()
+{
+    m_canceled = true;
+}
+
+bool TorrentCreator::onPieceHashed(int piece, int numPieces)
+{
+    const int done = piece + 1;
+    const int percent = static_cast<int>(100LL * done / numPieces);
+    if (percent != m_lastPercent)
+    {
+        m_lastPercent = percent;
+        const qint64 elapsed = m_timer.elapsed();
+        const int secondsLeft = static_cast<int>(elapsed * (numPieces - done) / done / 1000);
+        emit progress(percent, secondsLeft);
+    }
+    return !m_canceled;
+}
+
+void TorrentCreator::create()
+{
+    qDebug() << __FUNCTION__ << "creating" << m_torrentPath << "from" << m_sourcePath;
+    m_timer.start();
+
+    libtorrent::file_storage fs;
+    libtorrent::add_files(fs, m_sourcePath.toUtf8().constData(), &skipHidden);
+    if (fs.num_files() == 0 || fs.total_size() == 0)
+    {
+        emit failed(tr("There are no files to share in \"%1\"").arg(m_sourcePath));
+        m_thread->quit();
+        return;
+    }
+
+    // piece_size 0 lets libtorrent scale the piece size with the total size (up to 16 MiB)
+    libtorrent::create_torrent t(fs, 0);
+    for (int i = 0; i < m_trackers.size(); ++i)
+    {
+        t.add_tracker(m_trackers[i].toStdString(), i);
+    }
+    t.set_priv(m_private);
+    t.set_creator(PROJECT_NAME " " PROJECT_VERSION);
+
+    libtorrent::error_code ec;
+    libtorrent::set_piece_hashes(t, savePath().toUtf8().constData(),
+        boost::bind(&TorrentCreator::onPieceHashed, this, _1, t.num_pieces()),
+        QThread::idealThreadCount(), ec);
+    if (ec)
+    {
+        if (ec == boost::asio::error::operation_aborted)
+        {
+            qDebug() << __FUNCTION__ << "canceled";
+        }
+        else
+        {
+            qWarning() << __FUNCTION__ << "hashing failed:" << QString::fromStdString(ec.message());
+            emit failed(QString::fromStdString(ec.message()));
+        }
+        m_thread->quit();
+        return;
+    }
+
+    std::vector<char> torrent;
+    libtorrent::bencode(std::back_inserter(torrent), t.generate());
+
+    QSaveFile file(m_torrentPath);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(torrent.data(), torrent.size()) != static_cast<qint64>(torrent.size())
+        || !file.commit())
+    {
+        qWarning() << __FUNCTION__ << "could not write" << m_torrentPath << file.errorString();
+        emit failed(file.errorString());
+        m_thread->quit();
+        return;
+    }
+
+    qDebug() << __FUNCTION__ << "done in" << m_timer.elapsed() << "ms," << t.num_pieces() << "pieces";
+    emit finished(m_torrentPath, savePath());
+    m_thread->quit();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QElapsedTimer>
+
+#include <atomic>
+
+class QThread;
+
+// Builds a .torrent for a local file or folder on a worker thread.
+// Pieces are hashed by libtorrent's set_piece_hashes with one hashing thread per core.
+class TorrentCreator : public QObject
+{
+    Q_OBJECT
+public:
+    TorrentCreator(const QString& sourcePath, const QString& torrentPath, QObject* parent = nullptr);
+    ~TorrentCreator();
+
+    void setTrackers(const QStringList& trackers) { m_trackers = trackers; }
+    void setPrivate(bool isPrivate) { m_private = isPrivate; }
+
+    QString sourcePath() const { return m_sourcePath; }
+    QString torrentPath() const { return m_torrentPath; }
+    // the folder the source lives in, i.e. the save path to seed it from
+    QString savePath() const;
+
+    static QString defaultTorrentPath(const QString& sourcePath);
+
+public Q_SLOTS:
+    void start();
+    void cancel();
+
+Q_SIGNALS:
+    void progress(int percent, int secondsLeft);
+    void finished(const QString& torrentPath, const QString& savePath);
+    void failed(const QString& error);
+
+private Q_SLOTS:
+    void create();
+
+private:
+    bool onPieceHashed(int piece, int numPieces);
+
+    QString m_sourcePath;
+    QString m_torrentPath;
+    QStringList m_trackers;
+    bool m_private;
+
+    QThread* m_thread;
+    QElapsedTimer m_timer;
+    int m_lastPercent;
+    std::atomic<bool> m_canceled;
+};
@@ -7,6 +7,7 @@
 #include <utility>
 #include <algorithm>
 #include <functional>
+#include <future>
 #include <stdio.h>
 #include <boost/function_output_iterator.hpp>
 #include <libtorrent/version.hpp>
@@ -14,21 +15,37 @@
 #include <libtorrent/bencode.hpp>
 #include <libtorrent/file.hpp>
 #include <libtorrent/announce_entry.hpp>
-#include <libtorrent/lazy_entry.hpp>
+#include <libtorrent/bdecode.hpp>
+#include <libtorrent/ip_filter.hpp>
+#include <libtorrent/kademlia/dht_storage.hpp>
 #include <QString>
 #include <QStringList>
 #include <QDebug>
 #include <QByteArray>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStandardPaths>
 #include <QMainWindow>
 #include <QMessageBox>
+#include <QThread>
+#include <QTemporaryFile>
+#include <QSaveFile>
+
+#if defined(Q_OS_DARWIN)
+#include <fcntl.h>
+#elif defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <errno.h>
+#endif
 
 #include "settings_declaration.h"
 #include "application.h"
 
 #include "addtorrentform.h"
 #include "torrentslistener.h"
+#include "sessionmetrics.h"
 #include "downloadtype.h"
 #include "downloadcollectionmodel.h"
 
@@ -65,6 +82,29 @@ void setProxySettings(libtorrent::session* sess)
     sess->set_proxy(s);
 }
 
+// Checks whether the file system behind the folder can reserve space without writing zeros
+bool probeNativeAllocation(const QString& folder)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_DARWIN)
+    QTemporaryFile probe(QDir(folder).filePath("allocation_probe"));
+    if (!probe.open())
+    {
+        return false;
+    }
+    const off_t probeSize = 1024 * 1024;
+#if defined(Q_OS_LINUX)
+    return fallocate(probe.handle(), 0, 0, probeSize) == 0;
+#else
+    fstore_t f = { F_ALLOCATEALL, F_PEOFPOSMODE, 0, probeSize, 0 };
+    return fcntl(probe.handle(), F_PREALLOCATE, &f) != -1;
+#endif
+#else
+    // Windows marks torrent files sparse, reserving space there means writing zeros
+    Q_UNUSED(folder);
+    return false;
+#endif
+}
+
 bool loadFastResumeData(const QString& hash, std::vector<char>& buf)
 {
     const QString fastresume_path = utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER) + hash + ".fastresume";
@@ -90,6 +130,25 @@ bool loadFastResumeData(const QString& hash, std::vector<char>& buf)
     return content_size > 0;
 }
 
+const char SESSION_STATE_FILE_NAME[] = "session.state";
+
+QString sessionStatePath()
+{
+    return utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER) + SESSION_STATE_FILE_NAME;
+}
+
+QByteArray readSessionState(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+std::future<QByteArray> sessionStatePreload;
+
 libtorrent::sha1_hash hashFromQString(const QString& hash)
 {
     libtorrent::sha1_hash hex;
@@ -97,37 +156,48 @@ libtorrent::sha1_hash hashFromQString(const QString& hash)
     return hex;
 }
 
+// The folder or the single file the torrent's files are put in
+QString torrentRootItemPath(const libtorrent::torrent_info& torrInfo, std::string savePath)
+{
+    if (torrInfo.num_files() <= 0)
+    {
+        return QString();
+    }
+
+    const libtorrent::file_storage& files = torrInfo.files();
+    const std::string firstFile = files.file_path(0);
+    auto end = firstFile.cend();
+    for (int i = 1; i < files.num_files() && end != firstFile.cbegin(); ++i)
+    {
+        const std::string path = files.file_path(i);
+        auto loc = std::mismatch(firstFile.cbegin(), end, path.cbegin(), path.cend());
+        end = loc.first;
+    }
+
+    auto minLength = std::distance(firstFile.cbegin(), end);
+
+    auto lastSlash = firstFile.find_last_of("/\\", minLength);
+    if (lastSlash != std::string::npos && lastSlash > 0)
+    {
+        minLength = lastSlash;
+    }
+
+    if (!savePath.empty() && savePath[savePath.size() - 1] != '\\' && savePath[savePath.size() - 1] != '/')
+        savePath += QDir::separator().toLatin1();
+    return QString::fromStdString(savePath + firstFile.substr(0, minLength));
+}
+
 QString torrentRootItemPath(const libtorrent::torrent_handle& handle)
 {
     QString result;
     Q_ASSERT(handle.is_valid());
     if (handle.is_valid())
     {
-        libtorrent::torrent_info torrInfo = handle.get_torrent_info();
+        boost::shared_ptr<const libtorrent::torrent_info> torrInfo = handle.torrent_file();
 
-        if (torrInfo.num_files() > 0)
+        if (torrInfo)
         {
-            const std::string& firstFile = torrInfo.file_at(0).path;
-            auto end = firstFile.cend();
-            for (int i = 1; i < torrInfo.num_files(); ++i)
-            {
-                const libtorrent::file_entry& fentry = torrInfo.file_at(i);
-                auto loc = std::mismatch(firstFile.cbegin(), end, fentry.path.cbegin(), fentry.path.cend());
-                end = loc.first;
-            }
-
-            auto minLength = std::distance(firstFile.cbegin(), end);
-
-            auto lastSlash = firstFile.find_last_of("/\\", minLength);
-            if (lastSlash != std::string::npos && lastSlash > 0)
-            {
-                minLength = lastSlash;
-            }
-
-            auto lhs = handle.save_path();
-            if (!lhs.empty() && lhs[lhs.size() - 1] != '\\' && lhs[lhs.size() - 1] != '/')
-                lhs += QDir::separator().toLatin1();
-            result = QString::fromStdString(lhs + firstFile.substr(0, minLength));
+            result = torrentRootItemPath(*torrInfo, handle.save_path());
         }
     }
     return result;
@@ -186,6 +256,22 @@ QString toQString(const libtorrent::sha1_hash& hash)
     return QString(out);
 }
 
+QString metadataCachePath(const QString& infoHash)
+{
+    return utilities::PrepareCacheFolder(METADATA_CACHE_SUB_FOLDER) + infoHash.toLower() + ".torrent";
+}
+
+void pruneMetadataCache()
+{
+    const int maxCachedTorrents = 500;
+    const QFileInfoList cached = QDir(utilities::PrepareCacheFolder(METADATA_CACHE_SUB_FOLDER))
+        .entryInfoList(QStringList("*.torrent"), QDir::Files, QDir::Time);
+    for (int i = maxCachedTorrents; i < cached.size(); ++i)
+    {
+        QFile::remove(cached[i].absoluteFilePath());
+    }
+}
+
 using namespace app_settings;
 
 std::unique_ptr<TorrentManager> TorrentManager::m_instance;
@@ -200,6 +286,14 @@ TorrentManager* TorrentManager::Instance()
     return m_instance.get();
 }
 
+void TorrentManager::preloadSessionState()
+{
+    if (!m_instance && !sessionStatePreload.valid())
+    {
+        sessionStatePreload = std::async(std::launch::async, readSessionState, sessionStatePath());
+    }
+}
+
 void TorrentManager::dispose()
 {
     m_instance.reset();
@@ -222,19 +316,47 @@ TorrentManager::TorrentManager()
 #endif
     ));
 
+    // The default DHT storage allocates a tree node per peer and grows with the session's
+    // uptime; the flat one stays within TorrentsDhtStorageMemoryMb. The DHT started with
+    // the session is restarted below to pick it up
+    m_session->set_dht_storage(&libtorrent::dht::dht_flat_storage_constructor);
+    libtorrent::settings_pack dhtOff;
+    dhtOff.set_bool(libtorrent::settings_pack::enable_dht, false);
+    m_session->apply_settings(dhtOff);
+
+    libtorrent::settings_pack pack;
+    pack.set_bool(libtorrent::settings_pack::enable_dht, true);
+    m_session->apply_settings(pack);
+
+    applyBlocklist();
+
+    // Probe the default download folder up front so the first add does not pay for it
+    allocationModeFor(global_functions::GetVideoFolder());
+
     DownloadCollectionModel* dlcModel = &DownloadCollectionModel::instance();
 
-    QByteArray in = QByteArray::fromBase64(dlcModel->getTorrentSessionState().toLatin1());
-    // bdecode
-    libtorrent::lazy_entry e;
-    libtorrent::error_code ec;
-    lazy_bdecode(in.constData(), in.constData() + in.size(), e, ec);
-    if (!ec)
-    {
-        m_session->load_state(e);
-    }
+    loadSessionState();
+
+    // after the saved state, which carries the DHT settings of the previous run
+    libtorrent::dht_settings dhtSettings = m_session->get_dht_settings();
+    dhtSettings.max_storage_memory = QSettings().value(
+        TorrentsDhtStorageMemoryMb, TorrentsDhtStorageMemoryMb_Default).toInt() * 1024 * 1024;
+    m_session->set_dht_settings(dhtSettings);
+
+    // Also after the saved state: it holds every non-default setting of the previous run,
+    // which would otherwise override the current ones
+    libtorrent::settings_pack overrides;
+    // Checking reads and hashes pieces on every disk thread, use all cores for it
+    overrides.set_int(libtorrent::settings_pack::aio_threads, std::max(4, QThread::idealThreadCount()));
+    overrides.set_int(libtorrent::settings_pack::checking_mem_usage, 4096); // 64 MiB of 16 KiB blocks
+    overrides.set_bool(libtorrent::settings_pack::zero_copy_send,
+        QSettings().value(TorrentsZeroCopySeeding, TorrentsZeroCopySeeding_Default).toBool());
+    overrides.set_int(libtorrent::settings_pack::network_threads,
+        QSettings().value(TorrentsNetworkThreads, TorrentsNetworkThreads_Default).toInt());
+    m_session->apply_settings(overrides);
 
     TorrentsListener::instance().setAlertDispatch(m_session.get());
+    SessionMetrics::instance().start(m_session.get());
 
     VERIFY(connect(dlcModel, SIGNAL(signalDeleteURLFromModel(int, DownloadType::Type, int)), SLOT(on_deleteTaskWithID(int, DownloadType::Type, int))));
     VERIFY(connect(dlcModel, SIGNAL(signalPauseDownloadItemWithID(int, DownloadType::Type)), SLOT(on_pauseTaskWithID(int, DownloadType::Type))));
@@ -276,6 +398,15 @@ TorrentManager::TorrentManager()
     VERIFY(connect(&m_resumeDataTimer, SIGNAL(timeout()), SLOT(cacheResumeTorrentsData())));
     m_resumeDataTimer.setSingleShot(false);
     m_resumeDataTimer.start(200000); // 3.3min
+
+    VERIFY(connect(&m_checkingProgressTimer, SIGNAL(timeout()), SLOT(updateCheckingProgress())));
+    VERIFY(connect(&TorrentsListener::instance(), SIGNAL(torrentChecked(int)), SLOT(onTorrentChecked(int))));
+    m_checkingProgressTimer.setSingleShot(false);
+    m_checkingProgressTimer.setInterval(1000);
+
+    VERIFY(connect(&m_hibernateTimer, SIGNAL(timeout()), SLOT(hibernateIdleTorrents())));
+    m_hibernateTimer.setSingleShot(false);
+    m_hibernateTimer.start(60000);
 }
 
 TorrentManager::~TorrentManager()
@@ -292,22 +423,28 @@ void TorrentManager::close()
 
     m_closed = true;
 
+    if (m_blocklistLoader.valid())
+    {
+        m_blocklistLoader.wait();
+    }
+
     DownloadCollectionModel* dlcModel = &DownloadCollectionModel::instance();
-    libtorrent::entry session_state;
-    m_session->save_state(session_state);
-    QByteArray out;
-    bencode(std::back_inserter(out), session_state);
-    dlcModel->setTorrentSessionState(out.toBase64());
+    saveSessionState();
 
     //
     m_resumeDataTimer.stop();
+    m_checkingProgressTimer.stop();
+    m_hibernateTimer.stop();
+    SessionMetrics::instance().stop();
 
     // Avoid setting model items' states to paused
     TorrentsListener::instance().disconnect(dlcModel);
+    TorrentsListener::instance().beginShutdown();
     // Pause session
     m_session->pause();
 
-    cacheResumeTorrentsData(true);
+    const int pendingResumeData = cacheResumeTorrentsData(true);
+    TorrentsListener::instance().stopAlertDispatch(pendingResumeData);
 }
 
 int TorrentManager::cacheResumeTorrentsData(bool fully_data_save /* = false */)
@@ -375,20 +512,52 @@ libtorrent::torrent_handle TorrentManager::addTorrent(
 {
     qDebug() << __FUNCTION__ << " adding file: " << torrOrMagnet;
 
+    // A torrent we have just created is seeded from where its content lives
+    const QString createdFrom = m_createdTorrents.take(torrOrMagnet);
+    const bool is_created = !createdFrom.isEmpty();
+
     libtorrent::add_torrent_params torrentParams;
-    torrentParams.save_path = 
-        (savePath.isEmpty() ? global_functions::GetVideoFolder() : savePath).toUtf8().constData();
+    const QString saveFolder = is_created ? createdFrom
+        : savePath.isEmpty() ? global_functions::GetVideoFolder() : savePath;
+    torrentParams.save_path = saveFolder.toUtf8().constData();
     torrentParams.flags = libtorrent::add_torrent_params::flag_paused | libtorrent::add_torrent_params::flag_override_resume_data;// | libtorrent::add_torrent_params::flag_update_subscribe;
+    if (is_created)
+        torrentParams.flags |= libtorrent::add_torrent_params::flag_seed_mode;
     if (QSettings().value(TorrentsSequentialDownload, TorrentsSequentialDownload_Default).toBool())
         torrentParams.flags |= libtorrent::add_torrent_params::flag_sequential_download;
     torrentParams.userdata = reinterpret_cast<void*>(id);
 
-    torrentParams.storage_mode = libtorrent::storage_mode_allocate;
+    torrentParams.storage_mode = allocationModeFor(saveFolder);
 
-    const bool enable_file_dialog = interactive 
+    const bool enable_file_dialog = interactive && !is_created
         && QSettings().value(ShowAddTorrentDialog, true).toBool();
     // TODO: may be two different functions
-    const bool is_adding_from_file = DownloadType::determineType(torrOrMagnet) != DownloadType::MagnetLink;
+    const bool is_magnet = DownloadType::determineType(torrOrMagnet) == DownloadType::MagnetLink;
+
+    // A magnet resolved before is added with the cached metadata instead of asking the swarm again
+    QString torrentFile = is_magnet ? QString() : torrOrMagnet;
+    if (is_magnet)
+    {
+        const QString hash = btihFromMaget(torrOrMagnet);
+        if (!hash.isEmpty() && QFile::exists(metadataCachePath(hash)))
+        {
+            libtorrent::error_code err;
+            auto cached = boost::make_shared<libtorrent::torrent_info>(metadataCachePath(hash).toUtf8().constData(), err);
+            if (!err && cached->is_valid() && toQString(cached->info_hash()) == hash.toLower())
+            {
+                qDebug() << __FUNCTION__ << "using cached metadata for" << hash;
+                libtorrent::parse_magnet_uri(torrOrMagnet.toStdString(), torrentParams, err);
+                torrentParams.ti = cached;
+                torrentFile = metadataCachePath(hash);
+            }
+            else
+            {
+                QFile::remove(metadataCachePath(hash));
+            }
+        }
+    }
+
+    const bool is_adding_from_file = !torrentFile.isEmpty();
     if (!is_adding_from_file)
     {
         torrentParams.url = torrOrMagnet.toStdString();
@@ -396,13 +565,16 @@ libtorrent::torrent_handle TorrentManager::addTorrent(
     }
     else
     {
-        libtorrent::error_code err;
-        torrentParams.ti = boost::make_shared<libtorrent::torrent_info>(torrOrMagnet.toUtf8().constData(), err);
-        if (!torrentParams.ti->is_valid() || err)
+        if (!torrentParams.ti)
         {
-            qDebug() << QString("Unable to decode torrent file: '%1', ERROR:%2").arg(torrOrMagnet).arg(err.message().c_str());
-            // TODO: handle error according to http://www.rasterbar.com/products/libtorrent/manual.html#error-code
-            return {};
+            libtorrent::error_code err;
+            torrentParams.ti = boost::make_shared<libtorrent::torrent_info>(torrOrMagnet.toUtf8().constData(), err);
+            if (!torrentParams.ti->is_valid() || err)
+            {
+                qDebug() << QString("Unable to decode torrent file: '%1', ERROR:%2").arg(torrOrMagnet).arg(err.message().c_str());
+                // TODO: handle error according to http://www.rasterbar.com/products/libtorrent/manual.html#error-code
+                return {};
+            }
         }
 
         // Set default priory to NORMAL. You can find similar code to magnets in metadata receiver
@@ -436,7 +608,7 @@ libtorrent::torrent_handle TorrentManager::addTorrent(
         if (interactive && mergeTrackers())
         {
             std::vector<libtorrent::announce_entry> trackers_new
-                = is_adding_from_file? torrentParams.ti->trackers() : parseTrackersList(torrOrMagnet);
+                = is_magnet ? parseTrackersList(torrOrMagnet) : torrentParams.ti->trackers();
             std::vector<libtorrent::announce_entry> trackers_current = duplicate_tor.trackers();
 
             auto trackerPr = [](libtorrent::announce_entry const & l, libtorrent::announce_entry const & r) {return l.url < r.url;};
@@ -473,7 +645,7 @@ libtorrent::torrent_handle TorrentManager::addTorrent(
         // Saving torrent
         if (is_adding_from_file)
         {
-            QFile::copy(torrOrMagnet, utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER) + toQString(handle.info_hash()) + ".torrent");
+            QFile::copy(torrentFile, utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER) + toQString(handle.info_hash()) + ".torrent");
         }
     }
 
@@ -484,6 +656,19 @@ void TorrentManager::on_deleteTaskWithID(int id, DownloadType::Type type, int de
 {
     if (DownloadType::isTorrentDownload(type))
     {
+        auto hibernated = m_hibernated.find(id);
+        if (hibernated != m_hibernated.end() && !deleteWithFiles)
+        {
+            const auto fileName = utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER) + hibernated->infoHash;
+            utilities::DeleteFileWithWaiting(fileName + ".torrent");
+            utilities::DeleteFileWithWaiting(fileName + ".fastresume");
+            m_hibernated.erase(hibernated);
+            return;
+        }
+        wakeTorrent(id); // the session knows which files are the torrent's
+        m_idleSince.remove(id);
+        m_pauseAfterCheck.remove(id);
+
         auto it = m_idToHandle.find(id);
         if (it != m_idToHandle.end() && it->is_valid())
         {
@@ -499,6 +684,7 @@ void TorrentManager::on_pauseTaskWithID(int id, DownloadType::Type type)
 {
     if (DownloadType::isTorrentDownload(type))
     {
+        m_pauseAfterCheck.remove(id);
         auto it = m_idToHandle.find(id);
         if (it != m_idToHandle.end() && it->is_valid())
         {
@@ -508,8 +694,43 @@ void TorrentManager::on_pauseTaskWithID(int id, DownloadType::Type type)
     }
 }
 
+bool TorrentManager::addHibernatedTorrent(
+    const QString& infoHash,
+    int id,
+    const QString& savePath,
+    const std::vector<boost::uint8_t>* file_priorities)
+{
+    if (QSettings().value(TorrentsHibernateAfterMinutes, TorrentsHibernateAfterMinutes_Default).toInt() <= 0)
+    {
+        return false;
+    }
+
+    // Magnets that never got their metadata and torrents never saved have to be loaded
+    const QString fileName = utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER) + infoHash;
+    if (!QFile::exists(fileName + ".torrent") || !QFile::exists(fileName + ".fastresume"))
+    {
+        return false;
+    }
+
+    HibernatedTorrent& torrent = m_hibernated[id];
+    torrent.infoHash = infoHash;
+    torrent.savePath = savePath;
+    if (file_priorities)
+    {
+        torrent.filePriorities = *file_priorities;
+    }
+    return true;
+}
+
+void TorrentManager::expectCreatedTorrent(const QString& torrentFile, const QString& savePath)
+{
+    m_createdTorrents[torrentFile] = savePath;
+}
+
 bool TorrentManager::resumeTorrent(int id)
 {
+    wakeTorrent(id);
+    m_pauseAfterCheck.remove(id); // the user wants it running after all
     auto it = m_idToHandle.find(id);
     if (it != m_idToHandle.end())
     {
@@ -522,6 +743,7 @@ bool TorrentManager::resumeTorrent(int id)
 
 bool TorrentManager::restartTorrent(int id)
 {
+    wakeTorrent(id);
     auto it = m_idToHandle.find(id);
     if (it != m_idToHandle.end())
     {
@@ -541,7 +763,8 @@ bool TorrentManager::restartTorrent(int id)
             torrentParams.userdata = reinterpret_cast<void*>(id);
             torrentParams.ti = boost::make_shared<libtorrent::torrent_info>(torrentPath.toUtf8().constData(), err);
 
-            torrentParams.storage_mode = libtorrent::storage_mode_allocate;
+            // Keep whatever allocation the torrent was started with
+            torrentParams.storage_mode = handle.status(0x0).storage_mode;
 
             torrentParams.file_priorities = std::vector<uint8_t>(priorities.begin(), priorities.end());
 
@@ -556,17 +779,358 @@ bool TorrentManager::restartTorrent(int id)
     return false;
 }
 
+libtorrent::storage_mode_t TorrentManager::allocationModeFor(const QString& savePath)
+{
+    switch (QSettings().value(TorrentsAllocationMode, TorrentsAllocationMode_Default).toInt())
+    {
+    case 1:
+        return libtorrent::storage_mode_sparse;
+    case 2:
+        return libtorrent::storage_mode_fast_allocate;
+    case 3:
+        return libtorrent::storage_mode_allocate;
+    }
+
+    const QString folder = QDir::cleanPath(savePath);
+    auto it = m_nativeAllocation.find(folder);
+    if (it == m_nativeAllocation.end())
+    {
+        it = m_nativeAllocation.insert(folder, probeNativeAllocation(folder));
+        qDebug() << __FUNCTION__ << folder << "native allocation:" << it.value();
+    }
+    return it.value() ? libtorrent::storage_mode_fast_allocate : libtorrent::storage_mode_sparse;
+}
+
+void TorrentManager::loadSessionState()
+{
+    m_sessionState = sessionStatePreload.valid()
+        ? sessionStatePreload.get() : readSessionState(sessionStatePath());
+
+    // Older versions kept the state base64-encoded inside the model file
+    DownloadCollectionModel& dlcModel = DownloadCollectionModel::instance();
+    const QString legacyState = dlcModel.getTorrentSessionState();
+    if (!legacyState.isEmpty())
+    {
+        dlcModel.setTorrentSessionState(QString());
+        if (m_sessionState.isEmpty())
+        {
+            qDebug() << __FUNCTION__ << "migrating session state out of the model file";
+            const QByteArray in = QByteArray::fromBase64(legacyState.toLatin1());
+            libtorrent::bdecode_node e;
+            libtorrent::error_code ec;
+            libtorrent::bdecode(in.constData(), in.constData() + in.size(), e, ec);
+            if (!ec)
+            {
+                m_session->load_state(e);
+            }
+            return; // m_sessionState stays empty, so close() writes the state file
+        }
+    }
+
+    if (m_sessionState.isEmpty())
+    {
+        return;
+    }
+
+    libtorrent::bdecode_node e;
+    libtorrent::error_code ec;
+    libtorrent::bdecode(m_sessionState.constData(), m_sessionState.constData() + m_sessionState.size(), e, ec);
+    if (ec)
+    {
+        qWarning() << __FUNCTION__ << "corrupted session state:" << QString::fromStdString(ec.message());
+        m_sessionState.clear();
+        return;
+    }
+    m_session->load_state(e);
+}
+
+void TorrentManager::saveSessionState()
+{
+    libtorrent::entry session_state;
+    m_session->save_state(session_state);
+    QByteArray out;
+    bencode(std::back_inserter(out), session_state);
+
+    // DHT nodes and settings rarely change between runs, skip the write when nothing did
+    if (out == m_sessionState)
+    {
+        return;
+    }
+
+    const QString path = sessionStatePath();
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() || !file.commit())
+    {
+        qWarning() << __FUNCTION__ << "could not save session state to" << path << file.errorString();
+        return;
+    }
+    m_sessionState = out;
+}
+
+// Parsing a blocklist of a few million ranges takes seconds, so the merged filter is cached
+// in binary form and mapped back in on later starts as long as the list itself is unchanged
+void TorrentManager::applyBlocklist()
+{
+    const QString path = QSettings().value(TorrentsBlocklistPath).toString();
+    if (path.isEmpty())
+    {
+        return;
+    }
+
+    // Built off the GUI thread, the session runs unfiltered until the filter is ready
+    m_blocklistLoader = std::async(std::launch::async, [this, path]
+    {
+        QSettings settings;
+        const QFileInfo listInfo(path);
+        if (!listInfo.isFile())
+        {
+            qWarning() << "applyBlocklist" << "blocklist not found:" << path;
+            return;
+        }
+        const QString stamp = QString("%1|%2|%3").arg(listInfo.absoluteFilePath())
+            .arg(listInfo.size()).arg(listInfo.lastModified().toMSecsSinceEpoch());
+        const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        const QString cachePath = QDir(cacheDir).filePath("blocklist.cache");
+
+        libtorrent::ip_filter filter;
+        libtorrent::error_code ec;
+        if (settings.value(TorrentsBlocklistCacheStamp).toString() == stamp
+            && filter.load_cache(cachePath.toUtf8().constData(), ec))
+        {
+            qDebug() << "applyBlocklist" << "loaded cached blocklist for" << path;
+            m_session->set_ip_filter(filter);
+            return;
+        }
+
+        QFile file(path);
+        if (listInfo.size() > INT_MAX || !file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "applyBlocklist" << "cannot read blocklist" << path << file.errorString();
+            return;
+        }
+        const QByteArray contents = file.readAll();
+        const int ranges = libtorrent::parse_blocklist(contents.constData(), contents.size(), filter, ec);
+        if (ranges < 0)
+        {
+            qWarning() << "applyBlocklist" << "cannot parse blocklist" << path << ec.message().c_str();
+            return;
+        }
+        qDebug() << "applyBlocklist" << path << "rules:" << ranges;
+
+        // Saving merges the rules, so the session gets the filter ready to use
+        QDir().mkpath(cacheDir);
+        filter.save_cache(cachePath.toUtf8().constData(), ec);
+        if (ec)
+        {
+            qWarning() << "applyBlocklist" << "cannot save blocklist cache" << cachePath << ec.message().c_str();
+            settings.remove(TorrentsBlocklistCacheStamp);
+        }
+        else
+        {
+            settings.setValue(TorrentsBlocklistCacheStamp, stamp);
+        }
+        m_session->set_ip_filter(filter);
+    });
+}
+
+bool TorrentManager::recheckTorrent(int id)
+{
+    wakeTorrent(id);
+    auto it = m_idToHandle.find(id);
+    if (it == m_idToHandle.end() || !it.value().is_valid())
+    {
+        return false;
+    }
+
+    libtorrent::torrent_handle handle = it.value();
+    const libtorrent::torrent_status status = handle.status(0x0);
+    if (!status.has_metadata)
+    {
+        return false;
+    }
+
+    qDebug() << __FUNCTION__ << "rechecking:" << handle.name().c_str();
+    handle.force_recheck();
+    // Files are only checked while the torrent is running, a paused one is paused again once checked
+    if (status.paused)
+    {
+        m_pauseAfterCheck.insert(id);
+        handle.resume();
+    }
+
+    if (!m_checkingProgressTimer.isActive())
+    {
+        m_checkingProgressTimer.start();
+    }
+    return true;
+}
+
+void TorrentManager::updateCheckingProgress()
+{
+    // one call into the session instead of a status() round trip per torrent
+    std::vector<libtorrent::torrent_status> checking;
+    m_session->get_torrent_status(&checking, [](const libtorrent::torrent_status& status)
+    {
+        return status.state == libtorrent::torrent_status::checking_files
+            || status.state == libtorrent::torrent_status::checking_resume_data;
+    }, 0x0);
+
+    for (const auto& status : checking)
+    {
+        TorrentsListener::instance().reportCheckingProgress(status.handle, status);
+    }
+
+    if (checking.empty())
+    {
+        m_checkingProgressTimer.stop();
+    }
+}
+
+void TorrentManager::onTorrentChecked(int id)
+{
+    if (!m_pauseAfterCheck.remove(id))
+    {
+        return;
+    }
+
+    auto it = m_idToHandle.find(id);
+    if (it != m_idToHandle.end() && it.value().is_valid())
+    {
+        qDebug() << __FUNCTION__ << "pausing again after the recheck:" << it.value().name().c_str();
+        it.value().pause();
+    }
+}
+
+// Paused torrents are unloaded once they have been left alone for TorrentsHibernateAfterMinutes,
+// each one loaded costs its metadata, piece picker and peer list and a visit on every session tick
+void TorrentManager::hibernateIdleTorrents()
+{
+    const int idleMinutes = QSettings().value(TorrentsHibernateAfterMinutes, TorrentsHibernateAfterMinutes_Default).toInt();
+    if (idleMinutes <= 0)
+    {
+        m_idleSince.clear();
+        return;
+    }
+
+    // one call into the session instead of a status() round trip per torrent
+    std::vector<libtorrent::torrent_status> resting;
+    m_session->get_torrent_status(&resting, [](const libtorrent::torrent_status& status)
+    {
+        return status.paused && status.has_metadata && !status.errc
+            && status.state != libtorrent::torrent_status::queued_for_checking
+            && status.state != libtorrent::torrent_status::checking_files
+            && status.state != libtorrent::torrent_status::checking_resume_data;
+    }, 0x0);
+
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    QMap<int, QDateTime> idleSince;
+    QList<int> expired;
+    for (const auto& status : resting)
+    {
+        const int id = TorrentsListener::instance().getItemID(status.handle);
+        if (id == nullItemID)
+        {
+            continue;
+        }
+        const QDateTime since = m_idleSince.value(id, now);
+        idleSince.insert(id, since);
+        if (since.secsTo(now) >= idleMinutes * 60)
+        {
+            expired.push_back(id);
+        }
+    }
+    // torrents that were resumed in the meantime start over
+    m_idleSince.swap(idleSince);
+
+    for (int id : expired)
+    {
+        hibernateTorrent(id);
+    }
+}
+
+void TorrentManager::hibernateTorrent(int id)
+{
+    auto it = m_idToHandle.find(id);
+    if (it == m_idToHandle.end() || !it.value().is_valid())
+    {
+        return;
+    }
+
+    libtorrent::torrent_handle handle = it.value();
+    const QString hash = toQString(handle.info_hash());
+    const QString fileName = utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER) + hash;
+    if (!QFile::exists(fileName + ".torrent"))
+    {
+        return;
+    }
+    // The torrent is brought back from its .fastresume, wait for it to be current
+    if (handle.need_save_resume_data() || !QFile::exists(fileName + ".fastresume"))
+    {
+        handle.save_resume_data();
+        return;
+    }
+
+    qDebug() << __FUNCTION__ << "hibernating:" << handle.name().c_str();
+    HibernatedTorrent& torrent = m_hibernated[id];
+    torrent.infoHash = hash;
+    torrent.savePath = QString::fromStdString(handle.save_path());
+    const auto priorities = handle.file_priorities();
+    torrent.filePriorities.assign(priorities.begin(), priorities.end());
+
+    m_idToHandle.erase(it);
+    m_idleSince.remove(id);
+    m_session->remove_torrent(handle);
+}
+
+// Adds a hibernated torrent back to the session, paused as it was left
+libtorrent::torrent_handle TorrentManager::wakeTorrent(int id)
+{
+    auto it = m_hibernated.find(id);
+    if (it == m_hibernated.end())
+    {
+        return {};
+    }
+
+    const HibernatedTorrent torrent = it.value();
+    m_hibernated.erase(it);
+
+    qDebug() << __FUNCTION__ << "waking:" << torrent.infoHash;
+    return addTorrent(
+        utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER) + torrent.infoHash + ".torrent",
+        id,
+        false,
+        torrent.savePath,
+        torrent.filePriorities.empty() ? nullptr : &torrent.filePriorities);
+}
+
 libtorrent::torrent_handle TorrentManager::torrentByModelId(int id)
 {
     auto it = m_idToHandle.find(id);
-    return (it != m_idToHandle.end()) ? it.value() : libtorrent::torrent_handle();
+    return (it != m_idToHandle.end()) ? it.value() : wakeTorrent(id);
 }
 
 
 QString TorrentManager::torrentRootItemPath(int itemId)
 {
-    libtorrent::torrent_handle handle = torrentByModelId(itemId);
-    return ::torrentRootItemPath(handle);
+    // Only the path is needed, a hibernated torrent is read from its cached .torrent
+    // instead of being woken up
+    auto hibernated = m_hibernated.constFind(itemId);
+    if (hibernated != m_hibernated.constEnd())
+    {
+        const QString fileName = utilities::PrepareCacheFolder(TORRENTS_SUB_FOLDER)
+            + hibernated.value().infoHash + ".torrent";
+        libtorrent::error_code ec;
+        const libtorrent::torrent_info torrInfo(fileName.toUtf8().constData(), ec);
+        if (ec)
+        {
+            qWarning() << __FUNCTION__ << "cannot read" << fileName << QString::fromStdString(ec.message());
+            return QString();
+        }
+        return ::torrentRootItemPath(torrInfo, hibernated.value().savePath.toStdString());
+    }
+
+    auto it = m_idToHandle.find(itemId);
+    return (it != m_idToHandle.end()) ? ::torrentRootItemPath(it.value()) : QString();
 }
 
 int TorrentManager::port() const
@@ -2,21 +2,31 @@
 
 #include <libtorrent/session.hpp>
 #include <libtorrent/torrent_handle.hpp>
+#include <QByteArray>
+#include <QDateTime>
 #include <QString>
 #include <QObject>
 #include <QMap>
+#include <QSet>
 #include <QTimer>
 
+#include <future>
 #include <memory>
+#include <vector>
 
 #include "downloadtype.h"
 #include "treeitem.h"
 
 
 static const char TORRENTS_SUB_FOLDER[] = "torrents";
+static const char METADATA_CACHE_SUB_FOLDER[] = "metadata";
 
 QString toQString(const libtorrent::sha1_hash& hash);
 
+// Resolved magnets keep their .torrent here, by info hash, even after the task is removed
+QString metadataCachePath(const QString& infoHash);
+void pruneMetadataCache();
+
 class TorrentManager : public QObject
 {
     Q_OBJECT
@@ -26,6 +36,8 @@ public:
     static TorrentManager* Instance();
     static void dispose();
     static bool isSessionExists();
+    // Starts reading the saved session state in the background; call before the download model is loaded
+    static void preloadSessionState();
 
     void close();
 
@@ -39,8 +51,17 @@ public:
         bool interactive = false, 
         const QString& savePath = "",
         const std::vector<boost::uint8_t>* file_priorities = nullptr);
+    // The next addTorrent() of this file seeds it from savePath in seed mode, without checking the pieces
+    void expectCreatedTorrent(const QString& torrentFile, const QString& savePath);
+    // Registers a resting torrent without loading it; false if it has to be added with addTorrent()
+    bool addHibernatedTorrent(
+        const QString& infoHash,
+        int id,
+        const QString& savePath,
+        const std::vector<boost::uint8_t>* file_priorities = nullptr);
     bool resumeTorrent(int id);
     bool restartTorrent(int id);
+    bool recheckTorrent(int id);
 
     QString torrentRootItemPath(int itemId);
 
@@ -54,16 +75,42 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     int cacheResumeTorrentsData(bool fully_data_save = false);
+    void updateCheckingProgress();
+    void onTorrentChecked(int id);
+    void hibernateIdleTorrents();
 
 private:
     explicit TorrentManager();
+    libtorrent::storage_mode_t allocationModeFor(const QString& savePath);
+    void applyBlocklist();
+    void loadSessionState();
+    void saveSessionState();
+    void hibernateTorrent(int id);
+    libtorrent::torrent_handle wakeTorrent(int id);
     TorrentManager(const TorrentManager&) = delete;
     TorrentManager& operator =(const TorrentManager&) = delete;
 
     static std::unique_ptr<TorrentManager> m_instance;
 
+    // What it takes to add a hibernated torrent back, its state stays in the .fastresume file
+    struct HibernatedTorrent
+    {
+        QString infoHash;
+        QString savePath;
+        std::vector<boost::uint8_t> filePriorities;
+    };
+
     QMap<int, libtorrent::torrent_handle> m_idToHandle;
+    QMap<int, HibernatedTorrent> m_hibernated;
+    QMap<int, QDateTime> m_idleSince; // loaded torrents seen paused, since when
+    QSet<int> m_pauseAfterCheck; // paused torrents resumed only to be rechecked
     QTimer m_resumeDataTimer;
+    QTimer m_checkingProgressTimer;
+    QTimer m_hibernateTimer;
+    QMap<QString, bool> m_nativeAllocation; // save folder -> probe result
+    QByteArray m_sessionState; // bencoded session state as last loaded or saved
+    QMap<QString, QString> m_createdTorrents; // created .torrent -> folder holding its content
+    std::future<void> m_blocklistLoader;
 
     bool m_closed;
 
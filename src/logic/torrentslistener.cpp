@@ -12,20 +12,29 @@
 
 #include "utilities/utils.h"
 #include "utilities/notify_helper.h"
+#include "sessionmetrics.h"
 #include "addtorrentform.h"
 #include "mainwindow.h"
 
 #include <QMetaType>
 #include <QThread>
 #include <QApplication>
+#include <QEvent>
 #include <QDebug>
 #include <QPointer>
 
 #include <functional>
+#include <iterator>
 #include <utility>
 
 namespace {
 
+// Posted to the listener when the alert thread has published a batch of updates
+const QEvent::Type TorrentUpdatesEvent = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+// How often the session is asked for the status of the torrents that changed
+const auto TORRENT_UPDATES_INTERVAL = std::chrono::seconds(1);
+
 class AddTorrentFormHelper : public NotifyHelper
 {
 public:
@@ -87,11 +96,16 @@ private:
 TorrentsListener::TorrentsListener(QObject* parent /* = 0 */)
     : QObject(parent)
     , m_askAboutFilesChoose(false)
+    , m_applyUpdates(true)
+    , m_stopping(false)
+    , m_resumeDataExpected(0)
+    , m_resumeDataSeen(0)
 {
 }
 
 TorrentsListener::~TorrentsListener()
 {
+    Q_ASSERT_X(!m_alertThread.joinable(), Q_FUNC_INFO, "stopAlertDispatch() was not called");
 }
 
 
@@ -108,23 +122,124 @@ void TorrentsListener::setAlertDispatch(libtorrent::session* s)
 
     static_assert(alertMask != 0, "alertMask should not be equal to zero");
 
-    s->set_alert_mask(alertMask);
+    // session_stats_alert is posted on request whatever the mask, while its category
+    // would also turn on a stats_alert per torrent every second
+    s->set_alert_mask(alertMask & ~libtorrent::alert::stats_notification);
 
-    s->set_alert_dispatch(std::bind(&TorrentsListener::alertDispatch, this, _1));
     s->add_extension(boost::shared_ptr<libtorrent::plugin>(new TorrentsListenerExtension(
         std::bind(&TorrentsListener::onTorrentAdded, this, _1, _2))));
+
+    m_stopping = false;
+    m_alertThread = std::thread(&TorrentsListener::alertLoop, this, s);
 }
 
 #undef ALERT_MASK_DEF
 
+void TorrentsListener::beginShutdown()
+{
+    m_applyUpdates = false;
+    m_resumeDataSeen = 0;
+}
+
+void TorrentsListener::stopAlertDispatch(int pendingResumeData)
+{
+    if (!m_alertThread.joinable())
+    {
+        return;
+    }
+    m_resumeDataExpected = pendingResumeData;
+    m_stopDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    m_stopping = true;
+    m_alertThread.join();
+}
+
+// Alerts are handled here instead of on the libtorrent network thread: the handlers
+// make blocking calls into the session and would otherwise stall it
+void TorrentsListener::alertLoop(libtorrent::session* s)
+{
+    std::vector<libtorrent::alert*> alerts;
+    auto lastUpdatesRequest = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        s->wait_for_alert(libtorrent::milliseconds(250));
+        s->pop_alerts(&alerts);
+        for (auto* a : alerts)
+        {
+            alertDispatch(a);
+        }
+
+        // one event for whatever the GUI thread hasn't picked up yet
+        if (m_updates.publish())
+        {
+            QCoreApplication::postEvent(this, new QEvent(TorrentUpdatesEvent));
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (m_stopping)
+        {
+            if (m_resumeDataSeen >= m_resumeDataExpected || now > m_stopDeadline)
+            {
+                break;
+            }
+        }
+        else if (now - lastUpdatesRequest >= TORRENT_UPDATES_INTERVAL)
+        {
+            // answered by a single state_update_alert for all torrents that changed
+            s->post_torrent_updates(libtorrent::torrent_handle::query_accurate_download_counters);
+            lastUpdatesRequest = now;
+        }
+    }
+}
+
+void TorrentsListener::customEvent(QEvent* event)
+{
+    if (event->type() != TorrentUpdatesEvent)
+    {
+        QObject::customEvent(event);
+        return;
+    }
+
+    if (TorrentUpdateBatch* batch = m_updates.take())
+    {
+        if (m_applyUpdates)
+        {
+            applyUpdates(*batch);
+        }
+        m_updates.recycle(batch);
+    }
+}
+
+void TorrentsListener::applyUpdates(const TorrentUpdateBatch& batch)
+{
+    DownloadCollectionModel::instance().applyTorrentUpdates(batch.updates);
+    SessionMetrics::instance().add(SessionMetrics::ModelUpdates, batch.updates.size());
+
+    for (const auto& u : batch.updates)
+    {
+        if (u.fields & TorrentUpdate::Progress)
+        {
+            emit progressUpdated(u.id);
+        }
+        if (u.fields & TorrentUpdate::Speed)
+        {
+            emit speedUpdated(u.id);
+        }
+    }
+
+    if (batch.tryNewTask)
+    {
+        emit signalTryNewtask();
+    }
+}
+
 
 #define CASE_DEF(r, data, elem) \
     if (typeid_ == typeid(libtorrent::elem)) \
-        handler(*static_cast<libtorrent::elem*>(p.get())); \
+        handler(*static_cast<libtorrent::elem*>(p)); \
     else
 
 
-void TorrentsListener::alertDispatch(std::auto_ptr<libtorrent::alert> p)
+void TorrentsListener::alertDispatch(libtorrent::alert* p)
 {
     const std::type_info& typeid_ = typeid(*p);
     BOOST_PP_SEQ_FOR_EACH(CASE_DEF, _, ALERTS_OF_INTEREST)
@@ -141,40 +256,40 @@ void TorrentsListener::alertDispatch(std::auto_ptr<libtorrent::alert> p)
 #define TRACE_ALERT
 #endif
 
-void TorrentsListener::handler(libtorrent::stats_alert const& a)
+void TorrentsListener::handler(libtorrent::state_update_alert const& a)
 {
     //TRACE_ALERT
-    libtorrent::torrent_status status = a.handle.status(libtorrent::torrent_handle::query_accurate_download_counters);
-
-    if (status.state == libtorrent::torrent_status::downloading)
-    {
-        ItemDC item;
-        item.setID(getItemID(a.handle));
-        item.setSize(status.total_wanted);
-        item.setSizeCurrDownl(status.total_wanted_done);
-
-        float downloadSpeed = status.download_payload_rate / 1024.0;
-        item.setSpeed(downloadSpeed);
-        float uploadSpeed = status.upload_payload_rate / 1024.0;
-        item.setSpeedUpload(uploadSpeed);
-        item.setStatus(downloadSpeed > 0 ? ItemDC::eDOWNLOADING : ItemDC::eSTALLED);
-        emit statusChange(item);
-        emit speedChange(item);
-        emit sizeCurrDownlChange(item);
-
-        emit signalTryNewtask(); // TODO fine tune
-    }
-    else if (status.state == libtorrent::torrent_status::seeding
-        || status.state == libtorrent::torrent_status::finished)
+    TorrentUpdateBatch& batch = m_updates.producing();
+    for (const libtorrent::torrent_status& status : a.status)
     {
-        float uploadSpeed = status.upload_payload_rate / 1024.0;
-        ItemDC item;
-        item.setID(getItemID(a.handle));
-        item.setSpeedUpload(uploadSpeed);
-        emit speedChange(item);
+        if (status.state == libtorrent::torrent_status::downloading)
+        {
+            TorrentUpdate u(getItemID(status.handle),
+                TorrentUpdate::Status | TorrentUpdate::Speed | TorrentUpdate::Progress);
+            u.size = status.total_wanted;
+            u.sizeDone = status.total_wanted_done;
+            u.speed = status.download_payload_rate / 1024.0;
+            u.speedUpload = status.upload_payload_rate / 1024.0;
+            u.status = u.speed > 0 ? ItemDC::eDOWNLOADING : ItemDC::eSTALLED;
+            batch.updates.push_back(u);
+
+            batch.tryNewTask = true; // TODO fine tune
+        }
+        else if (status.state == libtorrent::torrent_status::seeding
+            || status.state == libtorrent::torrent_status::finished)
+        {
+            TorrentUpdate u(getItemID(status.handle), TorrentUpdate::Speed);
+            u.speedUpload = status.upload_payload_rate / 1024.0;
+            batch.updates.push_back(u);
+        }
     }
 }
 
+void TorrentsListener::handler(libtorrent::session_stats_alert const& a)
+{
+    SessionMetrics::instance().postSample(std::vector<quint64>(std::begin(a.values), std::end(a.values)));
+}
+
 void TorrentsListener::handler(libtorrent::torrent_removed_alert const& a)
 {
     TRACE_ALERT
@@ -185,14 +300,10 @@ void TorrentsListener::handler(libtorrent::torrent_removed_alert const& a)
 void TorrentsListener::handler(libtorrent::torrent_paused_alert const& a)
 {
     TRACE_ALERT
-    ItemDC item;
-    item.setID(getItemID(a.handle));
-    const auto newStatus 
-        = (a.handle.is_seed() || a.handle.is_finished()) ? ItemDC::eFINISHED : ItemDC::ePAUSED;
-    item.setStatus(newStatus);
-    emit speedChange(item);
-    emit uploadSpeedChange(item);
-    emit statusChange(item);
+    // speeds are reset to 0 along with the status
+    TorrentUpdate u(getItemID(a.handle), TorrentUpdate::Speed | TorrentUpdate::Status);
+    u.status = (a.handle.is_seed() || a.handle.is_finished()) ? ItemDC::eFINISHED : ItemDC::ePAUSED;
+    m_updates.producing().updates.push_back(u);
 }
 
 void TorrentsListener::handler(libtorrent::torrent_resumed_alert const& a)
@@ -200,21 +311,25 @@ void TorrentsListener::handler(libtorrent::torrent_resumed_alert const& a)
     TRACE_ALERT
     if (a.handle.is_seed() || a.handle.is_finished())
     {
-        ItemDC item;
-        item.setStatus(ItemDC::eSEEDING);
-        item.setID(getItemID(a.handle));
-        emit statusChange(item);
+        TorrentUpdate u(getItemID(a.handle), TorrentUpdate::Status);
+        u.status = ItemDC::eSEEDING;
+        m_updates.producing().updates.push_back(u);
     }
 }
 
+void TorrentsListener::handler(libtorrent::torrent_checked_alert const& a)
+{
+    TRACE_ALERT
+    emit torrentChecked(getItemID(a.handle));
+}
+
 void TorrentsListener::handler(libtorrent::file_error_alert const& a)
 {
     TRACE_ALERT
-    ItemDC item;
-    item.setID(getItemID(a.handle));
-    item.setStatus(ItemDC::eERROR);
-    item.setErrorDescription(QString::fromLocal8Bit(a.error.message().c_str()));
-    emit statusChange(item);
+    TorrentUpdate u(getItemID(a.handle), TorrentUpdate::Status);
+    u.status = ItemDC::eERROR;
+    u.errorDescription = QString::fromLocal8Bit(a.error.message().c_str());
+    m_updates.producing().updates.push_back(u);
 }
 
 void TorrentsListener::handler(libtorrent::metadata_received_alert const& a)
@@ -241,9 +356,16 @@ void TorrentsListener::handler(libtorrent::storage_moved_alert const& a)
     emit torrentMoved(item);
 }
 
+void TorrentsListener::handler(libtorrent::save_resume_data_failed_alert const& a)
+{
+    TRACE_ALERT
+    ++m_resumeDataSeen;
+}
+
 void TorrentsListener::handler(libtorrent::save_resume_data_alert const& a)
 {
     TRACE_ALERT
+    ++m_resumeDataSeen;
     if (!a.resume_data)
     {
         return;
@@ -276,8 +398,7 @@ void TorrentsListener::handler(libtorrent::save_resume_data_alert const& a)
 void TorrentsListener::handler(libtorrent::state_changed_alert const& a)
 {
     TRACE_ALERT
-    ItemDC item;
-    item.setID(getItemID(a.handle));
+    TorrentUpdate u(getItemID(a.handle), TorrentUpdate::Status);
 
     switch (a.state)
     {
@@ -286,31 +407,47 @@ void TorrentsListener::handler(libtorrent::state_changed_alert const& a)
         {
             return;
         }
-        item.setStatus(ItemDC::eSEEDING);
+        u.status = ItemDC::eSEEDING;
         break;
     case libtorrent::torrent_status::finished:
         {
-            item.setStatus(a.handle.status(0x0).paused
-                ? ItemDC::eFINISHED : ItemDC::eSEEDING);
-            item.setSpeed(0);
+            u.status = a.handle.status(0x0).paused
+                ? ItemDC::eFINISHED : ItemDC::eSEEDING;
             libtorrent::torrent_status status = a.handle.status(libtorrent::torrent_handle::query_accurate_download_counters);
-            item.setSize(status.total_wanted);
-            item.setSizeCurrDownl(status.total_wanted_done);
-            item.setDownloadType(DownloadType::TorrentFile);
-            emit sizeCurrDownlChange(item);
-            emit speedChange(item);
+            u.fields |= TorrentUpdate::Speed | TorrentUpdate::Progress;
+            u.size = status.total_wanted;
+            u.sizeDone = status.total_wanted_done;
         }
         break;
+    case libtorrent::torrent_status::checking_files:
+        u.status = ItemDC::eCHECKING;
+        break;
     default:
         return;
     }
 
-    emit statusChange(item);
-
-    emit signalTryNewtask(); // TODO fine tune
+    TorrentUpdateBatch& batch = m_updates.producing();
+    batch.updates.push_back(u);
+    batch.tryNewTask = true; // TODO fine tune
 }
 
 
+void TorrentsListener::reportCheckingProgress(const libtorrent::torrent_handle& handle, const libtorrent::torrent_status& status)
+{
+    // called in the GUI thread, nothing to hand over
+    TorrentUpdateBatch batch;
+    TorrentUpdate u(getItemID(handle), TorrentUpdate::Status | TorrentUpdate::Progress);
+    u.status = ItemDC::eCHECKING;
+    u.size = status.total_wanted;
+    // while checking, progress is the part of the files that has been checked
+    u.sizeDone = status.total_wanted * status.progress_ppm / 1000000;
+    batch.updates.push_back(u);
+    if (m_applyUpdates)
+    {
+        applyUpdates(batch);
+    }
+}
+
 void TorrentsListener::onTorrentAdded(libtorrent::torrent_handle handle, void* userData)
 {
     const int id = (int)(intptr_t)userData;
@@ -354,6 +491,13 @@ void TorrentsListener::saveTorrentFile(const libtorrent::torrent_handle& handle)
         {
             torrent_file.write(&out[0], out.size());
             torrent_file.close();
+
+            // Adding the same magnet again will not have to fetch the metadata
+            const QString cachePath = metadataCachePath(toQString(handle.info_hash()));
+            if (!QFile::exists(cachePath) && QFile::copy(fileName, cachePath))
+            {
+                pruneMetadataCache();
+            }
         }
     }
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <QObject>
 #include <QReadWriteLock>
 
@@ -10,6 +13,7 @@
 
 #include "utilities/singleton.h"
 #include "treeitem.h"
+#include "torrentupdatequeue.h"
 
 // status conversion
 inline ItemDC::eSTATUSDC torrentStatus2ItemDCStatus(libtorrent::torrent_status::state_t state)
@@ -20,8 +24,9 @@ inline ItemDC::eSTATUSDC torrentStatus2ItemDCStatus(libtorrent::torrent_status::
         return ItemDC::eSEEDING;
     case libtorrent::torrent_status::finished:
         return ItemDC::eFINISHED;
-    case libtorrent::torrent_status::downloading_metadata:
     case libtorrent::torrent_status::checking_files:
+        return ItemDC::eCHECKING;
+    case libtorrent::torrent_status::downloading_metadata:
     case libtorrent::torrent_status::allocating:
     case libtorrent::torrent_status::checking_resume_data:
         return ItemDC::eSTARTING;
@@ -35,13 +40,16 @@ inline ItemDC::eSTATUSDC torrentStatus2ItemDCStatus(libtorrent::torrent_status::
 
 #define ALERTS_OF_INTEREST \
     (save_resume_data_alert)\
+    (save_resume_data_failed_alert)\
     (storage_moved_alert)\
     (metadata_received_alert)\
     (file_error_alert)\
     (torrent_paused_alert)\
     (torrent_resumed_alert)\
     (torrent_removed_alert)\
-    (stats_alert)\
+    (state_update_alert)\
+    (torrent_checked_alert)\
+    (session_stats_alert)\
     (state_changed_alert)
 
 #if 0
@@ -62,7 +70,6 @@ inline ItemDC::eSTATUSDC torrentStatus2ItemDCStatus(libtorrent::torrent_status::
 (fastresume_rejected_alert)\
 (url_seed_alert)\
 (listen_succeeded_alert)\
-(torrent_checked_alert)\
 (add_torrent_alert)\
 (block_downloading_alert)\
 (block_timeout_alert)\
@@ -90,22 +97,28 @@ class TorrentsListener : public QObject, public Singleton<TorrentsListener>
 friend class Singleton<TorrentsListener>;
 
 public:
+    // Starts the thread that pops the session's alerts
     void setAlertDispatch(libtorrent::session* s);
+    // Stops applying updates to the model, call before pausing the session on exit
+    void beginShutdown();
+    // Waits for pendingResumeData resume data alerts (10 s at most) and stops the alert thread
+    void stopAlertDispatch(int pendingResumeData);
     void setAt(ItemID id, const libtorrent::torrent_handle& handle);
     void setFileDialogEnabled(bool enabled);
 
     ItemID getItemID(const libtorrent::torrent_handle& h) const; // synchronized
 
     void handleItemMetadata(const libtorrent::torrent_handle& handle);
+    void reportCheckingProgress(const libtorrent::torrent_handle& handle, const libtorrent::torrent_status& status);
 
 signals:
-    void statusChange(const ItemDC& a_item);
-    void sizeCurrDownlChange(const ItemDC& a_item);
-    void sizeChange(const ItemDC& a_item);
-    void speedChange(const ItemDC& a_item);
-    void uploadSpeedChange(const ItemDC& a_item);
+    // emitted in the GUI thread once the model has the new values
+    void progressUpdated(ItemID id);
+    void speedUpdated(ItemID id);
     void itemMetadataReceived(const ItemDC& item);
     void torrentMoved(const ItemDC& item);
+    // emitted in the alert thread
+    void torrentChecked(int id);
 
     void signalTryNewtask();
 
@@ -113,9 +126,13 @@ private:
     TorrentsListener(QObject* parent = 0);
     ~TorrentsListener();
 
-    void alertDispatch(std::auto_ptr<libtorrent::alert> p);
+    void alertLoop(libtorrent::session* s);
+    void alertDispatch(libtorrent::alert* p);
     void onTorrentAdded(libtorrent::torrent_handle handl, void* userData);
 
+    void customEvent(QEvent* event) override;
+    void applyUpdates(const TorrentUpdateBatch& batch);
+
     void saveTorrentFile(const libtorrent::torrent_handle& handle);
     void askOpentorrentUser(const libtorrent::torrent_handle& handle);
 
@@ -129,4 +146,12 @@ private:
     QMap<libtorrent::torrent_handle, int> m_handleToId;
     mutable QReadWriteLock m_handleMapWriteDataLock;
     bool m_askAboutFilesChoose;
+
+    std::thread m_alertThread;
+    TorrentUpdateQueue m_updates; // filled by the alert thread, applied by the GUI thread
+    bool m_applyUpdates;
+    std::atomic<bool> m_stopping;
+    std::atomic<int> m_resumeDataExpected;
+    std::atomic<int> m_resumeDataSeen;
+    std::chrono::steady_clock::time_point m_stopDeadline; // set before m_stopping
 };
@@ -0,0 +1,64 @@
+#include "torrentupdatequeue.h"
+
+#include <iterator>
+
+
+TorrentUpdateQueue::TorrentUpdateQueue()
+    : m_producing(new TorrentUpdateBatch)
+    , m_ready(nullptr)
+    , m_spare(nullptr)
+    , m_wakeupPending(false)
+{
+}
+
+TorrentUpdateQueue::~TorrentUpdateQueue()
+{
+    delete m_producing;
+    delete m_ready.load();
+    delete m_spare.load();
+}
+
+bool TorrentUpdateQueue::publish()
+{
+    if (m_producing->empty())
+    {
+        return false;
+    }
+
+    // Once exchanged out, the ready batch belongs to us until it is stored back
+    TorrentUpdateBatch* ready = m_ready.exchange(nullptr);
+    if (ready)
+    {
+        // the consumer is behind: add to what it hasn't seen yet
+        ready->updates.insert(ready->updates.end(),
+            std::make_move_iterator(m_producing->updates.begin()),
+            std::make_move_iterator(m_producing->updates.end()));
+        ready->tryNewTask = ready->tryNewTask || m_producing->tryNewTask;
+        m_producing->clear();
+    }
+    else
+    {
+        ready = m_producing;
+        m_producing = m_spare.exchange(nullptr);
+        if (!m_producing)
+        {
+            m_producing = new TorrentUpdateBatch;
+        }
+    }
+    m_ready.store(ready);
+
+    return !m_wakeupPending.exchange(true);
+}
+
+TorrentUpdateBatch* TorrentUpdateQueue::take()
+{
+    // cleared first: a batch published from now on wakes us up again
+    m_wakeupPending.store(false);
+    return m_ready.exchange(nullptr);
+}
+
+void TorrentUpdateQueue::recycle(TorrentUpdateBatch* batch)
+{
+    batch->clear();
+    delete m_spare.exchange(batch);
+}
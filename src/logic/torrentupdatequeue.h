@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+#include <vector>
+
+#include "treeitem.h"
+
+// One model change produced from a torrent alert
+struct TorrentUpdate
+{
+    enum Field
+    {
+        Status = 1,     // status, errorDescription
+        Speed = 2,      // speed, speedUpload
+        Progress = 4    // size, sizeDone
+    };
+
+    TorrentUpdate(ItemID id_, int fields_)
+        : id(id_), fields(fields_), status(ItemDC::eUNKNOWN)
+        , speed(0), speedUpload(0), size(0), sizeDone(0) {}
+
+    ItemID id;
+    int fields;
+    ItemDC::eSTATUSDC status;
+    float speed;
+    float speedUpload;
+    qint64 size;
+    qint64 sizeDone;
+    QString errorDescription;
+};
+
+struct TorrentUpdateBatch
+{
+    TorrentUpdateBatch() : tryNewTask(false) {}
+
+    bool empty() const { return updates.empty() && !tryNewTask; }
+    void clear()
+    {
+        updates.clear();
+        tryNewTask = false;
+    }
+
+    std::vector<TorrentUpdate> updates;
+    bool tryNewTask; // some torrent started or finished downloading
+};
+
+// Hands batches of updates from the alert thread (the only producer) to the GUI thread
+// (the only consumer) without locks. The producer fills one batch while the consumer
+// applies another; a published batch the consumer hasn't taken yet is appended to.
+// At most three batches exist and their vectors keep their capacity between rounds.
+class TorrentUpdateQueue
+{
+public:
+    TorrentUpdateQueue();
+    ~TorrentUpdateQueue();
+
+    // producer: the batch being filled
+    TorrentUpdateBatch& producing() { return *m_producing; }
+    // producer: makes the filled batch visible to the consumer. Returns true if the
+    // consumer has to be woken up, i.e. it has taken everything published before
+    bool publish();
+
+    // consumer: everything published so far, or nullptr. Hand it back with recycle()
+    TorrentUpdateBatch* take();
+    void recycle(TorrentUpdateBatch* batch);
+
+private:
+    TorrentUpdateQueue(const TorrentUpdateQueue&) = delete;
+    TorrentUpdateQueue& operator =(const TorrentUpdateQueue&) = delete;
+
+    TorrentUpdateBatch* m_producing;
+    std::atomic<TorrentUpdateBatch*> m_ready;
+    std::atomic<TorrentUpdateBatch*> m_spare;
+    std::atomic<bool> m_wakeupPending;
+};
@@ -32,6 +32,7 @@ QString itemDCStatusToString(const ItemDC::eSTATUSDC status)
         { ItemDC::eSTALLED,     TREEVIEW_STALLED_STATUS },
         { ItemDC::eSTARTING,    TREEVIEW_STARTING_STATUS },
         { ItemDC::eSTOPPED,     TREEVIEW_STOPPED_STATUS },
+        { ItemDC::eCHECKING,    TREEVIEW_CHECKING_STATUS },
     };
 
     auto it = statusToTr.find(status);
@@ -44,7 +45,7 @@ void ItemDC::setStatusEx(int val)
 {
     // TODO validate
     m_eStatus = (eSTATUSDC) val;
-    if (eDOWNLOADING == m_eStatus || eCONNECTING == m_eStatus || eSTALLED == m_eStatus)
+    if (eDOWNLOADING == m_eStatus || eCONNECTING == m_eStatus || eSTALLED == m_eStatus || eCHECKING == m_eStatus)
     {
         m_eStatus = eQUEUED;
     }
@@ -57,7 +57,8 @@ public:
         eSTALLED,
         eSTARTING,
         eSTOPPED,
-        eUNKNOWN
+        eUNKNOWN,
+        eCHECKING
     };
 
     bool isValid() const { return m_ID != nullItemID; }
@@ -69,6 +69,7 @@ Tr::Translation TREEVIEW_STALLED_STATUS              = Tr::translate("MainWindow
 
 Tr::Translation TREEVIEW_SEEDING_STATUS              = Tr::translate("MainWindow", "Seeding");
 Tr::Translation TREEVIEW_STARTING_STATUS             = Tr::translate("MainWindow", "Starting");
+Tr::Translation TREEVIEW_CHECKING_STATUS             = Tr::translate("MainWindow", "Checking");
 
 Tr::Translation TREEVIEW_TITLE_HEADER                = Tr::translate("MainWindow", "Name");
 Tr::Translation TREEVIEW_STATUS_HEADER               = Tr::translate("MainWindow", "Status");
@@ -83,6 +84,7 @@ Tr::Translation TREEVIEW_MENU_MOVEDOWN               = Tr::translate("AddLinks",
 Tr::Translation TREEVIEW_MENU_OPENFOLDER             = Tr::translate("MainWindow", "Open in folder");
 Tr::Translation TREEVIEW_MENU_CANCEL                 = Tr::translate("MainWindow", "Cancel");
 Tr::Translation TREEVIEW_MENU_REMOVE                 = Tr::translate("MainWindow", "Remove");
+Tr::Translation TREEVIEW_MENU_RECHECK                = Tr::translate("MainWindow", "Recheck");
 
 Tr::Translation ABOUT_TITLE                          = Tr::translate("MainWindow", "About %1");
 
@@ -68,6 +68,8 @@ int main(int argc, char* argv[])
     Application::setStyle(new LIIIStyle);
     app.retranslateApp(QSettings().value(app_settings::ln, app_settings::ln_Default).toString());
 
+    // The session state file is read while the model file is parsed
+    TorrentManager::preloadSessionState();
     DownloadCollectionModel::instance().init();
 
     MainWindow w;
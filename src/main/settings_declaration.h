@@ -30,6 +30,32 @@ const int TrafficLimitKbs_Default = 1000;
 const char TorrentsSequentialDownload[] = "TorrentsSequentialDownload";
 const bool TorrentsSequentialDownload_Default = true;
 
+// 0 - auto (fast allocation when the file system supports it, sparse otherwise),
+// 1 - sparse, 2 - fast allocation, 3 - full allocation
+const char TorrentsAllocationMode[] = "TorrentsAllocationMode";
+const int TorrentsAllocationMode_Default = 0;
+
+// Send pieces to unencrypted TCP peers straight from the files (Linux only)
+const char TorrentsZeroCopySeeding[] = "TorrentsZeroCopySeeding";
+const bool TorrentsZeroCopySeeding_Default = true;
+
+// Number of threads issuing peer socket reads and writes, peers are spread over them (0 - main thread only)
+const char TorrentsNetworkThreads[] = "TorrentsNetworkThreads";
+const int TorrentsNetworkThreads_Default = 0;
+
+// Memory the DHT may use for the torrents, peers and items other nodes store with us, in MiB
+const char TorrentsDhtStorageMemoryMb[] = "TorrentsDhtStorageMemoryMb";
+const int TorrentsDhtStorageMemoryMb_Default = 64;
+
+// Paused and finished torrents idle this long are unloaded from the session until needed again, in minutes (0 - never)
+const char TorrentsHibernateAfterMinutes[] = "TorrentsHibernateAfterMinutes";
+const int TorrentsHibernateAfterMinutes_Default = 30;
+
+// eMule (ipfilter.dat) or P2P (.p2p, optionally gzipped) list of addresses to block, empty - none
+const char TorrentsBlocklistPath[] = "TorrentsBlocklistPath";
+// Identifies the list the parsed blocklist cache was built from (path, size and modification time)
+const char TorrentsBlocklistCacheStamp[] = "TorrentsBlocklistCacheStamp";
+
 const char VideoFolder[] = "VideoFolder";
 
 const char UnlimitedLabel[] = "UnlimitedLabel";
@@ -66,4 +92,12 @@ const bool UseProxy_Default = false;
 const char ProxyAddress[] = "ProxyAddress";
 
 const char ProxyPort[] = "ProxyPort";
+
+// How often session and application metrics are sampled and exported, 0 turns them off
+const char MetricsIntervalSec[] = "MetricsIntervalSec";
+const int MetricsIntervalSec_Default = 5;
+
+// Loopback port serving the metrics in Prometheus text format, 0 keeps it closed
+const char MetricsPort[] = "MetricsPort";
+const int MetricsPort_Default = 0;
 } // namespace app_settings